@@ -1,23 +1,25 @@
 #include "Thaumazein.h"
 #include "mpr121_daisy.h"
-// #include "DelayEffect.h"
 #include "Polyphony.h" // Add include for PolyphonyEngine
+#include "DelayEffect.h"
 #include <cmath>
 #include <algorithm>
 #include <vector> // Add vector for dynamic list
 
 // const float MASTER_VOLUME = 0.7f; // Master output level scaler // REMOVED - Defined in Thaumazein.h
 
-int  DetermineEngineSettings();
 // void ConfigureDelaySettings(); // Ensure this is removed or commented
 // void ProcessAudioOutput(AudioHandle::InterleavingOutputBuffer out, size_t size, float dry_level); // Ensure this is removed or commented
 void UpdatePerformanceMonitors(size_t size, AudioHandle::InterleavingOutputBuffer out);
+void PushTelemetryFrame();
+void LogDeadlineEvent(bool arp_on);
 
 // New helper function declarations
 void ProcessUIAndControls();
-void UpdateArpState(int& engineIndex, bool& poly_mode, int& effective_num_voices, bool& arp_on);
-void RenderVoices(int engineIndex, bool poly_mode, int effective_num_voices, bool arp_on);
-void ApplyEffectsAndOutput(AudioHandle::InterleavingOutputBuffer out, size_t size);
+void ApplyVocoderInsert(AudioHandle::InterleavingInputBuffer in, const float* mix, float* out);
+void ApplyEffectsAndOutput(AudioHandle::InterleavingInputBuffer in, AudioHandle::InterleavingOutputBuffer out, size_t size);
+bool IsSynthActive();
+void RenderIdleBlock(AudioHandle::InterleavingOutputBuffer out, size_t size);
 
 // Global variables for data sharing between decomposed functions
 
@@ -29,12 +31,6 @@ extern bool voice_active[NUM_VOICES];
 // CpuLoadMeter cpu_meter; // Removed: Now defined in Interface.cpp
 
 
-static bool was_arp_on = false; // For ARP state change detection
-
-volatile int current_engine_index = 0; // Global engine index controlled by touch pads
-
-// ADD: flag to indicate engine change so we can retrigger voices even when notes are held
-volatile bool engine_changed_flag = false;
 // 0 = inactive, 2 = send trigger low this block, 1 = send trigger high next block
 volatile int engine_retrigger_phase = 0;
 
@@ -42,19 +38,58 @@ volatile int engine_retrigger_phase = 0;
 clouds::GranularProcessor clouds_processor;
 uint8_t cloud_buffer[118784]; // Placed in SDRAM via DSY_SDRAM_BSS in .h
 uint8_t cloud_buffer_ccm[65408]; // Placed in DTCM via DSY_DTCM_BSS in .h
+float clouds_grain_staging[kCloudsGrainStagingSize]; // DTCM, see .h
 // End Clouds Integration
 
+VocoderInsert vocoder_insert;
+
+#ifdef POST_REVERB
+ReverbSc16 post_reverb;
+uint8_t post_reverb_buffer[kPostReverbBufferSize]; // Placed in SDRAM via DSY_SDRAM_BSS in .h
+float post_reverb_mix = 0.0f;
+#endif
+
+// Cycles spent in each callback stage during the last block
+static uint32_t stage_cycles[STAGE_LAST];
+
+JournalEvent control_journal_events[kControlJournalSize]; // Placed in SDRAM via DSY_SDRAM_BSS in .h
+
+#ifdef USE_SD_CARD
+// Streaming ring in AXI SRAM (.bss) so the SDMMC IDMA can reach it; the head
+// is copied out of the ring at load, so SDRAM is fine for it.
+alignas(32) int16_t sample_stream_ring[SampleStreamer::kRingSize];
+int16_t sample_head[SampleVoice::kHeadSize]; // Placed in SDRAM via DSY_SDRAM_BSS in .h
+#endif
+
+#ifdef RECORD_PERFORMANCE
+alignas(32) uint8_t recorder_ring[AudioRecorder::kRingBlocks * kRecorderBlockBytes]; // Placed in SDRAM via DSY_SDRAM_BSS in .h
+AudioRecorder recorder;
+#ifdef RECORD_DRY
+alignas(32) uint8_t dry_recorder_ring[AudioRecorder::kRingBlocks * kDryRecorderBlockBytes]; // Placed in SDRAM via DSY_SDRAM_BSS in .h
+AudioRecorder dry_recorder;
+#endif
+#endif
+
 void AudioCallback(AudioHandle::InterleavingInputBuffer in,
                  AudioHandle::InterleavingOutputBuffer out,
                  size_t size) {
     // Removed one-off debug print
     // Process UI controls at 1ms intervals inside audio callback
     static uint32_t last_ui_time = 0;
+    uint32_t stage_start = ReadCycleCounter();
+    deadline_monitor.BlockStart(stage_start);
     uint32_t now_ms = hw.system.GetNow();
     if(now_ms - last_ui_time >= 1) {
         last_ui_time = now_ms;
         ProcessUIAndControls();
     }
+    // Before the engine and layout flags are consumed below
+    JournalControls();
+    // Before the idle detector, which stays awake for the audio input source
+    vocoder_insert.SetSource(static_cast<VocoderInsert::Source>(vocoder_source));
+    uint32_t stage_end = ReadCycleCounter();
+    stage_cycles[STAGE_CONTROLS] = stage_end - stage_start;
+    stage_start = stage_end;
     cpu_meter.OnBlockStart(); // Mark the beginning of the audio block
     
     // Variables to be passed between helper functions
@@ -63,101 +98,120 @@ void AudioCallback(AudioHandle::InterleavingInputBuffer in,
     int effective_num_voices;
     bool arp_on;
 
-    // React to engine change flag by delegating voice migration to DSP layer.
-    static int prev_engine_index_static = 0;
-    if(engine_changed_flag) {
-        poly_engine.OnEngineChange(prev_engine_index_static, current_engine_index);
-        prev_engine_index_static = current_engine_index;
-        engine_changed_flag = false; // Clear flag after handling
-    }
-
+    // From here on the block is ControlPath.cpp, which tools/bench replays
+    HandleEngineAndLayoutChange();
     UpdateArpState(engineIndex, poly_mode, effective_num_voices, arp_on);
-    RenderVoices(engineIndex, poly_mode, effective_num_voices, arp_on);
-    ApplyEffectsAndOutput(out, size);
+    if (idle_detector.Update(IsSynthActive(), adc_raw_values)) {
+        stage_cycles[STAGE_VOICES] = 0;
+        RenderIdleBlock(out, size);
+    } else {
+        RenderVoices(engineIndex, poly_mode, effective_num_voices, arp_on);
+        stage_end = ReadCycleCounter();
+        stage_cycles[STAGE_VOICES] = stage_end - stage_start;
+        stage_start = stage_end;
+
+        ApplyEffectsAndOutput(in, out, size);
+        float peak = 0.0f;
+        for (size_t i = 0; i < size; ++i) {
+            peak = std::max(peak, fabsf(out[i]));
+        }
+        idle_detector.ObserveOutput(peak);
+    }
+#ifdef RECORD_PERFORMANCE
+    // One block copy; the main loop writes it out (ServiceRecording)
+    recorder.Capture(out);
+#endif
 
     // Clouds Integration: Call Prepare()
     clouds_processor.Prepare();
     // End Clouds Integration
+    stage_end = ReadCycleCounter();
+    stage_cycles[STAGE_EFFECTS] = stage_end - stage_start;
 
     cpu_meter.OnBlockEnd(); // Mark the end of the audio block
+    DeadlineMonitor::EventKind deadline_event = deadline_monitor.BlockEnd(stage_end);
+    if (deadline_event != DeadlineMonitor::EVENT_NONE) {
+        LogDeadlineEvent(arp_on);
+    }
+    if (deadline_event == DeadlineMonitor::EVENT_MISS || deadline_event == DeadlineMonitor::EVENT_LATE_START) {
+        // Keep the lead-up to the glitch for tools/bench --journal
+        control_journal.Freeze();
+    }
+    UpdatePerformanceMonitors(size, out);
 }
 
 void ProcessUIAndControls() {
     ProcessControls();
     ReadKnobValues();
-    
-    // Tempo control for arpeggiator via timing knob
-    if (arp_enabled) {
-        arp.SetMainTempoFromKnob(delay_time_val);
-    }
-
-    float touch_control = touch_cv_value; 
-    
-    float intensity_factor = 0.5f;
-
-    morph_knob_val   = morph_knob_val   * (1.0f - intensity_factor) + touch_control * intensity_factor;
-    // delay_feedback_val = delay_feedback_val * (1.0f - intensity_factor) + touch_control * intensity_factor;  // Delay effect removed
+    UpdateArpTempo();
 
+    // After the tempo so a synced echo follows the arp
+    DelayEffect::UpdateDelay(arp_enabled);
 
+    // Touch pressure now reaches the voices through PolyphonyEngine's ModMatrix
 }
 
-void UpdateArpState(int& engineIndex, bool& poly_mode, int& effective_num_voices, bool& arp_on_out) {
-    engineIndex = DetermineEngineSettings();
-    poly_mode = (engineIndex <= 3);
-    effective_num_voices = poly_mode ? NUM_VOICES : 1;
-
-    bool current_arp_on = arp_enabled;
-    if (!current_arp_on && was_arp_on) {
-        poly_engine.ResetVoices();
-        for (int v = 0; v < NUM_VOICES; ++v) {
+// Runs the vocoder on the voice mix. Works in [-1, 1] floats and hands the
+// result back in the mix buffer's summed int16 range so the Clouds feed below
+// stays unchanged.
+void ApplyVocoderInsert(AudioHandle::InterleavingInputBuffer in, const float* mix, float* out) {
+    static float modulator[BLOCK_SIZE];
+    static float carrier[BLOCK_SIZE];
+    const float kMixToFloat = 1.0f / (32768.0f * NUM_VOICES);
+    const float kVoiceToFloat = 1.0f / 32768.0f;
+
+    if (vocoder_insert.GetSource() == VocoderInsert::SOURCE_AUDIO_IN) {
+        for (size_t i = 0; i < BLOCK_SIZE; ++i) {
+            modulator[i] = in[i * 2]; // Left channel of the SAI input
+            carrier[i] = mix[i] * kMixToFloat;
         }
-        poly_engine.UpdateLastTouchState(0);
-    }
-    was_arp_on = current_arp_on;
-    arp_on_out = current_arp_on;
-
-    if (current_arp_on) {
-        arp.UpdateHeldNotes(current_touch_state, poly_engine.GetLastTouchState());
-        arp.Process(BLOCK_SIZE);
     } else {
-        poly_engine.HandleTouchInput(current_touch_state, poly_engine.GetLastTouchState(), engineIndex, poly_mode, effective_num_voices);
+        // Voice 0 against the others. Outside poly mode the other voices are
+        // silenced, so the carrier (and the output) simply goes quiet.
+        const plaits::Voice::Frame* voice0 = poly_engine.GetVoiceOutputBuffer(0);
+        for (size_t i = 0; i < BLOCK_SIZE; ++i) {
+            float v0 = static_cast<float>(voice0[i].out);
+            modulator[i] = v0 * kVoiceToFloat;
+            carrier[i] = (mix[i] - v0) * kMixToFloat;
+        }
     }
-    
-    poly_engine.UpdateLastTouchState(current_touch_state);
-}
 
-void RenderVoices(int engineIndex, bool poly_mode, int effective_num_voices, bool arp_on) {
-    PolyphonyEngine::RenderParameters params;
-    params.engine_index = engineIndex;
-    params.poly_mode = poly_mode;
-    params.effective_num_voices = effective_num_voices;
-    params.arp_on = arp_on;
-    params.pitch_val = pitch_val;
-    params.harm_knob_val = harm_knob_val;
-    params.morph_knob_val = morph_knob_val;
-    params.timbre_knob_val = timbre_knob_val;
-    params.env_attack_val = env_attack_val;
-    params.env_release_val = env_release_val;
-    params.delay_mix_val = 0.0f;  // Delay removed, set mix to 0
-    params.touch_cv_value = touch_cv_value;
-    
-    poly_engine.RenderBlock(params);
+    vocoder_insert.Process(modulator, carrier, out, BLOCK_SIZE);
+
+    for (size_t i = 0; i < BLOCK_SIZE; ++i) {
+        out[i] *= 32768.0f * NUM_VOICES;
+    }
 }
 
-void ApplyEffectsAndOutput(AudioHandle::InterleavingOutputBuffer out, size_t size) {
+void ApplyEffectsAndOutput(AudioHandle::InterleavingInputBuffer in, AudioHandle::InterleavingOutputBuffer out, size_t size) {
     // Clouds Integration: Prepare input and output buffers for Clouds
     static clouds::ShortFrame input_frames[BLOCK_SIZE];
     static clouds::ShortFrame output_frames[BLOCK_SIZE];
     // End Clouds Integration
+    static float insert_buffer[BLOCK_SIZE];
 
     // Normalized output: average voices and apply master volume
     const float* buffer = poly_engine.GetMainOutputBuffer();
+
+    if (vocoder_insert.IsActive()) {
+        ApplyVocoderInsert(in, buffer, insert_buffer);
+        buffer = insert_buffer;
+    }
+
+#ifdef USE_SD_CARD
+    static float stream_buffer[BLOCK_SIZE];
+    std::fill(stream_buffer, stream_buffer + BLOCK_SIZE, 0.0f);
+    sample_voice.Render(stream_buffer, BLOCK_SIZE);
+#endif
     // const float norm = 1.0f / 32768.0f; // Convert int16 range to [-1,1] // Clouds handles this
 
     // Clouds Integration: Feed synth output to Clouds input
     for (size_t i = 0; i < BLOCK_SIZE; ++i) {
         // Scale down to prevent overflow: average by number of voices and clamp to int16 range
         float scaled = buffer[i] / static_cast<float>(NUM_VOICES); // keep level similar to original output path
+#ifdef USE_SD_CARD
+        scaled += stream_buffer[i] * 32767.0f;
+#endif
         if (scaled > 32767.f) scaled = 32767.f;
         if (scaled < -32768.f) scaled = -32768.f;
         int16_t sample_int = static_cast<int16_t>(scaled);
@@ -165,35 +219,69 @@ void ApplyEffectsAndOutput(AudioHandle::InterleavingOutputBuffer out, size_t siz
         input_frames[i].r = sample_int; // Mono input to Clouds
     }
     // End Clouds Integration
+#ifdef RECORD_DRY
+    dry_recorder.Capture(input_frames);
+#endif
 
     // Clouds Integration: Process audio through Clouds
     clouds_processor.Process(input_frames, output_frames, BLOCK_SIZE);
     // End Clouds Integration
 
+    // For now, let's just use the left channel from Clouds and apply master volume.
+    // We might want to sum L+R or handle stereo properly later.
+    static float post_buffer[BLOCK_SIZE];
+    for (size_t i = 0; i < BLOCK_SIZE; ++i) {
+        post_buffer[i] = static_cast<float>(output_frames[i].l) / 32768.0f;
+    }
+
+    // Echo delay after Clouds, on the mono output
+    DelayEffect::ApplyDelay(post_buffer, BLOCK_SIZE);
+
+#ifdef POST_REVERB
+    if (post_reverb_mix > 0.0f) {
+        static float reverb_l[BLOCK_SIZE];
+        static float reverb_r[BLOCK_SIZE];
+        post_reverb.Process(post_buffer, post_buffer, reverb_l, reverb_r, BLOCK_SIZE);
+        for (size_t i = 0; i < BLOCK_SIZE; ++i) {
+            post_buffer[i] += (reverb_l[i] + reverb_r[i]) * 0.5f * post_reverb_mix;
+        }
+    }
+#endif
+
     for (size_t i = 0; i < size; i += 2) {
-        // Clouds Integration: Take output from Clouds
-        float outL = static_cast<float>(output_frames[i/2].l) / 32768.0f;
-        float outR = static_cast<float>(output_frames[i/2].r) / 32768.0f;
-        // End Clouds Integration
-        
-        // float raw = buffer[i/2]; // Original line
-        // Convert to float and average voices
-        // float sample = (raw * norm) / float(NUM_VOICES); // Original line
-        
-        // For now, let's just use the left channel from Clouds and apply master volume.
-        // We might want to sum L+R or handle stereo properly later.
-        float sample = outL; // Using Clouds output
+        float sample = post_buffer[i/2];
         
         // Apply master volume (keep below 1.0)
         sample *= MASTER_VOLUME;
         out[i]   = sample;
         out[i+1] = sample; // Outputting mono for now from Clouds L channel
     }
-    UpdatePerformanceMonitors(size, out);
 }
 
-int DetermineEngineSettings() {
-    return current_engine_index;
+// Anything that can start or sustain a sound without the output showing it
+// yet. Release tails are covered by the idle detector's output check; echoes
+// can be further apart than its hold, so a ringing echo line counts too.
+bool IsSynthActive() {
+    bool active = current_touch_state != 0
+        || poly_engine.GetActiveVoiceMask() != 0
+        || arp.IsActive()
+        || vocoder_insert.GetSource() == VocoderInsert::SOURCE_AUDIO_IN
+        || DelayEffect::IsRinging();
+#ifdef USE_SD_CARD
+    active = active || sample_voice.IsPlaying();
+#endif
+    return active;
+}
+
+// Silent block: no voices, no effects. Clouds keeps recording (silence) so
+// that its buffer and write head stay in step with time.
+void RenderIdleBlock(AudioHandle::InterleavingOutputBuffer out, size_t size) {
+    std::fill(out, out + size, 0.0f);
+    clouds_processor.RecordSilence(BLOCK_SIZE);
+#ifdef RECORD_DRY
+    static const clouds::ShortFrame silence[BLOCK_SIZE] = { };
+    dry_recorder.Capture(silence);
+#endif
 }
 
 void UpdatePerformanceMonitors(size_t size, AudioHandle::InterleavingOutputBuffer out) {
@@ -202,10 +290,51 @@ void UpdatePerformanceMonitors(size_t size, AudioHandle::InterleavingOutputBuffe
         smoothed_output_level = smoothed_output_level * 0.99f + current_level * 0.01f;
     }
 
-    static uint32_t display_counter = 0;
-    static const uint32_t display_interval_blocks = (uint32_t)(sample_rate / BLOCK_SIZE * 3.0f);
-    if (++display_counter >= display_interval_blocks) {
-        display_counter = 0;
-        update_display = true;
+    if (telemetry.FrameDue()) {
+        PushTelemetryFrame();
+    }
+}
+
+// Snapshot of the synth state for the telemetry stream. Only copies numbers;
+// all formatting happens on the host.
+void PushTelemetryFrame() {
+    TelemetryFrame frame;
+    frame.timestamp_ms = hw.system.GetNow();
+    frame.cpu_avg = static_cast<uint16_t>(std::min(cpu_meter.GetAvgCpuLoad(), 1.0f) * 1000.0f);
+    // Worst block since the previous frame; can exceed 100% on a missed deadline
+    frame.cpu_max = static_cast<uint16_t>(std::min(deadline_monitor.TakeWindowMaxLoad(), 65.0f) * 1000.0f);
+    for (int s = 0; s < STAGE_LAST; ++s) {
+        frame.stage_cycles[s] = stage_cycles[s];
+    }
+    frame.touch_state = current_touch_state;
+    frame.engine = static_cast<uint8_t>(current_engine_index);
+    frame.voice_active = poly_engine.GetActiveVoiceMask();
+    for (int i = 0; i < 12; ++i) {
+        frame.adc[i] = static_cast<uint16_t>(adc_raw_values[i] * 65535.0f);
+    }
+#ifdef USE_SD_CARD
+    frame.stream_underruns = sample_voice.underruns();
+#else
+    frame.stream_underruns = 0;
+#endif
+    frame.deadline_misses = deadline_monitor.misses();
+    frame.deadline_near_misses = deadline_monitor.near_misses();
+    telemetry.Push(frame);
+}
+
+// Captures what the synth was doing when a block ran late.
+void LogDeadlineEvent(bool arp_on) {
+    DeadlineMonitor::Record record;
+    record.timestamp_ms = hw.system.GetNow();
+    record.engine = static_cast<uint8_t>(current_engine_index);
+    uint8_t mask = poly_engine.GetActiveVoiceMask();
+    record.active_voices = 0;
+    for (; mask; mask >>= 1) {
+        record.active_voices += mask & 1;
     }
+    record.arp_on = arp_on;
+    record.clouds_mode = static_cast<uint8_t>(clouds_processor.playback_mode());
+    record.clouds_grains = static_cast<uint8_t>(clouds_processor.num_active_grains() + 0.5f);
+    record.clouds_quality = static_cast<uint8_t>(clouds_processor.quality());
+    deadline_monitor.Log(record, stage_cycles);
 } 
\ No newline at end of file
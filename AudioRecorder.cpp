@@ -0,0 +1,216 @@
+#include "AudioRecorder.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+// Keeps the RIFF size fields in range
+static const uint32_t kMaxDataBytes = 0xFFFFFFFFu - AudioRecorder::kDataOffset;
+
+static void WriteLe16(uint8_t* p, uint16_t v) {
+    p[0] = v & 0xff;
+    p[1] = v >> 8;
+}
+
+static void WriteLe32(uint8_t* p, uint32_t v) {
+    for (int i = 0; i < 4; ++i) {
+        p[i] = (v >> (8 * i)) & 0xff;
+    }
+}
+
+void AudioRecorder::Init(uint8_t* ring, size_t block_bytes, uint16_t channels, Format format,
+                         uint32_t sample_rate) {
+    ring_ = ring;
+    block_bytes_ = block_bytes;
+    channels_ = channels;
+    format_ = format;
+    sample_rate_ = sample_rate;
+    sink_ = nullptr;
+    armed_ = false;
+    write_count_ = 0;
+    read_count_ = 0;
+    dropped_ = 0;
+    pending_gap_ = 0;
+    silence_left_ = 0;
+    data_bytes_ = 0;
+    failed_ = false;
+}
+
+bool AudioRecorder::Start(StreamSink* sink, const char* path) {
+    if (sink_ || !ring_ || !sink->Open(path)) {
+        return false;
+    }
+    sink_ = sink;
+    write_count_ = 0;
+    read_count_ = 0;
+    dropped_ = 0;
+    pending_gap_ = 0;
+    silence_left_ = 0;
+    data_bytes_ = 0;
+    header_due_ = kHeaderIntervalBlocks * block_bytes_;
+    failed_ = false;
+    if (!WriteHeader()) {
+        Fail();
+        return false;
+    }
+    std::atomic_signal_fence(std::memory_order_release);
+    armed_ = true;
+    return true;
+}
+
+void AudioRecorder::Stop() {
+    if (!sink_) {
+        return;
+    }
+    // The callback cannot be half-way through Capture() here: it preempts the
+    // main loop, never the other way round.
+    armed_ = false;
+    while (sink_ && Flush(true)) { }
+    // Blocks dropped after the last capture
+    silence_left_ += pending_gap_;
+    pending_gap_ = 0;
+    while (sink_ && Flush(true)) { }
+    if (sink_) {
+        WriteHeader();
+        sink_->Close();
+        sink_ = nullptr;
+    }
+}
+
+bool AudioRecorder::Service() {
+    return sink_ && Flush(false);
+}
+
+bool AudioRecorder::Flush(bool draining) {
+    // Chunks are counted from the start of the data, not from the ring
+    // slot: after a gap or a short chunk, the next write ends on a chunk
+    // boundary of the file again, so full chunks stay sector-aligned.
+    const uint32_t to_boundary = kFlushBlocks - (data_bytes_ / block_bytes_) % kFlushBlocks;
+    bool ok;
+    if (silence_left_ > 0) {
+        uint32_t blocks = std::min<uint32_t>(silence_left_, to_boundary);
+        silence_left_ -= blocks;
+        ok = WriteSilence(blocks);
+    } else {
+        std::atomic_signal_fence(std::memory_order_acquire);
+        const uint32_t available = write_count_ - read_count_;
+        if (available == 0) {
+            return false;
+        }
+        const uint32_t slot = read_count_ & (kRingBlocks - 1);
+        if (gap_before_[slot] > 0) {
+            // Fill in what was dropped before this block first
+            silence_left_ = gap_before_[slot];
+            gap_before_[slot] = 0;
+            return Flush(draining);
+        }
+
+        // Up to the next chunk boundary, the end of the ring or the next gap
+        uint32_t count = std::min<uint32_t>(to_boundary, kRingBlocks - slot);
+        for (uint32_t i = 1; i < count && i < available; ++i) {
+            if (gap_before_[slot + i] > 0) {
+                count = i;
+            }
+        }
+        if (count > available) {
+            if (!draining) {
+                return false;
+            }
+            count = available;
+        }
+        ok = WriteData(ring_ + slot * block_bytes_, count * block_bytes_);
+        std::atomic_signal_fence(std::memory_order_release);
+        read_count_ = read_count_ + count;
+    }
+
+    if (ok && !draining && data_bytes_ >= header_due_) {
+        header_due_ = data_bytes_ + kHeaderIntervalBlocks * block_bytes_;
+        ok = WriteHeader() && sink_->Sync();
+    }
+    if (!ok) {
+        Fail();
+    }
+    return true;
+}
+
+bool AudioRecorder::WriteData(const void* src, size_t bytes) {
+    if (bytes > kMaxDataBytes - data_bytes_) {
+        return false;
+    }
+    size_t written = sink_->Write(src, bytes);
+    data_bytes_ += written;
+    return written == bytes;
+}
+
+bool AudioRecorder::WriteSilence(uint32_t blocks) {
+    static const uint8_t zeros[512] = { };
+    size_t bytes = blocks * block_bytes_;
+    while (bytes > 0) {
+        size_t n = std::min(bytes, sizeof(zeros));
+        if (!WriteData(zeros, n)) {
+            return false;
+        }
+        bytes -= n;
+    }
+    return true;
+}
+
+// RIFF + fmt (16-byte PCM / IEEE float) + JUNK padding + data header, so the
+// samples start at kDataOffset.
+bool AudioRecorder::WriteHeader() {
+    const uint16_t bits = format_ == FORMAT_FLOAT32 ? 32 : 16;
+    const uint16_t block_align = channels_ * bits / 8;
+    const uint32_t junk_size = kDataOffset - 12 - 24 - 8 - 8;
+
+    memset(header_, 0, sizeof(header_));
+    uint8_t* p = header_;
+    memcpy(p, "RIFF", 4);
+    WriteLe32(p + 4, kDataOffset - 8 + data_bytes_);
+    memcpy(p + 8, "WAVE", 4);
+    p += 12;
+    memcpy(p, "fmt ", 4);
+    WriteLe32(p + 4, 16);
+    WriteLe16(p + 8, format_);
+    WriteLe16(p + 10, channels_);
+    WriteLe32(p + 12, sample_rate_);
+    WriteLe32(p + 16, sample_rate_ * block_align);
+    WriteLe16(p + 20, block_align);
+    WriteLe16(p + 22, bits);
+    p += 24;
+    memcpy(p, "JUNK", 4);
+    WriteLe32(p + 4, junk_size);
+    p += 8 + junk_size;
+    memcpy(p, "data", 4);
+    WriteLe32(p + 4, data_bytes_);
+
+    return sink_->Seek(0)
+        && sink_->Write(header_, sizeof(header_)) == sizeof(header_)
+        && sink_->Seek(kDataOffset + data_bytes_);
+}
+
+// Card full or gone: keep what made it, stop recording.
+void AudioRecorder::Fail() {
+    armed_ = false;
+    failed_ = true;
+    WriteHeader();
+    sink_->Close();
+    sink_ = nullptr;
+}
+
+void AudioRecorder::Capture(const void* block) {
+    if (!armed_) {
+        return;
+    }
+    std::atomic_signal_fence(std::memory_order_acquire);
+    const uint32_t write_count = write_count_;
+    if (write_count - read_count_ >= kRingBlocks) {
+        ++pending_gap_;
+        dropped_ = dropped_ + 1;
+        return;
+    }
+    const uint32_t slot = write_count & (kRingBlocks - 1);
+    memcpy(ring_ + slot * block_bytes_, block, block_bytes_);
+    gap_before_[slot] = pending_gap_;
+    pending_gap_ = 0;
+    std::atomic_signal_fence(std::memory_order_release);
+    write_count_ = write_count + 1;
+}
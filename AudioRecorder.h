@@ -0,0 +1,94 @@
+#pragma once
+#ifndef AUDIO_RECORDER_H
+#define AUDIO_RECORDER_H
+
+#include <cstddef>
+#include <cstdint>
+#include "SampleStreaming.h"
+
+// Records audio blocks to a WAV file without the audio callback ever waiting
+// on the card.
+//
+// Capture() is the only thing the callback calls: one memcpy of the block into
+// the next ring slot, or, with the ring full, a counter increment. Its cost
+// does not depend on the state of the card. Service() runs from the main loop
+// and writes the ring straight to the sink in chunks of kFlushBlocks blocks;
+// the data starts on a sector boundary (the header is padded with a JUNK
+// chunk), so on the SD card every chunk is a run of whole sectors that FatFS
+// hands to the SDMMC DMA from the ring itself. Chunks are cut at the file's
+// chunk boundaries: a gap, or the ring wrapping mid-chunk, shortens one write
+// and the next ones are aligned again.
+//
+// Dropped blocks are written back as silence where they were lost, so the file
+// keeps the performance's timeline; dropped_blocks() tells how many.
+class AudioRecorder {
+public:
+    static const size_t kRingBlocks = 1024;    // ~1 s at 32 kHz / 32
+    static const size_t kFlushBlocks = 64;     // Per write; divides kRingBlocks
+    static const uint32_t kDataOffset = 512;   // Header + JUNK padding
+    // The header is rewritten (and the file synced) this often, so a take
+    // survives a power cut up to the last few seconds.
+    static const uint32_t kHeaderIntervalBlocks = 4096;
+
+    enum Format {
+        FORMAT_PCM16 = 1,
+        FORMAT_FLOAT32 = 3,
+    };
+
+    AudioRecorder() : ring_(nullptr), sink_(nullptr), armed_(false) {}
+
+    // ring must hold kRingBlocks * block_bytes bytes, be 32-byte aligned and be
+    // reachable by the SD DMA. block_bytes must be a multiple of 8 so that a
+    // chunk is a multiple of the 512-byte sector.
+    void Init(uint8_t* ring, size_t block_bytes, uint16_t channels, Format format,
+              uint32_t sample_rate);
+
+    // Main loop only. Creates the file, writes the header and arms Capture().
+    bool Start(StreamSink* sink, const char* path);
+    // Main loop only. Disarms Capture(), writes out the ring, patches the
+    // header and closes the file.
+    void Stop();
+    // Main loop only. Writes at most one chunk; returns true if it wrote.
+    bool Service();
+
+    // Audio callback only. Copies block_bytes bytes.
+    void Capture(const void* block);
+
+    bool recording() const { return sink_ != nullptr; }
+    uint32_t dropped_blocks() const { return dropped_; }
+    uint32_t recorded_blocks() const { return data_bytes_ / block_bytes_; }
+    // A write failed (card full or gone) or the file reached 4 GB; the take
+    // was closed.
+    bool failed() const { return failed_; }
+
+private:
+    bool Flush(bool draining);
+    bool WriteHeader();
+    bool WriteSilence(uint32_t blocks);
+    bool WriteData(const void* src, size_t bytes);
+    void Fail();
+
+    uint8_t* ring_;
+    size_t block_bytes_;
+    uint16_t channels_;
+    Format format_;
+    uint32_t sample_rate_;
+
+    // Callback side
+    volatile uint32_t write_count_;
+    volatile uint32_t dropped_;
+    uint32_t pending_gap_;                  // Blocks dropped since the last capture
+    uint32_t gap_before_[kRingBlocks];      // Dropped just before this slot
+
+    // Main loop side
+    StreamSink* sink_;
+    volatile bool armed_;
+    volatile uint32_t read_count_;
+    uint32_t silence_left_;                 // Dropped blocks still to write
+    uint32_t data_bytes_;
+    uint32_t header_due_;
+    bool failed_;
+    alignas(32) uint8_t header_[kDataOffset];
+};
+
+#endif // AUDIO_RECORDER_H
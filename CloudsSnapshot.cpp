@@ -0,0 +1,274 @@
+#include "CloudsSnapshot.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include "clouds/dsp/mu_law.h"
+
+using namespace clouds;
+
+static const uint32_t kSnapshotMagic = 0x504e5343; // 'CSNP'
+static const uint8_t kSnapshotVersion = 1;
+static const uint32_t kBufferTag = stmlib::FourCC<'b', 'u', 'f', 'f'>::value;
+
+// Whether the elapsed time has reached deadline, across counter wrap
+static bool Reached(uint32_t now_ms, uint32_t deadline) {
+    return static_cast<int32_t>(now_ms - deadline) >= 0;
+}
+
+bool CloudsSnapshot::Init(GranularProcessor* processor, StreamSource* source, StreamSink* sink,
+                          const char* prefix, bool mu_law, uint32_t now_ms) {
+    processor_ = processor;
+    source_ = source;
+    sink_ = sink;
+    snprintf(prefix_, sizeof(prefix_), "%s", prefix);
+    mu_law_ = mu_law;
+    timing_freeze_ = false;
+    saved_ = false;
+    saves_ = 0;
+    restored_ = false;
+
+    newest_slot_ = -1;
+    newest_sequence_ = 0;
+    for (int slot = 0; slot < 2; ++slot) {
+        Header header;
+        if (ReadHeader(slot, &header) &&
+            (newest_slot_ < 0 || static_cast<int32_t>(header.sequence - newest_sequence_) > 0)) {
+            newest_slot_ = slot;
+            newest_sequence_ = header.sequence;
+        }
+    }
+
+    if (newest_slot_ < 0) {
+        state_ = STATE_IDLE;
+        return false;
+    }
+    // Let Clouds set up its buffers first; they are cleared on the first block
+    state_ = STATE_RESTORE_WAIT;
+    deadline_ = now_ms + kRestoreDelayMs;
+    return true;
+}
+
+const char* CloudsSnapshot::SlotPath(int slot) {
+    snprintf(path_, sizeof(path_), "%sclouds%d.snp", prefix_, slot);
+    return path_;
+}
+
+bool CloudsSnapshot::ReadHeader(int slot, Header* header) {
+    bool valid = source_->Open(SlotPath(slot))
+        && source_->Read(header, sizeof(*header)) == sizeof(*header)
+        && header->magic == kSnapshotMagic
+        && header->version == kSnapshotVersion;
+    source_->Close();
+    return valid;
+}
+
+bool CloudsSnapshot::Compressed(const PersistentBlock& block, bool mu_law) const {
+    // 8-bit buffers are mu-law already
+    return mu_law && block.tag == kBufferTag && !(processor_->quality() & 2);
+}
+
+void CloudsSnapshot::Service(uint32_t now_ms) {
+    switch (state_) {
+        case STATE_DISABLED:
+            break;
+
+        case STATE_IDLE:
+            if (!processor_->frozen()) {
+                timing_freeze_ = false;
+                saved_ = false;
+            } else if (!timing_freeze_) {
+                timing_freeze_ = true;
+                frozen_since_ = now_ms;
+            } else if (!saved_ && now_ms - frozen_since_ >= kSaveDelayMs) {
+                BeginSave();
+            }
+            break;
+
+        case STATE_RESTORE_WAIT:
+            if (Reached(now_ms, deadline_)) {
+                // Stops the recording so that nothing writes the buffers
+                // while they are filled in
+                processor_->set_freeze(true);
+                state_ = STATE_RESTORE_FREEZE;
+                deadline_ = now_ms + kFreezeSettleMs;
+            }
+            break;
+
+        case STATE_RESTORE_FREEZE:
+            if (Reached(now_ms, deadline_)) {
+                BeginRestore();
+            }
+            break;
+
+        case STATE_RESTORING:
+            RestoreSlice();
+            break;
+
+        case STATE_SAVING:
+            SaveSlice();
+            break;
+    }
+}
+
+void CloudsSnapshot::BeginRestore() {
+    Header header;
+    PersistentState restored;
+    uint32_t block_header[2];
+
+    processor_->GetPersistentData(blocks_, &num_blocks_);
+    bool valid = source_->Open(SlotPath(newest_slot_))
+        && source_->Read(&header, sizeof(header)) == sizeof(header)
+        && header.magic == kSnapshotMagic
+        && header.num_blocks == num_blocks_
+        && source_->Read(block_header, sizeof(block_header)) == sizeof(block_header)
+        && block_header[0] == blocks_[0].tag
+        && block_header[1] == sizeof(restored)
+        && source_->Read(&restored, sizeof(restored)) == sizeof(restored)
+        // Saved with another buffer layout: leave Clouds as it is
+        && restored.quality == processor_->quality()
+        && (restored.spectral != 0) == (processor_->playback_mode() == PLAYBACK_MODE_SPECTRAL);
+    if (!valid) {
+        processor_->set_freeze(false);
+        Finish();
+        return;
+    }
+
+    // The processor only reads its state block in ResyncPersistentData()
+    memcpy(blocks_[0].data, &restored, sizeof(restored));
+    slot_ = newest_slot_;
+    slot_mu_law_ = header.mu_law != 0;
+    block_ = 1;
+    offset_ = 0;
+    state_ = STATE_RESTORING;
+    // Whatever ends up in the buffers, do not save it over the snapshot
+    saved_ = true;
+    timing_freeze_ = true;
+}
+
+void CloudsSnapshot::RestoreSlice() {
+    if (!processor_->frozen()) {
+        // Freeze released (mod wheel): recording takes over the buffers again
+        timing_freeze_ = false;
+        saved_ = false;
+        Finish();
+        return;
+    }
+
+    const PersistentBlock& block = blocks_[block_];
+    if (offset_ == 0) {
+        uint32_t block_header[2];
+        if (source_->Read(block_header, sizeof(block_header)) != sizeof(block_header) ||
+            block_header[0] != block.tag || block_header[1] != block.size) {
+            Finish();
+            return;
+        }
+    }
+
+    uint8_t* data = static_cast<uint8_t*>(block.data) + offset_;
+    size_t size = std::min(kSliceBytes, static_cast<size_t>(block.size) - offset_);
+    bool ok;
+    if (Compressed(block, slot_mu_law_)) {
+        size_t num_samples = size / 2;
+        ok = source_->Read(staging_, num_samples) == num_samples;
+        int16_t* samples = reinterpret_cast<int16_t*>(data);
+        for (size_t i = 0; i < num_samples; ++i) {
+            samples[i] = MuLaw2Lin(staging_[i]);
+        }
+    } else {
+        ok = source_->Read(data, size) == size;
+    }
+    if (!ok) {
+        Finish();
+        return;
+    }
+
+    offset_ += size;
+    if (offset_ == block.size) {
+        offset_ = 0;
+        if (++block_ == num_blocks_) {
+            processor_->ResyncPersistentData();
+            restored_ = true;
+            Finish();
+        }
+    }
+}
+
+void CloudsSnapshot::BeginSave() {
+    // One attempt per freeze, whether or not it completes
+    saved_ = true;
+    processor_->PreparePersistentData();
+    processor_->GetPersistentData(blocks_, &num_blocks_);
+
+    slot_ = newest_slot_ == 0 ? 1 : 0;
+    slot_mu_law_ = mu_law_;
+    Header header;
+    header.magic = 0;   // Until complete
+    header.sequence = newest_sequence_ + 1;
+    header.version = kSnapshotVersion;
+    header.mu_law = slot_mu_law_ ? 1 : 0;
+    header.num_blocks = static_cast<uint8_t>(num_blocks_);
+    header.reserved = 0;
+    if (!sink_->Open(SlotPath(slot_)) ||
+        sink_->Write(&header, sizeof(header)) != sizeof(header)) {
+        Finish();
+        return;
+    }
+    block_ = 0;
+    offset_ = 0;
+    state_ = STATE_SAVING;
+}
+
+void CloudsSnapshot::SaveSlice() {
+    if (!processor_->frozen()) {
+        // The buffer is being recorded over: drop this slot, keep the other
+        timing_freeze_ = false;
+        saved_ = false;
+        Finish();
+        return;
+    }
+
+    const PersistentBlock& block = blocks_[block_];
+    bool ok = true;
+    if (offset_ == 0) {
+        uint32_t block_header[2] = { block.tag, block.size };
+        ok = sink_->Write(block_header, sizeof(block_header)) == sizeof(block_header);
+    }
+
+    const uint8_t* data = static_cast<const uint8_t*>(block.data) + offset_;
+    size_t size = std::min(kSliceBytes, static_cast<size_t>(block.size) - offset_);
+    if (Compressed(block, slot_mu_law_)) {
+        size_t num_samples = size / 2;
+        const int16_t* samples = reinterpret_cast<const int16_t*>(data);
+        for (size_t i = 0; i < num_samples; ++i) {
+            staging_[i] = Lin2MuLaw(samples[i]);
+        }
+        ok = ok && sink_->Write(staging_, num_samples) == num_samples;
+    } else {
+        ok = ok && sink_->Write(data, size) == size;
+    }
+    if (!ok) {
+        Finish();
+        return;
+    }
+
+    offset_ += size;
+    if (offset_ == block.size) {
+        offset_ = 0;
+        if (++block_ == num_blocks_) {
+            const uint32_t magic = kSnapshotMagic;
+            if (sink_->Seek(0) && sink_->Write(&magic, sizeof(magic)) == sizeof(magic) &&
+                sink_->Sync()) {
+                newest_slot_ = slot_;
+                ++newest_sequence_;
+                ++saves_;
+            }
+            Finish();
+        }
+    }
+}
+
+void CloudsSnapshot::Finish() {
+    source_->Close();
+    sink_->Close();
+    state_ = STATE_IDLE;
+}
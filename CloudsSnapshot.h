@@ -0,0 +1,106 @@
+#pragma once
+#ifndef CLOUDS_SNAPSHOT_H
+#define CLOUDS_SNAPSHOT_H
+
+#include <cstddef>
+#include <cstdint>
+#include "SampleStreaming.h"
+#include "clouds/dsp/granular_processor.h"
+
+// Keeps a frozen Clouds texture across power cycles.
+//
+// Everything happens in the main loop, one kSliceBytes slice per Service()
+// call, on the blocks GetPersistentData() describes, so the audio callback
+// never waits on the card.
+//
+// Saving: once freeze has been held for kSaveDelayMs, the frozen buffer goes
+// to the older of two slot files. The header's magic is written last, and
+// releasing freeze half-way abandons the slot, so the other slot always holds
+// the previous complete snapshot.
+//
+// Restoring: kRestoreDelayMs after boot, once Clouds has set its buffers up
+// and sound is already running, Clouds is frozen and the newest complete slot
+// is read back straight into its buffers. Grains pick the texture up as it
+// arrives; the write heads are restored last.
+//
+// 16-bit buffers can be stored as 8-bit mu-law: half the size and write time,
+// at mu-law's resolution.
+class CloudsSnapshot {
+public:
+    static const size_t kSliceBytes = 4096;
+    static const uint32_t kSaveDelayMs = 2000;
+    static const uint32_t kRestoreDelayMs = 500;
+    static const uint32_t kFreezeSettleMs = 10;     // A few audio blocks
+
+    // Part of the file format.
+    struct Header {
+        uint32_t magic;
+        uint32_t sequence;          // Newest complete slot wins
+        uint8_t version;
+        uint8_t mu_law;
+        uint8_t num_blocks;
+        uint8_t reserved;
+    };
+
+    CloudsSnapshot() : processor_(nullptr), state_(STATE_DISABLED) {}
+
+    // Main loop only. Slot files are <prefix>clouds0.snp and clouds1.snp.
+    // Returns true if a snapshot will be restored.
+    bool Init(clouds::GranularProcessor* processor, StreamSource* source, StreamSink* sink,
+              const char* prefix, bool mu_law, uint32_t now_ms);
+
+    // Main loop only.
+    void Service(uint32_t now_ms);
+
+    bool busy() const { return state_ > STATE_IDLE; }
+    uint32_t saves() const { return saves_; }
+    bool restored() const { return restored_; }
+
+private:
+    enum State {
+        STATE_DISABLED,
+        STATE_IDLE,
+        STATE_RESTORE_WAIT,
+        STATE_RESTORE_FREEZE,
+        STATE_RESTORING,
+        STATE_SAVING,
+    };
+
+    bool ReadHeader(int slot, Header* header);
+    bool Compressed(const clouds::PersistentBlock& block, bool mu_law) const;
+    void BeginRestore();
+    void RestoreSlice();
+    void BeginSave();
+    void SaveSlice();
+    void Finish();
+    const char* SlotPath(int slot);
+
+    clouds::GranularProcessor* processor_;
+    StreamSource* source_;
+    StreamSink* sink_;
+    char prefix_[16];
+    char path_[32];
+    bool mu_law_;
+    State state_;
+
+    int newest_slot_;               // -1 if none
+    uint32_t newest_sequence_;
+    int slot_;                      // Being saved or restored
+    bool slot_mu_law_;
+
+    clouds::PersistentBlock blocks_[4];
+    size_t num_blocks_;
+    size_t block_;
+    size_t offset_;                 // Bytes of blocks_[block_] done
+
+    uint32_t deadline_;
+    bool timing_freeze_;
+    uint32_t frozen_since_;
+    bool saved_;                    // This freeze is on the card already
+    uint32_t saves_;
+    bool restored_;
+
+    alignas(32) uint8_t staging_[kSliceBytes / 2];
+};
+
+#endif // CLOUDS_SNAPSHOT_H
@@ -0,0 +1,208 @@
+#include "ControlJournal.h"
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+ControlJournal control_journal;
+
+void ControlJournal::Init(JournalEvent* buffer, size_t capacity, float adc_deadband) {
+    buffer_ = buffer;
+    capacity_ = capacity;
+    adc_deadband_ = adc_deadband;
+    Restart();
+}
+
+void ControlJournal::Restart() {
+    block_ = 0;
+    write_count_ = 0;
+    // The idle detector starts from zeroed knobs too
+    memset(&last_, 0, sizeof(last_));
+    post_roll_ = -1;
+    dump_open_ = false;
+    restart_ = false;
+    std::atomic_signal_fence(std::memory_order_release);
+    frozen_ = false;
+}
+
+void ControlJournal::Log(uint8_t type, uint8_t id, uint16_t data, float value) {
+    JournalEvent& event = buffer_[write_count_ & (capacity_ - 1)];
+    event.block = block_;
+    event.type = type;
+    event.id = id;
+    event.data = data;
+    event.value = value;
+    write_count_ = write_count_ + 1;
+}
+
+void ControlJournal::Record(const JournalState& state) {
+    if (restart_) {
+        Restart();
+    }
+    if (frozen_) {
+        return;
+    }
+
+    const bool keyframe = block_ % kKeyframeBlocks == 0;
+    if (keyframe) {
+        Log(JOURNAL_KEYFRAME, 0, 0, 0.0f);
+    }
+
+    if (keyframe || state.touch_state != last_.touch_state) {
+        Log(JOURNAL_TOUCH, 0, state.touch_state, 0.0f);
+    }
+    // Bitwise, so that a replay reproduces every last bit
+    if (keyframe || memcmp(&state.touch_cv, &last_.touch_cv, sizeof(float)) != 0) {
+        Log(JOURNAL_TOUCH_CV, 0, 0, state.touch_cv);
+    }
+    for (int i = 0; i < CONTROL_LAST; ++i) {
+        if (keyframe || memcmp(&state.controls[i], &last_.controls[i], sizeof(float)) != 0) {
+            Log(JOURNAL_CONTROL, i, 0, state.controls[i]);
+        }
+    }
+    // Same rule as IdleDetector::Update, so the journaled values trip it on
+    // the same blocks as the real ones did
+    for (int i = 0; i < JournalState::kNumAdc; ++i) {
+        bool moved = fabsf(state.adc[i] - last_.adc[i]) > adc_deadband_;
+        if (moved) {
+            last_.adc[i] = state.adc[i];
+        }
+        if (moved || keyframe) {
+            Log(JOURNAL_ADC, i, 0, last_.adc[i]);
+        }
+    }
+    if (keyframe || state.engine_changed || state.engine != last_.engine) {
+        Log(JOURNAL_ENGINE, state.engine_changed ? 1 : 0, state.engine, 0.0f);
+    }
+    if (keyframe || state.layout_changed || state.layout != last_.layout) {
+        Log(JOURNAL_LAYOUT, state.layout_changed ? 1 : 0, state.layout, 0.0f);
+    }
+    for (int i = 0; i < 3; ++i) {
+        if (keyframe || state.part_engine != last_.part_engine
+                || memcmp(&state.part_timbre[i], &last_.part_timbre[i], sizeof(float)) != 0) {
+            Log(JOURNAL_PART, i, state.part_engine, state.part_timbre[i]);
+        }
+    }
+    if (keyframe || state.arp_enabled != last_.arp_enabled) {
+        Log(JOURNAL_ARP, 0, state.arp_enabled ? 1 : 0, 0.0f);
+    }
+    if (keyframe || state.vocoder_source != last_.vocoder_source) {
+        Log(JOURNAL_VOCODER, 0, state.vocoder_source, 0.0f);
+    }
+    if (keyframe || state.freeze != last_.freeze) {
+        Log(JOURNAL_FREEZE, 0, state.freeze ? 1 : 0, 0.0f);
+    }
+
+    last_.touch_state = state.touch_state;
+    last_.touch_cv = state.touch_cv;
+    memcpy(last_.controls, state.controls, sizeof(last_.controls));
+    last_.engine = state.engine;
+    last_.layout = state.layout;
+    last_.part_engine = state.part_engine;
+    memcpy(last_.part_timbre, state.part_timbre, sizeof(last_.part_timbre));
+    last_.arp_enabled = state.arp_enabled;
+    last_.vocoder_source = state.vocoder_source;
+    last_.freeze = state.freeze;
+    ++block_;
+
+    if (post_roll_ > 0 && --post_roll_ == 0) {
+        std::atomic_signal_fence(std::memory_order_release);
+        frozen_ = true;
+    }
+}
+
+void ControlJournal::Freeze() {
+    if (post_roll_ < 0 && !frozen_) {
+        post_roll_ = kPostRollBlocks;
+    }
+}
+
+size_t ControlJournal::ReadDump(JournalEvent* out, size_t max, uint32_t* index) {
+    if (!frozen_ || restart_) {
+        return 0;
+    }
+    std::atomic_signal_fence(std::memory_order_acquire);
+    const uint32_t end = write_count_;
+    if (!dump_open_) {
+        dump_start_ = end > capacity_ ? end - capacity_ : 0;
+        dump_read_ = dump_start_;
+        dump_open_ = true;
+    }
+
+    size_t count = 0;
+    *index = dump_read_ - dump_start_;
+    for (; count < max && dump_read_ != end; ++count, ++dump_read_) {
+        out[count] = buffer_[dump_read_ & (capacity_ - 1)];
+    }
+    if (count == 0) {
+        restart_ = true;
+    }
+    return count;
+}
+
+void JournalPlayer::Init(const JournalEvent* events, size_t size) {
+    events_ = events;
+    size_ = size;
+    next_ = 0;
+    block_ = size > 0 ? events[0].block : 0;
+    memset(&state_, 0, sizeof(state_));
+}
+
+const JournalState& JournalPlayer::Next() {
+    state_.engine_changed = false;
+    state_.layout_changed = false;
+    for (; next_ < size_ && events_[next_].block == block_; ++next_) {
+        const JournalEvent& e = events_[next_];
+        switch (e.type) {
+            case JOURNAL_TOUCH:
+                state_.touch_state = e.data;
+                break;
+            case JOURNAL_TOUCH_CV:
+                state_.touch_cv = e.value;
+                break;
+            case JOURNAL_CONTROL:
+                if (e.id < CONTROL_LAST) state_.controls[e.id] = e.value;
+                break;
+            case JOURNAL_ADC:
+                if (e.id < JournalState::kNumAdc) state_.adc[e.id] = e.value;
+                break;
+            case JOURNAL_ENGINE:
+                state_.engine = static_cast<uint8_t>(e.data);
+                state_.engine_changed = e.id != 0;
+                break;
+            case JOURNAL_LAYOUT:
+                state_.layout = static_cast<uint8_t>(e.data);
+                state_.layout_changed = e.id != 0;
+                break;
+            case JOURNAL_PART:
+                state_.part_engine = static_cast<uint8_t>(e.data);
+                if (e.id < 3) state_.part_timbre[e.id] = e.value;
+                break;
+            case JOURNAL_ARP:
+                state_.arp_enabled = e.data != 0;
+                break;
+            case JOURNAL_VOCODER:
+                state_.vocoder_source = static_cast<uint8_t>(e.data);
+                break;
+            case JOURNAL_FREEZE:
+                state_.freeze = e.data != 0;
+                break;
+            default:
+                break;
+        }
+    }
+    ++block_;
+    return state_;
+}
+
+size_t JournalPlayer::num_blocks() const {
+    return size_ > 0 ? events_[size_ - 1].block - events_[0].block + 1 : 0;
+}
+
+size_t FindJournalStart(const JournalEvent* events, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        if (events[i].type == JOURNAL_KEYFRAME) {
+            return i;
+        }
+    }
+    return size;
+}
@@ -0,0 +1,142 @@
+#pragma once
+#ifndef CONTROL_JOURNAL_H
+#define CONTROL_JOURNAL_H
+
+#include <cstddef>
+#include <cstdint>
+#include "ControlValue.h"
+
+// Journal of the control inputs the audio callback acts on, one timestamp per
+// audio block, so that a glitch heard on stage can be replayed on the host
+// with exactly the same inputs (tools/bench --journal).
+//
+// Only changes are logged. Knob events are the deadbanded moves ControlSet
+// accepted (the values it hands on are bit-identical on replay), so knobs at
+// rest cost nothing; raw ADC values are only logged when they move past the
+// idle detector's deadband, which is all it looks at. Every kKeyframeBlocks
+// blocks a keyframe restates the whole state (layout and its frozen part,
+// vocoder source and Clouds freeze included), so a journal that has wrapped
+// can still be replayed from its oldest keyframe.
+//
+// The events live in a RAM ring that the audio callback overwrites. After a
+// deadline miss the journal freezes a few blocks later, keeping the lead-up to
+// the glitch, and the main loop streams it out through the telemetry port
+// (TELEMETRY_PACKET_JOURNAL); tools/telemetry_decode.py --journal saves it.
+// Recording then starts over.
+
+enum JournalEventType : uint8_t {
+    JOURNAL_KEYFRAME,   // The events of the same block restate everything
+    JOURNAL_TOUCH,      // data: pad bits (current_touch_state)
+    JOURNAL_TOUCH_CV,   // value: touch pressure (touch_cv_value)
+    JOURNAL_CONTROL,    // id: ControlId, value: as accepted by ControlSet
+    JOURNAL_ADC,        // id: ADC channel, value: raw reading
+    JOURNAL_ENGINE,     // data: engine index, id: 1 if engine_changed_flag
+    JOURNAL_LAYOUT,     // data: layout, id: 1 if layout_change_flag
+    JOURNAL_ARP,        // data: arp_enabled
+    JOURNAL_VOCODER,    // data: vocoder_source (VocoderInsert::Source)
+    JOURNAL_PART,       // Split/layer part 0: id: 0-2 harmonics/timbre/morph, data: engine
+    JOURNAL_FREEZE,     // data: Clouds freeze parameter
+    JOURNAL_LAST
+};
+
+// Part of the dump format (telemetry packets and journal files).
+struct JournalEvent {
+    uint32_t block;     // Audio blocks since the journal was started
+    uint8_t type;       // JournalEventType
+    uint8_t id;
+    uint16_t data;
+    float value;
+};
+
+static_assert(sizeof(JournalEvent) == 12, "Journal event layout is part of the dump format");
+
+// Control inputs of one audio block, as the callback sees them once the UI
+// has been processed.
+struct JournalState {
+    static const int kNumAdc = 12;
+
+    uint16_t touch_state;
+    float touch_cv;
+    float controls[CONTROL_LAST];
+    float adc[kNumAdc];         // Raw; only deadbanded moves are journaled
+    uint8_t engine;
+    bool engine_changed;        // Pulses, for one block
+    uint8_t layout;             // PolyphonyEngine::Layout, before the pulse
+    bool layout_changed;
+    uint8_t part_engine;        // Split/layer part 0, frozen by SetLayout
+    float part_timbre[3];       // Its harmonics, timbre, morph
+    bool arp_enabled;
+    uint8_t vocoder_source;
+    bool freeze;                // Clouds, after the knobs were applied
+};
+
+class ControlJournal {
+public:
+    static const uint32_t kKeyframeBlocks = 1000;   // 1 s at 32 kHz / 32
+    static const uint32_t kPostRollBlocks = 100;    // Kept after a miss
+
+    // capacity must be a power of two. adc_deadband should match the idle
+    // detector's.
+    void Init(JournalEvent* buffer, size_t capacity, float adc_deadband = 0.01f);
+
+    // Audio callback, once per block after the controls were read.
+    void Record(const JournalState& state);
+    // Audio callback. Stops recording kPostRollBlocks blocks later.
+    void Freeze();
+
+    // Main loop. Once frozen, copies out up to max events, oldest first, and
+    // returns how many; index receives the position of the first one in the
+    // dump. Returns 0 when the dump is complete, and restarts recording.
+    size_t ReadDump(JournalEvent* out, size_t max, uint32_t* index);
+
+    bool frozen() const { return frozen_; }
+    uint32_t block() const { return block_; }
+
+private:
+    void Log(uint8_t type, uint8_t id, uint16_t data, float value);
+    void Restart();
+
+    JournalEvent* buffer_;
+    size_t capacity_;
+    float adc_deadband_;
+
+    uint32_t block_;
+    volatile uint32_t write_count_;
+    JournalState last_;         // As logged, i.e. as a replay will see it
+    int32_t post_roll_;         // Blocks left before freezing, -1 if none
+    volatile bool frozen_;
+
+    bool dump_open_;            // Main loop only
+    uint32_t dump_start_;
+    uint32_t dump_read_;
+    volatile bool restart_;     // Set by the main loop, handled in Record()
+};
+
+// Rebuilds the per-block state from a journal, for replay on the host.
+class JournalPlayer {
+public:
+    // events must start with a keyframe (or be the start of a journal).
+    void Init(const JournalEvent* events, size_t size);
+
+    // Applies the events of the next block and returns its state. The
+    // engine_changed / layout_changed pulses only last for that block.
+    const JournalState& Next();
+
+    bool done() const { return next_ >= size_; }
+    uint32_t block() const { return block_; }
+    size_t num_blocks() const;
+
+private:
+    const JournalEvent* events_;
+    size_t size_;
+    size_t next_;
+    uint32_t block_;
+    JournalState state_;
+};
+
+// Finds the oldest keyframe in a (possibly wrapped) dump; replay starts there.
+size_t FindJournalStart(const JournalEvent* events, size_t size);
+
+extern ControlJournal control_journal;
+
+#endif // CONTROL_JOURNAL_H
@@ -0,0 +1,325 @@
+#include "ControlPath.h"
+#include "Polyphony.h"
+#include <algorithm>
+
+// Shared touch sensor data (polled in main loop)
+volatile uint16_t current_touch_state = 0;
+volatile float touch_cv_value = 0.0f;
+
+float sample_rate = 48000.0f;
+
+// Raw readings of all 12 ADCs, for the idle detector and telemetry
+volatile float adc_raw_values[12] = {0.0f};
+
+volatile int current_engine_index = 0; // Global engine index controlled by touch pads
+// Flag to indicate engine change so we can retrigger voices even when notes are held
+volatile bool engine_changed_flag = false;
+// Set by the UI to step single -> split -> layer; handled at block start
+volatile bool layout_change_flag = false;
+
+Arpeggiator arp;
+volatile bool arp_enabled = false;
+// Applied to vocoder_insert at block start, so a switch lands between blocks
+volatile uint8_t vocoder_source = 0; // VocoderInsert::SOURCE_OFF
+
+const int kSampleEngineIndex = MAX_ENGINE_INDEX + 1;
+SampleVoice sample_voice;
+
+// Global knob values
+float pitch_val, harm_knob_val, timbre_knob_val, morph_knob_val;
+float env_attack_val, env_release_val;
+float delay_time_val;
+float delay_mix_feedback_val;
+float delay_mix_val, delay_feedback_val;
+float mod_wheel_val;
+
+ControlSet controls;
+static const uint32_t kCloudsControls = ControlMask(CONTROL_DELAY_TIME) | ControlMask(CONTROL_MIX)
+    | ControlMask(CONTROL_ATTACK) | ControlMask(CONTROL_TIMBRE) | ControlMask(CONTROL_HARMONICS)
+    | ControlMask(CONTROL_MORPH) | ControlMask(CONTROL_PITCH) | ControlMask(CONTROL_MOD_WHEEL)
+    | ControlMask(CONTROL_TOUCH);
+
+static bool was_arp_on = false; // For ARP state change detection
+
+// Versions the derived values were last updated at; ~0u forces an update.
+static uint32_t clouds_version = ~0u;
+static uint32_t freeze_version = ~0u;
+static uint32_t tempo_version = ~0u;
+static bool tempo_arp_enabled = false;
+// The last Plaits engine, for voice migration across the sample engine
+static int prev_engine_index = 0;
+
+void ResetControlPath() {
+    was_arp_on = false;
+    clouds_version = ~0u;
+    freeze_version = ~0u;
+    tempo_version = ~0u;
+    tempo_arp_enabled = false;
+    prev_engine_index = 0;
+}
+
+// Init() drops the note callback, so it is set again on every restart.
+static void StartArpeggiator(ArpNoteHook on_note) {
+    arp.Init(sample_rate);
+    arp.SetNoteTriggerCallback([on_note](int pad_idx) {
+        if (IsSampleEngine(current_engine_index)) {
+            sample_voice.NoteOn(PolyphonyEngine::PadNote(pad_idx));
+        } else {
+            poly_engine.TriggerArpVoice(pad_idx, current_engine_index);
+        }
+        if (on_note) {
+            on_note(pad_idx);
+        }
+    });
+    arp.SetDirection(Arpeggiator::AsPlayed);
+}
+
+void InitArpeggiator(ArpNoteHook on_note) {
+    StartArpeggiator(on_note);
+}
+
+void SetArpEnabled(bool enabled, ArpNoteHook on_note) {
+    arp_enabled = enabled;
+    if (enabled) {
+        StartArpeggiator(on_note); // Restart timing
+    } else {
+        // Clearing held notes ensures LEDs revert to touch-indication mode
+        arp.ClearNotes();
+    }
+}
+
+bool ApplyKnobValues() {
+    delay_time_val = controls.value(CONTROL_DELAY_TIME);
+    delay_mix_feedback_val = controls.value(CONTROL_MIX);
+    // One knob for both: the echo comes in over the first half, feedback
+    // keeps building across the whole travel.
+    delay_mix_val = std::min(delay_mix_feedback_val * 2.0f, 1.0f) * 0.6f;
+    delay_feedback_val = delay_mix_feedback_val * 0.85f;
+    env_release_val = controls.value(CONTROL_RELEASE);
+    env_attack_val = controls.value(CONTROL_ATTACK);
+    timbre_knob_val = controls.value(CONTROL_TIMBRE);
+    harm_knob_val = controls.value(CONTROL_HARMONICS);
+    morph_knob_val = controls.value(CONTROL_MORPH);
+    pitch_val = controls.value(CONTROL_PITCH);
+    mod_wheel_val = controls.value(CONTROL_MOD_WHEEL);
+
+    // Clouds only needs new parameters when one of its inputs moved.
+    uint32_t version = controls.Version(kCloudsControls);
+    if (version == clouds_version) {
+        return false;
+    }
+    clouds_version = version;
+
+    // Touch pressure reaches the voices through the ModMatrix; Clouds texture
+    // keeps its own 50/50 pressure blend.
+    const float intensity = 0.5f;
+    float texture = morph_knob_val * (1.0f - intensity) + controls.value(CONTROL_TOUCH) * intensity;
+
+    // Clouds Integration: Update Clouds parameters from knobs
+    clouds::Parameters* p = clouds_processor.mutable_parameters();
+    p->pitch         = pitch_val;
+    p->texture       = texture;
+    p->density       = harm_knob_val;
+    p->position      = timbre_knob_val; // control position with knob again
+    p->size          = delay_time_val; // Repurposed delay time knob
+
+    // ADC 1 (delay_mix_feedback_knob) controls dry_wet and feedback
+    p->dry_wet       = delay_mix_feedback_val;
+    p->feedback      = 0.0f;
+#ifdef POST_REVERB
+    // The reverb after Clouds takes the knob instead (ReadKnobValues)
+    p->reverb        = 0.0f;
+#else
+    p->reverb        = delay_mix_feedback_val; // same as dry_wet knob
+#endif
+    p->stereo_spread = env_attack_val;
+    // Freeze when mod wheel exceeds threshold. Only when the wheel moves, so
+    // that a buffer restored frozen at boot (CloudsSnapshot) stays frozen.
+    uint32_t mod_wheel_version = controls.Version(ControlMask(CONTROL_MOD_WHEEL));
+    if (mod_wheel_version != freeze_version) {
+        freeze_version = mod_wheel_version;
+        p->freeze    = (mod_wheel_val > 0.3f);
+    }
+    // End Clouds Integration
+    return true;
+}
+
+void UpdateArpTempo() {
+    // Tempo control for arpeggiator via timing knob; the arpeggiator is
+    // re-initialized when it is switched on, so re-apply it then too.
+    uint32_t version = controls.Version(ControlMask(CONTROL_DELAY_TIME));
+    if (arp_enabled && (version != tempo_version || !tempo_arp_enabled)) {
+        arp.SetMainTempoFromKnob(delay_time_val);
+        tempo_version = version;
+    }
+    tempo_arp_enabled = arp_enabled;
+}
+
+// The UI inputs the rest of the callback acts on, for the control journal.
+void JournalControls() {
+    JournalState state;
+    state.touch_state = current_touch_state;
+    state.touch_cv = touch_cv_value;
+    for (int i = 0; i < CONTROL_LAST; ++i) {
+        state.controls[i] = controls.value(static_cast<ControlId>(i));
+    }
+    for (int i = 0; i < JournalState::kNumAdc; ++i) {
+        state.adc[i] = adc_raw_values[i];
+    }
+    state.engine = static_cast<uint8_t>(current_engine_index);
+    state.engine_changed = engine_changed_flag;
+    state.layout = static_cast<uint8_t>(poly_engine.GetLayout());
+    state.layout_changed = layout_change_flag;
+    const PolyphonyEngine::Part& part = poly_engine.GetPart(0);
+    state.part_engine = static_cast<uint8_t>(part.engine_index);
+    state.part_timbre[0] = part.harmonics;
+    state.part_timbre[1] = part.timbre;
+    state.part_timbre[2] = part.morph;
+    state.arp_enabled = arp_enabled;
+    state.vocoder_source = vocoder_source;
+    state.freeze = clouds_processor.parameters().freeze;
+    control_journal.Record(state);
+}
+
+// Same order as ProcessUIAndControls: pads, knobs, tempo. The touch inputs
+// come from the main loop, so their place does not matter.
+void ReplayControls(const JournalState& state) {
+    // Only the first keyframe of a replay finds the engine or the layout
+    // differing without a change pulse: it starts mid-session.
+    if (!state.engine_changed && state.engine != current_engine_index
+            && !IsSampleEngine(state.engine)) {
+        prev_engine_index = state.engine;
+    }
+    current_engine_index = state.engine;
+    engine_changed_flag = state.engine_changed;
+    if (state.layout != poly_engine.GetLayout()) {
+        PolyphonyEngine::Part part0 = { state.part_engine, state.part_timbre[0],
+            state.part_timbre[1], state.part_timbre[2], false };
+        poly_engine.RestoreLayout(static_cast<PolyphonyEngine::Layout>(state.layout),
+            part0, state.engine);
+    }
+    layout_change_flag = state.layout_changed;
+    if (state.arp_enabled != arp_enabled) {
+        SetArpEnabled(state.arp_enabled, nullptr);
+    }
+    vocoder_source = state.vocoder_source;
+    for (int i = 0; i < JournalState::kNumAdc; ++i) {
+        adc_raw_values[i] = state.adc[i];
+    }
+    // Journaled values went through the deadband already
+    for (int i = 0; i < CONTROL_LAST; ++i) {
+        controls.Restore(static_cast<ControlId>(i), state.controls[i]);
+    }
+    ApplyKnobValues();
+    // The main loop can freeze Clouds too (CloudsSnapshot)
+    clouds_processor.mutable_parameters()->freeze = state.freeze;
+    UpdateArpTempo();
+
+    current_touch_state = state.touch_state;
+    touch_cv_value = state.touch_cv;
+}
+
+void HandleEngineAndLayoutChange() {
+    // React to engine change flag by delegating voice migration to DSP layer.
+    // Across the sample engine the Plaits voices carry on from the last
+    // Plaits engine.
+    if(engine_changed_flag) {
+        if (IsSampleEngine(current_engine_index)) {
+            poly_engine.ClearVoices();
+        } else {
+            sample_voice.NoteOff();
+            poly_engine.OnEngineChange(prev_engine_index, current_engine_index);
+            prev_engine_index = current_engine_index;
+        }
+        engine_changed_flag = false; // Clear flag after handling
+    }
+    if(layout_change_flag && IsSampleEngine(current_engine_index)) {
+        layout_change_flag = false;
+    }
+    if(layout_change_flag) {
+        PolyphonyEngine::Layout next = static_cast<PolyphonyEngine::Layout>(
+            (poly_engine.GetLayout() + 1) % PolyphonyEngine::LAYOUT_LAST);
+        poly_engine.SetLayout(next, current_engine_index, harm_knob_val, timbre_knob_val, morph_knob_val);
+        layout_change_flag = false;
+    }
+}
+
+// Sample engine: one note at a time, the newest pad wins; the note fades out
+// once every pad is up.
+static void HandleSampleTouch(uint16_t touch_state, uint16_t last_touch_state) {
+    uint16_t pressed = touch_state & ~last_touch_state;
+    for (int i = 11; i >= 0; --i) {
+        if ((pressed >> i) & 1) {
+            sample_voice.NoteOn(PolyphonyEngine::PadNote(i));
+            break;
+        }
+    }
+    if (!touch_state && last_touch_state) {
+        sample_voice.NoteOff();
+    }
+}
+
+void UpdateArpState(int& engineIndex, bool& poly_mode, int& effective_num_voices, bool& arp_on_out) {
+    engineIndex = DetermineEngineSettings();
+    bool sample_engine = IsSampleEngine(engineIndex);
+    // Split/layer patches allocate from every slot against the cost budget
+    bool layout = poly_engine.GetLayout() != PolyphonyEngine::LAYOUT_SINGLE && !arp_enabled;
+    poly_mode = !sample_engine && (layout || IsPolyEngine(engineIndex));
+    if (sample_engine) {
+        effective_num_voices = 0;
+    } else if (layout) {
+        effective_num_voices = MAX_VOICES;
+    } else {
+        effective_num_voices = poly_mode ? poly_engine.PolyVoiceCount(engineIndex) : 1;
+    }
+
+    bool current_arp_on = arp_enabled;
+    if (!current_arp_on && was_arp_on) {
+        poly_engine.ResetVoices();
+        poly_engine.UpdateLastTouchState(0);
+        sample_voice.NoteOff();
+    }
+    was_arp_on = current_arp_on;
+    arp_on_out = current_arp_on;
+
+    if (current_arp_on) {
+        arp.UpdateHeldNotes(current_touch_state, poly_engine.GetLastTouchState());
+        arp.Process(BLOCK_SIZE);
+    } else if (sample_engine) {
+        HandleSampleTouch(current_touch_state, poly_engine.GetLastTouchState());
+    } else {
+        poly_engine.HandleTouchInput(current_touch_state, poly_engine.GetLastTouchState(), engineIndex, poly_mode, effective_num_voices);
+    }
+
+    poly_engine.UpdateLastTouchState(current_touch_state);
+}
+
+void RenderVoices(int engineIndex, bool poly_mode, int effective_num_voices, bool arp_on) {
+    if (IsSampleEngine(engineIndex)) {
+        // sample_voice renders into the Clouds feed (ApplyEffectsAndOutput)
+        poly_engine.RenderSilence();
+        return;
+    }
+
+    PolyphonyEngine::RenderParameters params;
+    params.engine_index = engineIndex;
+    params.poly_mode = poly_mode;
+    params.effective_num_voices = effective_num_voices;
+    params.arp_on = arp_on;
+    params.pitch_val = pitch_val;
+    params.harm_knob_val = harm_knob_val;
+    params.morph_knob_val = morph_knob_val;
+    params.timbre_knob_val = timbre_knob_val;
+    params.env_attack_val = env_attack_val;
+    params.env_release_val = env_release_val;
+    params.envelope_version = controls.Version(ControlMask(CONTROL_ATTACK) | ControlMask(CONTROL_RELEASE));
+    params.delay_mix_val = delay_mix_val;
+    params.touch_cv_value = touch_cv_value;
+    params.mod_wheel_val = mod_wheel_val;
+
+    poly_engine.RenderBlock(params);
+}
+
+int DetermineEngineSettings() {
+    return current_engine_index;
+}
@@ -0,0 +1,85 @@
+#pragma once
+#ifndef CONTROL_PATH_H
+#define CONTROL_PATH_H
+
+#include <cstdint>
+#include "Arpeggiator.h"
+#include "ControlJournal.h"
+#include "ControlValue.h"
+#include "SampleStreaming.h"
+#include "clouds/dsp/granular_processor.h"
+
+// The audio callback's control path: from the block's control inputs to the
+// rendered voices. Knob-derived values and Clouds parameters, the arpeggiator's
+// on/off and tempo, engine and layout changes, note handling and
+// PolyphonyEngine all run here, and nothing here touches the hardware.
+//
+// On the device, ProcessControls / ReadKnobValues / PollTouchSensor fill in the
+// inputs below from the ADCs and the touch sensor. On the host, tools/bench
+// fills them in from a control journal with ReplayControls() and then runs the
+// same functions the callback runs, so a replay goes through the firmware's
+// own voice allocation, arpeggiator and layouts.
+
+// --- Control inputs (written by the hardware side or ReplayControls) ---
+extern float sample_rate;
+extern volatile uint16_t current_touch_state;
+extern volatile float touch_cv_value;
+extern volatile float adc_raw_values[12];
+extern volatile int current_engine_index;
+extern volatile bool engine_changed_flag;
+extern volatile bool layout_change_flag;
+extern volatile bool arp_enabled;
+extern volatile uint8_t vocoder_source;    // VocoderInsert::Source, set by the UI
+extern ControlSet controls;                 // Deadbanded knob values and versions
+
+// --- Derived from the controls by ApplyKnobValues() ---
+extern float pitch_val, harm_knob_val, timbre_knob_val, morph_knob_val;
+extern float delay_time_val, delay_mix_feedback_val, delay_mix_val, delay_feedback_val;
+extern float env_attack_val, env_release_val;
+extern float mod_wheel_val;
+
+extern Arpeggiator arp;
+extern clouds::GranularProcessor clouds_processor;
+
+// The sample engine (sample.wav on the card), one step past the last Plaits
+// engine. The model pads only reach it once a sample is loaded; while it is
+// selected the pads and the arpeggiator play sample_voice and the Plaits
+// voices rest. It has no split/layer layouts.
+extern const int kSampleEngineIndex;
+extern SampleVoice sample_voice;
+inline bool IsSampleEngine(int engine_index) {
+    return engine_index == kSampleEngineIndex;
+}
+
+// Called for every arpeggiator note after the voice is triggered (pad LEDs).
+typedef void (*ArpNoteHook)(int pad_idx);
+
+// Forgets what the control path derived from earlier blocks, so that the
+// next block recomputes everything; the host calls it before a replay.
+void ResetControlPath();
+// Boot: sets the arpeggiator up, off.
+void InitArpeggiator(ArpNoteHook on_note);
+// Arp pad toggle: switching on restarts the arpeggiator's timing, switching
+// off drops its held notes.
+void SetArpEnabled(bool enabled, ArpNoteHook on_note);
+
+// After controls moved: the knob values the rest of the synth reads, and the
+// Clouds parameters. Returns true if an input of Clouds moved.
+bool ApplyKnobValues();
+// Arpeggiator tempo from the delay time knob.
+void UpdateArpTempo();
+
+// Audio callback, once the controls are read: logs them to control_journal.
+void JournalControls();
+// Host: sets the control inputs of one journaled block, as ProcessControls and
+// ReadKnobValues would have, and derives the knob values from them.
+void ReplayControls(const JournalState& state);
+
+// Audio callback, after JournalControls(): consumes the engine and layout
+// change flags.
+void HandleEngineAndLayoutChange();
+void UpdateArpState(int& engineIndex, bool& poly_mode, int& effective_num_voices, bool& arp_on);
+void RenderVoices(int engineIndex, bool poly_mode, int effective_num_voices, bool arp_on);
+int DetermineEngineSettings();
+
+#endif // CONTROL_PATH_H
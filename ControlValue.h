@@ -0,0 +1,101 @@
+#pragma once
+#ifndef CONTROL_VALUE_H
+#define CONTROL_VALUE_H
+
+#include <cmath>
+#include <cstdint>
+
+// Knob readings go through a deadband before they reach the rest of the
+// synth: a value only moves once the input has drifted past the deadband from
+// where it last settled, and every move bumps a version counter. Consumers
+// remember the version their derived values (envelope times, Clouds
+// parameters, tempo...) were computed from and skip the work when it has not
+// changed - which, with the knobs at rest, is every block.
+enum ControlId {
+    CONTROL_DELAY_TIME,     // ADC 0
+    CONTROL_MIX,            // ADC 1
+    CONTROL_RELEASE,        // ADC 2
+    CONTROL_ATTACK,         // ADC 3
+    CONTROL_TIMBRE,         // ADC 4
+    CONTROL_HARMONICS,      // ADC 5
+    CONTROL_MORPH,          // ADC 6
+    CONTROL_PITCH,          // ADC 7
+    CONTROL_MOD_WHEEL,      // ADC 11
+    CONTROL_TOUCH,          // Touch pressure
+    CONTROL_LAST
+};
+
+class ControlValue {
+public:
+    void Init(float value, float deadband) {
+        value_ = value;
+        deadband_ = deadband;
+        version_ = 0;
+    }
+
+    // Returns true if the value moved. The ends of the range are always
+    // reachable, whatever the deadband.
+    bool Set(float value) {
+        if (value == value_) {
+            return false;
+        }
+        bool at_end = value <= 0.0f || value >= 1.0f;
+        if (!at_end && fabsf(value - value_) <= deadband_) {
+            return false;
+        }
+        value_ = value;
+        ++version_;
+        return true;
+    }
+
+    // Takes a value that went through Set() before as is (journal replay),
+    // so that the versions move on the same blocks as they did then.
+    void Restore(float value) {
+        if (value != value_) {
+            value_ = value;
+            ++version_;
+        }
+    }
+
+    float value() const { return value_; }
+    uint32_t version() const { return version_; }
+
+private:
+    float value_;
+    float deadband_;
+    uint32_t version_;
+};
+
+class ControlSet {
+public:
+    void Init(float deadband) {
+        for (int i = 0; i < CONTROL_LAST; ++i) {
+            controls_[i].Init(0.0f, deadband);
+        }
+    }
+
+    bool Set(ControlId id, float value) { return controls_[id].Set(value); }
+    void Restore(ControlId id, float value) { controls_[id].Restore(value); }
+    float value(ControlId id) const { return controls_[id].value(); }
+
+    // Changes whenever any of the controls in mask (bit i = ControlId i)
+    // moves; counters only grow, so their sum does too.
+    uint32_t Version(uint32_t mask) const {
+        uint32_t version = 0;
+        for (int i = 0; i < CONTROL_LAST; ++i) {
+            if (mask & (1u << i)) {
+                version += controls_[i].version();
+            }
+        }
+        return version;
+    }
+
+private:
+    ControlValue controls_[CONTROL_LAST];
+};
+
+inline uint32_t ControlMask(ControlId id) {
+    return 1u << id;
+}
+
+#endif // CONTROL_VALUE_H
@@ -0,0 +1,92 @@
+#include "DeadlineMonitor.h"
+#include <atomic>
+
+DeadlineMonitor deadline_monitor;
+
+void DeadlineMonitor::Init(float sample_rate, size_t block_size, float near_miss_ratio) {
+    const float period = static_cast<float>(SystemCoreClock) * block_size / sample_rate;
+    budget_cycles_ = static_cast<uint32_t>(period);
+    near_miss_cycles_ = static_cast<uint32_t>(period * near_miss_ratio);
+    late_start_cycles_ = static_cast<uint32_t>(period * 1.5f);
+
+    started_ = false;
+    event_ = EVENT_NONE;
+    misses_ = 0;
+    near_misses_ = 0;
+    window_max_cycles_ = 0;
+    write_count_ = 0;
+    read_count_ = 0;
+}
+
+void DeadlineMonitor::BlockStart(uint32_t now) {
+    interval_ = started_ ? now - previous_start_ : budget_cycles_;
+    previous_start_ = now;
+    block_start_ = now;
+    started_ = true;
+}
+
+DeadlineMonitor::EventKind DeadlineMonitor::BlockEnd(uint32_t now) {
+    block_cycles_ = now - block_start_;
+    if (block_cycles_ > window_max_cycles_) {
+        window_max_cycles_ = block_cycles_;
+    }
+
+    if (block_cycles_ > budget_cycles_) {
+        event_ = EVENT_MISS;
+    } else if (interval_ > late_start_cycles_) {
+        event_ = EVENT_LATE_START;
+    } else if (block_cycles_ > near_miss_cycles_) {
+        event_ = EVENT_NEAR_MISS;
+    } else {
+        event_ = EVENT_NONE;
+    }
+
+    if (event_ == EVENT_NEAR_MISS) {
+        ++near_misses_;
+    } else if (event_ != EVENT_NONE) {
+        ++misses_;
+    }
+    return event_;
+}
+
+void DeadlineMonitor::Log(Record& record, const uint32_t* stage_cycles) {
+    record.block_cycles = block_cycles_;
+    record.interval_cycles = interval_;
+    record.kind = event_;
+    record.worst_stage = 0;
+    for (int s = 0; s < STAGE_LAST; ++s) {
+        record.stage_cycles[s] = stage_cycles[s];
+        if (stage_cycles[s] > stage_cycles[record.worst_stage]) {
+            record.worst_stage = s;
+        }
+    }
+
+    const uint32_t write = write_count_;
+    records_[write & (kNumRecords - 1)] = record;
+    std::atomic_signal_fence(std::memory_order_release);
+    write_count_ = write + 1;
+}
+
+bool DeadlineMonitor::Pop(Record& record) {
+    uint32_t write = write_count_;
+    if (write - read_count_ > kNumRecords) {
+        // Lapped: the oldest unread records were overwritten.
+        read_count_ = write - kNumRecords;
+    }
+    if (read_count_ == write) return false;
+
+    std::atomic_signal_fence(std::memory_order_acquire);
+    record = records_[read_count_ & (kNumRecords - 1)];
+    // If the callback wrote over this slot while it was copied, drop it.
+    std::atomic_signal_fence(std::memory_order_acquire);
+    write = write_count_;
+    bool intact = write - read_count_ <= kNumRecords;
+    ++read_count_;
+    return intact;
+}
+
+float DeadlineMonitor::TakeWindowMaxLoad() {
+    const uint32_t max_cycles = window_max_cycles_;
+    window_max_cycles_ = 0;
+    return static_cast<float>(max_cycles) / budget_cycles_;
+}
@@ -0,0 +1,90 @@
+#pragma once
+#ifndef DEADLINE_MONITOR_H
+#define DEADLINE_MONITOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include "Telemetry.h"
+
+// Watches every audio callback against its deadline (one block period, 1 ms
+// at 32 kHz / 32 samples) using the core cycle counter.
+//
+// A block is a near miss when it takes more than near_miss_ratio of the
+// period, and a miss when it takes longer than the period or when the callback
+// starts late (more than 1.5 periods after the previous one) - the latter
+// catches overruns caused by interrupts outside the callback as well.
+// Each event leaves a Record with the synth state at the time in a small ring,
+// which the main loop forwards through the telemetry stream.
+class DeadlineMonitor {
+public:
+    enum EventKind : uint8_t {
+        EVENT_NONE,
+        EVENT_NEAR_MISS,
+        EVENT_MISS,
+        EVENT_LATE_START
+    };
+
+    // Part of the telemetry wire format (TELEMETRY_PACKET_DEADLINE).
+    struct Record {
+        uint32_t timestamp_ms;
+        uint32_t block_cycles;                 // Callback duration
+        uint32_t interval_cycles;              // Since the previous callback start
+        uint32_t stage_cycles[STAGE_LAST];
+        uint8_t kind;                          // EventKind
+        uint8_t worst_stage;                   // TelemetryStage that took longest
+        uint8_t engine;
+        uint8_t active_voices;
+        uint8_t arp_on;
+        uint8_t clouds_mode;                   // clouds::PlaybackMode
+        uint8_t clouds_grains;
+        uint8_t clouds_quality;
+    };
+
+    static_assert(sizeof(Record) == 32, "Deadline record layout is part of the wire format");
+
+    static const size_t kNumRecords = 32;      // Power of two
+
+    void Init(float sample_rate, size_t block_size, float near_miss_ratio = 0.9f);
+
+    // Audio callback, first thing. now is ReadCycleCounter().
+    void BlockStart(uint32_t now);
+    // Audio callback, last thing. Returns what (if anything) happened; for
+    // anything but EVENT_NONE the caller fills in the context and calls Log().
+    EventKind BlockEnd(uint32_t now);
+    // Audio callback. Fills in the timing fields and stores the record,
+    // overwriting the oldest one when the ring is full.
+    void Log(Record& record, const uint32_t* stage_cycles);
+
+    // Main loop. Copies out the oldest record not yet read.
+    bool Pop(Record& record);
+
+    uint32_t misses() const { return misses_; }
+    uint32_t near_misses() const { return near_misses_; }
+    // Highest block load since the last call (CpuLoadMeter's maximum is never
+    // reset, so it stops saying anything after the first glitch).
+    float TakeWindowMaxLoad();
+
+private:
+    uint32_t budget_cycles_;
+    uint32_t near_miss_cycles_;
+    uint32_t late_start_cycles_;
+
+    uint32_t block_start_;
+    uint32_t previous_start_;
+    uint32_t interval_;
+    uint32_t block_cycles_;
+    bool started_;
+    EventKind event_;
+
+    volatile uint32_t misses_;
+    volatile uint32_t near_misses_;
+    volatile uint32_t window_max_cycles_;
+
+    Record records_[kNumRecords];
+    volatile uint32_t write_count_;
+    uint32_t read_count_;
+};
+
+extern DeadlineMonitor deadline_monitor;
+
+#endif // DEADLINE_MONITOR_H
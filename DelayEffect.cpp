@@ -1,45 +1,86 @@
 #include "DelayEffect.h"
 #include "Thaumazein.h" // For global variables and Daisy hardware access
 
-// Removed multi-line comment about assumed global variables
+int16_t delay_buffer[MAX_DELAY_SAMPLES]; // Placed in SDRAM via DSY_SDRAM_BSS in .h
+infrasonic::EchoDelay delay;
 
 namespace DelayEffect {
 
-void UpdateDelay() {
+// Synced echoes are at least this long, so fast arps repeat every few steps
+static const float kMinSyncedTime = 0.12f;
+static const float kMixOff = 0.001f;
+// Below the idle detector's output threshold
+static const float kLineSilence = 1.0e-4f;
+
+static float mix = 0.0f;
+static float mix_target = 0.0f;
+static bool running = false;
+static size_t quiet_samples = 0;   // Since the last audible sample went in
+
+void Init(float sample_rate) {
+    delay.Init(sample_rate, delay_buffer, MAX_DELAY_SAMPLES);
+    delay.SetLagTime(0.15f);
+}
+
+void UpdateDelay(bool arp_on) {
+    // Only recompute when a knob moved or the arp was toggled
+    static uint32_t delay_version = ~0u;
+    static bool delay_arp_on = false;
+    uint32_t version = controls.Version(ControlMask(CONTROL_DELAY_TIME) | ControlMask(CONTROL_MIX));
+    if (version == delay_version && arp_on == delay_arp_on) {
+        return;
+    }
+    delay_version = version;
+    delay_arp_on = arp_on;
+
     delay.SetFeedback(delay_feedback_val * 0.98f); 
+    mix_target = delay_mix_val;
+
     float delay_time_s = 0.01f + delay_time_val * 0.99f; 
+    if (arp_on) {
+        float step = arp.GetCurrentInterval();
+        float steps = ceilf(kMinSyncedTime / step);
+        delay_time_s = step * fmaxf(steps, 1.0f);
+    }
     delay.SetDelayTime(delay_time_s);
 }
 
-void ApplyDelayToOutput(const float* mixed_signal_input, // This will be mix_buffer_out
-                        daisy::AudioHandle::InterleavingOutputBuffer out,
-                        size_t size,
-                        float dry_level) {
-    float wet_level = 1.0f - dry_level; 
-    
-    float dry_level_clamped = fmaxf(0.0f, fminf(dry_level, 1.0f));
-
-    float norm_factor = static_cast<float>(NUM_VOICES) * MASTER_VOLUME;
-    if (norm_factor == 0.0f) { // Prevent division by zero
-        // Handle the case where norm_factor is zero
-        // This is a placeholder and should be replaced with an appropriate handling logic
-        norm_factor = 1.0f; // Using a default value to avoid division by zero
+void ApplyDelay(float* buffer, size_t size) {
+    static float wet[BLOCK_SIZE];
+
+    if (mix_target < kMixOff && mix < kMixOff) {
+        mix = 0.0f;
+        running = false;
+        return;
+    }
+    if (!running) {
+        // Whatever is in the line predates the mix going down
+        delay.Reset();
+        running = true;
+        quiet_samples = MAX_DELAY_SAMPLES;
+    }
+
+    delay.Process(buffer, wet, size);
+
+    // The line takes in + feedback * wet, never louder than both
+    for (size_t i = 0; i < size; ++i) {
+        if (fabsf(buffer[i]) > kLineSilence || fabsf(wet[i]) > kLineSilence) {
+            quiet_samples = 0;
+        } else if (quiet_samples < MAX_DELAY_SAMPLES) {
+            ++quiet_samples;
+        }
     }
-    
-    for (size_t i = 0; i < size; i += 2) {
-        // mixed_signal_input is effectively mix_buffer_out[i/2]
-        float raw_sample_from_buffer = mixed_signal_input[i/2];
-        
-        float sample_to_delay = raw_sample_from_buffer / 32768.f / norm_factor;
-
-        float wet_sample = delay.Process(sample_to_delay); // delay object from Thaumazein.h
-        
-        // MASTER_VOLUME is assumed to be from Thaumazein.h
-        float output_val = ((sample_to_delay * dry_level_clamped) + (wet_sample * wet_level)) * MASTER_VOLUME;
-        
-        out[i]     = output_val;
-        out[i+1]   = output_val;
+
+    float mix_inc = (mix_target - mix) / static_cast<float>(size);
+    for (size_t i = 0; i < size; ++i) {
+        mix += mix_inc;
+        buffer[i] += wet[i] * mix;
     }
+    mix = mix_target;
+}
+
+bool IsRinging() {
+    return running && mix_target >= kMixOff && quiet_samples < MAX_DELAY_SAMPLES;
 }
 
-} // namespace DelayEffect 
\ No newline at end of file
+} // namespace DelayEffect 
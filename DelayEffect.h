@@ -2,29 +2,38 @@
 
 #include <cstddef> // For size_t
 
-// Assuming 'daisy.h' or a similar header included by 'Thaumazein.h'
-// makes 'daisy::AudioHandle' available. For self-containment of this header,
-// and to ensure Daisy types are known:
-#include "daisy.h"
-
 namespace DelayEffect {
 
+    /**
+     * @brief Points the echo delay at its SDRAM line and resets it.
+     */
+    void Init(float sample_rate);
+
     /**
      * @brief Configures the delay parameters like feedback and time.
+     *
+     * Free-running time follows the delay time knob; with the arpeggiator on
+     * the time locks to a whole number of arp steps.
+     */
+    void UpdateDelay(bool arp_on);
+
+    /**
+     * @brief Adds the delayed signal to a mono block, in place.
+     *
+     * Does nothing (and leaves the line untouched) while the mix is down.
+     *
+     * @param buffer Mono samples in [-1, 1].
+     * @param size Number of samples.
      */
-    void UpdateDelay();
+    void ApplyDelay(float* buffer, size_t size);
 
     /**
-     * @brief Applies the delay effect to the input audio signal and writes to the output buffer.
-     * 
-     * @param mixed_signal_input Pointer to the input buffer containing the dry audio signal (mono).
-     * @param out The interleaved output buffer to write the processed audio to.
-     * @param size The number of samples in the output buffer (for all channels).
-     * @param dry_level The proportion of the dry signal in the final mix (0.0 to 1.0).
+     * @brief Whether echoes are still to come: the mix is up and something
+     * above the silence threshold went into the line within its length.
+     *
+     * The idle detector's hold is shorter than the longest echo, so it
+     * counts this as activity.
      */
-    void ApplyDelayToOutput(const float* mixed_signal_input,
-                            daisy::AudioHandle::InterleavingOutputBuffer out,
-                            size_t size,
-                            float dry_level);
+    bool IsRinging();
 
-} // namespace DelayEffect 
\ No newline at end of file
+} // namespace DelayEffect 
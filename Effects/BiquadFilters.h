@@ -5,6 +5,11 @@
 #include <cassert>
 #include <array>
 #include <daisysp.h>
+#ifdef __arm__
+#include <arm_math.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 namespace infrasonic {
 
@@ -35,12 +40,14 @@ class BiquadSection {
         ~BiquadSection() {}
 
         void SetCoefficients(const Coefficients coefficients) { coefs_ = coefficients; }
+        const Coefficients& coefficients() const { return coefs_; }
 
         inline float Process(const float in, const int channel)
         {
             assert(channel < 2);
 
-            // TODO: arm accelerated version
+            // Per-sample path; BiquadCascade::ProcessBlock* cover whole
+            // blocks (CMSIS on target, SSE on host).
 
             const float &b0 = coefs_[0];
             const float &b1 = coefs_[1];
@@ -67,47 +74,76 @@ class BiquadSection {
 
 /// Templated cascaded biquad filter. Filter Order = 2 * NumSections.
 /// NOTE: Only supports even-ordered filters.
+///
+/// Process()/ProcessStereo() run per sample and pick up new parameters
+/// immediately. ProcessBlock()/ProcessBlockStereo() keep their own state and
+/// glide to new coefficients over kCoefRampBlocks blocks, so parameters can be
+/// moved every block without zipper noise or per-sample trig. Use one family
+/// or the other on a given instance.
 template<size_t NumSections, BiquadSection::FilterType FilterType>
 class BiquadCascade {
 
     static_assert(NumSections > 0, "Must have at least one section");
 
     public:
+        static constexpr size_t kCoefRampBlocks = 4;
+
         BiquadCascade() {}
         ~BiquadCascade() {}
 
         // Individual param update methods recalculate coefficients
-        // every time one of them is called. To update everything at once,
+        // whenever one of them changes a value. To update everything at once,
         // use SetParams()
 
         void Init(const float sample_rate) {
             sample_rate_ = sample_rate;
             cutoff_hz_ = sample_rate * 0.25f;
             SetFlatResponse();
+            for (size_t i=0; i<NumSections * 5; i++) {
+                block_coefs_[i] = target_coefs_[i];
+                coef_inc_[i] = 0.0f;
+            }
+            ramp_blocks_left_ = 0;
+            for (size_t i=0; i<NumSections * 4; i++) {
+                block_state_[i] = 0.0f;
+            }
+#ifdef __arm__
+            arm_biquad_cascade_df2T_init_f32(&mono_inst_, NumSections, block_coefs_, block_state_);
+            arm_biquad_cascade_stereo_df2T_init_f32(&stereo_inst_, NumSections, block_coefs_, block_state_);
+#endif
         }
 
         inline void SetCutoff(const float cutoff_hz)
         {
-            cutoff_hz_ = daisysp::fclamp(cutoff_hz, 1.f, sample_rate_ * 0.5f);
+            const float cutoff = daisysp::fclamp(cutoff_hz, 1.f, sample_rate_ * 0.5f);
+            if (cutoff == cutoff_hz_) return;
+            cutoff_hz_ = cutoff;
             updateCoefficients();
         }
 
         inline void SetQ(const float q)
         {
+            const float q_clamped = daisysp::fmax(q, 0.1f);
+            bool changed = false;
             for (size_t i=0; i<NumSections; i++) {
-                q_[i] = daisysp::fmax(q, 0.1f);
+                changed = changed || q_[i] != q_clamped;
+                q_[i] = q_clamped;
             }
-            updateCoefficients();
+            if (changed) updateCoefficients();
         }
 
         /// Update params simultaneously, recalculating coefficients only once 
         inline void SetParams(const float cutoff_hz, const float q)
         {
-            cutoff_hz_ = daisysp::fclamp(cutoff_hz, 1.f, sample_rate_ * 0.5f);
+            const float cutoff = daisysp::fclamp(cutoff_hz, 1.f, sample_rate_ * 0.5f);
+            const float q_clamped = daisysp::fmax(q, 0.1f);
+            bool changed = cutoff != cutoff_hz_;
+            cutoff_hz_ = cutoff;
             for (size_t i=0; i<NumSections; i++) {
-                q_[i] = daisysp::fmax(q, 0.1f);
+                changed = changed || q_[i] != q_clamped;
+                q_[i] = q_clamped;
             }
-            updateCoefficients();
+            if (changed) updateCoefficients();
         }
 
         /// Sets Q values in each section for a truly "flat" (-3dB cutoff point) response
@@ -139,6 +175,83 @@ class BiquadCascade {
             }
         }
 
+        /// Mono block processing. `in` and `out` may alias.
+        void ProcessBlock(const float *in, float *out, size_t size)
+        {
+            stepCoefficientRamp();
+#ifdef __arm__
+            arm_biquad_cascade_df2T_f32(&mono_inst_, in, out, size);
+#else
+            // Section by section over the whole block, state in registers
+            for (size_t s=0; s<NumSections; s++) {
+                const float *c = &block_coefs_[s * 5];
+                const float b0 = c[0], b1 = c[1], b2 = c[2], a1 = c[3], a2 = c[4];
+                float s1 = block_state_[s * 2];
+                float s2 = block_state_[s * 2 + 1];
+                const float *src = s == 0 ? in : out;
+                for (size_t i=0; i<size; i++) {
+                    const float x = src[i];
+                    const float y = b0 * x + s1;
+                    s1 = s2 + b1 * x + a1 * y;
+                    s2 = b2 * x + a2 * y;
+                    out[i] = y;
+                }
+                block_state_[s * 2] = s1;
+                block_state_[s * 2 + 1] = s2;
+            }
+#endif
+        }
+
+        /// In-place stereo block processing on interleaved L/R frames.
+        void ProcessBlockStereo(float *interleaved, size_t frames)
+        {
+            stepCoefficientRamp();
+#ifdef __arm__
+            arm_biquad_cascade_stereo_df2T_f32(&stereo_inst_, interleaved, interleaved, frames);
+#elif defined(__SSE2__)
+            // Left and right share the coefficients; one SSE lane each
+            for (size_t s=0; s<NumSections; s++) {
+                const float *c = &block_coefs_[s * 5];
+                const __m128 b0 = _mm_set1_ps(c[0]), b1 = _mm_set1_ps(c[1]), b2 = _mm_set1_ps(c[2]);
+                const __m128 a1 = _mm_set1_ps(c[3]), a2 = _mm_set1_ps(c[4]);
+                __m128 s1 = _mm_setr_ps(block_state_[s * 4], block_state_[s * 4 + 2], 0.0f, 0.0f);
+                __m128 s2 = _mm_setr_ps(block_state_[s * 4 + 1], block_state_[s * 4 + 3], 0.0f, 0.0f);
+                for (size_t i=0; i<frames; i++) {
+                    double *frame = reinterpret_cast<double *>(&interleaved[i * 2]);
+                    const __m128 x = _mm_castpd_ps(_mm_load_sd(frame));
+                    const __m128 y = _mm_add_ps(_mm_mul_ps(b0, x), s1);
+                    s1 = _mm_add_ps(_mm_add_ps(s2, _mm_mul_ps(b1, x)), _mm_mul_ps(a1, y));
+                    s2 = _mm_add_ps(_mm_mul_ps(b2, x), _mm_mul_ps(a2, y));
+                    _mm_store_sd(frame, _mm_castps_pd(y));
+                }
+                float st[4];
+                _mm_storeu_ps(st, s1);
+                block_state_[s * 4] = st[0];
+                block_state_[s * 4 + 2] = st[1];
+                _mm_storeu_ps(st, s2);
+                block_state_[s * 4 + 1] = st[0];
+                block_state_[s * 4 + 3] = st[1];
+            }
+#else
+            for (size_t s=0; s<NumSections; s++) {
+                const float *c = &block_coefs_[s * 5];
+                for (size_t ch=0; ch<2; ch++) {
+                    float s1 = block_state_[s * 4 + ch * 2];
+                    float s2 = block_state_[s * 4 + ch * 2 + 1];
+                    for (size_t i=0; i<frames; i++) {
+                        const float x = interleaved[i * 2 + ch];
+                        const float y = c[0] * x + s1;
+                        s1 = s2 + c[1] * x + c[3] * y;
+                        s2 = c[2] * x + c[4] * y;
+                        interleaved[i * 2 + ch] = y;
+                    }
+                    block_state_[s * 4 + ch * 2] = s1;
+                    block_state_[s * 4 + ch * 2 + 1] = s2;
+                }
+            }
+#endif
+        }
+
     private:
 
         float sample_rate_;
@@ -146,9 +259,47 @@ class BiquadCascade {
 
         std::array<BiquadSection, NumSections> biquads_;
 
+        // Block path: coefficients in CMSIS df2T order {b0, b1, b2, -a1, -a2}
+        // per section, gliding towards target_coefs_. State is laid out for
+        // the stereo kernel (d1 L, d2 L, d1 R, d2 R per section); the mono
+        // kernel uses the first 2 * NumSections floats.
+        float block_coefs_[NumSections * 5];
+        float target_coefs_[NumSections * 5];
+        float coef_inc_[NumSections * 5];
+        size_t ramp_blocks_left_ = 0;
+        float block_state_[NumSections * 4];
+#ifdef __arm__
+        arm_biquad_cascade_df2T_instance_f32 mono_inst_;
+        arm_biquad_cascade_stereo_df2T_instance_f32 stereo_inst_;
+#endif
+
         inline void updateCoefficients() {
             for (size_t i=0; i<NumSections; i++) {
-                biquads_[i].SetCoefficients(BiquadSection::CalculateCoefficients(FilterType, sample_rate_, cutoff_hz_, q_[i]));
+                const BiquadSection::Coefficients c = BiquadSection::CalculateCoefficients(FilterType, sample_rate_, cutoff_hz_, q_[i]);
+                biquads_[i].SetCoefficients(c);
+                float *t = &target_coefs_[i * 5];
+                t[0] = c[0];
+                t[1] = c[1];
+                t[2] = c[2];
+                t[3] = -c[3];
+                t[4] = -c[4];
+            }
+            for (size_t i=0; i<NumSections * 5; i++) {
+                coef_inc_[i] = (target_coefs_[i] - block_coefs_[i]) * (1.0f / kCoefRampBlocks);
+            }
+            ramp_blocks_left_ = kCoefRampBlocks;
+        }
+
+        inline void stepCoefficientRamp() {
+            if (ramp_blocks_left_ == 0) return;
+            if (--ramp_blocks_left_ == 0) {
+                for (size_t i=0; i<NumSections * 5; i++) {
+                    block_coefs_[i] = target_coefs_[i];
+                }
+            } else {
+                for (size_t i=0; i<NumSections * 5; i++) {
+                    block_coefs_[i] += coef_inc_[i];
+                }
             }
         }
 };
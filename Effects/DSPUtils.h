@@ -44,7 +44,7 @@ inline float tanf(const float x)
     // arm_sin_cos_f32(x, &s, &c);
     // return s / c;
 #else
-    return std::tanf(x);
+    return std::tan(x); // std::tanf is missing from some host libstdc++
 #endif
 }
 
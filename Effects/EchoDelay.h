@@ -2,6 +2,8 @@
 #ifndef INFS_ECHODELAY_H
 #define INFS_ECHODELAY_H
 
+#include <cstddef>
+#include <cstdint>
 #include <daisysp.h>
 #include "BiquadFilters.h"
 #include "DSPUtils.h"
@@ -10,13 +12,13 @@ namespace infrasonic {
 
 /**
  * @brief
- * Tape-ish echo delay.
+ * Tape-ish echo delay, processed a block at a time.
+ *   - Lines are stored as 16-bit samples in caller-provided memory (SDRAM),
+ *     so a few seconds of delay cost no internal RAM
+ *   - Delay time is smoothed once per block and ramped linearly across it
  *   - Feedback is unbounded, but signal is soft-clipped
  *   - Output is full-wet, should be mixed with dry signal externally
- *
- * @tparam MaxLength Max length of delay in samples
  */
-template<size_t MaxLength>
 class EchoDelay {
 
     public:
@@ -24,12 +26,31 @@ class EchoDelay {
         EchoDelay() {}
         ~EchoDelay() {}
 
-        void Init(float sample_rate)
+        /**
+         * @param buffer Delay memory, `length` samples. Not cleared here;
+         *               samples older than the last Reset() are never read.
+         */
+        void Init(float sample_rate, int16_t* buffer, size_t length)
         {
             sample_rate_ = sample_rate;
-            delayLine_.Init();
+            buffer_ = buffer;
+            length_ = length;
             bpf_.Init(sample_rate);
             bpf_.SetParams(800.0f, 1.0f);
+            SetLagTime(0.2f);
+            SetDelayTime(0.25f, true);
+            feedback_ = 0.0f;
+            feedback_target_ = 0.0f;
+            Reset();
+        }
+
+        /**
+         * @brief Forget the delay contents without touching the memory
+         */
+        void Reset()
+        {
+            write_ptr_ = 0;
+            written_ = 0;
         }
 
         /**
@@ -43,39 +64,67 @@ class EchoDelay {
         /**
          * @brief Set the Delay Time in seconds
          *
-         * @param time_s Delay time in seconds. Will be truncated to MaxLength.
+         * @param time_s Delay time in seconds. Will be truncated to the buffer length.
          * @param immediately If true, sets delay time immediately with no smoothing.
          */
         void SetDelayTime(const float time_s, bool immediately = false)
         {
-            delay_time_target_ = time_s;
-            if (immediately) delay_time_current_ = time_s;
+            delay_target_ = daisysp::fclamp(time_s * sample_rate_, 1.0f, MaxDelay());
+            if (immediately) delay_current_ = delay_target_;
         }
 
         /**
          * @brief
          * Set the feedback amount (linear multiplier).
          * This can be >1 in magnitude for saturated swells, or negative.
-         *
-         * NOTE: This is not internally smoothed. Use external smoothing if desired.
-         *
-         * @param feedback
+         * Ramped across the next block.
          */
         void SetFeedback(const float feedback)
         {
-            feedback_ = feedback;
+            feedback_target_ = feedback;
         }
 
-        inline float Process(const float in)
+        float MaxDelay() const { return static_cast<float>(length_) - 2.0f; }
+
+        /**
+         * @brief Process a block of mono samples. `in` and `out` may alias.
+         */
+        void Process(const float* in, float* out, size_t size)
         {
-            float out;
-            daisysp::fonepole(delay_time_current_, delay_time_target_, delay_smooth_coef_);
-            delayLine_.SetDelay(delay_time_current_ * sample_rate_);
-            out = delayLine_.Read();
-            out = bpf_.Process(out);
-            out = daisysp::SoftClip(out);
-            delayLine_.Write(out * feedback_ + in);
-            return out;
+            // The one-pole runs at block rate; its per-sample coefficient is
+            // scaled by the block length.
+            const float coef = daisysp::fmin(delay_smooth_coef_ * size, 1.0f);
+            const float size_recip = 1.0f / static_cast<float>(size);
+            float delay = delay_current_;
+            delay_current_ += (delay_target_ - delay_current_) * coef;
+            const float delay_inc = (delay_current_ - delay) * size_recip;
+            float feedback = feedback_;
+            const float feedback_inc = (feedback_target_ - feedback_) * size_recip;
+            feedback_ = feedback_target_;
+
+            for (size_t i = 0; i < size; ++i) {
+                delay += delay_inc;
+                feedback += feedback_inc;
+
+                const size_t delay_int = static_cast<size_t>(delay);
+                const float delay_frac = delay - static_cast<float>(delay_int);
+                float wet = 0.0f;
+                if (delay_int + 1 <= written_) {
+                    size_t a = write_ptr_ + length_ - delay_int;
+                    if (a >= length_) a -= length_;
+                    size_t b = a == 0 ? length_ - 1 : a - 1;
+                    const float sa = static_cast<float>(buffer_[a]);
+                    const float sb = static_cast<float>(buffer_[b]);
+                    wet = (sa + (sb - sa) * delay_frac) * kFromInt16;
+                }
+                wet = bpf_.Process(wet);
+                wet = daisysp::SoftClip(wet);
+
+                buffer_[write_ptr_] = ToInt16(wet * feedback + in[i]);
+                if (++write_ptr_ >= length_) write_ptr_ = 0;
+                if (written_ < length_) ++written_;
+                out[i] = wet;
+            }
         }
 
     private:
@@ -85,14 +134,27 @@ class EchoDelay {
         EchoDelay& operator=(const EchoDelay &other) = delete;
         EchoDelay& operator=(EchoDelay &&other) = delete;
 
+        static constexpr float kFromInt16 = 1.0f / 32768.0f;
+
+        static inline int16_t ToInt16(float x)
+        {
+            x = daisysp::fclamp(x, -1.0f, 1.0f) * 32767.0f;
+            return static_cast<int16_t>(x);
+        }
+
         float sample_rate_;
-        float delay_time_current_;
-        float delay_time_target_;
+        float delay_current_;       // Samples
+        float delay_target_;
         float delay_smooth_coef_;
 
         float feedback_;
+        float feedback_target_;
+
+        int16_t* buffer_;
+        size_t length_;
+        size_t write_ptr_;
+        size_t written_;            // Samples written since Reset(), up to length_
 
-        daisysp::DelayLine<float, MaxLength> delayLine_;
         BPF12 bpf_;
 };
 
@@ -0,0 +1,317 @@
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include "reverbsc16.h"
+#include "stmlib/utils/buffer_allocator.h"
+
+#define DEFAULT_SRATE 48000.0
+#define DELAYPOS_SHIFT 28
+#define DELAYPOS_SCALE 0x10000000
+#define DELAYPOS_MASK 0x0FFFFFFF
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846 /* pi */
+#endif
+
+using namespace daisysp;
+
+/* Same line table as ReverbSc                                       */
+/* kReverbParams[n][0] = delay time (in seconds)                     */
+/* kReverbParams[n][1] = random variation in delay time (in seconds) */
+/* kReverbParams[n][2] = random variation frequency (in 1/sec)       */
+/* kReverbParams[n][3] = random seed (0 - 32767)                     */
+
+static const float kReverbParams[8][4]
+    = {{(2473.0 / DEFAULT_SRATE), 0.0010, 3.100, 1966.0},
+       {(2767.0 / DEFAULT_SRATE), 0.0011, 3.500, 29491.0},
+       {(3217.0 / DEFAULT_SRATE), 0.0017, 1.110, 22937.0},
+       {(3557.0 / DEFAULT_SRATE), 0.0006, 3.973, 9830.0},
+       {(3907.0 / DEFAULT_SRATE), 0.0010, 2.341, 20643.0},
+       {(4127.0 / DEFAULT_SRATE), 0.0011, 1.897, 22937.0},
+       {(2143.0 / DEFAULT_SRATE), 0.0017, 0.891, 29491.0},
+       {(1933.0 / DEFAULT_SRATE), 0.0006, 3.221, 14417.0}};
+
+static const float kOutputGain = 0.35;
+static const float kJpScale    = 0.25;
+
+// Lines hold the junction input minus the filter state, which can run
+// past full scale at high feedback; int16 covers +/-4.
+static const float kToStorage   = 8192.0f;
+static const float kFromStorage = 1.0f / 8192.0f;
+
+static int DelayLineMaxSamples(float sr, int n)
+{
+    float max_del;
+
+    max_del = kReverbParams[n][0];
+    max_del += (kReverbParams[n][1] * 1.125);
+    return (int)(max_del * sr + 16.5);
+}
+
+static inline int16_t ToStorage(float x)
+{
+    x *= kToStorage;
+    x = x > 32767.0f ? 32767.0f : (x < -32768.0f ? -32768.0f : x);
+    return (int16_t)x;
+}
+
+size_t ReverbSc16::RequiredBytes(float sample_rate)
+{
+    size_t n_bytes = 0;
+    for(int i = 0; i < 8; i++)
+    {
+        // BufferAllocator rounds each allocation up to 4 bytes
+        size_t line_bytes = DelayLineMaxSamples(sample_rate, i) * sizeof(int16_t);
+        n_bytes += (line_bytes + 3) & ~3;
+    }
+    return n_bytes;
+}
+
+int ReverbSc16::Init(float sr, stmlib::BufferAllocator *allocator)
+{
+    sample_rate_ = sr;
+    feedback_    = 0.97;
+    lpfreq_      = 10000;
+    damp_fact_   = 1.0;
+    prv_lpfreq_  = 0.0;
+    init_done_   = 0;
+    for(int i = 0; i < 8; i++)
+    {
+        delay_lines_[i].buf = allocator->Allocate<int16_t>(
+            DelayLineMaxSamples(sr, i));
+        if(delay_lines_[i].buf == NULL)
+            return 1;
+        InitDelayLine(&delay_lines_[i], i);
+    }
+    init_done_ = 1;
+    return 0;
+}
+
+void ReverbSc16::Clear()
+{
+    for(int i = 0; i < 8; i++)
+    {
+        memset(delay_lines_[i].buf,
+               0,
+               delay_lines_[i].buffer_size * sizeof(int16_t));
+        delay_lines_[i].filter_state = 0.0f;
+    }
+}
+
+void ReverbSc16::NextRandomLineseg(ReverbSc16Dl *lp, int n)
+{
+    float prv_del, nxt_del, phs_inc_val;
+
+    /* update random seed */
+    if(lp->seed_val < 0)
+        lp->seed_val += 0x10000;
+    lp->seed_val = (lp->seed_val * 15625 + 1) & 0xFFFF;
+    if(lp->seed_val >= 0x8000)
+        lp->seed_val -= 0x10000;
+    /* length of next segment in samples; only checked between blocks */
+    lp->rand_line_cnt = (int)((sample_rate_ / kReverbParams[n][2]) + 0.5);
+    prv_del           = (float)lp->write_pos;
+    prv_del -= ((float)lp->read_pos
+                + ((float)lp->read_pos_frac / (float)DELAYPOS_SCALE));
+    while(prv_del < 0.0)
+        prv_del += lp->buffer_size;
+    prv_del = prv_del / sample_rate_; /* previous delay time in seconds */
+    nxt_del = (float)lp->seed_val * kReverbParams[n][1] / 32768.0;
+    /* next delay time in seconds */
+    nxt_del = kReverbParams[n][0] + nxt_del;
+    /* calculate phase increment per sample */
+    phs_inc_val           = (prv_del - nxt_del) / (float)lp->rand_line_cnt;
+    phs_inc_val           = phs_inc_val * sample_rate_ + 1.0;
+    lp->read_pos_frac_inc = (int)(phs_inc_val * DELAYPOS_SCALE + 0.5);
+}
+
+void ReverbSc16::InitDelayLine(ReverbSc16Dl *lp, int n)
+{
+    float read_pos;
+
+    /* calculate length of delay line */
+    lp->buffer_size = DelayLineMaxSamples(sample_rate_, n);
+    lp->write_pos   = 0;
+    /* set random seed */
+    lp->seed_val = (int)(kReverbParams[n][3] + 0.5);
+    /* set initial delay time */
+    read_pos     = (float)lp->seed_val * kReverbParams[n][1] / 32768;
+    read_pos     = kReverbParams[n][0] + read_pos;
+    read_pos     = (float)lp->buffer_size - (read_pos * sample_rate_);
+    lp->read_pos = (int)read_pos;
+    read_pos     = (read_pos - (float)lp->read_pos) * (float)DELAYPOS_SCALE;
+    lp->read_pos_frac = (int)(read_pos + 0.5);
+    /* initialise first random line segment */
+    NextRandomLineseg(lp, n);
+    /* clear delay line to zero */
+    lp->filter_state = 0.0;
+    memset(lp->buf, 0, lp->buffer_size * sizeof(int16_t));
+}
+
+void ReverbSc16::Process(const float *in1,
+                         const float *in2,
+                         float *      out1,
+                         float *      out2,
+                         size_t       size)
+{
+    if(init_done_ <= 0)
+        return;
+
+    while(size > 0)
+    {
+        size_t chunk = size < kMaxBlockSize ? size : kMaxBlockSize;
+        ProcessChunk(in1, in2, out1, out2, chunk);
+        in1 += chunk;
+        in2 += chunk;
+        out1 += chunk;
+        out2 += chunk;
+        size -= chunk;
+    }
+}
+
+void ReverbSc16::ProcessChunk(const float *in1,
+                              const float *in2,
+                              float *      out1,
+                              float *      out2,
+                              size_t       size)
+{
+    // filtered[n][t + 1] is line n's filter state after sample t;
+    // filtered[n][0] is the state carried in from the previous block.
+    float filtered[8][kMaxBlockSize + 1];
+    float jp[kMaxBlockSize];
+    float out_l[kMaxBlockSize];
+    float out_r[kMaxBlockSize];
+
+    /* calculate tone filter coefficient if frequency changed */
+    if(lpfreq_ != prv_lpfreq_)
+    {
+        prv_lpfreq_ = lpfreq_;
+        float damp_fact
+            = 2.0f - cosf(prv_lpfreq_ * (2.0f * (float)M_PI) / sample_rate_);
+        damp_fact_ = damp_fact - sqrtf(damp_fact * damp_fact - 1.0f);
+    }
+    const float damp_fact = damp_fact_;
+    const float feedback  = feedback_;
+
+    /* read and filter every line for the whole block; reads never reach
+       the samples written below because each line is longer than a block */
+
+    for(int n = 0; n < 8; n++)
+    {
+        ReverbSc16Dl *lp          = &delay_lines_[n];
+        const int     buffer_size = lp->buffer_size;
+        const int16_t *buf        = lp->buf;
+        int           read_pos    = lp->read_pos;
+        int           read_frac   = lp->read_pos_frac;
+        const int     frac_inc    = lp->read_pos_frac_inc;
+        float         state       = lp->filter_state;
+
+        filtered[n][0] = state;
+        for(size_t t = 0; t < size; t++)
+        {
+            if(read_frac >= DELAYPOS_SCALE)
+            {
+                read_pos += (read_frac >> DELAYPOS_SHIFT);
+                read_frac &= DELAYPOS_MASK;
+            }
+            if(read_pos >= buffer_size)
+                read_pos -= buffer_size;
+            float frac = (float)read_frac * (1.0f / (float)DELAYPOS_SCALE);
+
+            /* calculate interpolation coefficients */
+
+            float a2  = (frac * frac - 1.0f) * (1.0f / 6.0f);
+            float a1  = (frac + 1.0f) * 0.5f;
+            float am1 = a1 - 1.0f;
+            float a0  = 3.0f * a2;
+            a1 -= a0;
+            am1 -= a2;
+            a0 -= frac;
+
+            /* read four samples for interpolation */
+
+            float vm1, v0, v1, v2;
+            if(read_pos > 0 && read_pos < (buffer_size - 2))
+            {
+                vm1 = (float)buf[read_pos - 1];
+                v0  = (float)buf[read_pos];
+                v1  = (float)buf[read_pos + 1];
+                v2  = (float)buf[read_pos + 2];
+            }
+            else
+            {
+                /* at buffer wrap-around, need to check index */
+
+                int p = read_pos - 1;
+                if(p < 0)
+                    p += buffer_size;
+                vm1 = (float)buf[p];
+                if(++p >= buffer_size)
+                    p -= buffer_size;
+                v0 = (float)buf[p];
+                if(++p >= buffer_size)
+                    p -= buffer_size;
+                v1 = (float)buf[p];
+                if(++p >= buffer_size)
+                    p -= buffer_size;
+                v2 = (float)buf[p];
+            }
+            v0 = (am1 * vm1 + a0 * v0 + a1 * v1 + a2 * v2) * frac + v0;
+            read_frac += frac_inc;
+
+            /* apply feedback gain and lowpass filter */
+
+            v0 *= feedback * kFromStorage;
+            state = (state - v0) * damp_fact + v0;
+            filtered[n][t + 1] = state;
+        }
+        lp->read_pos      = read_pos;
+        lp->read_pos_frac = read_frac;
+        lp->filter_state  = state;
+    }
+
+    /* "resultant junction pressure" from the previous sample's states, and
+       the outputs from this sample's */
+
+    for(size_t t = 0; t < size; t++)
+    {
+        float sum = 0.0f, l = 0.0f, r = 0.0f;
+        for(int n = 0; n < 8; n += 2)
+        {
+            sum += filtered[n][t] + filtered[n + 1][t];
+            l += filtered[n][t + 1];
+            r += filtered[n + 1][t + 1];
+        }
+        jp[t]    = sum * kJpScale;
+        out_l[t] = l * kOutputGain;
+        out_r[t] = r * kOutputGain;
+    }
+
+    /* send input signal and feedback to the delay lines */
+
+    for(int n = 0; n < 8; n++)
+    {
+        ReverbSc16Dl *lp          = &delay_lines_[n];
+        const float * in          = n & 1 ? in2 : in1;
+        const int     buffer_size = lp->buffer_size;
+        int           write_pos   = lp->write_pos;
+        for(size_t t = 0; t < size; t++)
+        {
+            lp->buf[write_pos] = ToStorage(jp[t] + in[t] - filtered[n][t]);
+            if(++write_pos >= buffer_size)
+                write_pos -= buffer_size;
+        }
+        lp->write_pos = write_pos;
+
+        /* start next random line segment if the current one has ended */
+
+        lp->rand_line_cnt -= (int)size;
+        if(lp->rand_line_cnt <= 0)
+        {
+            NextRandomLineseg(lp, n);
+        }
+    }
+
+    memcpy(out1, out_l, size * sizeof(float));
+    memcpy(out2, out_r, size * sizeof(float));
+}
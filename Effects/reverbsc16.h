@@ -0,0 +1,102 @@
+#pragma once
+#ifndef DSYSP_REVERBSC16_H
+#define DSYSP_REVERBSC16_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace stmlib
+{
+class BufferAllocator;
+}
+
+namespace daisysp
+{
+/** Delay line for ReverbSc16: 16-bit storage, external memory
+*/
+typedef struct
+{
+    int      write_pos;         /**< write position */
+    int      buffer_size;       /**< buffer size */
+    int      read_pos;          /**< read position */
+    int      read_pos_frac;     /**< fractional component of read pos */
+    int      read_pos_frac_inc; /**< increment for fractional */
+    int      seed_val;          /**< randseed */
+    int      rand_line_cnt;     /**< samples left in the random segment */
+    float    filter_state;      /**< state of filter */
+    int16_t *buf;               /**< buffer ptr */
+} ReverbSc16Dl;
+
+/** Stereo Reverb, memory-light variant of ReverbSc
+
+Same network as ReverbSc (eight modulated lines with a shared junction),
+with these differences:
+- Delay memory comes from a caller-supplied allocator (meant for SDRAM)
+  and is stored as int16 with headroom, about 33 KB at 32 kHz instead of
+  the 387 KB float array ReverbSc embeds.
+- The random delay modulation and the damping coefficient are updated once
+  per block.
+- Whole blocks are processed one line at a time. This is exact as long as
+  every line is longer than a block, which holds for blocks up to
+  kMaxBlockSize at any sample rate above 8 kHz.
+
+The gain is memory, not speed: on the host bench (effects/reverb_sc*, 32-
+sample blocks, five runs) it takes 104-112 ns/sample against 107-148 for
+ReverbSc, within run-to-run noise of each other. It has not been timed on
+the Daisy.
+*/
+class ReverbSc16
+{
+  public:
+    ReverbSc16() {}
+    ~ReverbSc16() {}
+
+    static const size_t kMaxBlockSize = 32;
+
+    /** Bytes of delay memory Init will take at this sample rate. */
+    static size_t RequiredBytes(float sample_rate);
+
+    /** Initializes the reverb, taking its delay lines from allocator.
+        Returns 0 if all good, or 1 if the allocator ran out of memory.
+    */
+    int Init(float sample_rate, stmlib::BufferAllocator *allocator);
+
+    /** Process a block of stereo input. Outputs may alias the inputs.
+        Longer blocks are processed in kMaxBlockSize chunks.
+    */
+    void Process(const float *in1,
+                 const float *in2,
+                 float *      out1,
+                 float *      out2,
+                 size_t       size);
+
+    /** controls the reverb time. reverb tail becomes infinite when set to 1.0
+        \param fb - sets reverb time. range: 0.0 to 1.0
+    */
+    inline void SetFeedback(const float &fb) { feedback_ = fb; }
+    /** controls the internal dampening filter's cutoff frequency.
+        \param freq - low pass frequency. range: 0.0 to sample_rate / 2
+    */
+    inline void SetLpFreq(const float &freq) { lpfreq_ = freq; }
+
+    /** Zeroes the delay lines. */
+    void Clear();
+
+  private:
+    void  ProcessChunk(const float *in1,
+                       const float *in2,
+                       float *      out1,
+                       float *      out2,
+                       size_t       size);
+    void  NextRandomLineseg(ReverbSc16Dl *lp, int n);
+    void  InitDelayLine(ReverbSc16Dl *lp, int n);
+    float feedback_, lpfreq_;
+    float sample_rate_;
+    float damp_fact_;
+    float prv_lpfreq_;
+    int   init_done_;
+    ReverbSc16Dl delay_lines_[8];
+};
+
+} // namespace daisysp
+#endif
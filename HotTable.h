@@ -0,0 +1,66 @@
+#pragma once
+#ifndef HOT_TABLE_H
+#define HOT_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Lookup tables that LutResidency may copy out of QSPI flash. Code keeps
+// using them by name; the name is a pointer (set to the flash copy until
+// LutResidency::Init moves it) instead of the array itself. The waveshaper
+// tables are reached through plaits::lookup_table_i16_table, whose entries
+// are repointed instead.
+enum HotTableId {
+    HOT_LUT_SINE,               // plaits
+    HOT_LUT_FOLD,
+    HOT_LUT_FOLD_2,
+    HOT_LUT_SVF_SHIFT,
+    HOT_LUT_WS_INVERSE_TAN,     // Same order as LUT_WS_* in plaits/resources.h
+    HOT_LUT_WS_INVERSE_SIN,
+    HOT_LUT_WS_LINEAR,
+    HOT_LUT_WS_BUMP,
+    HOT_LUT_WS_DOUBLE_BUMP,
+    HOT_LUT_WINDOW,             // clouds
+    HOT_LUT_SINE_WINDOW_4096,
+    HOT_TABLE_LAST
+};
+
+inline uint32_t HotTableMask(HotTableId id) {
+    return 1u << id;
+}
+
+#ifdef LUT_PROFILE
+// Host profiling build: every lookup through a table name is counted. An
+// interpolated read (the name decays to a pointer) counts once.
+extern uint32_t hot_table_access_count[HOT_TABLE_LAST];
+
+template<typename T, HotTableId Id>
+class HotTable {
+public:
+    constexpr HotTable(const T* data) : data_(data) {}
+
+    T operator[](size_t i) const {
+        ++hot_table_access_count[Id];
+        return data_[i];
+    }
+    operator const T*() const {
+        ++hot_table_access_count[Id];
+        return data_;
+    }
+    HotTable& operator=(const T* data) {
+        data_ = data;
+        return *this;
+    }
+
+private:
+    const T* data_;
+};
+
+#define HOT_TABLE(type, id) HotTable<type, id>
+#define HOT_TABLE_COUNT(id, n) (hot_table_access_count[id] += (n))
+#else
+#define HOT_TABLE(type, id) const type*
+#define HOT_TABLE_COUNT(id, n) do { } while (0)
+#endif
+
+#endif // HOT_TABLE_H
@@ -0,0 +1,42 @@
+#include "IdleDetector.h"
+#include <cmath>
+
+IdleDetector idle_detector;
+
+void IdleDetector::Init(size_t hold_blocks, float silence_threshold, float knob_deadband) {
+    hold_blocks_ = hold_blocks;
+    silence_threshold_ = silence_threshold;
+    knob_deadband_ = knob_deadband;
+    for (int i = 0; i < kNumKnobs; ++i) {
+        knobs_[i] = 0.0f;
+    }
+    quiet_blocks_ = 0;
+    idle_ = false;
+}
+
+bool IdleDetector::Update(bool active, const volatile float* knobs) {
+    // Compared against the last significant value rather than the previous
+    // block, so that a slow turn still adds up to a move.
+    bool knob_moved = false;
+    for (int i = 0; i < kNumKnobs; ++i) {
+        float value = knobs[i];
+        if (fabsf(value - knobs_[i]) > knob_deadband_) {
+            knobs_[i] = value;
+            knob_moved = true;
+        }
+    }
+
+    if (active || knob_moved) {
+        quiet_blocks_ = 0;
+    }
+    idle_ = quiet_blocks_ >= hold_blocks_;
+    return idle_;
+}
+
+void IdleDetector::ObserveOutput(float peak) {
+    if (peak >= silence_threshold_) {
+        quiet_blocks_ = 0;
+    } else if (quiet_blocks_ < hold_blocks_) {
+        ++quiet_blocks_;
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+#ifndef IDLE_DETECTOR_H
+#define IDLE_DETECTOR_H
+
+#include <cstddef>
+#include <cstdint>
+
+// How long the output must stay silent before rendering stops - long enough
+// for release envelopes and the Clouds / reverb tails to ring out.
+#ifndef IDLE_HOLD_MS
+#define IDLE_HOLD_MS 500
+#endif
+
+// Decides when the whole synth is silent, so that the audio callback can skip
+// voice rendering and effects and the main loop can sleep.
+//
+// The synth goes idle once nothing can start a sound by itself (the caller
+// reports pads, voices, arpeggiator and audio sources as "active") and the
+// output has stayed below the silence threshold for hold_blocks blocks in a
+// row. Activity, or any knob moving past the deadband, wakes it up on the
+// block where it is seen.
+class IdleDetector {
+public:
+    void Init(size_t hold_blocks, float silence_threshold = 1.0e-4f, float knob_deadband = 0.01f);
+
+    // Audio callback, once the controls have been read. knobs points to the
+    // 12 raw ADC values. Returns true if this block can be skipped.
+    bool Update(bool active, const volatile float* knobs);
+    // Audio callback, after a rendered block: peak of its output.
+    void ObserveOutput(float peak);
+
+    bool idle() const { return idle_; }
+
+private:
+    static const int kNumKnobs = 12;
+
+    size_t hold_blocks_;
+    float silence_threshold_;
+    float knob_deadband_;
+
+    float knobs_[kNumKnobs];    // Values at the last significant move
+    size_t quiet_blocks_;
+    volatile bool idle_;
+};
+
+extern IdleDetector idle_detector;
+
+#endif // IDLE_DETECTOR_H
@@ -2,8 +2,11 @@
 #include "Arpeggiator.h"
 #include "Polyphony.h"
 #include "SynthStateStorage.h"
+#include "DelayEffect.h"
+#include "LutResidency.h"
 #include "plaits/resources.h"
 #include <algorithm>
+#include <cstdio>
 
 // --- Global hardware variables ---
 DaisySeed hw;
@@ -12,17 +15,12 @@ CpuLoadMeter cpu_meter;
 // Global definition for the touch sensor driver
 thaumazein_hal::Mpr121 touch_sensor;
 
-// Arpeggiator instance
-Arpeggiator arp;
 GPIO touch_leds[12];
 // Timestamp for each LED when an ARP note triggers (ms)
 volatile uint32_t arp_led_timestamps[12] = {0};
 // Duration in milliseconds for each LED blink on ARP trigger
 const uint32_t ARP_LED_DURATION_MS = 100;
 
-// ADDED: Global flag for arpeggiator state, managed by Interface.cpp
-volatile bool arp_enabled = false;
-
 // Add: flag indicating if the MPR121 touch sensor was successfully initialised
 bool touch_sensor_present = true;
 
@@ -41,20 +39,14 @@ AnalogControl mod_wheel;             // ADC 11 (Pin 28) Mod Wheel Control
 AnalogControl delay_mix_feedback_knob; // ADC 1 (Pin 16) Delay Mix & Feedback
 
 // CPU usage monitoring
-float sample_rate = 48000.0f; 
 volatile uint32_t avg_elapsed_us = 0; 
-volatile bool update_display = false; 
 // Output Level monitoring
 volatile float smoothed_output_level = 0.0f; 
 
-// Definition for adc_raw_values moved from AudioProcessor.cpp
-volatile float adc_raw_values[12] = {0.0f};
-
-// Global knob values, moved from AudioProcessor.cpp
-float pitch_val, harm_knob_val, timbre_knob_val, morph_knob_val;
-float env_attack_val, env_release_val;
-float delay_time_val;
-float delay_mix_feedback_val;
+// Arpeggiator notes blink their pad's LED
+static void OnArpNote(int pad_idx) {
+    arp_led_timestamps[11 - pad_idx] = hw.system.GetNow();
+}
 
 // Simple diagnostic blink: flashes the Daisy user LED 'count' times rapidly.
 static void DebugBlink(int count)
@@ -76,6 +68,8 @@ void InitializeHardware() {
     
     // Initialize Plaits resources that require SDRAM
     plaits::PlaitsResourcesInit_C();  // Correctly call namespaced C-linkage version
+    // Hot lookup tables out of QSPI, before any engine or Clouds Init
+    LutResidency::Init();
     // plaits::TestLinkerFunction_C(); // This was removed, keep it removed or commented
 
     // Set sample rate to 32 kHz for lower CPU load and memory use
@@ -144,7 +138,7 @@ void InitializeTouchSensor() {
 }
 
 void InitializeDelay() {
-    // Delay initialization removed
+    DelayEffect::Init(sample_rate);
 }
 
 // Initialize GPIO and light up all touch pad LEDs
@@ -161,12 +155,172 @@ void InitializeTouchLEDs() {
     };
 
     for(int i = 0; i < 12; ++i) {
+        if (!TouchLedAvailable(i)) continue; // Pin owned by SDMMC1
         led_cfg.pin = led_pins[i];
         touch_leds[i].Init(led_cfg);
         touch_leds[i].Write(true);
     }
 }
 
+#ifdef RECORD_PERFORMANCE
+static SdFileSink take_file;
+#ifdef RECORD_DRY
+static SdFileSink dry_take_file;
+#endif
+
+// Every boot records into the next free takeNNN.wav (and takeNNN-dry.wav).
+// There is no stop control: after a power cut the header is at most
+// AudioRecorder::kHeaderIntervalBlocks behind the data.
+void StartRecording() {
+    char name[24];
+    int take = 0;
+    for (; take < 1000; ++take) {
+        snprintf(name, sizeof(name), "take%03d.wav", take);
+        if (!SdStorage::Exists(name)) break;
+    }
+    if (take == 1000) {
+        hw.PrintLine("[WARN] SD: no free take name, not recording");
+        return;
+    }
+
+    recorder.Init(recorder_ring, kRecorderBlockBytes, 2, AudioRecorder::FORMAT_FLOAT32,
+                  static_cast<uint32_t>(sample_rate));
+    if (recorder.Start(&take_file, SdStorage::Path(name))) {
+        hw.PrintLine("SD: recording %s", name);
+    }
+#ifdef RECORD_DRY
+    snprintf(name, sizeof(name), "take%03d-dry.wav", take);
+    dry_recorder.Init(dry_recorder_ring, kDryRecorderBlockBytes, 2, AudioRecorder::FORMAT_PCM16,
+                      static_cast<uint32_t>(sample_rate));
+    dry_recorder.Start(&dry_take_file, SdStorage::Path(name));
+#endif
+}
+
+// Main loop. Card writes and their latency stay out of the audio callback;
+// drops are reported at most once a second.
+void ServiceRecording() {
+    recorder.Service();
+#ifdef RECORD_DRY
+    dry_recorder.Service();
+#endif
+
+    static uint32_t last_report = 0;
+    static uint32_t reported_drops = 0;
+    static bool reported_failure = false;
+    uint32_t now = hw.system.GetNow();
+    if (now - last_report < 1000) return;
+    last_report = now;
+    uint32_t drops = recorder.dropped_blocks();
+#ifdef RECORD_DRY
+    drops += dry_recorder.dropped_blocks();
+#endif
+    if (drops != reported_drops) {
+        reported_drops = drops;
+        hw.PrintLine("[WARN] Recorder dropped %lu blocks", static_cast<unsigned long>(drops));
+    }
+    if (recorder.failed() && !reported_failure) {
+        reported_failure = true;
+        hw.PrintLine("[WARN] Recording stopped: SD write failed");
+    }
+}
+#endif
+
+#ifdef USE_SD_CARD
+static SdFileSource wavetable_file;
+static SdFileSource sample_file;
+static SdFileSource snapshot_source;
+static SdFileSink snapshot_sink;
+CloudsSnapshot clouds_snapshot;
+
+// Optional user content on the card:
+//   wavetable.wav - 16-bit mono, up to 64 consecutive 256-sample cycles,
+//                   replacing the first wavetable bank
+//   sample.wav    - 16-bit mono/stereo, played from the pads by the sample
+//                   engine, resampled if it is not at the audio rate
+//   clouds0.snp, clouds1.snp - the last frozen Clouds buffer, restored
+//                   (frozen) shortly after boot
+// Must run before audio starts: the import writes the SDRAM wavetable bank.
+void InitializeSdCard() {
+    sample_voice.Init(sample_head, sample_stream_ring, sample_rate);
+    if (!SdStorage::Init()) {
+        hw.PrintLine("[WARN] No SD card – using built-in wavetables");
+        return;
+    }
+
+    if (wavetable_file.Open(SdStorage::Path("wavetable.wav"))) {
+        WavetableImporter importer;
+        int num_waves = importer.Import(wavetable_file, plaits::wav_integrated_waves, 0);
+        wavetable_file.Close();
+        hw.PrintLine("SD: imported %d waves", num_waves);
+    }
+
+    if (sample_file.Open(SdStorage::Path("sample.wav"))) {
+        if (sample_voice.Open(&sample_file)) {
+            sample_voice.SetLevel(0.5f);
+            hw.PrintLine("SD: sample.wav on the sample engine, %u Hz", static_cast<unsigned>(sample_voice.file_rate()));
+        } else {
+            sample_file.Close();
+            hw.PrintLine("[WARN] sample.wav is not 16-bit PCM – not played");
+        }
+    }
+
+#ifdef CLOUDS_SNAPSHOT_MU_LAW
+    const bool snapshot_mu_law = true;
+#else
+    const bool snapshot_mu_law = false;
+#endif
+    if (clouds_snapshot.Init(&clouds_processor, &snapshot_source, &snapshot_sink,
+                             SdStorage::Path(""), snapshot_mu_law, hw.system.GetNow())) {
+        hw.PrintLine("SD: restoring Clouds buffer");
+    }
+
+#ifdef RECORD_PERFORMANCE
+    StartRecording();
+#endif
+}
+#endif
+
+#ifdef FFT_BENCHMARK
+static float fft_bench_in[clouds::kMaxFftSize];
+static float fft_bench_out[clouds::kMaxFftSize];
+
+// Times a forward + inverse transform (one STFT hop) for each Clouds FFT
+// backend and prints the cycles and the CPU share at 4x overlap.
+void BenchmarkFftBackends() {
+    static clouds::ShyFftBackend shy;
+    static clouds::RealFft radix4;
+#ifdef CLOUDS_FFT_CMSIS
+    static clouds::ArmFftBackend cmsis;
+    clouds::FftBackend* backends[] = { &shy, &radix4, &cmsis };
+#else
+    clouds::FftBackend* backends[] = { &shy, &radix4 };
+#endif
+    const size_t kIterations = 16;
+
+    for (size_t size = 1024; size <= clouds::kMaxFftSize; size *= 2) {
+        for (clouds::FftBackend* fft : backends) {
+            fft->Init(size);
+            uint32_t cycles = 0;
+            for (size_t n = 0; n < kIterations; ++n) {
+                for (size_t i = 0; i < size; ++i) {
+                    fft_bench_in[i] = static_cast<float>(i & 31) / 32.0f - 0.5f;
+                }
+                uint32_t start = ReadCycleCounter();
+                fft->Direct(fft_bench_in, fft_bench_out);
+                fft->Inverse(fft_bench_out, fft_bench_in);
+                cycles += ReadCycleCounter() - start;
+            }
+            cycles /= kIterations;
+            float hops_per_second = sample_rate / (size / 4);
+            int load = static_cast<int>(cycles * hops_per_second / SystemCoreClock * 1000.0f);
+            hw.PrintLine("FFT %-6s %4d: %7lu cycles, %d.%d%% CPU",
+                         fft->name(), static_cast<int>(size),
+                         static_cast<unsigned long>(cycles), load / 10, load % 10);
+        }
+    }
+}
+#endif
+
 void InitializeSynth() {
     InitializeHardware();
     DebugBlink(1);
@@ -175,48 +329,70 @@ void InitializeSynth() {
     DebugBlink(2);
 
     InitializeControls();
+    controls.Init(1.0f / 1024.0f); // Knob deadband, about 10-bit resolution
     DebugBlink(3);
 
     InitializeTouchSensor();
     DebugBlink(4);
 
-    // InitializeDelay(); // Delay effect removed
-    // DebugBlink(5);
+    InitializeDelay();
+    DebugBlink(5);
 
     InitializeTouchLEDs();
     DebugBlink(6);
 
     cpu_meter.Init(sample_rate, BLOCK_SIZE); // Initialize CPU Load Meter
+    EnableCycleCounter(); // Per-stage timing for telemetry
+    telemetry.Init(TELEMETRY_FRAME_BLOCKS, TELEMETRY_DRAIN_MS);
+    deadline_monitor.Init(sample_rate, BLOCK_SIZE);
+    control_journal.Init(control_journal_events, kControlJournalSize);
+    idle_detector.Init(static_cast<size_t>(sample_rate * IDLE_HOLD_MS / 1000.0f) / BLOCK_SIZE);
     DebugBlink(7);
 
     // --- Initialize Arpeggiator ---
-    arp.Init(sample_rate);
+    InitArpeggiator(OnArpNote);
     DebugBlink(8);
 
-    // Note trigger callback
-    arp.SetNoteTriggerCallback([&](int pad_idx){ 
-        poly_engine.TriggerArpVoice(pad_idx, current_engine_index); 
-        arp_led_timestamps[11 - pad_idx] = hw.system.GetNow();
-    });
-    arp.SetDirection(Arpeggiator::AsPlayed);
-
     // Clouds Integration: Initialize Clouds processor
     clouds_processor.Init(cloud_buffer, sizeof(cloud_buffer),
                           cloud_buffer_ccm, sizeof(cloud_buffer_ccm));
+    clouds_processor.set_grain_staging_buffer(clouds_grain_staging,
+                                              kCloudsGrainStagingSize);
     clouds_processor.mutable_parameters()->dry_wet = 0.0f;
     clouds_processor.mutable_parameters()->freeze = false;
+    // Always in Granular mode
+    clouds_processor.set_playback_mode(clouds::PLAYBACK_MODE_GRANULAR);
     // End Clouds Integration
 
+#ifdef POST_REVERB
+    static stmlib::BufferAllocator post_reverb_allocator(post_reverb_buffer, sizeof(post_reverb_buffer));
+    if (post_reverb.Init(sample_rate, &post_reverb_allocator) != 0) {
+        hw.PrintLine("[WARN] Post reverb needs %u bytes", static_cast<unsigned>(ReverbSc16::RequiredBytes(sample_rate)));
+    }
+    post_reverb.SetLpFreq(9000.0f);
+#endif
+
+    // Vocoder insert starts bypassed (vocoder_source); arp pad + model pad selects a source
+    vocoder_insert.Init(sample_rate);
+
+#ifdef USE_SD_CARD
+    InitializeSdCard();
+#endif
+
     hw.StartLog(false); // Start log immediately (non-blocking)
     DebugBlink(9);
 
+#ifdef FFT_BENCHMARK
+    BenchmarkFftBackends();
+#endif
+
     hw.StartAudio(AudioCallback);
     DebugBlink(10);
     
     hw.PrintLine("Plaits Synth Started - Ready for Bootloader CMD");
     char settings[64];
     // Print Max Voices (compile time)
-    sprintf(settings, "Max Voices: %d | Block: %d | SR: %d", NUM_VOICES, BLOCK_SIZE, (int)sample_rate);
+    sprintf(settings, "Max Voices: %d | Block: %d | SR: %d", MAX_VOICES, BLOCK_SIZE, (int)sample_rate);
     hw.PrintLine(settings);
     sprintf(settings, "Engine Range: 0-%d", MAX_ENGINE_INDEX);
     hw.PrintLine(settings);
@@ -273,39 +449,40 @@ void UpdateLED() {
     hw.SetLed(led_on);
 }
 
+// The arp pad doubles as a shift key: while it is held, the model pads step
+// the vocoder insert's source instead of the engine.
+static bool arp_pad_held = false;       // debounced pad pressed state
+static bool arp_pad_shifted = false;    // a model pad was used during the hold
+static bool arp_before_press = false;   // to undo the toggle of a shift hold
+
+// Off -> audio in -> voice 0 -> off. The audio callback picks it up at the
+// next block (vocoder_source is a journaled control input).
+static void StepVocoderSource(int step) {
+    const int kNumSources = VocoderInsert::SOURCE_VOICE_0 + 1;
+    vocoder_source = static_cast<uint8_t>((vocoder_source + step + kNumSources) % kNumSources);
+}
+
 // NEW Function for Arpeggiator Toggle Pad
 void UpdateArpeggiatorToggle() {
     constexpr float kOnThreshold  = 0.30f;   // more sensitive press detection
     constexpr float kOffThreshold = 0.20f;   // lower release threshold for fast reset
-    static bool pad_pressed = false;          // debounced pad pressed state
 
     float pad_read = arp_pad.Value();
 
     // Detect state transitions with hysteresis
-    if(!pad_pressed && pad_read > kOnThreshold)
+    if(!arp_pad_held && pad_read > kOnThreshold)
     {
-        pad_pressed = true;
-        // Rising edge detected -> toggle arp
-        arp_enabled = !arp_enabled;
-        if(arp_enabled)
-        {
-            arp.Init(sample_rate);          // restart timing
-            arp.SetNoteTriggerCallback([&](int pad_idx){ 
-                poly_engine.TriggerArpVoice(pad_idx, current_engine_index); 
-                arp_led_timestamps[11 - pad_idx] = hw.system.GetNow();
-            });
-            arp.SetDirection(Arpeggiator::AsPlayed); // Set default direction to AsPlayed
-        }
-        else
-        {
-            // Clearing held notes ensures LEDs revert to touch-indication mode
-            arp.ClearNotes();
-        }
+        arp_pad_held = true;
+        arp_pad_shifted = false;
+        // Rising edge detected -> toggle arp. Used as shift, the pad undoes
+        // this again (UpdateEngineSelection).
+        arp_before_press = arp_enabled;
+        SetArpEnabled(!arp_enabled, OnArpNote);
     }
-    else if(pad_pressed && pad_read < kOffThreshold)
+    else if(arp_pad_held && pad_read < kOffThreshold)
     {
         // Consider pad released only when it falls well below off threshold
-        pad_pressed = false;
+        arp_pad_held = false;
     }
 }
 
@@ -313,12 +490,14 @@ void UpdateArpeggiatorToggle() {
 void UpdateEngineSelection() {
     // --- Model selection logic via touch pads ---
     const float threshold = 0.5f;
-    const int kNumEngines = MAX_ENGINE_INDEX + 1; // inclusive range 0..MAX_ENGINE_INDEX
+    // 0..MAX_ENGINE_INDEX, and the sample engine once a sample is loaded
+    const int kNumEngines = MAX_ENGINE_INDEX + 1 + (sample_voice.loaded() ? 1 : 0);
     const int kDebounceCount = 10; // blocks for debounce (~3ms)
     static int model_prev_counter = 0;
     static int model_next_counter = 0;
     static bool debounced_prev = false;
     static bool debounced_next = false;
+    static int engine_before_press = 0;
 
     // Raw readings
     bool raw_prev = model_prev_pad.Value() > threshold;
@@ -336,12 +515,36 @@ void UpdateEngineSelection() {
     bool new_debounced_prev = model_prev_counter > (kDebounceCount / 2);
     bool new_debounced_next = model_next_counter > (kDebounceCount / 2);
 
+    // With the arp pad held, the model pads step the vocoder source and the
+    // first of them undoes the arp pad's toggle.
+    bool rose_prev = new_debounced_prev && !debounced_prev;
+    bool rose_next = new_debounced_next && !debounced_next;
+    if (arp_pad_held && (rose_prev || rose_next)) {
+        if (!arp_pad_shifted) {
+            SetArpEnabled(arp_before_press, OnArpNote);
+            arp_pad_shifted = true;
+        }
+        StepVocoderSource(rose_prev ? 1 : -1);
+        rose_prev = rose_next = false;
+    }
+    // Pressing the second model pad while the first is held steps the
+    // split/layer layout and undoes the first pad's engine step.
+    if ((rose_prev && debounced_next) || (rose_next && debounced_prev)) {
+        current_engine_index = engine_before_press;
+        engine_changed_flag = true;
+        layout_change_flag = true;
+        rose_prev = rose_next = false;
+    }
+    if (rose_prev || rose_next) {
+        engine_before_press = current_engine_index;
+    }
+
     // On rising edge, update engine index
-    if (new_debounced_prev && !debounced_prev) {
+    if (rose_prev) {
         current_engine_index = (current_engine_index + 1) % kNumEngines;
         engine_changed_flag = true;
     }
-    if (new_debounced_next && !debounced_next) {
+    if (rose_next) {
         current_engine_index = (current_engine_index - 1 + kNumEngines) % kNumEngines;
         engine_changed_flag = true;
     }
@@ -381,45 +584,24 @@ void ProcessControls() {
 
 // Moved from AudioProcessor.cpp
 void ReadKnobValues() {
-    delay_time_val = delay_time_knob.Value();           // ADC 0
-    delay_mix_feedback_val = delay_mix_feedback_knob.Value(); // ADC 1
-    env_release_val = env_release_knob.Value();       // ADC 2
-    env_attack_val = env_attack_knob.Value();        // ADC 3
-    timbre_knob_val = timbre_knob.Value();            // ADC 4
-    harm_knob_val = harmonics_knob.Value();         // ADC 5
-    morph_knob_val = morph_knob.Value();             // ADC 6
-    pitch_val = pitch_knob.Value();                 // ADC 7
-
-    // Derive separate mix and feedback values from the combined knob
-    // Simple approach: use the same value for both
-    // delay_mix_val = delay_mix_feedback_val;
-    // delay_feedback_val = delay_mix_feedback_val;
-
-    // Restore touch-pad pressure modulation (was previously in audio ISR)
-    const float intensity = 0.5f;
-    morph_knob_val      = morph_knob_val * (1.0f - intensity) + touch_cv_value * intensity;
-    // delay_feedback_val  = delay_feedback_val * (1.0f - intensity) + touch_cv_value * intensity;
-
-    // Clouds Integration: Update Clouds parameters from knobs
-    clouds::Parameters* p = clouds_processor.mutable_parameters();
-    if (p) { // Check if p is not null, though mutable_parameters() should always return a valid pointer
-        p->pitch         = pitch_val;
-        p->texture       = morph_knob_val; // morph_knob_val is already affected by touch_cv_value above
-        p->density       = harm_knob_val;
-        p->position      = timbre_knob_val; // control position with knob again
-        p->size          = delay_time_val; // Repurposed delay time knob
-        
-        // ADC 1 (delay_mix_feedback_knob) controls dry_wet and feedback
-        p->dry_wet       = delay_mix_feedback_val;
-        p->feedback      = 0.0f;
-        p->reverb        = delay_mix_feedback_val; // same as dry_wet knob
-        p->stereo_spread = env_attack_val;
-        // Freeze when mod wheel exceeds threshold
-        p->freeze        = (mod_wheel.Value() > 0.3f);
-        // p->freeze is not yet mapped
+    controls.Set(CONTROL_DELAY_TIME, delay_time_knob.Value());        // ADC 0
+    controls.Set(CONTROL_MIX, delay_mix_feedback_knob.Value());       // ADC 1
+    controls.Set(CONTROL_RELEASE, env_release_knob.Value());          // ADC 2
+    controls.Set(CONTROL_ATTACK, env_attack_knob.Value());            // ADC 3
+    controls.Set(CONTROL_TIMBRE, timbre_knob.Value());                // ADC 4
+    controls.Set(CONTROL_HARMONICS, harmonics_knob.Value());          // ADC 5
+    controls.Set(CONTROL_MORPH, morph_knob.Value());                  // ADC 6
+    controls.Set(CONTROL_PITCH, pitch_knob.Value());                  // ADC 7
+    controls.Set(CONTROL_MOD_WHEEL, mod_wheel.Value());               // ADC 11
+    controls.Set(CONTROL_TOUCH, touch_cv_value);
+
+    // Derived values and Clouds parameters (ControlPath.cpp)
+    if (!ApplyKnobValues()) {
+        return;
     }
-    // End Clouds Integration
-
-    // Always force Clouds into Granular mode
-    clouds_processor.set_playback_mode(clouds::PLAYBACK_MODE_GRANULAR);
+#ifdef POST_REVERB
+    // The reverb after Clouds takes the mix knob instead of the Clouds reverb
+    post_reverb_mix = delay_mix_feedback_val * 0.6f;
+    post_reverb.SetFeedback(0.6f + 0.3f * delay_mix_feedback_val);
+#endif
 } 
\ No newline at end of file
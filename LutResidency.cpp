@@ -0,0 +1,122 @@
+#include "LutResidency.h"
+#include "plaits/resources.h"
+#include "clouds/resources.h"
+#include <cstring>
+
+#ifdef LUT_PROFILE
+// No DTCM on the host; resources.h has pulled in daisy_core.h's definition
+#undef DTCM_MEM_SECTION
+#define DTCM_MEM_SECTION
+uint32_t hot_table_access_count[HOT_TABLE_LAST];
+#else
+#include "daisy_core.h"
+#endif
+
+// Arena sizes; the defaults fit the default masks with some room to spare.
+#ifndef HOT_LUT_DTCM_BYTES
+#define HOT_LUT_DTCM_BYTES 9216
+#endif
+#ifndef HOT_LUT_SRAM_BYTES
+#define HOT_LUT_SRAM_BYTES 24576
+#endif
+
+// The table names start out on the flash arrays
+namespace plaits {
+HOT_TABLE(float, HOT_LUT_SINE) lut_sine = lut_sine_flash;
+HOT_TABLE(float, HOT_LUT_FOLD) lut_fold = lut_fold_flash;
+HOT_TABLE(float, HOT_LUT_FOLD_2) lut_fold_2 = lut_fold_2_flash;
+HOT_TABLE(float, HOT_LUT_SVF_SHIFT) lut_svf_shift = lut_svf_shift_flash;
+} // namespace plaits
+
+namespace clouds {
+HOT_TABLE(float, HOT_LUT_WINDOW) lut_window = lut_window_flash;
+HOT_TABLE(float, HOT_LUT_SINE_WINDOW_4096) lut_sine_window_4096 = lut_sine_window_4096_flash;
+} // namespace clouds
+
+namespace LutResidency {
+
+// uint32_t keeps every copy 4-byte aligned for the float tables
+DTCM_MEM_SECTION static uint32_t dtcm_arena[HOT_LUT_DTCM_BYTES / 4];
+static uint32_t sram_arena[HOT_LUT_SRAM_BYTES / 4]; // .bss, AXI SRAM
+
+struct TableInfo {
+    const char* name;
+    const void* flash;
+    size_t bytes;
+};
+
+static const TableInfo kTables[HOT_TABLE_LAST] = {
+    { "plaits lut_sine", plaits::lut_sine_flash, LUT_SINE_SIZE * sizeof(float) },
+    { "plaits lut_fold", plaits::lut_fold_flash, LUT_FOLD_SIZE * sizeof(float) },
+    { "plaits lut_fold_2", plaits::lut_fold_2_flash, LUT_FOLD_2_SIZE * sizeof(float) },
+    { "plaits lut_svf_shift", plaits::lut_svf_shift_flash, LUT_SVF_SHIFT_SIZE * sizeof(float) },
+    { "plaits lut_ws_inverse_tan", plaits::lut_ws_inverse_tan, LUT_WS_INVERSE_TAN_SIZE * sizeof(int16_t) },
+    { "plaits lut_ws_inverse_sin", plaits::lut_ws_inverse_sin, LUT_WS_INVERSE_SIN_SIZE * sizeof(int16_t) },
+    { "plaits lut_ws_linear", plaits::lut_ws_linear, LUT_WS_LINEAR_SIZE * sizeof(int16_t) },
+    { "plaits lut_ws_bump", plaits::lut_ws_bump, LUT_WS_BUMP_SIZE * sizeof(int16_t) },
+    { "plaits lut_ws_double_bump", plaits::lut_ws_double_bump, LUT_WS_DOUBLE_BUMP_SIZE * sizeof(int16_t) },
+    { "clouds lut_window", clouds::lut_window_flash, LUT_WINDOW_SIZE * sizeof(float) },
+    { "clouds lut_sine_window_4096", clouds::lut_sine_window_4096_flash, LUT_SINE_WINDOW_4096_SIZE * sizeof(float) },
+};
+
+static Location locations[HOT_TABLE_LAST];
+static size_t dtcm_used_bytes = 0;
+static size_t sram_used_bytes = 0;
+
+static void Redirect(HotTableId id, const void* data) {
+    const float* f = static_cast<const float*>(data);
+    const int16_t* i16 = static_cast<const int16_t*>(data);
+    switch (id) {
+        case HOT_LUT_SINE: plaits::lut_sine = f; break;
+        case HOT_LUT_FOLD: plaits::lut_fold = f; break;
+        case HOT_LUT_FOLD_2: plaits::lut_fold_2 = f; break;
+        case HOT_LUT_SVF_SHIFT: plaits::lut_svf_shift = f; break;
+        case HOT_LUT_WINDOW: clouds::lut_window = f; break;
+        case HOT_LUT_SINE_WINDOW_4096: clouds::lut_sine_window_4096 = f; break;
+        case HOT_LUT_WS_DOUBLE_BUMP:
+            // The table list repeats the last shape as an interpolation sentinel
+            plaits::lookup_table_i16_table[LUT_WS_DOUBLE_BUMP] = i16;
+            plaits::lookup_table_i16_table[LUT_WS_DOUBLE_BUMP_SENTINEL] = i16;
+            break;
+        default:
+            plaits::lookup_table_i16_table[LUT_WS_INVERSE_TAN + (id - HOT_LUT_WS_INVERSE_TAN)] = i16;
+            break;
+    }
+}
+
+// Copies the masked tables into arena, in id order. Returns bytes used.
+static size_t Place(uint32_t mask, uint32_t* arena, size_t arena_bytes, Location location) {
+    size_t used = 0;
+    for (int i = 0; i < HOT_TABLE_LAST; ++i) {
+        HotTableId id = static_cast<HotTableId>(i);
+        if (!(mask & HotTableMask(id)) || locations[id] != LOCATION_FLASH) {
+            continue;
+        }
+        size_t bytes = (kTables[id].bytes + 3) & ~static_cast<size_t>(3);
+        if (used + bytes > arena_bytes) {
+            continue;
+        }
+        void* copy = reinterpret_cast<uint8_t*>(arena) + used;
+        memcpy(copy, kTables[id].flash, kTables[id].bytes);
+        Redirect(id, copy);
+        locations[id] = location;
+        used += bytes;
+    }
+    return used;
+}
+
+void Init(uint32_t dtcm_mask, uint32_t sram_mask) {
+    for (int i = 0; i < HOT_TABLE_LAST; ++i) {
+        locations[i] = LOCATION_FLASH;
+    }
+    dtcm_used_bytes = Place(dtcm_mask, dtcm_arena, sizeof(dtcm_arena), LOCATION_DTCM);
+    sram_used_bytes = Place(sram_mask, sram_arena, sizeof(sram_arena), LOCATION_SRAM);
+}
+
+const char* name(HotTableId id) { return kTables[id].name; }
+size_t bytes(HotTableId id) { return kTables[id].bytes; }
+Location location(HotTableId id) { return locations[id]; }
+size_t dtcm_used() { return dtcm_used_bytes; }
+size_t sram_used() { return sram_used_bytes; }
+
+} // namespace LutResidency
@@ -0,0 +1,53 @@
+#pragma once
+#ifndef LUT_RESIDENCY_H
+#define LUT_RESIDENCY_H
+
+#include <cstddef>
+#include <cstdint>
+#include "HotTable.h"
+
+// Which hot tables are copied out of QSPI flash at boot, as HotTableMask()
+// bits. The defaults are what tools/lut_profile picks over the bench
+// scenarios, filling each arena by lookups per byte: the Plaits sine (635
+// lookups/byte), the waveshaper tables (31-93) and the SVF shift table (7)
+// fit in DTCM; the wave folds (39) and the Clouds grain window (4.7) go to AXI
+// SRAM. The spectral-mode window stays in flash since the granular build never
+// reads it. Re-run the profile after engine changes.
+#ifndef HOT_LUT_DTCM_MASK
+#define HOT_LUT_DTCM_MASK ((1u << HOT_LUT_SINE) | (1u << HOT_LUT_SVF_SHIFT) \
+    | (1u << HOT_LUT_WS_INVERSE_TAN) | (1u << HOT_LUT_WS_INVERSE_SIN) \
+    | (1u << HOT_LUT_WS_LINEAR) | (1u << HOT_LUT_WS_BUMP) \
+    | (1u << HOT_LUT_WS_DOUBLE_BUMP))
+#endif
+
+#ifndef HOT_LUT_SRAM_MASK
+#define HOT_LUT_SRAM_MASK ((1u << HOT_LUT_FOLD) | (1u << HOT_LUT_FOLD_2) \
+    | (1u << HOT_LUT_WINDOW))
+#endif
+
+namespace LutResidency {
+
+    enum Location {
+        LOCATION_FLASH,
+        LOCATION_DTCM,
+        LOCATION_SRAM,
+    };
+
+    /**
+     * @brief Copies the selected tables into RAM and points their names at
+     * the copies. Call once at boot, before any engine or Clouds Init (the
+     * phase vocoder keeps the window pointer it is given).
+     *
+     * A table that does not fit its arena stays in flash.
+     */
+    void Init(uint32_t dtcm_mask = HOT_LUT_DTCM_MASK, uint32_t sram_mask = HOT_LUT_SRAM_MASK);
+
+    const char* name(HotTableId id);
+    size_t bytes(HotTableId id);
+    Location location(HotTableId id);
+    size_t dtcm_used();
+    size_t sram_used();
+
+} // namespace LutResidency
+
+#endif // LUT_RESIDENCY_H
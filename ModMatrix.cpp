@@ -0,0 +1,160 @@
+#include "ModMatrix.h"
+#include <algorithm>
+#include <cstring>
+#include "tides2/poly_slope_generator.h"
+#include "stmlib/utils/gate_flags.h"
+
+// Kept out of the header: tides2/resources.h defines LUT_* macros that clash
+// with the warps ones pulled in through Thaumazein.h.
+static tides2::PolySlopeGenerator lfo_generator;
+
+// tides2 looping ramps come out as +/-5 (volts); bring them back to +/-1.
+static const float kLfoScale = 0.2f;
+
+// plaits::Voice reshapes modulation amounts (a * max(|a| - 0.05, 0.05) * 1.05);
+// this one comes out as 1, so destinations reach the engine as computed.
+static const float kUnityModulationAmount = 1.00122024f;
+
+static_assert(ModMatrix::kNumLfoChannels == tides2::PolySlopeGenerator::num_channels,
+              "LFO channels match the tides2 generator");
+static_assert(ModMatrix::kMaxVoices % ModMatrix::kNumLfoChannels == 0,
+              "Voice slots cover whole sets of LFO channels");
+
+void ModMatrix::Init(float sample_rate, size_t block_size) {
+    sample_rate_ = sample_rate;
+    block_size_ = static_cast<float>(block_size);
+    lfo_frequency_ = 0.3f;
+    lfo_shape_ = 0.5f;
+    lfo_spread_ = 1.0f;
+
+    lfo_generator.Init();
+
+    memset(sources_, 0, sizeof(sources_));
+    memset(destinations_, 0, sizeof(destinations_));
+    for (int d = 0; d < DEST_LAST; ++d) {
+        knob_scale_[d] = 1.0f;
+    }
+    ClearRoutes();
+}
+
+void ModMatrix::ClearRoutes() {
+    num_routes_ = 0;
+    lfo_routed_ = false;
+    for (int d = 0; d < DEST_LAST; ++d) {
+        destination_routed_[d] = false;
+    }
+}
+
+int ModMatrix::AddRoute(Source source, Destination destination, float amount) {
+    if (num_routes_ >= kMaxRoutes) return -1;
+    routes_[num_routes_].source = source;
+    routes_[num_routes_].destination = destination;
+    routes_[num_routes_].amount = amount;
+    routes_[num_routes_].blend = false;
+    destination_routed_[destination] = true;
+    lfo_routed_ |= (source == SOURCE_LFO);
+    return num_routes_++;
+}
+
+int ModMatrix::AddBlendRoute(Source source, Destination destination, float amount) {
+    int slot = AddRoute(source, destination, amount);
+    if (slot >= 0) {
+        routes_[slot].blend = true;
+    }
+    return slot;
+}
+
+void ModMatrix::SetRouteAmount(int slot, float amount) {
+    if (slot < 0 || slot >= num_routes_) return;
+    routes_[slot].amount = amount;
+}
+
+void ModMatrix::SetLfoRate(float hz) {
+    lfo_frequency_ = std::max(hz, 0.0f);
+}
+
+void ModMatrix::SetLfoShape(float shape) {
+    lfo_shape_ = std::min(std::max(shape, 0.0f), 1.0f);
+}
+
+void ModMatrix::SetLfoSpread(float spread) {
+    lfo_spread_ = std::min(std::max(spread, 0.0f), 1.0f);
+}
+
+void ModMatrix::RenderLfo() {
+    // The generator is stepped once per audio block, so its normalised
+    // frequency is expressed against the block rate rather than the sample rate.
+    const float frequency = lfo_frequency_ * block_size_ / sample_rate_;
+    stmlib::GateFlags gate = stmlib::GATE_FLAG_LOW;
+    tides2::PolySlopeGenerator::OutputSample out;
+    lfo_generator.Render(
+        tides2::RAMP_MODE_LOOPING,
+        tides2::OUTPUT_MODE_SLOPE_PHASE,
+        tides2::RANGE_CONTROL,
+        frequency,
+        0.5f,          // pw: symmetric slopes
+        lfo_shape_,
+        0.5f,          // smoothness: neutral, no fold or filter
+        lfo_spread_,   // shift: phase spread between the four channels
+        &gate,
+        nullptr,
+        &out,
+        1);
+    for (int v = 0; v < kMaxVoices; ++v) {
+        float sign = (v / kNumLfoChannels) & 1 ? -kLfoScale : kLfoScale;
+        sources_[SOURCE_LFO][v] = out.channel[v % kNumLfoChannels] * sign;
+    }
+}
+
+void ModMatrix::Process(const float* envelopes, float touch, float wheel, int num_voices) {
+    num_voices = std::min(num_voices, static_cast<int>(kMaxVoices));
+
+    if (lfo_routed_) {
+        RenderLfo();
+    }
+    for (int v = 0; v < num_voices; ++v) {
+        sources_[SOURCE_TOUCH][v] = touch;
+        sources_[SOURCE_MOD_WHEEL][v] = wheel;
+        sources_[SOURCE_ENVELOPE][v] = envelopes[v];
+    }
+
+    memset(destinations_, 0, sizeof(destinations_));
+    for (int d = 0; d < DEST_LAST; ++d) {
+        knob_scale_[d] = 1.0f;
+    }
+    for (int r = 0; r < num_routes_; ++r) {
+        const float* src = sources_[routes_[r].source];
+        float* dst = destinations_[routes_[r].destination];
+        const float amount = routes_[r].amount;
+        for (int v = 0; v < num_voices; ++v) {
+            dst[v] += src[v] * amount;
+        }
+        if (routes_[r].blend) {
+            knob_scale_[routes_[r].destination] -= amount;
+        }
+    }
+}
+
+// What plaits::Voice adds to the knob value. Blend routes take their share of
+// the knob value back out.
+float ModMatrix::Offset(Destination destination, int voice, float knob) const {
+    return destinations_[destination][voice] - (1.0f - knob_scale_[destination]) * knob;
+}
+
+void ModMatrix::Apply(int voice, plaits::Patch& patch, plaits::Modulations& mod) const {
+    // Harmonics modulation is always summed in by plaits::Voice; the other
+    // three only take effect when patched, scaled by the patch's amount.
+    mod.harmonics = Offset(DEST_HARMONICS, voice, patch.harmonics);
+
+    mod.timbre = Offset(DEST_TIMBRE, voice, patch.timbre);
+    mod.timbre_patched = destination_routed_[DEST_TIMBRE];
+    patch.timbre_modulation_amount = mod.timbre_patched ? kUnityModulationAmount : 0.0f;
+
+    mod.morph = Offset(DEST_MORPH, voice, patch.morph);
+    mod.morph_patched = destination_routed_[DEST_MORPH];
+    patch.morph_modulation_amount = mod.morph_patched ? kUnityModulationAmount : 0.0f;
+
+    mod.frequency = Offset(DEST_FREQUENCY, voice, patch.note);
+    mod.frequency_patched = destination_routed_[DEST_FREQUENCY];
+    patch.frequency_modulation_amount = mod.frequency_patched ? kUnityModulationAmount : 0.0f;
+}
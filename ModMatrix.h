@@ -0,0 +1,95 @@
+#pragma once
+#ifndef MOD_MATRIX_H
+#define MOD_MATRIX_H
+
+#include <cstddef>
+#include "plaits/dsp/voice.h"
+
+// Block-rate modulation matrix.
+// Sources and destinations are stored as [slot][voice] rows (structure of
+// arrays), so every route is one short contiguous loop over the voices and the
+// whole matrix runs once per audio block instead of once per sample. Plaits
+// oscillators already ramp timbre/morph/harmonics/frequency across a render
+// block, so the block-rate output still moves smoothly.
+//
+// A route either adds to the knob value (AddRoute) or crossfades the knob
+// value toward its source (AddBlendRoute): at amount 0.5 touch on morph gives
+// morph * 0.5 + touch * 0.5, the blend the firmware used before the matrix.
+class ModMatrix {
+public:
+    enum Source {
+        SOURCE_LFO,       // Tides2 poly-slope LFO, one phase-spread channel per voice
+        SOURCE_TOUCH,     // Touch pad pressure (global)
+        SOURCE_MOD_WHEEL, // Mod wheel (global)
+        SOURCE_ENVELOPE,  // Per-voice VoiceEnvelope output
+        SOURCE_LAST
+    };
+
+    enum Destination {
+        DEST_TIMBRE,
+        DEST_MORPH,
+        DEST_HARMONICS,
+        DEST_FREQUENCY,   // In semitones per unit of source
+        DEST_LAST
+    };
+
+    struct Route {
+        Source source;
+        Destination destination;
+        float amount;
+        bool blend;         // Crossfade from the knob value instead of adding
+    };
+
+    static const int kMaxRoutes = 8;
+    // The tides2 generator has four LFO channels; voice slots beyond them
+    // reuse a channel, inverted.
+    static const int kMaxVoices = 8;
+    static const int kNumLfoChannels = 4;
+
+    void Init(float sample_rate, size_t block_size);
+
+    void ClearRoutes();
+    // Returns the slot index, or -1 if the matrix is full.
+    int AddRoute(Source source, Destination destination, float amount);
+    // value * (1 - amount) + source * amount. Blend amounts on one
+    // destination add up.
+    int AddBlendRoute(Source source, Destination destination, float amount);
+    void SetRouteAmount(int slot, float amount);
+    int GetNumRoutes() const { return num_routes_; }
+
+    void SetLfoRate(float hz);
+    void SetLfoShape(float shape);   // 0-1, tides2 wave shape
+    void SetLfoSpread(float spread); // 0-1, phase offset between voice channels
+
+    // Evaluates all routes for num_voices voices. envelopes holds one value per
+    // voice for this block; touch and wheel are shared by every voice.
+    void Process(const float* envelopes, float touch, float wheel, int num_voices);
+
+    // Writes this block's destinations into a voice's patch/modulations, after
+    // the patch holds the knob values. Destinations without a route are left
+    // unpatched.
+    void Apply(int voice, plaits::Patch& patch, plaits::Modulations& mod) const;
+
+    float Get(Destination destination, int voice) const { return destinations_[destination][voice]; }
+
+private:
+    void RenderLfo();
+    float Offset(Destination destination, int voice, float knob) const;
+
+    Route routes_[kMaxRoutes];
+    int num_routes_;
+    bool destination_routed_[DEST_LAST];
+    bool lfo_routed_;
+
+    float sources_[SOURCE_LAST][kMaxVoices];
+    float destinations_[DEST_LAST][kMaxVoices];
+    float knob_scale_[DEST_LAST];   // 1 - the destination's blend amounts
+
+    float sample_rate_;
+    float block_size_;
+    float lfo_frequency_;
+    float lfo_shape_;
+    float lfo_spread_;
+};
+
+#endif // MOD_MATRIX_H
@@ -1,10 +1,13 @@
-#include "Thaumazein.h"
 #include "Polyphony.h"
+#include "ControlPath.h"
 #include "stmlib/utils/buffer_allocator.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 
 DSY_SDRAM_BSS char shared_buffer[262144];
 
-const int MAX_ENGINE_INDEX = 15;
+const int MAX_ENGINE_INDEX = plaits::kBraidsEngineIndex;
 
 
 PolyphonyEngine poly_engine;
@@ -14,28 +17,38 @@ const float PolyphonyEngine::kTouchMidiNotes_[12] = {
     50.0f, 52.0f, 53.0f, 55.0f, 57.0f, 59.0f  // D3, E3, F3, G3, A3, B3
 };
 
-PolyphonyEngine::PolyphonyEngine() : allocator_(nullptr), hw_ptr_(nullptr), engine_changed_flag_(false) {
+PolyphonyEngine::PolyphonyEngine() : hw_ptr_(nullptr), engine_changed_flag_(false) {
     memset(voice_active_, 0, sizeof(voice_active_));
+    memset(voice_sounding_, 0, sizeof(voice_sounding_));
+    memset(voice_age_, 0, sizeof(voice_age_));
+    for (int v = 0; v < MAX_VOICES; ++v) {
+        voice_part_[v] = -1;
+    }
     memset(voice_note_, 0, sizeof(voice_note_));
+    memset(envelope_values_, 0, sizeof(envelope_values_));
     memset(mix_buffer_out_, 0, sizeof(mix_buffer_out_));
     memset(mix_buffer_aux_, 0, sizeof(mix_buffer_aux_));
+    memset(fade_buffer_out_, 0, sizeof(fade_buffer_out_));
+    memset(fade_buffer_aux_, 0, sizeof(fade_buffer_aux_));
 }
 
 PolyphonyEngine::~PolyphonyEngine() {
-    if (allocator_) {
-        delete allocator_;
-        allocator_ = nullptr;
-    }
 }
 
 void PolyphonyEngine::Init(daisy::DaisySeed* hw) {
     hw_ptr_ = hw;
     AllocateVoices(); 
     InitVoiceParameters(); 
+    InitModMatrix();
 }
 
 void PolyphonyEngine::HandleTouchInput(uint16_t current_touch_state_param, uint16_t last_touch_state_param, int engine_index, bool poly_mode, int effective_num_voices) {
-    bool percussive_engine = (engine_index > 7);
+    if (layout_ != LAYOUT_SINGLE) {
+        HandleLayoutTouch(current_touch_state_param, last_touch_state_param);
+        return;
+    }
+
+    bool percussive_engine = IsPercussiveEngine(engine_index);
 
     for (int i = 0; i < 12; ++i) {
         bool pad_currently_pressed = (current_touch_state_param >> i) & 1;
@@ -81,7 +94,7 @@ void PolyphonyEngine::HandleTouchInput(uint16_t current_touch_state_param, uint1
 void PolyphonyEngine::RenderBlock(const RenderParameters& params) {
     PrepVoiceParams(params);
     
-    ProcessEnvelopes(params.poly_mode);
+    ProcessEnvelopes(params.poly_mode ? params.effective_num_voices : 1);
 
     if (params.arp_on) {
         modulations_[0].trigger = 0.0f;
@@ -89,10 +102,22 @@ void PolyphonyEngine::RenderBlock(const RenderParameters& params) {
     }
 }
 
+void PolyphonyEngine::RenderSilence() {
+    for (int v = 0; v < MAX_VOICES; ++v) {
+        SilenceVoice(v);
+    }
+    memset(mix_buffer_out_, 0, sizeof(mix_buffer_out_));
+    memset(mix_buffer_aux_, 0, sizeof(mix_buffer_aux_));
+    memset(fade_buffer_out_, 0, sizeof(fade_buffer_out_));
+    memset(fade_buffer_aux_, 0, sizeof(fade_buffer_aux_));
+}
+
 void PolyphonyEngine::ResetVoices() {
-    for (int v = 0; v < NUM_VOICES; v++) {
+    for (int v = 0; v < MAX_VOICES; v++) {
         voice_envelopes_[v].Reset();
         voice_active_[v] = false;
+        voice_sounding_[v] = false;
+        voice_part_[v] = -1;
         modulations_[v].trigger = 0.0f;
         modulations_[v].trigger_patched = false; 
         modulations_[v].level_patched = false;  
@@ -100,19 +125,22 @@ void PolyphonyEngine::ResetVoices() {
 }
 
 void PolyphonyEngine::AllocateVoices() {
-    if (!allocator_) {
-        allocator_ = new stmlib::BufferAllocator(shared_buffer, sizeof(shared_buffer));
-    }
-
-    for (int i = 0; i < NUM_VOICES; ++i) {
-        voices_[i].Init(allocator_);
+    // Split/layer run any engine on every slot at once, so no two voices can
+    // share engine state (string delay lines, particle diffuser, chord ratios).
+    // A 32 KB slice is twice the RAM Plaits itself gives all engines.
+    const size_t slice_size = sizeof(shared_buffer) / MAX_VOICES;
+
+    for (int i = 0; i < MAX_VOICES; ++i) {
+        allocators_[i].Init(&shared_buffer[i * slice_size], slice_size);
+        voices_[i].Init(&allocators_[i]);
+        voices_[i].Seed(i); // Same noise per slot on every boot and host render
     }
 }
 
 void PolyphonyEngine::InitVoiceParameters() {
-    float sample_rate_val = SAMPLE_RATE;
+    float sample_rate_val = sample_rate;
 
-    for (int i = 0; i < NUM_VOICES; ++i) {
+    for (int i = 0; i < MAX_VOICES; ++i) {
         patches_[i].engine = 0;      
         modulations_[i].engine = 0; 
         modulations_[i].trigger = 0.0f;
@@ -128,19 +156,41 @@ void PolyphonyEngine::InitVoiceParameters() {
     }
 }
 
-void PolyphonyEngine::PrepVoiceParams(const RenderParameters& params) {
-    bool percussive_engine = (params.engine_index > 7);
+void PolyphonyEngine::InitModMatrix() {
+    static_assert(MAX_VOICES <= ModMatrix::kMaxVoices, "ModMatrix has one row slot per voice");
+    mod_matrix_.Init(sample_rate, BLOCK_SIZE);
 
-    float attack_value = 0.0f;
-    float release_value = 0.0f;
-    if (!percussive_engine) {
-        float attack_raw = params.env_attack_val; 
-        if (attack_raw < 0.2f) {
-            attack_value = attack_raw * (attack_raw * 0.5f);
-        } else {
-            attack_value = attack_raw * attack_raw * attack_raw;
+    // Touch pressure on morph: the same 50/50 blend with morph_knob_val as
+    // before the matrix.
+    mod_matrix_.AddBlendRoute(ModMatrix::SOURCE_TOUCH, ModMatrix::DEST_MORPH, 0.5f);
+}
+
+void PolyphonyEngine::PrepVoiceParams(const RenderParameters& params) {
+    // Split/layer voices each take engine and timbre from their part; the
+    // arpeggiator always plays the selected engine on voice 0.
+    bool layout = layout_ != LAYOUT_SINGLE && !params.arp_on;
+    bool percussive_engine = IsPercussiveEngine(params.engine_index);
+    bool envelope_percussive = percussive_engine && !layout;
+
+    if (params.envelope_version != envelope_version_ || envelope_percussive != envelope_percussive_) {
+        envelope_version_ = params.envelope_version;
+        envelope_percussive_ = envelope_percussive;
+        attack_value_ = 0.0f;
+        release_value_ = 0.0f;
+        if (!envelope_percussive) {
+            float attack_raw = params.env_attack_val; 
+            if (attack_raw < 0.2f) {
+                attack_value_ = attack_raw * (attack_raw * 0.5f);
+            } else {
+                attack_value_ = attack_raw * attack_raw * attack_raw;
+            }
+            release_value_ = params.env_release_val * params.env_release_val * params.env_release_val;
+            // All voices, so that switching back to poly finds them up to date
+            for (int v = 0; v < MAX_VOICES; ++v) {
+                voice_envelopes_[v].SetAttackTime(attack_value_);
+                voice_envelopes_[v].SetReleaseTime(release_value_);
+            }
         }
-        release_value = params.env_release_val * params.env_release_val * params.env_release_val;
     }
 
     float global_pitch_offset = params.pitch_val * 24.f - 12.f;
@@ -148,26 +198,50 @@ void PolyphonyEngine::PrepVoiceParams(const RenderParameters& params) {
     float current_global_morph = params.morph_knob_val;
     float current_global_timbre = params.timbre_knob_val;
 
+    int voice_engine[MAX_VOICES];
+    for (int v = 0; v < params.effective_num_voices; ++v) {
+        voice_engine[v] = voice_part_[v] >= 0 ? parts_[voice_part_[v]].engine_index : params.engine_index;
+    }
+
+    // Envelopes run first for every voice so the matrix sees this block's
+    // values and can be evaluated once for all voices.
+    for (int v = 0; v < params.effective_num_voices; ++v) {
+        bool percussive_voice = IsPercussiveEngine(voice_engine[v]);
+        UpdateModAndEnv(
+            modulations_[v],
+            voice_envelopes_[v],
+            percussive_voice
+        );
+        envelope_values_[v] = percussive_voice ? 0.0f : modulations_[v].level;
+    }
+    mod_matrix_.Process(envelope_values_, params.touch_cv_value, params.mod_wheel_val, params.effective_num_voices);
+
+    // Poly mode with every voice on one engine can run the engine stage of
+    // all voices in lock-step; the voices are split around the engine call.
+    bool lockstep = params.poly_mode && !layout && params.effective_num_voices == NUM_VOICES;
+
     for (int v = 0; v <= params.effective_num_voices - 1; ++v) { 
+        // Layout slots that have gone quiet cost nothing
+        if (layout && (voice_part_[v] < 0 || !voice_sounding_[v])) {
+            SilenceVoice(v);
+            continue;
+        }
+
+        const Part* part = voice_part_[v] >= 0 ? &parts_[voice_part_[v]] : nullptr;
+        bool own_timbre = part && !part->follow_knobs;
+
         PatchParams patch_params;
-        patch_params.engine_idx = params.engine_index;
+        patch_params.engine_idx = voice_engine[v];
         patch_params.note = voice_note_[v];
         patch_params.global_pitch_offset = global_pitch_offset;
-        patch_params.harmonics = current_global_harmonics;
-        patch_params.timbre = current_global_timbre;
-        patch_params.morph = current_global_morph;
+        patch_params.harmonics = own_timbre ? part->harmonics : current_global_harmonics;
+        patch_params.timbre = own_timbre ? part->timbre : current_global_timbre;
+        patch_params.morph = own_timbre ? part->morph : current_global_morph;
         patch_params.arp_on = params.arp_on;
-        patch_params.decay = release_value;
+        patch_params.decay = IsPercussiveEngine(voice_engine[v]) ? 0.0f : release_value_;
         
         UpdatePatchParams(patches_[v], patch_params);
-
-        UpdateModAndEnv(
-            modulations_[v],
-            voice_envelopes_[v],
-            percussive_engine,
-            attack_value,
-            release_value
-        );
+        mod_matrix_.Apply(v, patches_[v], modulations_[v]);
 
         if (!params.poly_mode && !params.arp_on) {
             UpdateMonoTrigger(
@@ -177,37 +251,85 @@ void PolyphonyEngine::PrepVoiceParams(const RenderParameters& params) {
             );
         }
         
-        voices_[v].Render(patches_[v], modulations_[v], output_buffers_[v], BLOCK_SIZE);
+        if (lockstep) {
+            voices_[v].BeginRender(patches_[v], modulations_[v], &engine_parameters_[v], BLOCK_SIZE);
+        } else {
+            voices_[v].Render(patches_[v], modulations_[v], output_buffers_[v], BLOCK_SIZE);
+        }
 
-        if (!params.poly_mode && !params.arp_on && (patches_[v].engine > 7) && v == 0) {
+        if (!params.poly_mode && !params.arp_on && IsPercussiveEngine(patches_[v].engine) && v == 0) {
             modulations_[v].trigger = 0.0f;
         }
+
+        if (layout) {
+            // Drum parts get a one-block trigger pulse, like the mono path
+            if (IsPercussiveEngine(voice_engine[v])) {
+                modulations_[v].trigger = 0.0f;
+            }
+            bool sounding = voice_active_[v];
+            for (int i = 0; i < BLOCK_SIZE && !sounding; ++i) {
+                sounding = abs(output_buffers_[v][i].out) > kSilenceThreshold;
+            }
+            voice_sounding_[v] = sounding;
+        }
     }
     
+    if (lockstep) {
+        RenderLockstep();
+    }
+
     int effective_voices = params.effective_num_voices; 
-    for (int v = effective_voices; v < NUM_VOICES; ++v) {
+    for (int v = effective_voices; v < MAX_VOICES; ++v) {
          SilenceVoice(v);
     }
 
     if(engine_changed_flag_) {
         for(int v = 0; v < effective_voices; ++v) {
-            RetriggerVoice(v);
+            // In a layout only part 1 follows the engine selection
+            if (!layout || voice_part_[v] == 1) {
+                RetriggerVoice(v);
+            }
         }
         engine_changed_flag_ = false;
     }
 }
 
-void PolyphonyEngine::ProcessEnvelopes(bool poly_mode) {
+void PolyphonyEngine::RenderLockstep() {
+    static_assert(NUM_VOICES == plaits::kLockstepVoices, "Lock-step renders exactly NUM_VOICES voices");
+    plaits::Voice* voices[NUM_VOICES];
+    for (int v = 0; v < NUM_VOICES; ++v) {
+        voices[v] = &voices_[v];
+    }
+
+    // Engines without a lock-step path (or mixed engines) render one by one.
+    if (!plaits::Voice::RenderLockstep(voices, engine_parameters_, BLOCK_SIZE)) {
+        for (int v = 0; v < NUM_VOICES; ++v) {
+            voices_[v].RenderEngine(engine_parameters_[v], BLOCK_SIZE);
+        }
+    }
+
+    for (int v = 0; v < NUM_VOICES; ++v) {
+        voices_[v].EndRender(patches_[v], modulations_[v], engine_parameters_[v], output_buffers_[v], BLOCK_SIZE);
+    }
+}
+
+void PolyphonyEngine::ProcessEnvelopes(int num_voices) {
     memset(mix_buffer_out_, 0, sizeof(mix_buffer_out_));
     memset(mix_buffer_aux_, 0, sizeof(mix_buffer_aux_));
 
-    int voices_to_process = poly_mode ? NUM_VOICES : 1;
-    for (int v = 0; v < voices_to_process; ++v) {
+    for (int v = 0; v < num_voices; ++v) {
         for (int i = 0; i < BLOCK_SIZE; ++i) {
             mix_buffer_out_[i] += output_buffers_[v][i].out;
             mix_buffer_aux_[i] += output_buffers_[v][i].aux;
         }
     }
+
+    for (int i = 0; i < BLOCK_SIZE; ++i) {
+        mix_buffer_out_[i] += fade_buffer_out_[i];
+        mix_buffer_aux_[i] += fade_buffer_aux_[i];
+    }
+    memset(fade_buffer_out_, 0, sizeof(fade_buffer_out_));
+    memset(fade_buffer_aux_, 0, sizeof(fade_buffer_aux_));
 }
 
 void PolyphonyEngine::UpdatePatchParams(plaits::Patch& patch, const PatchParams& params) {
@@ -223,7 +345,7 @@ void PolyphonyEngine::UpdatePatchParams(plaits::Patch& patch, const PatchParams&
     patch.morph_modulation_amount = 0.f;
 }
 
-void PolyphonyEngine::UpdateModAndEnv(plaits::Modulations& mod, VoiceEnvelope& env, bool percussive_engine, float attack_value, float release_value) {
+void PolyphonyEngine::UpdateModAndEnv(plaits::Modulations& mod, VoiceEnvelope& env, bool percussive_engine) {
     mod.engine = 0;
     mod.note = 0.0f; 
     mod.frequency = 0.0f;
@@ -232,8 +354,6 @@ void PolyphonyEngine::UpdateModAndEnv(plaits::Modulations& mod, VoiceEnvelope& e
     mod.morph = 0.0f; 
 
     if (!percussive_engine) {
-        env.SetAttackTime(attack_value);
-        env.SetReleaseTime(release_value);
         float env_value = env.Process();
         mod.level = env_value;
         mod.level_patched = true;
@@ -251,14 +371,14 @@ void PolyphonyEngine::UpdateMonoTrigger(plaits::Modulations& mod, bool& active_f
 }
 
 void PolyphonyEngine::SilenceVoice(int voice_idx) {
-    if (voice_idx >= 0 && voice_idx < NUM_VOICES) {
+    if (voice_idx >= 0 && voice_idx < MAX_VOICES) {
         memset(output_buffers_[voice_idx], 0, sizeof(plaits::Voice::Frame) * BLOCK_SIZE);
     }
 }
 
 void PolyphonyEngine::RetriggerVoice(int voice_idx) {
-    if (voice_idx >= 0 && voice_idx < NUM_VOICES && voice_active_[voice_idx]) {
-        bool percussive_engine = (patches_[voice_idx].engine > 7);
+    if (voice_idx >= 0 && voice_idx < MAX_VOICES && voice_active_[voice_idx]) {
+        bool percussive_engine = IsPercussiveEngine(patches_[voice_idx].engine);
         if (!percussive_engine) {
             voice_envelopes_[voice_idx].Reset();
             voice_envelopes_[voice_idx].Trigger();
@@ -272,9 +392,11 @@ void PolyphonyEngine::RetriggerVoice(int voice_idx) {
 }
 
 void PolyphonyEngine::ClearVoices() {
-    for (int v = 0; v < NUM_VOICES; ++v) {
+    for (int v = 0; v < MAX_VOICES; ++v) {
         voice_envelopes_[v].Reset();
         voice_active_[v] = false;
+        voice_sounding_[v] = false;
+        voice_part_[v] = -1;
         modulations_[v].trigger = 0.0f;
         modulations_[v].trigger_patched = false;
         modulations_[v].level_patched = false; 
@@ -282,10 +404,150 @@ void PolyphonyEngine::ClearVoices() {
     }
 }
 
+void PolyphonyEngine::ReleaseVoicesFrom(int first_voice) {
+    for (int v = first_voice; v < MAX_VOICES; ++v) {
+        StopVoice(v);
+    }
+}
+
+void PolyphonyEngine::StopVoice(int voice_idx) {
+    if (voice_part_[voice_idx] >= 0 && voice_sounding_[voice_idx]) {
+        FadeOutVoice(voice_idx);
+    }
+    voice_envelopes_[voice_idx].Reset();
+    voice_active_[voice_idx] = false;
+    voice_sounding_[voice_idx] = false;
+    voice_part_[voice_idx] = -1;
+    modulations_[voice_idx].trigger = 0.0f;
+    modulations_[voice_idx].trigger_patched = false;
+    SilenceVoice(voice_idx);
+}
+
+// A stolen layout voice renders one more block, ramped down to silence, so
+// that its slot is free for the new note straight away without a click.
+void PolyphonyEngine::FadeOutVoice(int voice_idx) {
+    plaits::Voice::Frame frames[BLOCK_SIZE];
+    modulations_[voice_idx].trigger = 0.0f;
+    voices_[voice_idx].Render(patches_[voice_idx], modulations_[voice_idx], frames, BLOCK_SIZE);
+    for (int i = 0; i < BLOCK_SIZE; ++i) {
+        float gain = 1.0f - static_cast<float>(i + 1) / BLOCK_SIZE;
+        fade_buffer_out_[i] += frames[i].out * gain;
+        fade_buffer_aux_[i] += frames[i].aux * gain;
+    }
+}
+
+void PolyphonyEngine::SetLayout(Layout layout, int engine_index, float harmonics, float timbre, float morph) {
+    ClearVoices();
+    layout_ = layout;
+    split_pad_ = kDefaultSplitPad;
+    parts_[0] = { engine_index, harmonics, timbre, morph, false };
+    parts_[1] = { engine_index, harmonics, timbre, morph, true };
+}
+
+void PolyphonyEngine::RestoreLayout(Layout layout, const Part& part0, int engine_index) {
+    SetLayout(layout, part0.engine_index, part0.harmonics, part0.timbre, part0.morph);
+    parts_[1].engine_index = engine_index;
+}
+
+void PolyphonyEngine::HandleLayoutTouch(uint16_t current_touch_state_param, uint16_t last_touch_state_param) {
+    for (int i = 0; i < 12; ++i) {
+        bool pad_currently_pressed = (current_touch_state_param >> i) & 1;
+        bool pad_was_pressed = (last_touch_state_param >> i) & 1;
+        float note_for_pad = kTouchMidiNotes_[i];
+
+        if (pad_currently_pressed && !pad_was_pressed) {
+            for (int part = 0; part < kNumParts; ++part) {
+                if (PadInPart(i, part)) {
+                    StartLayoutVoice(part, note_for_pad);
+                }
+            }
+        } else if (!pad_currently_pressed && pad_was_pressed) {
+            // Layered pads hold one voice per part
+            for (int v = 0; v < MAX_VOICES; ++v) {
+                if (voice_active_[v] && voice_part_[v] >= 0 && fabsf(voice_note_[v] - note_for_pad) < 0.1f) {
+                    voice_active_[v] = false;
+                    voice_envelopes_[v].Release();
+                }
+            }
+        }
+    }
+}
+
+bool PolyphonyEngine::PadInPart(int pad, int part) const {
+    if (layout_ == LAYOUT_LAYER) {
+        return true;
+    }
+    return part == 0 ? pad < split_pad_ : pad >= split_pad_;
+}
+
+void PolyphonyEngine::StartLayoutVoice(int part, float note) {
+    int engine_index = parts_[part].engine_index;
+    int v = AllocateVoice(voices_[0].GetEngineCost(engine_index));
+    bool percussive = IsPercussiveEngine(engine_index);
+
+    voice_part_[v] = part;
+    voice_note_[v] = note;
+    voice_active_[v] = true;
+    voice_sounding_[v] = true;
+    voice_age_[v] = ++note_counter_;
+    modulations_[v].trigger = 1.0f;
+    modulations_[v].trigger_patched = percussive;
+    voice_envelopes_[v].Trigger();
+}
+
+// Render cost of the sounding layout voices at their parts' current engines.
+// Also finds the first free slot and the oldest sounding voice (-1 if none).
+float PolyphonyEngine::LayoutLoad(int* free_voice, int* oldest_voice) const {
+    float load = 0.0f;
+    *free_voice = -1;
+    *oldest_voice = -1;
+    for (int v = 0; v < MAX_VOICES; ++v) {
+        if (voice_part_[v] < 0 || !voice_sounding_[v]) {
+            if (*free_voice < 0) {
+                *free_voice = v;
+            }
+            continue;
+        }
+        load += voices_[0].GetEngineCost(parts_[voice_part_[v]].engine_index);
+        if (*oldest_voice < 0 || voice_age_[v] < voice_age_[*oldest_voice]) {
+            *oldest_voice = v;
+        }
+    }
+    return load;
+}
+
+// Mixed engines share one render budget, NUM_VOICES voices of cost 1.0.
+// The oldest sounding voices are stolen until the new one fits.
+int PolyphonyEngine::AllocateVoice(float cost) {
+    while (true) {
+        int free_voice;
+        int oldest_voice;
+        float load = cost + LayoutLoad(&free_voice, &oldest_voice);
+        if (oldest_voice < 0 || (free_voice >= 0 && load <= kVoiceCostBudget)) {
+            return free_voice;
+        }
+        StopVoice(oldest_voice);
+    }
+}
+
+// A part's sounding voices switch engine with it, so the load can go over
+// budget without a note-on; steal the oldest voices until it fits again.
+void PolyphonyEngine::EnforceVoiceBudget() {
+    while (true) {
+        int free_voice;
+        int oldest_voice;
+        float load = LayoutLoad(&free_voice, &oldest_voice);
+        if (oldest_voice < 0 || load <= kVoiceCostBudget) {
+            return;
+        }
+        StopVoice(oldest_voice);
+    }
+}
+
 void PolyphonyEngine::PolyToMono(int source_voice_idx) {
-    if (source_voice_idx < 0 || source_voice_idx >= NUM_VOICES) return;
+    if (source_voice_idx < 0 || source_voice_idx >= MAX_VOICES) return;
 
-    for (int v = 0; v < NUM_VOICES; ++v) {
+    for (int v = 0; v < MAX_VOICES; ++v) {
         if (v != source_voice_idx) {
             voice_active_[v] = false;
             voice_envelopes_[v].Reset();
@@ -318,8 +580,8 @@ void PolyphonyEngine::PolyToMono(int source_voice_idx) {
 }
 
 void PolyphonyEngine::OnEngineChange(int old_engine_idx, int new_engine_idx) {
-    bool prev_was_poly = (old_engine_idx <= 3);
-    bool now_poly      = (new_engine_idx <= 3);
+    bool prev_was_poly = IsPolyEngine(old_engine_idx);
+    bool now_poly      = IsPolyEngine(new_engine_idx);
 
     if(old_engine_idx == new_engine_idx) {
         return;
@@ -327,13 +589,23 @@ void PolyphonyEngine::OnEngineChange(int old_engine_idx, int new_engine_idx) {
 
     engine_changed_flag_ = true;
 
+    if (layout_ != LAYOUT_SINGLE) {
+        parts_[1].engine_index = new_engine_idx;
+        EnforceVoiceBudget();
+        return;
+    }
+
     if(prev_was_poly == now_poly) {
+        // Going from a cheap pad engine back to a regular one
+        if (now_poly) {
+            ReleaseVoicesFrom(PolyVoiceCount(new_engine_idx));
+        }
         return;
     }
 
     if(prev_was_poly && !now_poly) {
         int source_voice = -1;
-        for(int v = 0; v < NUM_VOICES; ++v) {
+        for(int v = 0; v < MAX_VOICES; ++v) {
             if(voice_active_[v]) { source_voice = v; break; }
         }
 
@@ -398,10 +670,11 @@ void PolyphonyEngine::TriggerArpVoice(int pad_idx, int current_engine_index_val)
     if (pad_idx < 0 || pad_idx >= 12) return;
 
     float note_to_play = kTouchMidiNotes_[pad_idx];
-    bool percussive = (current_engine_index_val > 7);
+    bool percussive = IsPercussiveEngine(current_engine_index_val);
 
     voice_note_[0] = note_to_play;
     voice_active_[0] = true;
+    voice_part_[0] = -1;
 
     PatchParams patch_params;
     patch_params.engine_idx = current_engine_index_val;
@@ -425,10 +698,28 @@ void PolyphonyEngine::TriggerArpVoice(int pad_idx, int current_engine_index_val)
 }
 
 bool PolyphonyEngine::IsAnyVoiceActive() const {
-    for (int i = 0; i < NUM_VOICES; ++i) {
+    for (int i = 0; i < MAX_VOICES; ++i) {
         if (voice_active_[i]) {
             return true;
         }
     }
     return false;
 }
+
+int PolyphonyEngine::PolyVoiceCount(int engine_index) const {
+    static_assert(MAX_VOICES <= 8, "Active voice mask is 8 bits");
+    static_assert(MAX_VOICES <= static_cast<int>(plaits::kMaxBraidsEngines), "One Braids oscillator per voice slot");
+    float cost = voices_[0].GetEngineCost(engine_index);
+    int count = cost > 0.0f ? static_cast<int>(NUM_VOICES / cost + 0.01f) : MAX_VOICES;
+    return std::min(std::max(count, 1), MAX_VOICES);
+}
+
+uint8_t PolyphonyEngine::GetActiveVoiceMask() const {
+    uint8_t mask = 0;
+    for (int i = 0; i < MAX_VOICES; ++i) {
+        if (voice_active_[i]) {
+            mask |= 1 << i;
+        }
+    }
+    return mask;
+}
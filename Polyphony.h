@@ -2,13 +2,14 @@
 #define POLYPHONY_H
 
 // Define global constants needed by this header
-#define NUM_VOICES 4
+#define NUM_VOICES 4    // Polyphony of a typical (cost 1.0) engine; also the mix scaling
+#define MAX_VOICES 8    // Voice slots, for engines cheap enough to run more voices
 #define BLOCK_SIZE 32
 
 #include "daisy_seed.h"
 #include "plaits/dsp/voice.h"
 #include "VoiceEnvelope.h"
-#include "Thaumazein.h"
+#include "ModMatrix.h"
 #include "stmlib/utils/buffer_allocator.h"
 
 namespace stmlib {
@@ -19,6 +20,15 @@ namespace plaits {
     class Voice;
 }
 
+// Engine families, by plaits::Voice registry index.
+inline bool IsPercussiveEngine(int engine_index) {
+    return engine_index > 7 && engine_index < plaits::kBraidsEngineIndex;
+}
+
+inline bool IsPolyEngine(int engine_index) {
+    return engine_index <= 3 || engine_index >= plaits::kBraidsEngineIndex;
+}
+
 struct PatchParams {
     int engine_idx;
     float note;
@@ -32,6 +42,25 @@ struct PatchParams {
 
 class PolyphonyEngine {
 public:
+    enum Layout {
+        LAYOUT_SINGLE,  // Every voice on the selected engine
+        LAYOUT_SPLIT,   // Pads below the split play part 0, the others part 1
+        LAYOUT_LAYER,   // Every pad plays both parts
+        LAYOUT_LAST
+    };
+
+    // A sound in split/layer mode: engine plus its own timbre set.
+    struct Part {
+        int engine_index;
+        float harmonics;
+        float timbre;
+        float morph;
+        bool follow_knobs;   // Timbre set tracks the knobs instead
+    };
+
+    static const int kNumParts = 2;
+    static const int kDefaultSplitPad = 4;
+
     struct RenderParameters {
         int engine_index;
         bool poly_mode;
@@ -43,8 +72,10 @@ public:
         float timbre_knob_val;
         float env_attack_val;
         float env_release_val;
+        uint32_t envelope_version;   // Changes when attack or release moves
         float delay_mix_val;
         float touch_cv_value;
+        float mod_wheel_val;
     };
 
     PolyphonyEngine();
@@ -57,52 +88,114 @@ public:
     
     const float* GetMainOutputBuffer() const { return mix_buffer_out_; }
     const float* GetAuxOutputBuffer() const { return mix_buffer_aux_; }
+    const plaits::Voice::Frame* GetVoiceOutputBuffer(int voice_idx) const { return output_buffers_[voice_idx]; }
+
+    // Sample engine selected: the voices stay as they are, the mix is silent.
+    void RenderSilence();
+
+    // MIDI note of a touch pad.
+    static float PadNote(int pad) { return kTouchMidiNotes_[pad]; }
 
     void TriggerArpVoice(int pad_idx, int current_engine_index_val);
     bool IsAnyVoiceActive() const;
+    // Voices an engine gets in poly mode: NUM_VOICES at cost 1.0, more for
+    // cheaper engines, up to MAX_VOICES.
+    int PolyVoiceCount(int engine_index) const;
+    uint8_t GetActiveVoiceMask() const;
     void PolyToMono(int source_voice_idx);
     void ClearVoices();
     void OnEngineChange(int old_engine_idx, int new_engine_idx);
 
+    // Part 0 keeps engine_index and the given timbre set; part 1 starts on
+    // the same engine and then follows engine selection and the knobs.
+    void SetLayout(Layout layout, int engine_index, float harmonics, float timbre, float morph);
+    Layout GetLayout() const { return layout_; }
+    const Part& GetPart(int part) const { return parts_[part]; }
+    // Control journal replay: layout and part 0 as journaled, part 1 on the
+    // selected engine.
+    void RestoreLayout(Layout layout, const Part& part0, int engine_index);
+
+    ModMatrix& GetModMatrix() { return mod_matrix_; }
+
     uint16_t GetLastTouchState() const;
     void UpdateLastTouchState(uint16_t current_state);
 
 private:
-    plaits::Voice voices_[NUM_VOICES];
-    plaits::Patch patches_[NUM_VOICES];
-    plaits::Modulations modulations_[NUM_VOICES];
-    VoiceEnvelope voice_envelopes_[NUM_VOICES];
-    bool voice_active_[NUM_VOICES];
-    float voice_note_[NUM_VOICES];
-    plaits::Voice::Frame output_buffers_[NUM_VOICES][BLOCK_SIZE];
+    plaits::Voice voices_[MAX_VOICES];
+    plaits::Patch patches_[MAX_VOICES];
+    plaits::Modulations modulations_[MAX_VOICES];
+    VoiceEnvelope voice_envelopes_[MAX_VOICES];
+    bool voice_active_[MAX_VOICES];
+    float voice_note_[MAX_VOICES];
+    plaits::Voice::Frame output_buffers_[MAX_VOICES][BLOCK_SIZE];
+    plaits::EngineParameters engine_parameters_[MAX_VOICES]; // Between BeginRender and EndRender
+    float envelope_values_[MAX_VOICES];
+    ModMatrix mod_matrix_;
 
     float mix_buffer_out_[BLOCK_SIZE];
     float mix_buffer_aux_[BLOCK_SIZE];
+    // Stolen voices fading out, added to the next mix
+    float fade_buffer_out_[BLOCK_SIZE];
+    float fade_buffer_aux_[BLOCK_SIZE];
     
-    stmlib::BufferAllocator* allocator_;
+    // Each voice's engines allocate from their own slice of shared_buffer
+    stmlib::BufferAllocator allocators_[MAX_VOICES];
     daisy::DaisySeed* hw_ptr_;
 
     void AllocateVoices();
     void InitVoiceParameters();
+    void InitModMatrix();
     void PrepVoiceParams(const RenderParameters& params);
-    void ProcessEnvelopes(bool poly_mode);
+    void RenderLockstep();
+    void ProcessEnvelopes(int num_voices);
     void UpdatePatchParams(plaits::Patch& patch, const PatchParams& params);
-    void UpdateModAndEnv(plaits::Modulations& mod, VoiceEnvelope& env, bool percussive_engine, 
-                        float attack_value, float release_value);
+    void UpdateModAndEnv(plaits::Modulations& mod, VoiceEnvelope& env, bool percussive_engine);
     void UpdateMonoTrigger(plaits::Modulations& mod, bool& active_flag, bool engine_changed_flag);
     void SilenceVoice(int voice_idx);
     void RetriggerVoice(int voice_idx);
+    void ReleaseVoicesFrom(int first_voice);
+    void StopVoice(int voice_idx);
+    void FadeOutVoice(int voice_idx);
+
+    void HandleLayoutTouch(uint16_t current_touch_state, uint16_t last_touch_state);
+    bool PadInPart(int pad, int part) const;
+    void StartLayoutVoice(int part, float note);
+    float LayoutLoad(int* free_voice, int* oldest_voice) const;
+    int AllocateVoice(float cost);
+    void EnforceVoiceBudget();
 
     int FindVoiceForNote(float note, int engine_index, bool poly_mode, int max_voices);
     int FindFreeVoice(int max_voices);
     void AssignMonoNote(float note, bool percussive_engine);
 
     bool engine_changed_flag_ = false; 
+
+    // Split/layer state. voice_part_ is -1 for voices outside a layout.
+    Layout layout_ = LAYOUT_SINGLE;
+    int split_pad_ = kDefaultSplitPad;
+    Part parts_[kNumParts];
+    int voice_part_[MAX_VOICES];
+    bool voice_sounding_[MAX_VOICES];   // Held, or last block not silent
+    uint32_t voice_age_[MAX_VOICES];     // Note-on order, for voice stealing
+    uint32_t note_counter_ = 0;
+
+    // Envelope settings derived from the knobs, recomputed only when the
+    // envelope version (or the engine family) changes.
+    uint32_t envelope_version_ = ~0u;
+    bool envelope_percussive_ = false;
+    float attack_value_ = 0.0f;
+    float release_value_ = 0.0f;
     uint16_t last_touch_state_member_ = 0;
 
     static const float kTouchMidiNotes_[12];
+    static constexpr float kVoiceCostBudget = NUM_VOICES;
+    static const int kSilenceThreshold = 4;     // int16 LSBs
 };
 
 extern PolyphonyEngine poly_engine;
+extern const int MAX_ENGINE_INDEX;
+
+// Plaits voice buffers
+extern char shared_buffer[262144];
 
 #endif // POLYPHONY_H 
\ No newline at end of file
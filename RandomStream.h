@@ -0,0 +1,91 @@
+#pragma once
+#ifndef RANDOM_STREAM_H
+#define RANDOM_STREAM_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Block random-number service for the grain scheduler and the noise engines.
+// A stream runs kLanes interleaved LCGs (the constants of stmlib::Random), so
+// filling a block has no serial dependency from one draw to the next and the
+// lane loop compiles to independent multiply-adds. A stream only advances when
+// its owner draws from it: seeded per voice, an engine renders the same noise
+// whatever the other voices are doing.
+class RandomStream {
+public:
+    static const size_t kLanes = 4;
+
+    RandomStream() { Init(0); }
+
+    // Nearby seeds (voice indices) are hashed apart so their lanes don't
+    // start on neighbouring points of the same sequence.
+    void Init(uint32_t seed) {
+        for (size_t l = 0; l < kLanes; ++l) {
+            uint32_t z = seed * kLanes + l + 1;
+            z = (z ^ (z >> 16)) * 0x45d9f3bu;
+            z = (z ^ (z >> 16)) * 0x45d9f3bu;
+            state_[l] = z ^ (z >> 16);
+        }
+        lane_ = 0;
+    }
+
+    // Single draws, for per-event decisions (grain pan, spread)
+    inline uint32_t GetWord() {
+        uint32_t w = state_[lane_] = Step(state_[lane_]);
+        lane_ = (lane_ + 1) & (kLanes - 1);
+        return w;
+    }
+    inline float GetFloat() { return ToFloat(GetWord()); }
+
+    void FillWords(uint32_t* out, size_t size) {
+        Generate(out, size, [](uint32_t w) { return w; });
+    }
+
+    // [0, 1)
+    void FillUniform(float* out, size_t size) {
+        Generate(out, size, [](uint32_t w) { return ToFloat(w); });
+    }
+
+    // Unit mean; scale by the mean interval
+    void FillExponential(float* out, size_t size) {
+        FillUniform(out, size);
+        for (size_t i = 0; i < size; ++i) {
+            out[i] = -logf(1.0f - out[i]);
+        }
+    }
+
+    // out[i] = (uniform < p), so p <= 0 never fires and p >= 1 always does
+    void FillBernoulli(bool* out, size_t size, float p) {
+        Generate(out, size, [p](uint32_t w) { return ToFloat(w) < p; });
+    }
+
+private:
+    static inline uint32_t Step(uint32_t s) {
+        return s * 1664525u + 1013904223u;
+    }
+
+    // Top 24 bits, exactly representable, so the result never rounds to 1
+    static inline float ToFloat(uint32_t w) {
+        return static_cast<float>(w >> 8) * (1.0f / 16777216.0f);
+    }
+
+    template<typename T, typename Map>
+    inline void Generate(T* out, size_t size, Map map) {
+        size_t i = 0;
+        for (; i + kLanes <= size; i += kLanes) {
+            for (size_t l = 0; l < kLanes; ++l) {
+                state_[l] = Step(state_[l]);
+                out[i + l] = map(state_[l]);
+            }
+        }
+        for (; i < size; ++i) {
+            out[i] = map(GetWord());
+        }
+    }
+
+    uint32_t state_[kLanes];
+    size_t lane_;
+};
+
+#endif // RANDOM_STREAM_H
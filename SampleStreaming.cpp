@@ -0,0 +1,422 @@
+#include "SampleStreaming.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+// WAV fields are little-endian, as are both the H7 and the host.
+static uint16_t ReadLe16(const uint8_t* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+static uint32_t ReadLe32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24));
+}
+
+bool ParseWavHeader(StreamSource& source, WavInfo& info) {
+    uint8_t header[12];
+    if (!source.Seek(0) || source.Read(header, sizeof(header)) != sizeof(header)) return false;
+    if (memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0) return false;
+
+    bool have_format = false;
+    uint32_t offset = sizeof(header);
+    while (true) {
+        uint8_t chunk[8];
+        if (source.Read(chunk, sizeof(chunk)) != sizeof(chunk)) return false;
+        const uint32_t chunk_size = ReadLe32(chunk + 4);
+        offset += sizeof(chunk);
+
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            uint8_t fmt[16];
+            if (chunk_size < sizeof(fmt) || source.Read(fmt, sizeof(fmt)) != sizeof(fmt)) return false;
+            info.format = ReadLe16(fmt);
+            info.channels = ReadLe16(fmt + 2);
+            info.sample_rate = ReadLe32(fmt + 4);
+            info.bits_per_sample = ReadLe16(fmt + 14);
+            have_format = true;
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            info.data_offset = offset;
+            info.data_size = chunk_size;
+            break;
+        }
+        // Chunks are padded to an even size
+        offset += chunk_size + (chunk_size & 1);
+        if (!source.Seek(offset)) return false;
+    }
+
+    return have_format && info.format == 1 && info.bits_per_sample == 16 &&
+           (info.channels == 1 || info.channels == 2) && info.data_size > 0 &&
+           source.Seek(info.data_offset);
+}
+
+// --- WavetableImporter ---
+
+void WavetableImporter::Integrate(const int16_t* cycle, int16_t* out) {
+    float x[kWaveSize];
+    float mean = 0.0f;
+    for (size_t i = 0; i < kWaveSize; ++i) {
+        x[i] = static_cast<float>(cycle[i]);
+        mean += x[i];
+    }
+    mean /= kWaveSize;
+
+    float peak = 0.0f;
+    for (size_t i = 0; i < kWaveSize; ++i) {
+        x[i] -= mean;
+        peak = std::max(peak, fabsf(x[i]));
+    }
+    const float gain = peak > 0.0f ? 1.0f / peak : 0.0f;
+
+    // With the DC removed the running sum is periodic, so one period of it is
+    // enough to build the wrapped table.
+    float sum = 0.0f;
+    float sum_mean = 0.0f;
+    for (size_t i = 0; i < kWaveSize; ++i) {
+        sum += x[i] * gain;
+        x[i] = sum;
+        sum_mean += sum;
+    }
+    sum_mean /= kWaveSize;
+
+    // Same scale and 4-sample lead-in as the built-in tables
+    // (see plaits/resources/wavetables.py).
+    const float kScale = 4.0f * 32768.0f / kWaveSize;
+    for (size_t i = 0; i < kWaveStride; ++i) {
+        float v = (x[(i + kWaveSize - 4) % kWaveSize] - sum_mean) * kScale;
+        v = std::min(std::max(v, -32768.0f), 32767.0f);
+        out[i] = static_cast<int16_t>(v);
+    }
+}
+
+int WavetableImporter::Import(StreamSource& source, int16_t* waves, int bank) {
+    if (bank < 0 || bank >= kNumBanks) return 0;
+
+    WavInfo info;
+    if (!ParseWavHeader(source, info) || info.channels != 1) return 0;
+
+    const int available = static_cast<int>(info.data_size / (kWaveSize * sizeof(int16_t)));
+    const int num_waves = available < kWavesPerBank ? available : kWavesPerBank;
+
+    int16_t cycle[kWaveSize];
+    int16_t* destination = waves + bank * kWavesPerBank * kWaveStride;
+    for (int w = 0; w < num_waves; ++w) {
+        if (source.Read(cycle, sizeof(cycle)) != sizeof(cycle)) return w;
+        Integrate(cycle, destination + w * kWaveStride);
+    }
+    return num_waves;
+}
+
+// --- SampleStreamer ---
+
+void SampleStreamer::Init(int16_t* ring, float output_rate) {
+    ring_ = ring;
+    output_rate_ = output_rate;
+    source_ = nullptr;
+    playing_ = false;
+    looping_ = true;
+    level_ = 1.0f;
+    underruns_ = 0;
+    half_ready_[0] = half_ready_[1] = false;
+    end_of_file_ = true;
+}
+
+bool SampleStreamer::Open(StreamSource* source, uint32_t start_frame) {
+    Close();
+    if (!ParseWavHeader(*source, info_) || info_.sample_rate == 0) return false;
+
+    source_ = source;
+    step_ = static_cast<float>(info_.sample_rate) / output_rate_;
+    // Two frames in before the first output sample
+    phase_ = 2.0f;
+    previous_ = next_ = 0;
+
+    return Restart(start_frame);
+}
+
+bool SampleStreamer::Restart(uint32_t start_frame) {
+    if (!source_) return false;
+
+    half_ready_[0] = half_ready_[1] = false;
+    fill_half_ = 0;
+    read_half_ = 0;
+    read_pos_ = 0;
+
+    const uint32_t offset = start_frame * info_.channels * sizeof(int16_t);
+    if (offset >= info_.data_size || !source_->Seek(info_.data_offset + offset)) {
+        end_of_file_ = true;
+        return false;
+    }
+    bytes_left_ = info_.data_size - offset;
+    end_of_file_ = false;
+
+    // Pre-fill both halves so playback can start straight away.
+    Service();
+    return half_ready_[0];
+}
+
+void SampleStreamer::Close() {
+    playing_ = false;
+    source_ = nullptr;
+    half_ready_[0] = half_ready_[1] = false;
+}
+
+bool SampleStreamer::FillHalf(int half) {
+    uint8_t* destination = reinterpret_cast<uint8_t*>(ring_ + half * kHalfSize);
+    const size_t wanted = kHalfSize * sizeof(int16_t);
+    size_t got = 0;
+
+    while (got < wanted) {
+        if (bytes_left_ == 0) {
+            if (!looping_ || !source_->Seek(info_.data_offset)) {
+                end_of_file_ = true;
+                break;
+            }
+            bytes_left_ = info_.data_size;
+        }
+        const size_t chunk = std::min(wanted - got, static_cast<size_t>(bytes_left_));
+        const size_t read = source_->Read(destination + got, chunk);
+        if (read == 0) {
+            // Truncated file or card error: play out what we have.
+            end_of_file_ = true;
+            break;
+        }
+        got += read;
+        bytes_left_ -= read;
+    }
+
+    // Whole frames only, so a stereo pair never straddles the two halves.
+    size_t samples = got / sizeof(int16_t);
+    samples -= samples % info_.channels;
+    if (samples == 0) return false;
+
+    valid_[half] = samples;
+    // The sample data has to be in place before the callback sees the flag.
+    std::atomic_signal_fence(std::memory_order_release);
+    half_ready_[half] = true;
+    return true;
+}
+
+bool SampleStreamer::Service() {
+    if (!source_) return false;
+
+    bool did_read = false;
+    while (!half_ready_[fill_half_] && !end_of_file_) {
+        if (!FillHalf(fill_half_)) break;
+        fill_half_ ^= 1;
+        did_read = true;
+    }
+    if (end_of_file_ && !half_ready_[0] && !half_ready_[1]) {
+        playing_ = false;
+    }
+    return did_read;
+}
+
+// Audio callback only. False on an underrun or at the end of the file.
+bool SampleStreamer::ReadFrame(int32_t* frame) {
+    if (!half_ready_[read_half_]) {
+        // Main loop fell behind (or the file ended)
+        if (!end_of_file_) ++underruns_;
+        return false;
+    }
+    std::atomic_signal_fence(std::memory_order_acquire);
+    const int16_t* samples = ring_ + read_half_ * kHalfSize + read_pos_;
+    *frame = samples[0];
+    if (info_.channels == 2) *frame += samples[1];
+
+    read_pos_ += info_.channels;
+    if (read_pos_ >= valid_[read_half_]) {
+        half_ready_[read_half_] = false;
+        read_half_ ^= 1;
+        read_pos_ = 0;
+    }
+    return true;
+}
+
+void SampleStreamer::Render(float* out, size_t size) {
+    if (!playing_) return;
+
+    const float scale = level_ / (32768.0f * info_.channels);
+    for (size_t i = 0; i < size; ++i) {
+        while (phase_ >= 1.0f) {
+            int32_t frame;
+            if (!ReadFrame(&frame)) return; // Skip the rest of the block
+            previous_ = next_;
+            next_ = frame;
+            phase_ -= 1.0f;
+        }
+        // At the output rate phase_ stays 0: the frames come out unchanged
+        const float a = static_cast<float>(previous_);
+        const float b = static_cast<float>(next_);
+        out[i] += (a + (b - a) * phase_) * scale;
+        phase_ += step_;
+    }
+}
+
+// --- SampleVoice ---
+
+void SampleVoice::Init(int16_t* head, int16_t* ring, float output_rate) {
+    head_ = head;
+    ring_ = ring;
+    output_rate_ = output_rate;
+    streamer_.Init(ring, output_rate);
+    loaded_ = false;
+    playing_ = false;
+    pending_ = false;
+    generation_ = serviced_ = 0;
+    head_frames_ = num_frames_ = 0;
+    gain_ = gain_target_ = 0.0f;
+    level_ = 1.0f;
+    underruns_ = 0;
+}
+
+bool SampleVoice::Open(StreamSource* source) {
+    Close();
+    WavInfo info;
+    if (!ParseWavHeader(*source, info) || info.sample_rate == 0) return false;
+
+    const size_t frame_bytes = info.channels * sizeof(int16_t);
+    num_frames_ = info.data_size / frame_bytes;
+    head_frames_ = std::min(num_frames_, static_cast<uint32_t>(kHeadSize / info.channels));
+
+    // Load the head through the ring, a half at a time
+    uint8_t* head = reinterpret_cast<uint8_t*>(head_);
+    const size_t head_bytes = head_frames_ * frame_bytes;
+    const size_t half_bytes = SampleStreamer::kHalfSize * sizeof(int16_t);
+    for (size_t done = 0; done < head_bytes; ) {
+        const size_t chunk = std::min(half_bytes, head_bytes - done);
+        if (source->Read(ring_, chunk) != chunk) return false;
+        memcpy(head + done, ring_, chunk);
+        done += chunk;
+    }
+
+    // The stream picks up where the head ends (nothing left for short files)
+    streamer_.SetLooping(false);
+    if (!streamer_.Open(source, head_frames_) && head_frames_ < num_frames_) return false;
+    generation_ = serviced_ = 0;
+    loaded_ = true;
+    return true;
+}
+
+void SampleVoice::Close() {
+    loaded_ = false;
+    playing_ = false;
+    pending_ = false;
+    streamer_.Close();
+}
+
+bool SampleVoice::Service() {
+    if (!loaded_) return false;
+
+    const uint32_t generation = generation_;
+    if (generation != serviced_) {
+        // The callback is playing the head of a newer note and leaves the
+        // ring alone until serviced_ catches up.
+        if (head_frames_ < num_frames_) {
+            streamer_.Restart(head_frames_);
+        }
+        std::atomic_signal_fence(std::memory_order_release);
+        serviced_ = generation;
+        return true;
+    }
+    return streamer_.Service();
+}
+
+void SampleVoice::NoteOn(float note) {
+    if (!loaded_) return;
+    pending_step_ = static_cast<float>(streamer_.file_rate()) / output_rate_ *
+        powf(2.0f, (note - kRootNote) / 12.0f);
+    pending_ = true;
+    if (!playing_ || gain_ == 0.0f) {
+        Start();
+    } else {
+        // Fade the sounding note out first
+        gain_target_ = 0.0f;
+    }
+}
+
+void SampleVoice::NoteOff() {
+    pending_ = false;
+    gain_target_ = 0.0f;
+}
+
+void SampleVoice::Start() {
+    pending_ = false;
+    step_ = pending_step_;
+    phase_ = 2.0f;
+    previous_ = next_ = 0;
+    head_pos_ = 0;
+    gain_ = 0.0f;
+    gain_target_ = 1.0f;
+    ++generation_;
+    playing_ = true;
+}
+
+// From the head, then from the stream once Service() has rewound it for this
+// note. False at the end of the file or on an underrun.
+bool SampleVoice::ReadFrame(int32_t* frame) {
+    const int channels = streamer_.info().channels;
+    if (head_pos_ < head_frames_) {
+        const int16_t* samples = head_ + head_pos_ * channels;
+        *frame = samples[0];
+        if (channels == 2) *frame += samples[1];
+        ++head_pos_;
+        return true;
+    }
+    if (head_frames_ == num_frames_) {
+        return false;
+    }
+    if (serviced_ != generation_) {
+        // The main loop has not rewound the stream for this note yet
+        ++underruns_;
+        return false;
+    }
+    std::atomic_signal_fence(std::memory_order_acquire);
+    return streamer_.ReadFrame(frame);
+}
+
+// The note has played up to the end of the file
+bool SampleVoice::PlayedOut() const {
+    if (head_frames_ == num_frames_) {
+        return head_pos_ == num_frames_;
+    }
+    return serviced_ == generation_ && streamer_.finished();
+}
+
+void SampleVoice::Render(float* out, size_t size) {
+    if (!playing_) return;
+
+    const float scale = level_ / (32768.0f * streamer_.info().channels);
+    const float ramp = 1.0f / kRampSamples;
+    for (size_t i = 0; i < size; ++i) {
+        while (phase_ >= 1.0f) {
+            int32_t frame;
+            if (!ReadFrame(&frame)) {
+                // Played out, or the main loop is behind: skip the rest of the block
+                if (PlayedOut()) {
+                    playing_ = false;
+                }
+                return;
+            }
+            previous_ = next_;
+            next_ = frame;
+            phase_ -= 1.0f;
+        }
+        if (gain_ < gain_target_) {
+            gain_ = std::min(gain_ + ramp, gain_target_);
+        } else if (gain_ > gain_target_) {
+            gain_ = std::max(gain_ - ramp, gain_target_);
+            if (gain_ == 0.0f) {
+                if (!pending_) {
+                    playing_ = false;
+                    return;
+                }
+                Start();
+                continue;
+            }
+        }
+        const float a = static_cast<float>(previous_);
+        const float b = static_cast<float>(next_);
+        out[i] += (a + (b - a) * phase_) * scale * gain_;
+        phase_ += step_;
+    }
+}
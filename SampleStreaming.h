@@ -0,0 +1,288 @@
+#pragma once
+#ifndef SAMPLE_STREAMING_H
+#define SAMPLE_STREAMING_H
+
+#include <cstddef>
+#include <cstdint>
+#if !defined(__arm__)
+#include <cstdio>
+#endif
+
+// Storage-agnostic building blocks for SD wavetables, sample streaming and
+// recording (AudioRecorder.h). Nothing in here talks to FatFS directly: the
+// device build hands in an SdFileSource / SdFileSink (SdStorage.h) whose
+// transfers go straight between the caller's buffer and SDMMC DMA, host
+// builds can use the FileStreamSource / FileStreamSink stand-ins below.
+
+// Sequential, seekable byte source (one open file).
+class StreamSource {
+public:
+    virtual ~StreamSource() {}
+    virtual bool Open(const char* path) = 0;
+    virtual void Close() = 0;
+    virtual bool Seek(uint32_t offset) = 0;
+    // Returns the number of bytes actually read (short at end of file).
+    virtual size_t Read(void* dst, size_t bytes) = 0;
+};
+
+// Sequential, seekable byte sink (one file open for writing).
+class StreamSink {
+public:
+    virtual ~StreamSink() {}
+    // Creates or truncates the file.
+    virtual bool Open(const char* path) = 0;
+    virtual void Close() = 0;
+    virtual bool Seek(uint32_t offset) = 0;
+    // Returns the number of bytes actually written (short when the card is full).
+    virtual size_t Write(const void* src, size_t bytes) = 0;
+    // Commits what was written so far to the medium.
+    virtual bool Sync() = 0;
+};
+
+#if !defined(__arm__)
+// Host stand-in for the SD card: a plain stdio file.
+class FileStreamSource : public StreamSource {
+public:
+    FileStreamSource() : file_(nullptr) {}
+    ~FileStreamSource() { Close(); }
+
+    bool Open(const char* path) override {
+        Close();
+        file_ = fopen(path, "rb");
+        return file_ != nullptr;
+    }
+    void Close() override {
+        if (file_) fclose(file_);
+        file_ = nullptr;
+    }
+    bool Seek(uint32_t offset) override {
+        return file_ && fseek(file_, static_cast<long>(offset), SEEK_SET) == 0;
+    }
+    size_t Read(void* dst, size_t bytes) override {
+        return file_ ? fread(dst, 1, bytes, file_) : 0;
+    }
+
+private:
+    FILE* file_;
+};
+
+class FileStreamSink : public StreamSink {
+public:
+    FileStreamSink() : file_(nullptr) {}
+    ~FileStreamSink() { Close(); }
+
+    bool Open(const char* path) override {
+        Close();
+        file_ = fopen(path, "wb");
+        return file_ != nullptr;
+    }
+    void Close() override {
+        if (file_) fclose(file_);
+        file_ = nullptr;
+    }
+    bool Seek(uint32_t offset) override {
+        return file_ && fseek(file_, static_cast<long>(offset), SEEK_SET) == 0;
+    }
+    size_t Write(const void* src, size_t bytes) override {
+        return file_ ? fwrite(src, 1, bytes, file_) : 0;
+    }
+    bool Sync() override {
+        return file_ && fflush(file_) == 0;
+    }
+
+private:
+    FILE* file_;
+};
+#endif
+
+// The parts of a RIFF/WAVE header the streamer and importer care about.
+struct WavInfo {
+    uint16_t format;          // 1 = PCM
+    uint16_t channels;
+    uint32_t sample_rate;
+    uint16_t bits_per_sample;
+    uint32_t data_offset;     // Byte offset of the first sample
+    uint32_t data_size;       // Bytes of sample data
+};
+
+// Walks the chunk list up to "data". Only 16-bit PCM is accepted.
+bool ParseWavHeader(StreamSource& source, WavInfo& info);
+
+// Imports single-cycle waves into Plaits' wavetable layout (wav_integrated_waves):
+// 256 samples per cycle, stored integrated (running sum) with 4 guard samples.
+// The wavetable engine differentiates on playback with a pitch-dependent
+// smoothing filter, which is how Plaits band-limits its tables; integrating at
+// import time gives user waves the same treatment as the built-in ones.
+class WavetableImporter {
+public:
+    static const size_t kWaveSize = 256;
+    static const size_t kWaveStride = kWaveSize + 4;
+    static const int kWavesPerBank = 64;   // 8x8 grid, one wavetable engine bank
+    static const int kNumBanks = 3;        // The engine addresses 192 waves
+
+    // Reads consecutive 256-sample cycles from a 16-bit mono WAV into the given
+    // bank, replacing up to 64 waves. Returns the number of waves imported.
+    int Import(StreamSource& source, int16_t* waves, int bank);
+
+    // Normalises one cycle and writes it in integrated form (kWaveStride samples).
+    static void Integrate(const int16_t* cycle, int16_t* out);
+};
+
+// Double-buffered int16 ring for streaming long WAVs.
+// The ring is split in two halves. The audio callback only ever reads from a
+// half that is marked ready; Service() runs from the main loop, refills
+// whichever half the callback has released and marks it ready again. The
+// callback never touches the source, so SD latency can only ever cost an
+// underrun (silence), never a late audio block.
+//
+// Files at another rate than the output are resampled on the way out, with
+// linear interpolation; a 44.1/48 kHz file keeps some aliasing above 16 kHz.
+class SampleStreamer {
+public:
+    // Samples (not frames) per half. 2 x 4 KB halves give ~64 ms of mono
+    // 32 kHz audio per refill.
+    static const size_t kHalfSize = 2048;
+    static const size_t kRingSize = 2 * kHalfSize;
+
+    SampleStreamer() : source_(nullptr), ring_(nullptr), playing_(false) {}
+
+    // ring must hold kRingSize samples and be reachable by the SD DMA.
+    void Init(int16_t* ring, float output_rate);
+
+    // Main loop only. Parses the header and pre-fills both halves, starting
+    // start_frame frames into the sample data.
+    bool Open(StreamSource* source, uint32_t start_frame = 0);
+    // Main loop only, while the callback is not reading (see SampleVoice):
+    // drops both halves and refills them from start_frame on.
+    bool Restart(uint32_t start_frame);
+    // Of the open file.
+    uint32_t file_rate() const { return info_.sample_rate; }
+    const WavInfo& info() const { return info_; }
+    void Close();
+
+    void SetLooping(bool looping) { looping_ = looping; }
+    void SetLevel(float level) { level_ = level; }
+    void Start() { playing_ = source_ != nullptr; }
+    void Stop() { playing_ = false; }
+    bool IsPlaying() const { return playing_; }
+
+    // Main loop only. Refills released halves; returns true if it read.
+    bool Service();
+
+    // Audio callback only. Adds size mono samples at the output rate (stereo
+    // files are summed) scaled to [-level, level] into out.
+    void Render(float* out, size_t size);
+
+    // Audio callback only. The next frame at the file's rate, channels summed;
+    // false on an underrun or at the end of the file.
+    bool ReadFrame(int32_t* frame);
+    // Every frame up to the end of the file has been read.
+    bool finished() const { return end_of_file_ && !half_ready_[0] && !half_ready_[1]; }
+
+    uint32_t underruns() const { return underruns_; }
+
+private:
+    bool FillHalf(int half);
+
+    StreamSource* source_;
+    WavInfo info_;
+    int16_t* ring_;
+
+    // Written by Service() after the half's data, cleared by Render() once the
+    // half has been played out.
+    volatile bool half_ready_[2];
+    volatile bool playing_;
+    volatile uint32_t underruns_;
+
+    bool looping_;
+    volatile bool end_of_file_;
+    uint32_t bytes_left_;
+    int fill_half_;
+
+    // Callback-owned read position
+    int read_half_;
+    size_t read_pos_;
+    size_t valid_[2];
+    float level_;
+
+    float output_rate_;
+    float step_;                // File frames per output sample
+    float phase_;               // Between previous_ and next_, in frames
+    int32_t previous_;
+    int32_t next_;
+};
+
+// The sample engine: a WAV from the card played from the pads, one note at a
+// time. A note restarts the file at the pad's pitch (kRootNote plays it as
+// recorded) and plays it once; releasing the pads fades it out.
+//
+// The first kHeadSize samples are loaded at Open() and stay in memory, so a
+// note starts on the block it is played. The rest streams through a
+// SampleStreamer: on each note the main loop seeks the stream back to the end
+// of the head and refills the ring while the head plays. The callback only
+// moves on to the ring once Service() has caught up with the latest note.
+class SampleVoice {
+public:
+    static const size_t kHeadSize = 16384;          // Samples, 0.5 s of mono 32 kHz
+    static constexpr float kRootNote = 48.0f;       // C3
+    static const size_t kRampSamples = 64;          // Note on / off declick
+
+    SampleVoice() : head_frames_(0), loaded_(false), playing_(false) {}
+
+    // head holds kHeadSize samples; ring as for SampleStreamer::Init.
+    void Init(int16_t* head, int16_t* ring, float output_rate);
+
+    // Main loop only. Parses the header, loads the head (through the ring, so
+    // that only the ring needs to be reachable by DMA) and primes the stream.
+    bool Open(StreamSource* source);
+    void Close();
+    bool loaded() const { return loaded_; }
+    uint32_t file_rate() const { return streamer_.file_rate(); }
+
+    // Main loop only. Seeks the stream after a note, refills the ring.
+    bool Service();
+
+    // Audio callback only.
+    void NoteOn(float note);
+    void NoteOff();
+    bool IsPlaying() const { return playing_; }
+    // Adds size mono samples scaled to [-level, level] into out.
+    void Render(float* out, size_t size);
+
+    void SetLevel(float level) { level_ = level; }
+    uint32_t underruns() const { return streamer_.underruns() + underruns_; }
+
+private:
+    void Start();
+    bool ReadFrame(int32_t* frame);
+    bool PlayedOut() const;
+
+    SampleStreamer streamer_;
+    int16_t* head_;
+    int16_t* ring_;
+    float output_rate_;
+    uint32_t head_frames_;
+    uint32_t num_frames_;
+    bool loaded_;
+
+    // A note bumps generation_; Service() sets serviced_ to it once the stream
+    // is back at the end of the head.
+    volatile uint32_t generation_;
+    volatile uint32_t serviced_;
+
+    // Callback-owned
+    volatile bool playing_;
+    bool pending_;              // A note waits for the previous one to fade out
+    float pending_step_;
+    uint32_t head_pos_;         // Frames read from the head
+    float step_;
+    float phase_;
+    int32_t previous_;
+    int32_t next_;
+    float gain_;
+    float gain_target_;
+    float level_;
+    volatile uint32_t underruns_;
+};
+
+#endif // SAMPLE_STREAMING_H
@@ -0,0 +1,92 @@
+#include "SdStorage.h"
+
+#ifdef USE_SD_CARD
+
+#include <cstdio>
+
+using namespace daisy;
+
+static SdmmcHandler sdmmc;
+static FatFSInterface fatfs_interface;
+static bool mounted = false;
+
+bool SdFileSource::Open(const char* path) {
+    Close();
+    open_ = f_open(&file_, path, FA_READ | FA_OPEN_EXISTING) == FR_OK;
+    return open_;
+}
+
+void SdFileSource::Close() {
+    if (open_) f_close(&file_);
+    open_ = false;
+}
+
+bool SdFileSource::Seek(uint32_t offset) {
+    return open_ && f_lseek(&file_, offset) == FR_OK;
+}
+
+size_t SdFileSource::Read(void* dst, size_t bytes) {
+    UINT read = 0;
+    if (!open_ || f_read(&file_, dst, bytes, &read) != FR_OK) return 0;
+    return read;
+}
+
+bool SdFileSink::Open(const char* path) {
+    Close();
+    open_ = f_open(&file_, path, FA_WRITE | FA_CREATE_ALWAYS) == FR_OK;
+    return open_;
+}
+
+void SdFileSink::Close() {
+    if (open_) f_close(&file_);
+    open_ = false;
+}
+
+bool SdFileSink::Seek(uint32_t offset) {
+    return open_ && f_lseek(&file_, offset) == FR_OK;
+}
+
+size_t SdFileSink::Write(const void* src, size_t bytes) {
+    UINT written = 0;
+    if (!open_ || f_write(&file_, src, bytes, &written) != FR_OK) return 0;
+    return written;
+}
+
+bool SdFileSink::Sync() {
+    return open_ && f_sync(&file_) == FR_OK;
+}
+
+namespace SdStorage {
+
+bool Init() {
+    SdmmcHandler::Config sd_cfg;
+    sd_cfg.Defaults();
+    sd_cfg.speed = SdmmcHandler::Speed::STANDARD;
+    if (sdmmc.Init(sd_cfg) != SdmmcHandler::Result::OK) return false;
+
+    FatFSInterface::Config fs_cfg;
+    fs_cfg.media = FatFSInterface::Config::MEDIA_SD;
+    if (fatfs_interface.Init(fs_cfg) != FatFSInterface::Result::OK) return false;
+
+    mounted = f_mount(&fatfs_interface.GetSDFileSystem(), fatfs_interface.GetSDPath(), 1) == FR_OK;
+    return mounted;
+}
+
+bool IsMounted() {
+    return mounted;
+}
+
+const char* Path(const char* name) {
+    static char path[64];
+    snprintf(path, sizeof(path), "%s%s", fatfs_interface.GetSDPath(), name);
+    return path;
+}
+
+bool Exists(const char* name) {
+    FILINFO info;
+    return f_stat(Path(name), &info) == FR_OK;
+}
+
+} // namespace SdStorage
+
+#endif // USE_SD_CARD
@@ -0,0 +1,59 @@
+#pragma once
+#ifndef SD_STORAGE_H
+#define SD_STORAGE_H
+
+#ifdef USE_SD_CARD
+
+#include "daisy_seed.h"
+#include "fatfs.h"
+#include "SampleStreaming.h"
+
+// FatFS-backed StreamSource. f_read hands sector-sized transfers straight to
+// the SDMMC IDMA, so destination buffers should live in AXI SRAM (plain .bss),
+// not DTCM, and be 32-byte aligned for the cache maintenance in sd_diskio.
+class SdFileSource : public StreamSource {
+public:
+    SdFileSource() : open_(false) {}
+
+    bool Open(const char* path) override;
+    void Close() override;
+    bool Seek(uint32_t offset) override;
+    size_t Read(void* dst, size_t bytes) override;
+
+private:
+    FIL file_;
+    bool open_;
+};
+
+// FatFS-backed StreamSink. Writes of whole sectors at sector-aligned file
+// offsets go straight from the caller's buffer to the SDMMC IDMA, with the same
+// placement and alignment rules as SdFileSource.
+class SdFileSink : public StreamSink {
+public:
+    SdFileSink() : open_(false) {}
+
+    bool Open(const char* path) override;
+    void Close() override;
+    bool Seek(uint32_t offset) override;
+    size_t Write(const void* src, size_t bytes) override;
+    bool Sync() override;
+
+private:
+    FIL file_;
+    bool open_;
+};
+
+// NOTE: SDMMC1 uses seed pins D1-D6, which normally drive six of the pad
+// LEDs; builds with USE_SD_CARD leave those LEDs dark (see TouchLedAvailable).
+namespace SdStorage {
+    // Initialises SDMMC1 (4-bit) and mounts the card. Returns false if no card.
+    bool Init();
+    bool IsMounted();
+    // Prefixes a file name with the SD volume ("0:/").
+    const char* Path(const char* name);
+    bool Exists(const char* name);
+}
+
+#endif // USE_SD_CARD
+
+#endif // SD_STORAGE_H
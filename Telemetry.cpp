@@ -0,0 +1,105 @@
+#include "Telemetry.h"
+#include "DeadlineMonitor.h"
+#include "daisy_seed.h"
+#include "hid/logger_impl.h"
+#include <atomic>
+#include <cstring>
+
+using namespace daisy;
+
+Telemetry telemetry;
+
+void EnableCycleCounter() {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->LAR = 0xC5ACCE55; // The M7 DWT is locked after reset
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+void Telemetry::Init(uint32_t blocks_per_frame, uint32_t drain_interval_ms) {
+    write_index_ = 0;
+    read_index_ = 0;
+    blocks_per_frame_ = blocks_per_frame > 0 ? blocks_per_frame : 1;
+    block_counter_ = 0;
+    sequence_ = 0;
+    dropped_ = 0;
+    drain_interval_ms_ = drain_interval_ms;
+    last_drain_ms_ = 0;
+}
+
+bool Telemetry::FrameDue() {
+    if (++block_counter_ < blocks_per_frame_) return false;
+    block_counter_ = 0;
+    return true;
+}
+
+void Telemetry::Push(TelemetryFrame& frame) {
+    frame.sequence = sequence_++;
+    const uint32_t write = write_index_;
+    if (write - read_index_ >= kRingSize) {
+        // Main loop isn't keeping up; the gap shows in sequence and dropped.
+        ++dropped_;
+        return;
+    }
+    frame.dropped = dropped_;
+    ring_[write & (kRingSize - 1)] = frame;
+    std::atomic_signal_fence(std::memory_order_release);
+    write_index_ = write + 1;
+}
+
+size_t Telemetry::Encode(uint8_t type, const void* payload, size_t length, uint8_t* buffer) {
+    buffer[0] = 0xA5;
+    buffer[1] = 0x5A;
+    buffer[2] = type;
+    buffer[3] = static_cast<uint8_t>(length);
+    memcpy(buffer + 4, payload, length);
+
+    uint16_t sum1 = 0;
+    uint16_t sum2 = 0;
+    for (size_t i = 0; i < 2 + length; ++i) {
+        sum1 = (sum1 + buffer[2 + i]) % 255;
+        sum2 = (sum2 + sum1) % 255;
+    }
+    buffer[4 + length] = static_cast<uint8_t>(sum1);
+    buffer[5 + length] = static_cast<uint8_t>(sum2);
+    return length + 6;
+}
+
+void Telemetry::Drain(uint32_t now_ms) {
+    if (now_ms - last_drain_ms_ < drain_interval_ms_) return;
+    last_drain_ms_ = now_ms;
+
+    const uint32_t write = write_index_;
+    std::atomic_signal_fence(std::memory_order_acquire);
+    uint32_t read = read_index_;
+
+    size_t size = 0;
+    for (; read != write; ++read) {
+        size += Encode(TELEMETRY_PACKET_STATUS, &ring_[read & (kRingSize - 1)],
+                       sizeof(TelemetryFrame), tx_buffer_ + size);
+    }
+    read_index_ = read;
+
+    DeadlineMonitor::Record record;
+    for (size_t i = 0; i < kMaxEventsPerDrain && deadline_monitor.Pop(record); ++i) {
+        size += Encode(TELEMETRY_PACKET_DEADLINE, &record, sizeof(record), tx_buffer_ + size);
+    }
+
+    // Index first, so the decoder can place the events and spot lost packets
+    alignas(4) uint8_t journal[4 + kJournalEventsPerPacket * sizeof(JournalEvent)];
+    for (size_t i = 0; i < kMaxJournalPacketsPerDrain; ++i) {
+        uint32_t index;
+        size_t count = control_journal.ReadDump(
+            reinterpret_cast<JournalEvent*>(journal + 4), kJournalEventsPerPacket, &index);
+        if (count == 0) break;
+        memcpy(journal, &index, sizeof(index));
+        size += Encode(TELEMETRY_PACKET_JOURNAL, journal, 4 + count * sizeof(JournalEvent), tx_buffer_ + size);
+    }
+    if (size == 0) return;
+
+    // CDC transfers run from tx_buffer_ in the background. One drain interval
+    // is far longer than a 3 KB transfer at full speed, so the buffer is free
+    // again by the next call. If the port is busy or closed the frames are
+    // simply dropped; the decoder sees the sequence gap.
+    LoggerImpl<LOGGER_INTERNAL>::Transmit(tx_buffer_, size);
+}
@@ -0,0 +1,113 @@
+#pragma once
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <cstddef>
+#include <cstdint>
+#include "ControlJournal.h"
+
+// Compact binary status stream over the USB CDC log port.
+// The audio callback fills a fixed-size Frame every few blocks and pushes it
+// into a single-producer/single-consumer ring; the main loop drains the ring at
+// its own pace and ships the frames as framed packets. Nothing is formatted on
+// the device: tools/telemetry_decode.py turns the packets back into text/CSV.
+//
+// Packet: 0xA5 0x5A | type | length | payload[length] | fletcher16 (LE)
+// The checksum covers type, length and payload. Text from hw.PrintLine can be
+// interleaved on the same port; the decoder skips it while resyncing.
+
+// Time-consuming stages of the audio callback, timed with the core cycle counter.
+enum TelemetryStage {
+    STAGE_CONTROLS,   // ProcessUIAndControls
+    STAGE_VOICES,     // Arp/touch handling + Plaits render
+    STAGE_EFFECTS,    // Vocoder insert, Clouds, output conversion
+    STAGE_LAST
+};
+
+enum TelemetryPacketType : uint8_t {
+    TELEMETRY_PACKET_STATUS = 0x01,
+    TELEMETRY_PACKET_DEADLINE = 0x02,   // DeadlineMonitor::Record
+    TELEMETRY_PACKET_JOURNAL = 0x03,    // uint32 index + JournalEvents (ControlJournal.h)
+};
+
+// Little-endian, naturally aligned so it can be sent as-is.
+struct TelemetryFrame {
+    uint32_t sequence;
+    uint32_t timestamp_ms;
+    uint16_t cpu_avg;                     // Load x 1000
+    uint16_t cpu_max;                     // Load x 1000
+    uint32_t stage_cycles[STAGE_LAST];    // Last block, CPU cycles
+    uint16_t touch_state;                 // One bit per pad
+    uint8_t engine;
+    uint8_t voice_active;                 // One bit per voice
+    uint16_t adc[12];                     // Raw ADC, 0-65535
+    uint32_t stream_underruns;            // SampleStreamer underruns
+    uint32_t dropped;                     // Frames lost to a full ring
+    uint32_t deadline_misses;             // DeadlineMonitor totals
+    uint32_t deadline_near_misses;
+};
+
+static_assert(sizeof(TelemetryFrame) == 68, "Telemetry frame layout is part of the wire format");
+
+// Defaults: one frame every 100 blocks (100 ms at 32 kHz / 32), shipped
+// four times a second. Override from the Makefile with C_DEFS.
+#ifndef TELEMETRY_FRAME_BLOCKS
+#define TELEMETRY_FRAME_BLOCKS 100
+#endif
+#ifndef TELEMETRY_DRAIN_MS
+#define TELEMETRY_DRAIN_MS 250
+#endif
+
+// Cycle counter used for stage timing (DWT->CYCCNT, 480 per us on the H750).
+// stm32h7xx.h is force-included by the libDaisy Makefile.
+void EnableCycleCounter();
+inline uint32_t ReadCycleCounter() { return DWT->CYCCNT; }
+
+class Telemetry {
+public:
+    static const size_t kRingSize = 16;   // Power of two
+    static const size_t kMaxPacketSize = 4 + sizeof(TelemetryFrame) + 2;
+    // Deadline records forwarded per drain, on top of the status frames.
+    static const size_t kMaxEventsPerDrain = 8;
+    // A frozen control journal goes out in packets of kJournalEventsPerPacket
+    // events, a few per drain: 16K events take about a minute at the default
+    // drain interval.
+    static const size_t kJournalEventsPerPacket = 20;
+    static const size_t kMaxJournalPacketsPerDrain = 4;
+    static const size_t kMaxJournalPacketSize = 4 + 4 + kJournalEventsPerPacket * sizeof(JournalEvent) + 2;
+
+    // blocks_per_frame: audio blocks between captured frames.
+    // drain_interval_ms: how often the main loop ships queued frames.
+    void Init(uint32_t blocks_per_frame, uint32_t drain_interval_ms);
+    void SetDrainInterval(uint32_t ms) { drain_interval_ms_ = ms; }
+
+    // Audio callback: true once every blocks_per_frame calls.
+    bool FrameDue();
+    // Audio callback: queues a copy of frame (sequence/dropped are filled in).
+    void Push(TelemetryFrame& frame);
+
+    // Main loop: ships everything queued once the drain interval has elapsed.
+    void Drain(uint32_t now_ms);
+
+    // Writes one packet into buffer (up to kMaxPacketSize bytes); returns its size.
+    static size_t Encode(uint8_t type, const void* payload, size_t length, uint8_t* buffer);
+
+private:
+    TelemetryFrame ring_[kRingSize];
+    volatile uint32_t write_index_;    // Audio callback only
+    volatile uint32_t read_index_;     // Main loop only
+
+    uint32_t blocks_per_frame_;
+    uint32_t block_counter_;
+    uint32_t sequence_;
+    uint32_t dropped_;
+
+    uint32_t drain_interval_ms_;
+    uint32_t last_drain_ms_;
+    uint8_t tx_buffer_[(kRingSize + kMaxEventsPerDrain) * kMaxPacketSize
+                       + kMaxJournalPacketsPerDrain * kMaxJournalPacketSize];
+};
+
+extern Telemetry telemetry;
+
+#endif // TELEMETRY_H
@@ -1,45 +1,5 @@
 #include "Thaumazein.h"
 
-// Define shared volatile variables
-volatile uint16_t current_touch_state = 0;
-volatile float touch_cv_value = 0.0f;
-
-void UpdateDisplay() {
-    if (update_display) {
-        // Build stats message in a smaller buffer
-        char msg[512];
-        int pos = 0;
-
-        // cpu load average/max
-        float avg_cpu_load = cpu_meter.GetAvgCpuLoad();
-        int cpu_avg = static_cast<int>(avg_cpu_load * 100.0f);
-        cpu_avg = cpu_avg < 0 ? 0 : (cpu_avg > 100 ? 100 : cpu_avg);
-        float max_cpu_load = cpu_meter.GetMaxCpuLoad();
-        int cpu_max = static_cast<int>(max_cpu_load * 100.0f);
-        cpu_max = cpu_max < 0 ? 0 : (cpu_max > 100 ? 100 : cpu_max);
-        pos += snprintf(msg + pos, sizeof(msg) - pos, "cpu : %d/%d\n", cpu_avg, cpu_max);
-
-        // Engine Info
-        int current_engine_idx = current_engine_index;
-        pos += snprintf(msg + pos, sizeof(msg) - pos, "Engine: %d (%s)\n", current_engine_idx, (current_engine_idx <= 3) ? "Poly-4" : "Mono");
-
-        // Only show ADC values 8-11
-        pos += snprintf(msg + pos, sizeof(msg) - pos, "ADC Values (8-11):\n");
-        for (int i = 8; i < 12; ++i) {
-            pos += snprintf(msg + pos, sizeof(msg) - pos, "[%d]: %d\n", i, static_cast<int>(adc_raw_values[i] * 1000));
-            if(pos >= (int)sizeof(msg) - 20) break; // safety margin
-        }
-
-        // Separator
-        pos += snprintf(msg + pos, sizeof(msg) - pos, "--------");
-
-        // Print once with a single call to avoid throttling
-        hw.PrintLine("%s", msg);
-
-        update_display = false; 
-    }
-}
-
 // Poll the touch sensor and update shared variables
 void PollTouchSensor() {
     if(!touch_sensor_present) {
@@ -65,7 +25,9 @@ void PollTouchSensor() {
         bool padTouched = (touched & (1 << i)) != 0;
         bool blink     = (now - arp_led_timestamps[ledIdx]) < ARP_LED_DURATION_MS;
         bool ledState  = arp_on ? blink : (padTouched || blink);
-        touch_leds[ledIdx].Write(ledState);
+        if (TouchLedAvailable(ledIdx)) {
+            touch_leds[ledIdx].Write(ledState);
+        }
     }
 
     if (touched == 0) {
@@ -125,7 +87,19 @@ int main(void) {
         // Check bootloader condition via ADC touch pads
         Bootload();
         
-        UpdateDisplay();
+        // Ship queued status frames (binary; decode with tools/telemetry_decode.py)
+        telemetry.Drain(hw.system.GetNow());
+
+#ifdef USE_SD_CARD
+        // Refill the sample engine's ring; SD reads never happen in the audio callback
+        sample_voice.Service();
+        // Saves a frozen Clouds buffer / restores it after boot, a slice at a time
+        clouds_snapshot.Service(hw.system.GetNow());
+#endif
+#ifdef RECORD_PERFORMANCE
+        // Write recorded blocks out; the callback only copies them into a ring
+        ServiceRecording();
+#endif
         
         // Poll touch sensor every 5 ms (200 Hz)
         if (hw.system.GetNow() - lastPoll >= 5) {
@@ -133,8 +107,15 @@ int main(void) {
             PollTouchSensor();
         }
         
-        // Yield for system tasks, adjusted for polling interval
-        System::Delay(1); // Shorter delay to allow more frequent polling checks
+        if (idle_detector.idle()) {
+            // Nothing is rendering: sleep until the next interrupt (SysTick
+            // and the audio DMA both fire every millisecond) instead of
+            // spinning. Touch scans keep their 5 ms rate.
+            __WFI();
+        } else {
+            // Yield for system tasks, adjusted for polling interval
+            System::Delay(1); // Shorter delay to allow more frequent polling checks
+        }
     }
     
     return 0;
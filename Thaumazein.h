@@ -7,16 +7,28 @@
 #include "daisysp.h"
 #include "plaits/dsp/voice.h"
 #include "mpr121_daisy.h"
-// #include "Effects/EchoDelay.h"
+#include "Effects/EchoDelay.h"
 #include "VoiceEnvelope.h"
 #include "Effects/reverbsc.h"
+#include "Effects/reverbsc16.h"
 #include "Effects/BiquadFilters.h"
 #include "util/CpuLoadMeter.h"
 #include "stmlib/utils/buffer_allocator.h"
 #include <cmath>
 #include "Arpeggiator.h"
 #include "Polyphony.h"
+#include "ControlPath.h"
 #include "SynthStateStorage.h"
+#include "VocoderInsert.h"
+#include "Telemetry.h"
+#include "DeadlineMonitor.h"
+#include "IdleDetector.h"
+#include "ControlValue.h"
+#include "ControlJournal.h"
+#include "SampleStreaming.h"
+#include "SdStorage.h"
+#include "AudioRecorder.h"
+#include "CloudsSnapshot.h"
 
 // Clouds Integration
 #include "clouds/dsp/granular_processor.h"
@@ -48,11 +60,14 @@ void ProcessControls();
 void ReadKnobValues();
 void UpdateEngineSelection();
 void UpdateArpeggiatorToggle();
+#ifdef RECORD_PERFORMANCE
+void ServiceRecording();
+#endif
 
 
 extern DaisySeed hw;
 extern thaumazein_hal::Mpr121 touch_sensor;
-// extern EchoDelay<48000> delay;
+extern EchoDelay delay;
 extern CpuLoadMeter cpu_meter;
 
 
@@ -70,35 +85,24 @@ extern AnalogControl model_next_pad;        // ADC 10 (Pin 25) Model Select Next
 extern AnalogControl mod_wheel;             // ADC 11 (Pin 28) Mod Wheel Control
 
 
-extern Arpeggiator arp;
-extern volatile bool arp_enabled;
+// Control inputs, knob values, arp and engine state: ControlPath.h
 
-
-extern float sample_rate;
-extern volatile bool update_display;
 extern volatile float smoothed_output_level;
-extern const int MAX_ENGINE_INDEX;
-
-// Shared buffer
-extern char shared_buffer[262144];
-
-// Shared touch sensor data (polled in main loop)
-extern volatile uint16_t current_touch_state; 
-extern volatile float touch_cv_value; 
-
-extern volatile int current_engine_index;
-extern volatile bool engine_changed_flag;
-
-extern volatile float adc_raw_values[12]; // Array to hold raw values for all 12 ADCs
-
-// Extern declarations for global knob values
-extern float pitch_val, harm_knob_val, timbre_knob_val, morph_knob_val;
-extern float delay_time_val, delay_mix_feedback_val, delay_mix_val, delay_feedback_val;
-extern float env_attack_val, env_release_val;
 
 // Add extern declaration for touch pad LED GPIOs
 extern daisy::GPIO touch_leds[12];
 
+// With the SD card enabled, seed pins D1-D6 belong to SDMMC1, so the last six
+// pad LEDs (led_pins[6..11]) are never configured and must not be written.
+inline bool TouchLedAvailable(int led_idx) {
+#ifdef USE_SD_CARD
+    return led_idx < 6;
+#else
+    (void)led_idx;
+    return true;
+#endif
+}
+
 // Add extern declarations for ARP LED blink timestamps and duration
 extern volatile uint32_t arp_led_timestamps[12];
 extern const uint32_t ARP_LED_DURATION_MS;
@@ -108,9 +112,54 @@ extern bool touch_sensor_present;
 extern PolyphonyEngine poly_engine;
 
 // Clouds Integration
-extern clouds::GranularProcessor clouds_processor;
 DSY_SDRAM_BSS extern uint8_t cloud_buffer[118784];
 DSY_SDRAM_BSS extern uint8_t cloud_buffer_ccm[65408];
+// Grain read windows are staged here each block (about 40 stereo grains at
+// unity pitch); grains that do not fit read SDRAM directly.
+const size_t kCloudsGrainStagingSize = 4096;
+DTCM_MEM_SECTION extern float clouds_grain_staging[kCloudsGrainStagingSize];
 // End Clouds Integration
 
+// Echo delay line, 16-bit in SDRAM (DelayEffect.cpp)
+DSY_SDRAM_BSS extern int16_t delay_buffer[MAX_DELAY_SAMPLES];
+
+#ifdef POST_REVERB
+// ReverbSc after Clouds (takes over from the Clouds reverb). 16-bit lines
+// from an SDRAM arena; 64 KB covers sample rates up to 48 kHz.
+extern ReverbSc16 post_reverb;
+const size_t kPostReverbBufferSize = 65536;
+DSY_SDRAM_BSS extern uint8_t post_reverb_buffer[kPostReverbBufferSize];
+extern float post_reverb_mix;
+#endif
+
+// Control journal ring (ControlJournal.h), 192 KB in SDRAM: at a few events
+// per block while playing that is well over the keyframe interval.
+const size_t kControlJournalSize = 16384;
+DSY_SDRAM_BSS extern JournalEvent control_journal_events[kControlJournalSize];
+
+// Vocoder insert between the voice mix and Clouds
+extern VocoderInsert vocoder_insert;
+
+#ifdef USE_SD_CARD
+// Buffers of the sample engine's voice (sample_voice, serviced in main loop)
+extern int16_t sample_stream_ring[SampleStreamer::kRingSize];
+DSY_SDRAM_BSS extern int16_t sample_head[SampleVoice::kHeadSize];
+// Frozen Clouds buffer saved to / restored from the card (serviced in main loop)
+extern CloudsSnapshot clouds_snapshot;
+#endif
+
+#ifdef RECORD_PERFORMANCE
+// Takes recorded to the SD card (AudioRecorder.h): the final stereo output as
+// 32-bit float and, with RECORD_DRY, the 16-bit Clouds input. The rings hold
+// about a second each; SDMMC1's IDMA reaches SDRAM through the AXI bus.
+const size_t kRecorderBlockBytes = BLOCK_SIZE * 2 * sizeof(float);
+extern AudioRecorder recorder;
+DSY_SDRAM_BSS extern uint8_t recorder_ring[AudioRecorder::kRingBlocks * kRecorderBlockBytes];
+#ifdef RECORD_DRY
+const size_t kDryRecorderBlockBytes = BLOCK_SIZE * sizeof(clouds::ShortFrame);
+extern AudioRecorder dry_recorder;
+DSY_SDRAM_BSS extern uint8_t dry_recorder_ring[AudioRecorder::kRingBlocks * kDryRecorderBlockBytes];
+#endif
+#endif
+
 #endif // THAUMAZEIN_H_ 
\ No newline at end of file
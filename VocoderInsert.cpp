@@ -0,0 +1,57 @@
+#include "VocoderInsert.h"
+#include <algorithm>
+
+void VocoderInsert::Init(float sample_rate) {
+    vocoder_.Init(sample_rate);
+    vocoder_.set_release_time(0.5f);
+    vocoder_.set_formant_shift(0.5f);
+    mix_ = 1.0f;
+    ClearChunks();
+}
+
+void VocoderInsert::SetSource(Source source) {
+    if (source == source_) return;
+    // Drop whatever was half-collected for the previous source so the first
+    // chunk after a switch doesn't replay stale audio.
+    ClearChunks();
+    source_ = source;
+}
+
+void VocoderInsert::SetMix(float value) {
+    mix_ = std::min(std::max(value, 0.0f), 1.0f);
+}
+
+void VocoderInsert::ClearChunks() {
+    fill_ = 0;
+    std::fill(modulator_chunk_, modulator_chunk_ + kChunkSize, 0.0f);
+    std::fill(carrier_chunk_, carrier_chunk_ + kChunkSize, 0.0f);
+    std::fill(dry_chunk_, dry_chunk_ + kChunkSize, 0.0f);
+    std::fill(wet_chunk_, wet_chunk_ + kChunkSize, 0.0f);
+}
+
+void VocoderInsert::Process(const float* modulator, const float* carrier, float* out, size_t size) {
+    if (source_ == SOURCE_OFF) {
+        if (out != carrier) {
+            std::copy(carrier, carrier + size, out);
+        }
+        return;
+    }
+
+    // Fixed kChunkSize-sample pipeline: collect one chunk while playing back
+    // the previous one, so the audio block size doesn't need to be a multiple
+    // of 12. The dry path is delayed by the same amount to keep the mix aligned.
+    for (size_t i = 0; i < size; ++i) {
+        modulator_chunk_[fill_] = modulator[i];
+        carrier_chunk_[fill_] = carrier[i];
+
+        float dry = dry_chunk_[fill_];
+        float wet = wet_chunk_[fill_];
+        out[i] = dry + (wet - dry) * mix_;
+
+        if (++fill_ == kChunkSize) {
+            std::copy(carrier_chunk_, carrier_chunk_ + kChunkSize, dry_chunk_);
+            vocoder_.Process(modulator_chunk_, carrier_chunk_, wet_chunk_, kChunkSize);
+            fill_ = 0;
+        }
+    }
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include <algorithm>
+#include <cmath>
 
 // Simple envelope for each polyphonic voice
 class VoiceEnvelope {
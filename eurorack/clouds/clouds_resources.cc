@@ -506,7 +506,7 @@ const float lut_sin[] = {
    9.996988187e-01,  9.998305818e-01,  9.999247018e-01,  9.999811753e-01,
    1.000000000e+00,
 };
-const float lut_window[] = {
+const float lut_window_flash[] = {
    0.000000000e+00,  1.470685589e-07,  5.882741491e-07,  1.323616511e-06,
    2.353095212e-06,  3.676709646e-06,  5.294459036e-06,  7.206342428e-06,
    9.412358699e-06,  1.191250655e-05,  1.470678451e-05,  1.779519094e-05,
@@ -1547,7 +1547,7 @@ const float lut_xfade_out[] = {
    2.603033675e-01,  1.919373828e-01,  1.215722327e-01,  4.994082069e-02,
    4.329780281e-17,
 };
-const float lut_sine_window_4096[] = {
+const float lut_sine_window_4096_flash[] = {
    0.000000000e+00,  1.725808584e-04,  4.103438160e-04,  6.809730624e-04,
    9.753747396e-04,  1.288775731e-03,  1.618163527e-03,  1.961437906e-03,
    2.317038924e-03,  2.683755658e-03,  3.060616964e-03,  3.446824198e-03,
@@ -2970,10 +2970,10 @@ const float lut_quantized_pitch[] = {
 
 const float* lookup_table_table[] = {
   lut_sin,
-  lut_window,
+  lut_window_flash,
   lut_xfade_in,
   lut_xfade_out,
-  lut_sine_window_4096,
+  lut_sine_window_4096_flash,
   lut_cutoff,
   lut_grain_size,
   lut_quantized_pitch,
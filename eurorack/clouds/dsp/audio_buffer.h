@@ -277,6 +277,28 @@ class AudioBuffer {
     return ((((a * t) - b_neg) * t + c) * t + x0) * scale;
   }
   
+  // Decodes size consecutive samples starting at integral (wrapping around
+  // the end of the buffer) to floats, with the same scaling as Read().
+  inline void ReadSpan(int32_t integral, int32_t size, float* destination)
+      const {
+    while (integral >= size_) {
+      integral -= size_;
+    }
+    while (size--) {
+      if (resolution == RESOLUTION_16_BIT) {
+        *destination++ = static_cast<float>(s16_[integral]) / 32768.0f;
+      } else if (resolution == RESOLUTION_8_BIT_MU_LAW) {
+        *destination++ = static_cast<float>(
+            MuLaw2Lin(s8_[integral])) / 32768.0f;
+      } else {
+        *destination++ = static_cast<float>(s8_[integral]) / 128.0f;
+      }
+      if (++integral >= size_) {
+        integral = 0;
+      }
+    }
+  }
+  
   inline int32_t size() const { return size_; }
   inline int32_t head() const { return write_head_; }
   
@@ -39,6 +39,44 @@
 
 namespace clouds {
 
+// Samples read past the last integral position by the Hermite interpolator.
+const int32_t kGrainSpanGuard = 4;
+
+// A span of the recording decoded to floats, indexed like the AudioBuffer it
+// was copied from.
+class GrainSpan {
+ public:
+  GrainSpan() { }
+  ~GrainSpan() { }
+
+  inline void Init(const float* data, int32_t origin) {
+    data_ = data;
+    origin_ = origin;
+  }
+
+  template<InterpolationMethod method>
+  inline float Read(int32_t integral, uint16_t fractional) const {
+    const float* x = &data_[integral - origin_];
+    float t = static_cast<float>(fractional) / 65536.0f;
+    if (method == INTERPOLATION_ZOH) {
+      return x[0];
+    } else if (method == INTERPOLATION_LINEAR) {
+      return x[0] + (x[1] - x[0]) * t;
+    } else {
+      const float c = (x[2] - x[0]) * 0.5f;
+      const float v = x[1] - x[2];
+      const float w = c + v;
+      const float a = w + v + (x[3] - x[1]) * 0.5f;
+      const float b_neg = w + a;
+      return (((a * t) - b_neg) * t + c) * t + x[1];
+    }
+  }
+
+ private:
+  const float* data_;
+  int32_t origin_;
+};
+
 enum GrainQuality {
   GRAIN_QUALITY_LOW,
   GRAIN_QUALITY_MEDIUM,
@@ -52,6 +90,7 @@ class Grain {
 
   void Init() {
     active_ = false;
+    staged_ = false;
     envelope_phase_ = 2.0f;
   }
 
@@ -80,6 +119,7 @@ class Grain {
       envelope_slope_ = 0.5f / (window_shape + 0.01f);
     }
     active_ = true;
+    staged_ = false;
     gain_l_ = gain_l;
     gain_r_ = gain_r;
     recommended_quality_ = recommended_quality;
@@ -117,6 +157,37 @@ class Grain {
     envelope_phase_ = phase;
   }
   
+  // Copies the part of the recording read during the next size samples, plus
+  // the interpolation guard, to staging (one span per channel), so that
+  // OverlapAdd() reads from there instead of the recording buffer. Returns
+  // the number of floats used - 0 when the grain is idle or the spans do not
+  // fit, in which case OverlapAdd() falls back to reading the recording.
+  template<int32_t num_channels, Resolution resolution>
+  inline int32_t Stage(
+      const AudioBuffer<resolution>* buffer,
+      float* staging,
+      int32_t capacity,
+      size_t size) {
+    staged_ = false;
+    int32_t num_samples = static_cast<int32_t>(size) - pre_delay_;
+    if (!active_ || num_samples <= 0) {
+      return 0;
+    }
+    int32_t first = phase_ >> 16;
+    int32_t last = (phase_ + phase_increment_ * (num_samples - 1)) >> 16;
+    int32_t span_size = last - first + kGrainSpanGuard;
+    if (span_size * num_channels > capacity) {
+      return 0;
+    }
+    int32_t origin = first_sample_ + first;
+    for (int32_t i = 0; i < num_channels; ++i) {
+      buffer[i].ReadSpan(origin, span_size, &staging[i * span_size]);
+      span_[i].Init(&staging[i * span_size], origin);
+    }
+    staged_ = true;
+    return span_size * num_channels;
+  }
+
   template<int32_t num_channels, GrainQuality quality, Resolution resolution>
   inline void OverlapAdd(
       const AudioBuffer<resolution>* buffer,
@@ -126,6 +197,27 @@ class Grain {
     if (!active_) {
       return;
     }
+    if (staged_) {
+      staged_ = false;
+      Render<num_channels, quality>(span_, destination, envelope, size);
+    } else {
+      Render<num_channels, quality>(buffer, destination, envelope, size);
+    }
+  }
+  
+  inline bool active() { return active_; }
+  
+  inline GrainQuality recommended_quality() const {
+    return recommended_quality_;
+  }
+
+ private:
+  template<int32_t num_channels, GrainQuality quality, typename Source>
+  inline void Render(
+      const Source* buffer,
+      float* destination,
+      float* envelope,
+      size_t size) {
     // Rendering is done on 32-sample long blocks. The pre-delay allows grains
     // to start at arbitrary samples within a block, rather than at block
     // boundaries.
@@ -171,14 +263,7 @@ class Grain {
     }
     phase_ = phase;
   }
-  
-  inline bool active() { return active_; }
-  
-  inline GrainQuality recommended_quality() const {
-    return recommended_quality_;
-  }
 
- private:
   int32_t first_sample_;
   int32_t width_;
   int32_t phase_;
@@ -194,6 +279,8 @@ class Grain {
   float gain_r_;
 
   bool active_;
+  bool staged_;
+  GrainSpan span_[2];
   
   GrainQuality recommended_quality_;
 
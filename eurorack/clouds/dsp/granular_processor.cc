@@ -53,15 +53,21 @@ void GranularProcessor::Init(
   num_channels_ = 2;
   low_fidelity_ = false;
   bypass_ = false;
+  silence_ = false;
+  freeze_lp_ = 0.0f;
+  fill(&fb_[0].l, &fb_[kMaxBlockSize].l, 0.0f);
   
   src_down_.Init();
   src_up_.Init();
+  player_.set_staging_buffer(NULL, 0);
   
   ResetFilters();
   
   previous_playback_mode_ = PLAYBACK_MODE_LAST;
   reset_buffers_ = true;
   dry_wet_ = 0.0f;
+  wet_idle_ = false;
+  wet_fade_ = 1.0f;
 }
 
 void GranularProcessor::ResetFilters() {
@@ -72,10 +78,7 @@ void GranularProcessor::ResetFilters() {
   }
 }
 
-void GranularProcessor::ProcessGranular(
-    FloatFrame* input,
-    FloatFrame* output,
-    size_t size) {
+void GranularProcessor::RecordInput(FloatFrame* input, size_t size) {
   // At the exception of the spectral mode, all modes require the incoming
   // audio signal to be written to the recording buffer.
   if (playback_mode_ != PLAYBACK_MODE_SPECTRAL) {
@@ -90,6 +93,33 @@ void GranularProcessor::ProcessGranular(
       }
     }
   }
+}
+
+void GranularProcessor::RecordSilence(size_t size) {
+  if (bypass_ || silence_ || reset_buffers_ ||
+      previous_playback_mode_ != playback_mode_) {
+    return;
+  }
+  if (low_fidelity_) {
+    size /= kDownsamplingFactor;
+  }
+  fill(&in_[0].l, &in_[size].l, 0.0f);
+  RecordInput(in_, size);
+}
+
+bool GranularProcessor::WetPathIdle() const {
+  return parameters_.dry_wet < kWetGateThreshold &&
+      dry_wet_ < kWetGateThreshold &&
+      parameters_.reverb < kWetGateThreshold &&
+      !parameters_.freeze &&
+      freeze_lp_ < kWetGateThreshold;
+}
+
+void GranularProcessor::ProcessGranular(
+    FloatFrame* input,
+    FloatFrame* output,
+    size_t size) {
+  RecordInput(input, size);
   
   switch (playback_mode_) {
     case PLAYBACK_MODE_GRANULAR:
@@ -188,6 +218,36 @@ void GranularProcessor::Process(
   // Apply feedback, with high-pass filtering to prevent build-ups at very
   // low frequencies (causing large DC swings).
   ONE_POLE(freeze_lp_, parameters_.freeze ? 1.0f : 0.0f, 0.0005f)
+  
+  // With DRY/WET and reverb all the way down, everything below would be mixed
+  // away. Keep recording, so that position and freeze still refer to recent
+  // audio, and pass the dry signal through.
+  bool wet_idle = WetPathIdle();
+  if (wet_idle) {
+    if (!wet_idle_) {
+      fill(&fb_[0].l, &fb_[size].l, 0.0f);
+    }
+    wet_idle_ = true;
+    if (low_fidelity_) {
+      src_down_.Process(in_, in_downsampled_, size);
+      RecordInput(in_downsampled_, size / kDownsamplingFactor);
+    } else {
+      RecordInput(in_, size);
+    }
+    float fade_out = Interpolate(lut_xfade_out, dry_wet_, 16.0f);
+    for (size_t i = 0; i < size; ++i) {
+      float l = static_cast<float>(input[i].l) / 32768.0f * fade_out;
+      float r = static_cast<float>(input[i].r) / 32768.0f * fade_out;
+      output[i].l = SoftConvert(l);
+      output[i].r = SoftConvert(r);
+    }
+    return;
+  } else if (wet_idle_) {
+    // The effects restart from stale state: fade them in.
+    wet_idle_ = false;
+    wet_fade_ = 0.0f;
+  }
+  
   float feedback = parameters_.feedback;
   float cutoff = (20.0f + 100.0f * feedback * feedback) / sample_rate();
   fb_filter_[0].set_f_q<FREQUENCY_FAST>(cutoff, 1.0f);
@@ -272,10 +332,15 @@ void GranularProcessor::Process(
   reverb_.Process(out_, size);
   
   const float post_gain = 1.2f;
+  const float wet_fade_increment = 1.0f / static_cast<float>(kWetFadeInSize);
   ParameterInterpolator dry_wet_mod(&dry_wet_, parameters_.dry_wet, size);
   for (size_t i = 0; i < size; ++i) {
     float dry_wet = dry_wet_mod.Next();
-    float fade_in = Interpolate(lut_xfade_in, dry_wet, 16.0f);
+    float fade_in = Interpolate(lut_xfade_in, dry_wet, 16.0f) * wet_fade_;
+    if (wet_fade_ < 1.0f) {
+      wet_fade_ += wet_fade_increment;
+      if (wet_fade_ > 1.0f) wet_fade_ = 1.0f;
+    }
     float fade_out = Interpolate(lut_xfade_out, dry_wet, 16.0f);
     float l = static_cast<float>(input[i].l) / 32768.0f * fade_out;
     float r = static_cast<float>(input[i].r) / 32768.0f * fade_out;
@@ -295,6 +360,16 @@ void GranularProcessor::PreparePersistentData() {
   persistent_state_.spectral = playback_mode() == PLAYBACK_MODE_SPECTRAL;
 }
 
+void GranularProcessor::ResyncPersistentData() {
+  if (low_fidelity_) {
+    buffer_8_[0].Resync(persistent_state_.write_head[0]);
+    buffer_8_[1].Resync(persistent_state_.write_head[1]);
+  } else {
+    buffer_16_[0].Resync(persistent_state_.write_head[0]);
+    buffer_16_[1].Resync(persistent_state_.write_head[1]);
+  }
+}
+
 void GranularProcessor::GetPersistentData(
       PersistentBlock* block, size_t *num_blocks) {
   PersistentBlock* first_block = block;
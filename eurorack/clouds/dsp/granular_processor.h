@@ -48,6 +48,12 @@ namespace clouds {
 
 const int32_t kDownsamplingFactor = 2;
 
+// Below this, DRY/WET, reverb and freeze are considered off and the wet path
+// is not computed at all.
+const float kWetGateThreshold = 0.001f;
+// Samples over which the wet path fades back in when it restarts.
+const int32_t kWetFadeInSize = 512;
+
 enum PlaybackMode {
   PLAYBACK_MODE_GRANULAR,
   PLAYBACK_MODE_STRETCH,
@@ -121,6 +127,20 @@ class GranularProcessor {
   }
   
   inline PlaybackMode playback_mode() const { return playback_mode_; }
+
+  inline float num_active_grains() const { return player_.num_grains(); }
+  
+  // Advances the recording buffer by size samples of silence without
+  // rendering anything, for blocks where the host skips processing.
+  void RecordSilence(size_t size);
+  
+  // True while the wet path is gated off (see kWetGateThreshold).
+  inline bool wet_idle() const { return wet_idle_; }
+
+  // See GranularSamplePlayer::set_staging_buffer().
+  inline void set_grain_staging_buffer(float* staging, int32_t size) {
+    player_.set_staging_buffer(staging, size);
+  }
   
   inline void set_quality(int32_t quality) {
     set_num_channels(quality & 1 ? 1 : 2);
@@ -147,6 +167,11 @@ class GranularProcessor {
   void GetPersistentData(PersistentBlock* block, size_t *num_blocks);
   bool LoadPersistentData(const uint32_t* data);
   void PreparePersistentData();
+  // Restores the write heads from the state block, for a host that has filled
+  // the blocks returned by GetPersistentData() in place, a slice at a time,
+  // instead of handing everything to LoadPersistentData() at once. The
+  // buffers must stay frozen until then.
+  void ResyncPersistentData();
 
  private:
   inline int32_t resolution() const {
@@ -159,7 +184,9 @@ class GranularProcessor {
   }
      
   void ResetFilters();
+  void RecordInput(FloatFrame* input, size_t size);
   void ProcessGranular(FloatFrame* input, FloatFrame* output, size_t size);
+  bool WetPathIdle() const;
 
   PlaybackMode playback_mode_;
   PlaybackMode previous_playback_mode_;
@@ -172,6 +199,9 @@ class GranularProcessor {
   float freeze_lp_;
   float dry_wet_;
   
+  bool wet_idle_;
+  float wet_fade_;
+  
   void* buffer_[2];
   size_t buffer_size_[2];
   
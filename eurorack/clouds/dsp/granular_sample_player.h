@@ -35,7 +35,6 @@
 
 #include "stmlib/dsp/atan.h"
 #include "stmlib/dsp/units.h"
-#include "stmlib/utils/random.h"
 
 #include "clouds/dsp/audio_buffer.h"
 #include "clouds/dsp/frame.h"
@@ -43,6 +42,7 @@
 #include "clouds/dsp/parameters.h"
 
 #include "clouds/resources.h"
+#include "RandomStream.h"
 
 namespace clouds {
 
@@ -65,7 +65,20 @@ class GranularSamplePlayer {
     num_grains_ = 0.0f;
     num_channels_ = num_channels;
     grain_size_hint_ = 1024.0f;
+    random_.Init(0);
   }
+
+  // Optional block of fast memory (DTCM on the Daisy) into which the samples
+  // read by each grain during a block are copied before rendering, so that
+  // the recording buffer is read once, sequentially, instead of at up to 64
+  // scattered positions per output sample. Survives Init().
+  inline void set_staging_buffer(float* staging, int32_t size) {
+    staging_ = staging;
+    staging_size_ = size;
+  }
+
+  // Smoothed count of grains that played during the last block.
+  inline float num_grains() const { return num_grains_; }
   
   template<Resolution resolution>
   void Play(
@@ -86,14 +99,21 @@ class GranularSamplePlayer {
     // Build a list of available grains.
     int32_t num_available_grains = FillAvailableGrainsList();
     
+    // Draw the whole block's probabilistic seeds at once. num_grains_ only
+    // changes at the end of the block, so neither does the condition.
+    bool seed_probabilistic[kMaxBlockSize];
+    if (p > 0.0f && target_num_grains > num_grains_) {
+      random_.FillBernoulli(seed_probabilistic, size, p);
+    } else {
+      std::fill(&seed_probabilistic[0], &seed_probabilistic[size], false);
+    }
+    
     // Try to schedule new grains.
     bool seed_trigger = parameters.trigger;
     for (size_t t = 0; t < size; ++t) {
       grain_rate_phasor_ += 1.0f;
-      bool seed_probabilistic = stmlib::Random::GetFloat() < p
-          && target_num_grains > num_grains_;
       bool seed_deterministic = grain_rate_phasor_ >= space_between_grains;
-      bool seed = seed_probabilistic || seed_deterministic || seed_trigger;
+      bool seed = seed_probabilistic[t] || seed_deterministic || seed_trigger;
       if (num_available_grains && seed) {
         --num_available_grains;
         int32_t index = available_grains_[num_available_grains];
@@ -117,6 +137,19 @@ class GranularSamplePlayer {
       }
     }
     
+    // Stage the grains' read windows, in order, until the buffer is full.
+    if (staging_) {
+      float* staging = staging_;
+      int32_t capacity = staging_size_;
+      for (int32_t i = 0; i < max_num_grains_; ++i) {
+        int32_t used = num_channels_ == 1
+            ? grains_[i].Stage<1>(buffer, staging, capacity, size)
+            : grains_[i].Stage<2>(buffer, staging, capacity, size);
+        staging += used;
+        capacity -= used;
+      }
+    }
+    
     // Overlap grains.
     std::fill(&out[0], &out[size * 2], 0.0f);
     float* e = envelope_buffer_;
@@ -188,7 +221,7 @@ class GranularSamplePlayer {
     float grain_size = Interpolate(lut_grain_size, parameters.size, 256.0f);
     float pitch_ratio = SemitonesToRatio(pitch);
     float inv_pitch_ratio = SemitonesToRatio(-pitch);
-    float pan = 0.5f + parameters.stereo_spread * (stmlib::Random::GetFloat() - 0.5f);
+    float pan = 0.5f + parameters.stereo_spread * (random_.GetFloat() - 0.5f);
     float gain_l, gain_r;
     if (num_channels_ == 1) {
       gain_l = Interpolate(lut_sin, pan, 256.0f);
@@ -244,9 +277,13 @@ class GranularSamplePlayer {
   float grain_size_hint_;
   float grain_rate_phasor_;
   
+  float* staging_;
+  int32_t staging_size_;
+  
   Grain grains_[kMaxNumGrains];
   int32_t available_grains_[kMaxNumGrains];
   float envelope_buffer_[kMaxBlockSize];
+  RandomStream random_;
   
   DISALLOW_COPY_AND_ASSIGN(GranularSamplePlayer);
 };
@@ -0,0 +1,236 @@
+// -----------------------------------------------------------------------------
+//
+// Pluggable real FFT used by the STFT.
+
+#include "clouds/dsp/pvoc/fft_backend.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace clouds {
+
+using namespace std;
+
+static size_t Log2(size_t size) {
+  size_t bits = 0;
+  for (size_t t = size; t > 1; t >>= 1) {
+    ++bits;
+  }
+  return bits;
+}
+
+void ShyFftBackend::Init(size_t size) {
+  size_ = size;
+  num_passes_ = Log2(size);
+  fft_.Init();
+}
+
+void ShyFftBackend::Direct(float* in, float* out) {
+  if (size_ != FFT::max_size) {
+    fft_.Direct(in, out, num_passes_);
+  } else {
+    fft_.Direct(in, out);
+  }
+}
+
+void ShyFftBackend::Inverse(float* in, float* out) {
+  if (size_ != FFT::max_size) {
+    fft_.Inverse(in, out, num_passes_);
+  } else {
+    fft_.Inverse(in, out);
+  }
+}
+
+#ifdef CLOUDS_FFT_CMSIS
+
+void ArmFftBackend::Init(size_t size) {
+  size_ = size;
+  arm_rfft_fast_init_f32(&fft_, size);
+}
+
+void ArmFftBackend::Direct(float* in, float* out) {
+  arm_rfft_fast_f32(&fft_, in, out, 0);
+  // CMSIS interleaves (re, im) with the Nyquist real part in slot 1.
+  copy(&out[0], &out[size_], &in[0]);
+  for (size_t i = 0; i < size_ / 2; ++i) {
+    out[i] = in[2 * i];
+    out[i + size_ / 2] = in[2 * i + 1];
+  }
+}
+
+void ArmFftBackend::Inverse(float* in, float* out) {
+  copy(&in[0], &in[size_], &out[0]);
+  for (size_t i = 0; i < size_ / 2; ++i) {
+    in[2 * i] = out[i];
+    in[2 * i + 1] = out[i + size_ / 2];
+  }
+  arm_rfft_fast_f32(&fft_, in, out, 1);
+}
+
+#endif  // CLOUDS_FFT_CMSIS
+
+void RealFft::Init(size_t size) {
+  size_ = size;
+  half_ = size / 2;
+  num_bits_ = Log2(half_);
+  for (size_t k = 0; k < half_; ++k) {
+    double angle = 2.0 * M_PI * static_cast<double>(k) / size;
+    cos_[k] = static_cast<float>(cos(angle));
+    sin_[k] = static_cast<float>(sin(angle));
+  }
+}
+
+void RealFft::BitReverse(const float* in, float* out) {
+  for (size_t i = 0; i < half_; ++i) {
+    size_t r = 0;
+    for (size_t b = 0, t = i; b < num_bits_; ++b, t >>= 1) {
+      r = (r << 1) | (t & 1);
+    }
+    out[2 * r] = in[2 * i];
+    out[2 * r + 1] = in[2 * i + 1];
+  }
+}
+
+void RealFft::Transform(float* data) {
+  const size_t n = half_;
+  size_t h = 1;
+
+  if (num_bits_ & 1) {
+    // Odd number of stages: start with a twiddle-free radix-2 pass.
+    for (size_t i = 0; i < n; i += 2) {
+      float* a = &data[2 * i];
+      float* b = &data[2 * i + 2];
+      float br = b[0];
+      float bi = b[1];
+      b[0] = a[0] - br;
+      b[1] = a[1] - bi;
+      a[0] += br;
+      a[1] += bi;
+    }
+    h = 2;
+  }
+
+  // Each pass turns 4 consecutive sub-transforms of size h into one of size
+  // 4h: a size-2h radix-2 stage (twiddle W_2h^j) fused with the size-4h one
+  // (W_4h^j and W_4h^(j+h) = -i W_4h^j).
+  for (; h < n; h *= 4) {
+    const size_t span = 4 * h;
+    const size_t stride = size_ / span;
+    for (size_t j = 0; j < h; ++j) {
+      const float w1r = cos_[j * stride];
+      const float w1i = -sin_[j * stride];
+      const float w2r = cos_[2 * j * stride];
+      const float w2i = -sin_[2 * j * stride];
+      for (size_t g = j; g < n; g += span) {
+        float* a = &data[2 * g];
+        float* b = &data[2 * (g + h)];
+        float* c = &data[2 * (g + 2 * h)];
+        float* d = &data[2 * (g + 3 * h)];
+
+        float br = b[0] * w2r - b[1] * w2i;
+        float bi = b[0] * w2i + b[1] * w2r;
+        float dr = d[0] * w2r - d[1] * w2i;
+        float di = d[0] * w2i + d[1] * w2r;
+
+        float a1r = a[0] + br;
+        float a1i = a[1] + bi;
+        float b1r = a[0] - br;
+        float b1i = a[1] - bi;
+        float c1r = c[0] + dr;
+        float c1i = c[1] + di;
+        float d1r = c[0] - dr;
+        float d1i = c[1] - di;
+
+        float cr = c1r * w1r - c1i * w1i;
+        float ci = c1r * w1i + c1i * w1r;
+        // -i * w1 * d1
+        float tr = d1r * w1r - d1i * w1i;
+        float ti = d1r * w1i + d1i * w1r;
+        dr = ti;
+        di = -tr;
+
+        a[0] = a1r + cr;
+        a[1] = a1i + ci;
+        c[0] = a1r - cr;
+        c[1] = a1i - ci;
+        b[0] = b1r + dr;
+        b[1] = b1i + di;
+        d[0] = b1r - dr;
+        d[1] = b1i - di;
+      }
+    }
+  }
+}
+
+void RealFft::Direct(float* in, float* out) {
+  const size_t n = half_;
+
+  // Pairs of real samples are treated as one complex sample.
+  BitReverse(in, out);
+  Transform(out);
+
+  // Split the N/2-point complex spectrum into the N-point real one, using in
+  // as scratch.
+  float* re = &in[0];
+  float* im = &in[n];
+  re[0] = out[0] + out[1];
+  im[0] = out[0] - out[1];  // Nyquist
+  for (size_t k = 1; k < n; ++k) {
+    const float zr = out[2 * k];
+    const float zi = out[2 * k + 1];
+    const float mr = out[2 * (n - k)];
+    const float mi = out[2 * (n - k) + 1];
+
+    const float even_r = 0.5f * (zr + mr);
+    const float even_i = 0.5f * (zi - mi);
+    const float odd_r = 0.5f * (zi + mi);
+    const float odd_i = -0.5f * (zr - mr);
+
+    const float c = cos_[k];
+    const float s = sin_[k];
+    re[k] = even_r + c * odd_r + s * odd_i;
+    im[k] = even_i + c * odd_i - s * odd_r;
+  }
+  copy(&in[0], &in[size_], &out[0]);
+}
+
+void RealFft::Inverse(float* in, float* out) {
+  const size_t n = half_;
+  const float* re = &in[0];
+  const float* im = &in[n];
+
+  // Rebuild the N/2-point complex spectrum (conjugated, so that the forward
+  // transform computes the inverse).
+  out[0] = 0.5f * (re[0] + im[0]);
+  out[1] = -0.5f * (re[0] - im[0]);
+  for (size_t k = 1; k < n; ++k) {
+    const float xr = re[k];
+    const float xi = im[k];
+    const float mr = re[n - k];
+    const float mi = im[n - k];
+
+    const float even_r = 0.5f * (xr + mr);
+    const float even_i = 0.5f * (xi - mi);
+    const float tr = 0.5f * (xr - mr);
+    const float ti = 0.5f * (xi + mi);
+
+    const float c = cos_[k];
+    const float s = sin_[k];
+    const float odd_r = tr * c - ti * s;
+    const float odd_i = tr * s + ti * c;
+
+    out[2 * k] = even_r - odd_i;
+    out[2 * k + 1] = -(even_i + odd_r);
+  }
+
+  BitReverse(out, in);
+  Transform(in);
+
+  const float scale = 1.0f / static_cast<float>(n);
+  for (size_t i = 0; i < n; ++i) {
+    out[2 * i] = in[2 * i] * scale;
+    out[2 * i + 1] = -in[2 * i + 1] * scale;
+  }
+}
+
+}  // namespace clouds
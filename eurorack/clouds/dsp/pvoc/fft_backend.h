@@ -0,0 +1,134 @@
+// -----------------------------------------------------------------------------
+//
+// Pluggable real FFT used by the STFT.
+//
+// All backends share one data layout (the one the STFT and FrameTransformation
+// were written against): Direct() writes the real parts of bins 0..N/2-1 to
+// out[0..N/2) and the imaginary parts to out[N/2..N), with the Nyquist bin's
+// real part in out[N/2] (bin 0 has no imaginary part). Inverse() reads the
+// same layout. Both may destroy their input buffer.
+//
+// Backends:
+//  - ShyFftBackend: stmlib::ShyFFT, the historical default.
+//  - ArmFftBackend: CMSIS-DSP arm_rfft_fast_f32 (target only, needs the
+//    CMSIS-DSP transform sources in the build; see CLOUDS_FFT in the Makefile).
+//  - RealFft: portable radix-4 real FFT, for host builds and as a reference.
+//
+// The default backend used by PhaseVocoder is chosen at compile time with
+// CLOUDS_FFT_CMSIS / CLOUDS_FFT_PORTABLE, and falls back to ShyFFT.
+
+#ifndef CLOUDS_DSP_PVOC_FFT_BACKEND_H_
+#define CLOUDS_DSP_PVOC_FFT_BACKEND_H_
+
+#include "stmlib/stmlib.h"
+
+#include "stmlib/fft/shy_fft.h"
+
+#ifdef CLOUDS_FFT_CMSIS
+  #include <arm_math.h>
+#endif  // CLOUDS_FFT_CMSIS
+
+namespace clouds {
+
+const size_t kMaxFftSize = 4096;
+
+class FftBackend {
+ public:
+  FftBackend() { }
+  virtual ~FftBackend() { }
+
+  // size is a power of two, at most kMaxFftSize.
+  virtual void Init(size_t size) = 0;
+  virtual void Direct(float* in, float* out) = 0;
+  virtual void Inverse(float* in, float* out) = 0;
+
+  // Gain of a Direct() + Inverse() round trip: N for unnormalized inverses.
+  virtual float inverse_gain() const = 0;
+  virtual const char* name() const = 0;
+
+  inline size_t size() const { return size_; }
+
+ protected:
+  size_t size_;
+};
+
+class ShyFftBackend : public FftBackend {
+ public:
+  ShyFftBackend() { }
+  virtual ~ShyFftBackend() { }
+
+  virtual void Init(size_t size);
+  virtual void Direct(float* in, float* out);
+  virtual void Inverse(float* in, float* out);
+  virtual float inverse_gain() const { return static_cast<float>(size_); }
+  virtual const char* name() const { return "shy"; }
+
+ private:
+  typedef stmlib::ShyFFT<float, kMaxFftSize, stmlib::RotationPhasor> FFT;
+  FFT fft_;
+  size_t num_passes_;
+
+  DISALLOW_COPY_AND_ASSIGN(ShyFftBackend);
+};
+
+#ifdef CLOUDS_FFT_CMSIS
+class ArmFftBackend : public FftBackend {
+ public:
+  ArmFftBackend() { }
+  virtual ~ArmFftBackend() { }
+
+  virtual void Init(size_t size);
+  virtual void Direct(float* in, float* out);
+  virtual void Inverse(float* in, float* out);
+  // arm_rfft_fast_f32 scales its inverse by 1/N.
+  virtual float inverse_gain() const { return 1.0f; }
+  virtual const char* name() const { return "cmsis"; }
+
+ private:
+  arm_rfft_fast_instance_f32 fft_;
+
+  DISALLOW_COPY_AND_ASSIGN(ArmFftBackend);
+};
+#endif  // CLOUDS_FFT_CMSIS
+
+// Real FFT of size N computed as a complex FFT of size N/2 (even samples in
+// the real part, odd samples in the imaginary part) followed by the usual
+// split step. The complex FFT is decimation-in-time with two radix-2 stages
+// fused into each radix-4 pass, plus one radix-2 pass when log2(N/2) is odd.
+class RealFft : public FftBackend {
+ public:
+  RealFft() { }
+  virtual ~RealFft() { }
+
+  virtual void Init(size_t size);
+  virtual void Direct(float* in, float* out);
+  virtual void Inverse(float* in, float* out);
+  virtual float inverse_gain() const { return 1.0f; }
+  virtual const char* name() const { return "radix4"; }
+
+ private:
+  // In-place complex FFT on size_ / 2 interleaved (re, im) pairs.
+  void Transform(float* data);
+  void BitReverse(const float* in, float* out);
+
+  size_t half_;
+  size_t num_bits_;
+
+  // cos/sin of 2 pi k / N for k < N / 2.
+  float cos_[kMaxFftSize / 2];
+  float sin_[kMaxFftSize / 2];
+
+  DISALLOW_COPY_AND_ASSIGN(RealFft);
+};
+
+#if defined(CLOUDS_FFT_CMSIS)
+typedef ArmFftBackend DefaultFftBackend;
+#elif defined(CLOUDS_FFT_PORTABLE)
+typedef RealFft DefaultFftBackend;
+#else
+typedef ShyFftBackend DefaultFftBackend;
+#endif
+
+}  // namespace clouds
+
+#endif  // CLOUDS_DSP_PVOC_FFT_BACKEND_H_
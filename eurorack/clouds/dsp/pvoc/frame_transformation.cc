@@ -30,12 +30,12 @@
 
 #include <algorithm>
 
-#include "stmlib/dsp/atan.h"
 #include "stmlib/dsp/units.h"
 #include "stmlib/utils/random.h"
 
 #include "clouds/dsp/frame.h"
 #include "clouds/dsp/parameters.h"
+#include "clouds/dsp/pvoc/spectral_kernels.h"
 
 namespace clouds {
 
@@ -55,6 +55,7 @@ void FrameTransformation::Init(
   phases_ = static_cast<uint16_t*>((void*)(textures_[num_textures - 1]));
   num_textures_ = num_textures - 1;  // Last texture is used for storing phases.
   phases_delta_ = phases_ + size_;
+  fill(&phases_[0], &phases_[2 * size_], 0);
 
   glitch_algorithm_ = 0;
   Reset();
@@ -109,10 +110,12 @@ void FrameTransformation::RectangularToPolar(float* fft_data) {
   float* real = &fft_data[0];
   float* imag = &fft_data[fft_size_ >> 1];
   float* magnitude = &fft_data[0];
+  // The angles are packed into the (already consumed) imaginary parts.
+  uint16_t* angle = (uint16_t*) &fft_data[fft_size_ >> 1];
+  CartesianToPolar(&real[1], &imag[1], &magnitude[1], &angle[1], size_ - 1);
   for (int32_t i = 1; i < size_; ++i) {
-    uint16_t angle = fast_atan2r(imag[i], real[i], &magnitude[i]);
-    phases_delta_[i] = angle - phases_[i];
-    phases_[i] = angle;
+    phases_delta_[i] = angle[i] - phases_[i];
+    phases_[i] = angle[i];
   }
 }
 
@@ -142,9 +145,7 @@ void FrameTransformation::PolarToRectangular(float* fft_data) {
   float* imag = &fft_data[fft_size_ >> 1];
   float* magnitude = &fft_data[0];
   uint32_t* angle = (uint32_t*) &fft_data[fft_size_ >> 1];
-  for (int32_t i = 1; i < size_; ++i) {
-    fast_p2r(magnitude[i], angle[i], &real[i], &imag[i]);
-  }
+  PolarToCartesian(&magnitude[1], &angle[1], &real[1], &imag[1], size_ - 1);
   for (int32_t i = size_; i < fft_size_ >> 1; ++i) {
     real[i] = imag[i] = 0.0f;
   }
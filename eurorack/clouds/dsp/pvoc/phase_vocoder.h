@@ -31,8 +31,6 @@
 
 #include "stmlib/stmlib.h"
 
-#include "stmlib/fft/shy_fft.h"
-
 #include "clouds/dsp/frame.h"
 #include "clouds/dsp/pvoc/stft.h"
 #include "clouds/dsp/pvoc/frame_transformation.h"
@@ -61,7 +59,7 @@ class PhaseVocoder {
   void Buffer();
   
  private:
-  FFT fft_;
+  DefaultFftBackend fft_;
   
   STFT stft_[2];
   FrameTransformation frame_transformation_[2];
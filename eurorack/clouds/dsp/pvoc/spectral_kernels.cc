@@ -0,0 +1,210 @@
+// -----------------------------------------------------------------------------
+//
+// Batch cartesian <-> polar conversion for whole spectra.
+
+#include "clouds/dsp/pvoc/spectral_kernels.h"
+
+#include <cmath>
+
+#ifdef __SSE2__
+  #include <emmintrin.h>
+#endif  // __SSE2__
+
+namespace clouds {
+
+// atan(a) for a in [0, 1], odd minimax polynomial in a.
+const float kAtan1 = 0.99997726f;
+const float kAtan3 = -0.33262347f;
+const float kAtan5 = 0.19354346f;
+const float kAtan7 = -0.11643287f;
+const float kAtan9 = 0.05265332f;
+const float kAtan11 = -0.01172120f;
+
+const float kHalfPi = 1.57079632679f;
+const float kPi = 3.14159265359f;
+const float kRadiansToPhase = 65536.0f / (2.0f * kPi);
+const float kQuadrantPhaseToRadians = kHalfPi / 16384.0f;
+// Keeps the scaled angle positive so that truncation rounds to nearest.
+const float kPhaseRoundingOffset = 65536.0f + 0.5f;
+
+static inline float AtanUnit(float a) {
+  float s = a * a;
+  return a * (kAtan1 + s * (kAtan3 + s * (kAtan5 + s * (
+      kAtan7 + s * (kAtan9 + s * kAtan11)))));
+}
+
+// sin and cos of x in [0, pi / 2].
+static inline void SinCosQuadrant(float x, float* s, float* c) {
+  float x2 = x * x;
+  *s = x * (1.0f + x2 * (-1.0f / 6.0f + x2 * (1.0f / 120.0f + x2 * (
+      -1.0f / 5040.0f + x2 * (1.0f / 362880.0f)))));
+  *c = 1.0f + x2 * (-0.5f + x2 * (1.0f / 24.0f + x2 * (-1.0f / 720.0f + x2 * (
+      1.0f / 40320.0f + x2 * (-1.0f / 3628800.0f)))));
+}
+
+static inline void CartesianToPolarScalar(
+    float x, float y, float* magnitude, uint16_t* phase) {
+  float ax = fabsf(x);
+  float ay = fabsf(y);
+  float hi = ax > ay ? ax : ay;
+  float lo = ax > ay ? ay : ax;
+  float r = hi > 0.0f ? AtanUnit(lo / hi) : 0.0f;
+  if (ay > ax) r = kHalfPi - r;
+  if (x < 0.0f) r = kPi - r;
+  if (y < 0.0f) r = -r;
+  *magnitude = sqrtf(x * x + y * y);
+  *phase = static_cast<uint16_t>(
+      static_cast<int32_t>(r * kRadiansToPhase + kPhaseRoundingOffset));
+}
+
+static inline void PolarToCartesianScalar(
+    float magnitude, uint32_t phase, float* x, float* y) {
+  uint32_t quadrant = (phase >> 14) & 3;
+  float s, c;
+  SinCosQuadrant(
+      static_cast<float>(phase & 0x3fff) * kQuadrantPhaseToRadians, &s, &c);
+  // Rotate the first-quadrant (c, s) by quadrant * 90 degrees.
+  float cos_value = quadrant & 1 ? -s : c;
+  float sin_value = quadrant & 1 ? c : s;
+  if (quadrant & 2) {
+    cos_value = -cos_value;
+    sin_value = -sin_value;
+  }
+  *x = magnitude * cos_value;
+  *y = magnitude * sin_value;
+}
+
+#ifdef __SSE2__
+
+static inline __m128 Select(__m128 mask, __m128 a, __m128 b) {
+  return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+void CartesianToPolar(
+    const float* real,
+    const float* imag,
+    float* magnitude,
+    uint16_t* phase,
+    size_t size) {
+  const __m128 sign_mask = _mm_set1_ps(-0.0f);
+  const __m128 zero = _mm_setzero_ps();
+  size_t i = 0;
+  for (; i + 4 <= size; i += 4) {
+    __m128 x = _mm_loadu_ps(&real[i]);
+    __m128 y = _mm_loadu_ps(&imag[i]);
+    __m128 ax = _mm_andnot_ps(sign_mask, x);
+    __m128 ay = _mm_andnot_ps(sign_mask, y);
+    __m128 hi = _mm_max_ps(ax, ay);
+    __m128 lo = _mm_min_ps(ax, ay);
+    __m128 nonzero = _mm_cmpgt_ps(hi, zero);
+    __m128 a = _mm_and_ps(
+        nonzero, _mm_div_ps(lo, Select(nonzero, hi, _mm_set1_ps(1.0f))));
+
+    __m128 s = _mm_mul_ps(a, a);
+    __m128 r = _mm_set1_ps(kAtan11);
+    r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(kAtan9));
+    r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(kAtan7));
+    r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(kAtan5));
+    r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(kAtan3));
+    r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(kAtan1));
+    r = _mm_mul_ps(r, a);
+
+    r = Select(_mm_cmpgt_ps(ay, ax), _mm_sub_ps(_mm_set1_ps(kHalfPi), r), r);
+    r = Select(_mm_cmplt_ps(x, zero), _mm_sub_ps(_mm_set1_ps(kPi), r), r);
+    r = _mm_xor_ps(r, _mm_and_ps(sign_mask, y));
+
+    __m128 m = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)));
+    __m128i p = _mm_cvttps_epi32(_mm_add_ps(
+        _mm_mul_ps(r, _mm_set1_ps(kRadiansToPhase)),
+        _mm_set1_ps(kPhaseRoundingOffset)));
+
+    _mm_storeu_ps(&magnitude[i], m);
+    int32_t p32[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p32), p);
+    for (size_t j = 0; j < 4; ++j) {
+      phase[i + j] = static_cast<uint16_t>(p32[j]);
+    }
+  }
+  for (; i < size; ++i) {
+    CartesianToPolarScalar(real[i], imag[i], &magnitude[i], &phase[i]);
+  }
+}
+
+void PolarToCartesian(
+    const float* magnitude,
+    const uint32_t* phase,
+    float* real,
+    float* imag,
+    size_t size) {
+  const __m128i fraction_mask = _mm_set1_epi32(0x3fff);
+  const __m128i one = _mm_set1_epi32(1);
+  const __m128i two = _mm_set1_epi32(2);
+  size_t i = 0;
+  for (; i + 4 <= size; i += 4) {
+    __m128 m = _mm_loadu_ps(&magnitude[i]);
+    __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&phase[i]));
+    __m128i quadrant = _mm_srli_epi32(p, 14);
+    __m128 x = _mm_mul_ps(
+        _mm_cvtepi32_ps(_mm_and_si128(p, fraction_mask)),
+        _mm_set1_ps(kQuadrantPhaseToRadians));
+
+    __m128 x2 = _mm_mul_ps(x, x);
+    __m128 s = _mm_set1_ps(1.0f / 362880.0f);
+    s = _mm_add_ps(_mm_mul_ps(s, x2), _mm_set1_ps(-1.0f / 5040.0f));
+    s = _mm_add_ps(_mm_mul_ps(s, x2), _mm_set1_ps(1.0f / 120.0f));
+    s = _mm_add_ps(_mm_mul_ps(s, x2), _mm_set1_ps(-1.0f / 6.0f));
+    s = _mm_add_ps(_mm_mul_ps(s, x2), _mm_set1_ps(1.0f));
+    s = _mm_mul_ps(s, x);
+    __m128 c = _mm_set1_ps(-1.0f / 3628800.0f);
+    c = _mm_add_ps(_mm_mul_ps(c, x2), _mm_set1_ps(1.0f / 40320.0f));
+    c = _mm_add_ps(_mm_mul_ps(c, x2), _mm_set1_ps(-1.0f / 720.0f));
+    c = _mm_add_ps(_mm_mul_ps(c, x2), _mm_set1_ps(1.0f / 24.0f));
+    c = _mm_add_ps(_mm_mul_ps(c, x2), _mm_set1_ps(-0.5f));
+    c = _mm_add_ps(_mm_mul_ps(c, x2), _mm_set1_ps(1.0f));
+
+    // Odd quadrants swap the roles of sin and cos (with a sign on cos),
+    // quadrants 2 and 3 negate both.
+    __m128 odd = _mm_castsi128_ps(
+        _mm_cmpeq_epi32(_mm_and_si128(quadrant, one), one));
+    __m128 negate = _mm_castsi128_ps(
+        _mm_slli_epi32(_mm_and_si128(quadrant, two), 30));
+    __m128 cos_value = Select(odd, _mm_xor_ps(s, _mm_set1_ps(-0.0f)), c);
+    __m128 sin_value = Select(odd, c, s);
+    cos_value = _mm_xor_ps(cos_value, negate);
+    sin_value = _mm_xor_ps(sin_value, negate);
+
+    _mm_storeu_ps(&real[i], _mm_mul_ps(m, cos_value));
+    _mm_storeu_ps(&imag[i], _mm_mul_ps(m, sin_value));
+  }
+  for (; i < size; ++i) {
+    PolarToCartesianScalar(magnitude[i], phase[i], &real[i], &imag[i]);
+  }
+}
+
+#else
+
+void CartesianToPolar(
+    const float* real,
+    const float* imag,
+    float* magnitude,
+    uint16_t* phase,
+    size_t size) {
+  for (size_t i = 0; i < size; ++i) {
+    CartesianToPolarScalar(real[i], imag[i], &magnitude[i], &phase[i]);
+  }
+}
+
+void PolarToCartesian(
+    const float* magnitude,
+    const uint32_t* phase,
+    float* real,
+    float* imag,
+    size_t size) {
+  for (size_t i = 0; i < size; ++i) {
+    PolarToCartesianScalar(magnitude[i], phase[i], &real[i], &imag[i]);
+  }
+}
+
+#endif  // __SSE2__
+
+}  // namespace clouds
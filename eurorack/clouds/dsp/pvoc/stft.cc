@@ -39,7 +39,7 @@ using namespace std;
 using namespace stmlib;
 
 void STFT::Init(
-    FFT* fft,
+    FftBackend* fft,
     size_t fft_size,
     size_t hop_size,
     float* fft_buffer,
@@ -49,18 +49,10 @@ void STFT::Init(
     Modifier* modifier) {
   fft_size_ = fft_size;
   hop_size_ = hop_size;
-  fft_num_passes_ = 0;
-  for (size_t t = fft_size; t > 1; t >>= 1) {
-    ++fft_num_passes_;
-  }
   buffer_size_ = fft_size_ + hop_size_;
   
   fft_ = fft;
-#ifdef USE_ARM_FFT
-  arm_rfft_fast_init_f32(fft_, fft_size);
-#else
-  fft_->Init();
-#endif  // USE_ARM_FFT
+  fft_->Init(fft_size);
   
   analysis_ = &analysis_synthesis_buffer[0];
   synthesis_ = &analysis_synthesis_buffer[buffer_size_];
@@ -133,23 +125,11 @@ void STFT::Buffer() {
     }
     w += window_stride_;
   }
+  // Read through a stored pointer, so the profiling build counts it here.
+  HOT_TABLE_COUNT(HOT_LUT_SINE_WINDOW_4096, fft_size_);
   
   // Compute FFT. fft_in is lost.
-#ifdef USE_ARM_FFT
-  arm_rfft_fast_f32(fft_, fft_in_, fft_out_, 0);
-  copy(&fft_out_[0], &fft_out_[fft_size_], &fft_in_[0]);
-  // Re-arrange data.
-  for (size_t i = 0; i < fft_size_ / 2; ++i) {
-    fft_out_[i] = fft_in_[2 * i];
-    fft_out_[i + fft_size_ / 2] = fft_in_[2 * i + 1];
-  }
-#else
-  if (fft_size_ != FFT::max_size) {
-    fft_->Direct(fft_in_, fft_out_, fft_num_passes_);
-  } else {
-    fft_->Direct(fft_in_, fft_out_);
-  }
-#endif  // USE_ARM_FFT
+  fft_->Direct(fft_in_, fft_out_);
   // Process in the frequency domain.
   if (modifier_ != NULL && parameters_ != NULL) {
     modifier_->Process(*parameters_, &fft_out_[0], &ifft_in_[0]);
@@ -158,30 +138,11 @@ void STFT::Buffer() {
   }
   
   // Compute IFFT. ifft_in is lost.
-#ifdef USE_ARM_FFT
-  // Re-arrange data.
-  copy(&ifft_in_[0], &ifft_in_[fft_size_], &ifft_out_[0]);
-  for (size_t i = 0; i < fft_size_ / 2; ++i) {
-    ifft_in_[2 * i] = ifft_out_[i];
-    ifft_in_[2 * i + 1] = ifft_out_[i + fft_size_ / 2];
-  }
-  arm_rfft_fast_f32(fft_, ifft_in_, ifft_out_, 1);
-#else
-  if (fft_size_ != FFT::max_size) {
-    fft_->Inverse(ifft_in_, ifft_out_, fft_num_passes_);
-  } else {
-    fft_->Inverse(ifft_in_, ifft_out_);
-  }
-#endif  // USE_ARM_FFT
+  fft_->Inverse(ifft_in_, ifft_out_);
   
   size_t destination_ptr = process_ptr_;
-#ifdef USE_ARM_FFT
-  float inverse_window_size = 1.0f / \
-      float(fft_size_ / hop_size_ >> 1);
-#else
   float inverse_window_size = 1.0f / \
-      float(fft_size_ * fft_size_ / hop_size_ >> 1);
-#endif  // USE_ARM_FFT
+      (fft_->inverse_gain() * float(fft_size_ / hop_size_ >> 1));
     
   w = window_;
   for (size_t i = 0; i < fft_size_; ++i) {
@@ -199,6 +160,7 @@ void STFT::Buffer() {
     }
     w += window_stride_;
   }
+  HOT_TABLE_COUNT(HOT_LUT_SINE_WINDOW_4096, fft_size_);
 
   ++done_;
   process_ptr_ += hop_size_;
@@ -31,25 +31,12 @@
 
 #include "stmlib/stmlib.h"
 
-// #define USE_ARM_FFT
-
-#ifdef USE_ARM_FFT
-  #include <arm_math.h>
-#else
-  #include "stmlib/fft/shy_fft.h"
-#endif  // USE_ARM_FFT
+#include "clouds/dsp/pvoc/fft_backend.h"
 
 namespace clouds {
 
 struct Parameters;
 
-const size_t kMaxFftSize = 4096;
-#ifdef USE_ARM_FFT
-  typedef arm_rfft_fast_instance_f32 FFT;
-#else
-  typedef stmlib::ShyFFT<float, kMaxFftSize, stmlib::RotationPhasor> FFT;
-#endif  // USE_ARM_FFT
-
 typedef class FrameTransformation Modifier;
 
 class STFT {
@@ -60,7 +47,7 @@ class STFT {
   struct Frame { short l; short r; };
   
   void Init(
-      FFT* fft,
+      FftBackend* fft,
       size_t fft_size,
       size_t hop_size,
       float* fft_buffer,
@@ -81,9 +68,8 @@ class STFT {
   void Buffer();
   
  private:
-  FFT* fft_;
+  FftBackend* fft_;
   size_t fft_size_;
-  size_t fft_num_passes_;
   size_t hop_size_;
   size_t buffer_size_;
   float* fft_in_;
@@ -24,69 +24,154 @@
 //
 // -----------------------------------------------------------------------------
 //
-// Sample rate converter
+// Polyphase sample rate converter.
+//
+// ratio > 0 interpolates by ratio, ratio < 0 decimates by -ratio; any integer
+// factor works. The prototype filter is split into sub-filters at Init():
+// when interpolating, output phase p only uses taps p, p + L, p + 2L... so
+// each sub-filter is a short dense FIR and no multiply is spent on the zeros
+// stuffed between input samples. When decimating, an output is only computed
+// every M inputs; its M polyphase components interleave back into the full
+// prototype, which is evaluated as a single contiguous pass over the history.
+//
+// Sub-filters are stored time-reversed and the history is kept as two planar
+// linear buffers (left, right) that are appended to in chunks and shifted
+// once per chunk, so that every output is a unit-stride dot product over
+// contiguous memory - no wrap-around, no duplicated writes.
 
 #ifndef CLOUDS_DSP_SAMPLE_RATE_CONVERTER_H_
 #define CLOUDS_DSP_SAMPLE_RATE_CONVERTER_H_
 
 #include "stmlib/stmlib.h"
 
+#include <algorithm>
+
+#ifdef __SSE2__
+  #include <emmintrin.h>
+#endif  // __SSE2__
+
 #include "clouds/dsp/frame.h"
 
 namespace clouds {
 
+// Stereo dot product sharing the coefficient loads between both channels.
+inline void StereoDotProduct(
+    const float* h,
+    const float* l,
+    const float* r,
+    size_t size,
+    float* out_l,
+    float* out_r) {
+  size_t i = 0;
+#ifdef __SSE2__
+  __m128 acc_l = _mm_setzero_ps();
+  __m128 acc_r = _mm_setzero_ps();
+  for (; i + 4 <= size; i += 4) {
+    __m128 c = _mm_loadu_ps(&h[i]);
+    acc_l = _mm_add_ps(acc_l, _mm_mul_ps(c, _mm_loadu_ps(&l[i])));
+    acc_r = _mm_add_ps(acc_r, _mm_mul_ps(c, _mm_loadu_ps(&r[i])));
+  }
+  float lanes_l[4];
+  float lanes_r[4];
+  _mm_storeu_ps(lanes_l, acc_l);
+  _mm_storeu_ps(lanes_r, acc_r);
+  float y_l = (lanes_l[0] + lanes_l[1]) + (lanes_l[2] + lanes_l[3]);
+  float y_r = (lanes_r[0] + lanes_r[1]) + (lanes_r[2] + lanes_r[3]);
+#else
+  // Independent accumulators keep the FPU pipeline full on the Cortex-M7.
+  float l0 = 0.0f, l1 = 0.0f, r0 = 0.0f, r1 = 0.0f;
+  for (; i + 2 <= size; i += 2) {
+    l0 += h[i] * l[i];
+    r0 += h[i] * r[i];
+    l1 += h[i + 1] * l[i + 1];
+    r1 += h[i + 1] * r[i + 1];
+  }
+  float y_l = l0 + l1;
+  float y_r = r0 + r1;
+#endif  // __SSE2__
+  for (; i < size; ++i) {
+    y_l += h[i] * l[i];
+    y_r += h[i] * r[i];
+  }
+  *out_l = y_l;
+  *out_r = y_r;
+}
+
 template<int32_t ratio, int32_t filter_size, const float* coefficients>
 class SampleRateConverter {
  public:
   SampleRateConverter() { }
   ~SampleRateConverter() { }
- 
+
   void Init() {
-    for (int32_t i = 0; i < filter_size * 2; ++i) {
-      history_[i].l = history_[i].r = 0.0f;
+    const float scale = kUp ? static_cast<float>(kFactor) : 1.0f;
+    for (int32_t p = 0; p < kNumPhases; ++p) {
+      float* sub_filter = &sub_filters_[p * kTapsPerPhase];
+      for (int32_t k = 0; k < kTapsPerPhase; ++k) {
+        int32_t j = p + k * kNumPhases;
+        sub_filter[kTapsPerPhase - 1 - k] = j < filter_size
+            ? coefficients[j] * scale
+            : 0.0f;
+      }
     }
-    std::copy(&coefficients[0], &coefficients[filter_size], &coefficients_[0]);
-    history_ptr_ = filter_size - 1;
+    std::fill(&history_l_[0], &history_l_[kHistorySize + kChunkSize], 0.0f);
+    std::fill(&history_r_[0], &history_r_[kHistorySize + kChunkSize], 0.0f);
   };
 
+  // When decimating, input_size must be a multiple of the factor.
   void Process(const FloatFrame* in, FloatFrame* out, size_t input_size) {
-    int32_t history_ptr = history_ptr_;
-    FloatFrame* history = history_;
-    const float scale = ratio < 0 ? 1.0f : float(ratio);
     while (input_size) {
-      int32_t consumed = ratio < 0 ? -ratio : 1;
-      for (int32_t i = 0; i < consumed; ++i) {
-        history[history_ptr + filter_size] = history[history_ptr] = *in++;
-        --input_size;
-        --history_ptr;
-        if (history_ptr < 0) {
-          history_ptr += filter_size;
-        }
+      size_t n = std::min(input_size, static_cast<size_t>(kChunkSize));
+      for (size_t i = 0; i < n; ++i) {
+        history_l_[kHistorySize + i] = in[i].l;
+        history_r_[kHistorySize + i] = in[i].r;
       }
-    
-      int32_t produced = ratio > 0 ? ratio : 1;
-      for (int32_t i = 0; i < produced; ++i) {
-        float y_l = 0.0f;
-        float y_r = 0.0f;
-        const FloatFrame* x = &history[history_ptr + 1];
-        for (int32_t j = i; j < filter_size; j += produced) {
-          const float h = coefficients_[j];
-          y_l += x->l * h;
-          y_r += x->r * h;
-          ++x;
+      if (kUp) {
+        // The window of kTapsPerPhase samples ending with input i starts at i.
+        for (size_t i = 0; i < n; ++i) {
+          for (int32_t p = 0; p < kFactor; ++p) {
+            StereoDotProduct(
+                &sub_filters_[p * kTapsPerPhase],
+                &history_l_[i],
+                &history_r_[i],
+                kTapsPerPhase,
+                &out->l,
+                &out->r);
+            ++out;
+          }
+        }
+      } else {
+        for (size_t i = kFactor - 1; i < n; i += kFactor) {
+          StereoDotProduct(
+              sub_filters_,
+              &history_l_[i],
+              &history_r_[i],
+              kTapsPerPhase * kNumPhases,
+              &out->l,
+              &out->r);
+          ++out;
         }
-        out->l = y_l * scale;
-        out->r = y_r * scale;
-        ++out;
       }
+      std::copy(&history_l_[n], &history_l_[n + kHistorySize], &history_l_[0]);
+      std::copy(&history_r_[n], &history_r_[n + kHistorySize], &history_r_[0]);
+      in += n;
+      input_size -= n;
     }
-    history_ptr_ = history_ptr;
   }
- 
+
  private:
-  float coefficients_[filter_size];
-  FloatFrame history_[filter_size * 2];
-  int32_t history_ptr_;
+  static const bool kUp = ratio > 0;
+  static const int32_t kFactor = ratio > 0 ? ratio : -ratio;
+  static const int32_t kNumPhases = kUp ? kFactor : 1;
+  static const int32_t kTapsPerPhase = \
+      (filter_size + kNumPhases - 1) / kNumPhases;
+  static const int32_t kHistorySize = kTapsPerPhase - 1;
+  // Input frames per pass, a multiple of the decimation factor.
+  static const int32_t kChunkSize = 32 * (kUp ? 1 : kFactor);
+
+  float sub_filters_[kTapsPerPhase * kNumPhases];
+  float history_l_[kHistorySize + kChunkSize];
+  float history_r_[kHistorySize + kChunkSize];
 
   DISALLOW_COPY_AND_ASSIGN(SampleRateConverter);
 };
@@ -35,6 +35,7 @@
 
 
 #include "stmlib/stmlib.h"
+#include "HotTable.h"
 
 
 
@@ -54,10 +55,14 @@ extern const float src_filter_1x_2_63[];
 extern const float src_filter_1x_2_91[];
 extern const int16_t lut_db[];
 extern const float lut_sin[];
-extern const float lut_window[];
+// Hot tables: the names point at RAM copies once LutResidency has run
+extern HOT_TABLE(float, HOT_LUT_WINDOW) lut_window;
+extern HOT_TABLE(float, HOT_LUT_SINE_WINDOW_4096) lut_sine_window_4096;
+
+extern const float lut_window_flash[];
 extern const float lut_xfade_in[];
 extern const float lut_xfade_out[];
-extern const float lut_sine_window_4096[];
+extern const float lut_sine_window_4096_flash[];
 extern const float lut_cutoff[];
 extern const float lut_grain_size[];
 extern const float lut_quantized_pitch[];
@@ -0,0 +1,108 @@
+// -----------------------------------------------------------------------------
+//
+// Braids macro-oscillator shapes as a Plaits engine.
+
+#include "plaits/dsp/engine/braids_engine.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "braids/macro_oscillator.h"
+
+namespace plaits {
+
+using namespace std;
+using namespace stmlib;
+
+// Braids' pitch tables are computed for 96kHz.
+const float kBraidsSampleRate = 96000.0f;
+// Largest block braids::MacroOscillator renders in one call.
+const size_t kBraidsMaxBlockSize = 24;
+
+static const braids::MacroOscillatorShape kBraidsShapes[] = {
+  braids::MACRO_OSC_SHAPE_CSAW,
+  braids::MACRO_OSC_SHAPE_MORPH,
+  braids::MACRO_OSC_SHAPE_SAW_SQUARE,
+  braids::MACRO_OSC_SHAPE_SINE_TRIANGLE,
+  braids::MACRO_OSC_SHAPE_SQUARE_SUB,
+  braids::MACRO_OSC_SHAPE_SAW_SUB,
+  braids::MACRO_OSC_SHAPE_TRIPLE_SAW,
+  braids::MACRO_OSC_SHAPE_TRIPLE_SQUARE,
+  braids::MACRO_OSC_SHAPE_VOSIM,
+  braids::MACRO_OSC_SHAPE_VOWEL,
+  braids::MACRO_OSC_SHAPE_FM,
+  braids::MACRO_OSC_SHAPE_WAVETABLES,
+};
+
+const int kNumBraidsShapes = sizeof(kBraidsShapes) / sizeof(kBraidsShapes[0]);
+
+static braids::MacroOscillator oscillator_pool[kMaxBraidsEngines];
+static size_t oscillator_pool_size = 0;
+
+static const uint8_t sync_buffer[kBraidsMaxBlockSize] = { 0 };
+
+void BraidsEngine::Init(BufferAllocator* allocator) {
+  if (!oscillator_ && oscillator_pool_size < kMaxBraidsEngines) {
+    oscillator_ = &oscillator_pool[oscillator_pool_size++];
+  }
+  if (oscillator_) {
+    // MacroOscillator::Init() leaves the pitch smoothing and the previous
+    // shape as they were: start from a zeroed oscillator, as at boot.
+    memset(static_cast<void*>(oscillator_), 0, sizeof(*oscillator_));
+  }
+  shape_index_ = 0;
+  Reset();
+}
+
+void BraidsEngine::Reset() {
+  if (oscillator_) {
+    oscillator_->Init();
+    oscillator_->set_shape(kBraidsShapes[shape_index_]);
+  }
+}
+
+void BraidsEngine::Render(
+    const EngineParameters& parameters,
+    float* out,
+    float* aux,
+    size_t size,
+    bool* already_enveloped) {
+  if (!oscillator_) {
+    fill(&out[0], &out[size], 0.0f);
+    fill(&aux[0], &aux[size], 0.0f);
+    return;
+  }
+  
+  // Hysteresis, so that a knob resting on a boundary doesn't flip shapes.
+  float shape = parameters.harmonics * \
+      static_cast<float>(kNumBraidsShapes - 1);
+  if (fabsf(shape - static_cast<float>(shape_index_)) > 0.75f) {
+    shape_index_ = static_cast<int>(shape + 0.5f);
+  }
+  oscillator_->set_shape(kBraidsShapes[shape_index_]);
+  
+  const float pitch_offset = 12.0f * log2f(kBraidsSampleRate / kSampleRate);
+  float pitch = (parameters.note + pitch_offset) * 128.0f;
+  CONSTRAIN(pitch, 0.0f, 16383.0f);
+  oscillator_->set_pitch(static_cast<int16_t>(pitch));
+  oscillator_->set_parameters(
+      static_cast<int16_t>(parameters.timbre * 32767.0f),
+      static_cast<int16_t>(parameters.morph * 32767.0f));
+  if (parameters.trigger & TRIGGER_RISING_EDGE) {
+    oscillator_->Strike();
+  }
+  
+  int16_t buffer[kBraidsMaxBlockSize];
+  while (size) {
+    size_t chunk = min(size, kBraidsMaxBlockSize);
+    oscillator_->Render(sync_buffer, buffer, chunk);
+    for (size_t i = 0; i < chunk; ++i) {
+      out[i] = aux[i] = static_cast<float>(buffer[i]) / 32768.0f;
+    }
+    out += chunk;
+    aux += chunk;
+    size -= chunk;
+  }
+}
+
+}  // namespace plaits
@@ -0,0 +1,47 @@
+// -----------------------------------------------------------------------------
+//
+// Braids macro-oscillator shapes as a Plaits engine. HARMONICS selects the
+// shape, TIMBRE and MORPH drive the two Braids parameters. The shapes are the
+// cheap ones (analog models, VOSIM, vowel, FM, wavetables): a voice costs
+// about half of a typical Plaits engine, which is what lets pad patches run
+// twice the polyphony.
+
+#ifndef PLAITS_DSP_ENGINE_BRAIDS_ENGINE_H_
+#define PLAITS_DSP_ENGINE_BRAIDS_ENGINE_H_
+
+#include "plaits/dsp/engine/engine.h"
+
+namespace braids {
+class MacroOscillator;
+}  // namespace braids
+
+namespace plaits {
+
+// One oscillator per voice. They live in a pool in braids_engine.cc so that
+// braids/resources.h (whose LUT_* macros clash with Plaits') stays out of
+// this header.
+const size_t kMaxBraidsEngines = 8;
+
+class BraidsEngine : public Engine {
+ public:
+  BraidsEngine() : oscillator_(NULL) { }
+  ~BraidsEngine() { }
+  
+  virtual void Init(stmlib::BufferAllocator* allocator);
+  virtual void Reset();
+  virtual void Render(const EngineParameters& parameters,
+      float* out,
+      float* aux,
+      size_t size,
+      bool* already_enveloped);
+  
+ private:
+  braids::MacroOscillator* oscillator_;
+  int shape_index_;
+  
+  DISALLOW_COPY_AND_ASSIGN(BraidsEngine);
+};
+
+}  // namespace plaits
+
+#endif  // PLAITS_DSP_ENGINE_BRAIDS_ENGINE_H_
@@ -87,6 +87,11 @@ class Engine {
       float* aux,
       size_t size,
       bool* already_enveloped) = 0;
+  
+  // Engines drawing random numbers keep their own RandomStream; the voice
+  // seeds it so that each voice renders a reproducible stream of its own.
+  virtual void Seed(uint32_t seed) { }
+  
   PostProcessingSettings post_processing_settings;
 };
 
@@ -104,15 +109,19 @@ class EngineRegistry {
     return engine_[index];
   }
   
+  // cost is the render time relative to a typical engine (1.0). The host
+  // uses it to decide how many voices it can afford on that engine.
   void RegisterInstance(
       Engine* instance,
       bool already_enveloped,
       float out_gain,
-      float aux_gain) {
+      float aux_gain,
+      float cost = 1.0f) {
     if (num_engines_ >= max_size) {
       return;
     }
     engine_[num_engines_] = instance;
+    cost_[num_engines_] = cost;
     PostProcessingSettings* s = &instance->post_processing_settings;
     s->already_enveloped = already_enveloped;
     s->out_gain = out_gain;
@@ -121,9 +130,12 @@ class EngineRegistry {
   }
   
   inline int size() const { return num_engines_; }
+  
+  inline float cost(int index) const { return cost_[index]; }
 
  private:
   Engine* engine_[max_size];
+  float cost_[max_size];
   int num_engines_;
 };
 
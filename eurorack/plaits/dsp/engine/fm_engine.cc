@@ -32,6 +32,10 @@
 
 #include "plaits/resources.h"
 
+#ifdef __SSE2__
+  #include <emmintrin.h>
+#endif  // __SSE2__
+
 namespace plaits {
 
 using namespace stmlib;
@@ -52,7 +56,7 @@ void FMEngine::Reset() {
   
 }
 
-inline float FMEngine::SinePM(uint32_t phase, float fm) const {
+static inline float SinePM(uint32_t phase, float fm) {
   phase += (static_cast<uint32_t>((fm + 4.0f) * 536870912.0f)) << 3;
   uint32_t integral = phase >> 22;
   float fractional = static_cast<float>(phase << 10) / 4294967296.0f;
@@ -97,14 +101,13 @@ class Downsampler {
   DISALLOW_COPY_AND_ASSIGN(Downsampler);
 };
 
-void FMEngine::Render(
+/* static */
+void FMEngine::ComputeTargets(
     const EngineParameters& parameters,
-    float* out,
-    float* aux,
-    size_t size,
-    bool* already_enveloped) {
-  
-  // 4x oversampling
+    float* carrier_frequency,
+    float* modulator_frequency,
+    float* amount,
+    float* feedback) {
   const float note = parameters.note - 24.0f;
   
   const float ratio = Interpolate(
@@ -121,16 +124,39 @@ void FMEngine::Render(
   CONSTRAIN(hf_taming, 0.0f, 1.0f);
   hf_taming *= hf_taming;
   
+  *carrier_frequency = NoteToFrequency(note);
+  *modulator_frequency = target_modulator_frequency;
+  *amount = 2.0f * parameters.timbre * parameters.timbre * hf_taming;
+  *feedback = 2.0f * parameters.morph - 1.0f;
+}
+
+void FMEngine::Render(
+    const EngineParameters& parameters,
+    float* out,
+    float* aux,
+    size_t size,
+    bool* already_enveloped) {
+  
+  // 4x oversampling
+  float target_carrier_frequency;
+  float target_modulator_frequency;
+  float target_amount;
+  float target_feedback;
+  ComputeTargets(
+      parameters,
+      &target_carrier_frequency,
+      &target_modulator_frequency,
+      &target_amount,
+      &target_feedback);
+  
   ParameterInterpolator carrier_frequency(
-      &previous_carrier_frequency_, NoteToFrequency(note), size);
+      &previous_carrier_frequency_, target_carrier_frequency, size);
   ParameterInterpolator modulator_frequency(
       &previous_modulator_frequency_, target_modulator_frequency, size);
   ParameterInterpolator amount_modulation(
-      &previous_amount_,
-      2.0f * parameters.timbre * parameters.timbre * hf_taming,
-      size);
+      &previous_amount_, target_amount, size);
   ParameterInterpolator feedback_modulation(
-      &previous_feedback_, 2.0f * parameters.morph - 1.0f, size);
+      &previous_feedback_, target_feedback, size);
   
   Downsampler carrier_downsampler(&carrier_fir_);
   Downsampler sub_downsampler(&sub_fir_);
@@ -163,4 +189,292 @@ void FMEngine::Render(
   }
 }
 
+// Lock-step rendering. The state of the kFMLockstepVoices engines is copied
+// into structure-of-arrays form for the duration of the block, then written
+// back, so engines can move between Render() and RenderLockstep() freely.
+struct FMLockstepState {
+  uint32_t carrier_phase[kFMLockstepVoices];
+  uint32_t modulator_phase[kFMLockstepVoices];
+  uint32_t sub_phase[kFMLockstepVoices];
+  float previous_sample[kFMLockstepVoices];
+  float carrier_fir[kFMLockstepVoices];
+  float sub_fir[kFMLockstepVoices];
+  
+  float carrier_frequency[kFMLockstepVoices];
+  float modulator_frequency[kFMLockstepVoices];
+  float amount[kFMLockstepVoices];
+  float feedback[kFMLockstepVoices];
+  
+  float carrier_frequency_increment[kFMLockstepVoices];
+  float modulator_frequency_increment[kFMLockstepVoices];
+  float amount_increment[kFMLockstepVoices];
+  float feedback_increment[kFMLockstepVoices];
+};
+
+#ifdef __SSE2__
+
+// Truncating float to uint32 conversion, for values in [0, 2^32).
+static inline __m128i FloatToUint32(__m128 x) {
+  const __m128 two_31 = _mm_set1_ps(2147483648.0f);
+  __m128 high = _mm_cmpge_ps(x, two_31);
+  __m128i low_bits = _mm_cvttps_epi32(_mm_sub_ps(x, _mm_and_ps(high, two_31)));
+  return _mm_xor_si128(low_bits, _mm_slli_epi32(_mm_castps_si128(high), 31));
+}
+
+static inline __m128 SinePM4(__m128i phase, __m128 fm) {
+  phase = _mm_add_epi32(phase, _mm_slli_epi32(FloatToUint32(_mm_mul_ps(
+      _mm_add_ps(fm, _mm_set1_ps(4.0f)), _mm_set1_ps(536870912.0f))), 3));
+  // phase << 10 has only 22 significant bits, so dropping the 8 low zero
+  // bits before the (signed) conversion is exact.
+  __m128 fractional = _mm_mul_ps(
+      _mm_cvtepi32_ps(_mm_srli_epi32(_mm_slli_epi32(phase, 10), 8)),
+      _mm_set1_ps(1.0f / 16777216.0f));
+  uint32_t integral[kFMLockstepVoices];
+  _mm_storeu_si128(
+      reinterpret_cast<__m128i*>(integral), _mm_srli_epi32(phase, 22));
+  __m128 a = _mm_set_ps(
+      lut_sine[integral[3]],
+      lut_sine[integral[2]],
+      lut_sine[integral[1]],
+      lut_sine[integral[0]]);
+  __m128 b = _mm_set_ps(
+      lut_sine[integral[3] + 1],
+      lut_sine[integral[2] + 1],
+      lut_sine[integral[1] + 1],
+      lut_sine[integral[0] + 1]);
+  return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), fractional));
+}
+
+static void RenderLockstepBlock(
+    FMLockstepState* s,
+    float* const* out,
+    float* const* aux,
+    size_t size) {
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 two_32 = _mm_set1_ps(4294967296.0f);
+  
+  __m128i carrier_phase = _mm_loadu_si128(
+      reinterpret_cast<const __m128i*>(s->carrier_phase));
+  __m128i modulator_phase = _mm_loadu_si128(
+      reinterpret_cast<const __m128i*>(s->modulator_phase));
+  __m128i sub_phase = _mm_loadu_si128(
+      reinterpret_cast<const __m128i*>(s->sub_phase));
+  __m128 previous_sample = _mm_loadu_ps(s->previous_sample);
+  __m128 carrier_head = _mm_loadu_ps(s->carrier_fir);
+  __m128 sub_head = _mm_loadu_ps(s->sub_fir);
+  __m128 carrier_tail = zero;
+  __m128 sub_tail = zero;
+  
+  __m128 carrier_frequency = _mm_loadu_ps(s->carrier_frequency);
+  __m128 modulator_frequency = _mm_loadu_ps(s->modulator_frequency);
+  __m128 amount = _mm_loadu_ps(s->amount);
+  __m128 feedback = _mm_loadu_ps(s->feedback);
+  const __m128 carrier_frequency_increment = _mm_loadu_ps(
+      s->carrier_frequency_increment);
+  const __m128 modulator_frequency_increment = _mm_loadu_ps(
+      s->modulator_frequency_increment);
+  const __m128 amount_increment = _mm_loadu_ps(s->amount_increment);
+  const __m128 feedback_increment = _mm_loadu_ps(s->feedback_increment);
+  
+  for (size_t i = 0; i < size; ++i) {
+    amount = _mm_add_ps(amount, amount_increment);
+    feedback = _mm_add_ps(feedback, feedback_increment);
+    carrier_frequency = _mm_add_ps(
+        carrier_frequency, carrier_frequency_increment);
+    modulator_frequency = _mm_add_ps(
+        modulator_frequency, modulator_frequency_increment);
+    
+    __m128 feedback_squared = _mm_mul_ps(feedback, feedback);
+    __m128 phase_feedback = _mm_and_ps(
+        _mm_cmplt_ps(feedback, zero),
+        _mm_mul_ps(_mm_set1_ps(0.5f), feedback_squared));
+    __m128 modulator_fb = _mm_and_ps(
+        _mm_cmpgt_ps(feedback, zero),
+        _mm_mul_ps(_mm_set1_ps(0.25f), feedback_squared));
+    __m128i carrier_increment = FloatToUint32(
+        _mm_mul_ps(two_32, carrier_frequency));
+    __m128i sub_increment = _mm_srli_epi32(carrier_increment, 1);
+    __m128 modulator_increment = _mm_mul_ps(two_32, modulator_frequency);
+    
+    for (size_t j = 0; j < kOversampling; ++j) {
+      modulator_phase = _mm_add_epi32(modulator_phase, FloatToUint32(
+          _mm_mul_ps(modulator_increment, _mm_add_ps(
+              _mm_set1_ps(1.0f),
+              _mm_mul_ps(previous_sample, phase_feedback)))));
+      carrier_phase = _mm_add_epi32(carrier_phase, carrier_increment);
+      sub_phase = _mm_add_epi32(sub_phase, sub_increment);
+      __m128 modulator = SinePM4(
+          modulator_phase, _mm_mul_ps(modulator_fb, previous_sample));
+      __m128 carrier = SinePM4(carrier_phase, _mm_mul_ps(amount, modulator));
+      __m128 sub = SinePM4(sub_phase, _mm_mul_ps(
+          _mm_mul_ps(amount, carrier), _mm_set1_ps(0.25f)));
+      previous_sample = _mm_add_ps(previous_sample, _mm_mul_ps(
+          _mm_set1_ps(0.05f), _mm_sub_ps(carrier, previous_sample)));
+      
+      const __m128 head_coefficient = _mm_set1_ps(fir_coefficient[3 - j]);
+      const __m128 tail_coefficient = _mm_set1_ps(fir_coefficient[j]);
+      carrier_head = _mm_add_ps(
+          carrier_head, _mm_mul_ps(carrier, head_coefficient));
+      carrier_tail = _mm_add_ps(
+          carrier_tail, _mm_mul_ps(carrier, tail_coefficient));
+      sub_head = _mm_add_ps(sub_head, _mm_mul_ps(sub, head_coefficient));
+      sub_tail = _mm_add_ps(sub_tail, _mm_mul_ps(sub, tail_coefficient));
+    }
+    
+    float carrier_out[kFMLockstepVoices];
+    float sub_out[kFMLockstepVoices];
+    _mm_storeu_ps(carrier_out, carrier_head);
+    _mm_storeu_ps(sub_out, sub_head);
+    for (size_t v = 0; v < kFMLockstepVoices; ++v) {
+      out[v][i] = carrier_out[v];
+      aux[v][i] = sub_out[v];
+    }
+    carrier_head = carrier_tail;
+    sub_head = sub_tail;
+    carrier_tail = zero;
+    sub_tail = zero;
+  }
+  
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(s->carrier_phase), carrier_phase);
+  _mm_storeu_si128(
+      reinterpret_cast<__m128i*>(s->modulator_phase), modulator_phase);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(s->sub_phase), sub_phase);
+  _mm_storeu_ps(s->previous_sample, previous_sample);
+  _mm_storeu_ps(s->carrier_fir, carrier_head);
+  _mm_storeu_ps(s->sub_fir, sub_head);
+  _mm_storeu_ps(s->carrier_frequency, carrier_frequency);
+  _mm_storeu_ps(s->modulator_frequency, modulator_frequency);
+  _mm_storeu_ps(s->amount, amount);
+  _mm_storeu_ps(s->feedback, feedback);
+}
+
+#else
+
+// No float SIMD on the Cortex-M7: the voice loop is innermost instead, so
+// that each stage issues four independent dependency chains back to back
+// and the FPU pipeline stays full.
+static void RenderLockstepBlock(
+    FMLockstepState* s,
+    float* const* out,
+    float* const* aux,
+    size_t size) {
+  float carrier_tail[kFMLockstepVoices];
+  float sub_tail[kFMLockstepVoices];
+  float phase_feedback[kFMLockstepVoices];
+  float modulator_fb[kFMLockstepVoices];
+  uint32_t carrier_increment[kFMLockstepVoices];
+  
+  for (size_t i = 0; i < size; ++i) {
+    for (size_t v = 0; v < kFMLockstepVoices; ++v) {
+      s->amount[v] += s->amount_increment[v];
+      s->feedback[v] += s->feedback_increment[v];
+      s->carrier_frequency[v] += s->carrier_frequency_increment[v];
+      s->modulator_frequency[v] += s->modulator_frequency_increment[v];
+      
+      const float feedback = s->feedback[v];
+      phase_feedback[v] = feedback < 0.0f ? 0.5f * feedback * feedback : 0.0f;
+      modulator_fb[v] = feedback > 0.0f ? 0.25f * feedback * feedback : 0.0f;
+      carrier_increment[v] = static_cast<uint32_t>(
+          4294967296.0f * s->carrier_frequency[v]);
+      carrier_tail[v] = 0.0f;
+      sub_tail[v] = 0.0f;
+    }
+    
+    for (size_t j = 0; j < kOversampling; ++j) {
+      const float head_coefficient = fir_coefficient[3 - j];
+      const float tail_coefficient = fir_coefficient[j];
+      for (size_t v = 0; v < kFMLockstepVoices; ++v) {
+        float previous_sample = s->previous_sample[v];
+        s->modulator_phase[v] += static_cast<uint32_t>(4294967296.0f * \
+            s->modulator_frequency[v] * \
+            (1.0f + previous_sample * phase_feedback[v]));
+        s->carrier_phase[v] += carrier_increment[v];
+        s->sub_phase[v] += carrier_increment[v] >> 1;
+        float modulator = SinePM(
+            s->modulator_phase[v], modulator_fb[v] * previous_sample);
+        float carrier = SinePM(
+            s->carrier_phase[v], s->amount[v] * modulator);
+        float sub = SinePM(
+            s->sub_phase[v], s->amount[v] * carrier * 0.25f);
+        ONE_POLE(previous_sample, carrier, 0.05f);
+        s->previous_sample[v] = previous_sample;
+        s->carrier_fir[v] += carrier * head_coefficient;
+        carrier_tail[v] += carrier * tail_coefficient;
+        s->sub_fir[v] += sub * head_coefficient;
+        sub_tail[v] += sub * tail_coefficient;
+      }
+    }
+    
+    for (size_t v = 0; v < kFMLockstepVoices; ++v) {
+      out[v][i] = s->carrier_fir[v];
+      aux[v][i] = s->sub_fir[v];
+      s->carrier_fir[v] = carrier_tail[v];
+      s->sub_fir[v] = sub_tail[v];
+    }
+  }
+}
+
+#endif  // __SSE2__
+
+/* static */
+void FMEngine::RenderLockstep(
+    FMEngine* const* engines,
+    const EngineParameters* parameters,
+    float* const* out,
+    float* const* aux,
+    size_t size) {
+  FMLockstepState s;
+  const float block_size = static_cast<float>(size);
+  
+  for (size_t v = 0; v < kFMLockstepVoices; ++v) {
+    const FMEngine* e = engines[v];
+    float target_carrier_frequency;
+    float target_modulator_frequency;
+    float target_amount;
+    float target_feedback;
+    ComputeTargets(
+        parameters[v],
+        &target_carrier_frequency,
+        &target_modulator_frequency,
+        &target_amount,
+        &target_feedback);
+    
+    s.carrier_phase[v] = e->carrier_phase_;
+    s.modulator_phase[v] = e->modulator_phase_;
+    s.sub_phase[v] = e->sub_phase_;
+    s.previous_sample[v] = e->previous_sample_;
+    s.carrier_fir[v] = e->carrier_fir_;
+    s.sub_fir[v] = e->sub_fir_;
+    
+    // Same increments as ParameterInterpolator.
+    s.carrier_frequency[v] = e->previous_carrier_frequency_;
+    s.modulator_frequency[v] = e->previous_modulator_frequency_;
+    s.amount[v] = e->previous_amount_;
+    s.feedback[v] = e->previous_feedback_;
+    s.carrier_frequency_increment[v] = (
+        target_carrier_frequency - s.carrier_frequency[v]) / block_size;
+    s.modulator_frequency_increment[v] = (
+        target_modulator_frequency - s.modulator_frequency[v]) / block_size;
+    s.amount_increment[v] = (target_amount - s.amount[v]) / block_size;
+    s.feedback_increment[v] = (
+        target_feedback - s.feedback[v]) / block_size;
+  }
+  
+  RenderLockstepBlock(&s, out, aux, size);
+  
+  for (size_t v = 0; v < kFMLockstepVoices; ++v) {
+    FMEngine* e = engines[v];
+    e->carrier_phase_ = s.carrier_phase[v];
+    e->modulator_phase_ = s.modulator_phase[v];
+    e->sub_phase_ = s.sub_phase[v];
+    e->previous_sample_ = s.previous_sample[v];
+    e->carrier_fir_ = s.carrier_fir[v];
+    e->sub_fir_ = s.sub_fir[v];
+    e->previous_carrier_frequency_ = s.carrier_frequency[v];
+    e->previous_modulator_frequency_ = s.modulator_frequency[v];
+    e->previous_amount_ = s.amount[v];
+    e->previous_feedback_ = s.feedback[v];
+  }
+}
+
 }  // namespace plaits
@@ -32,6 +32,8 @@
 #include "plaits/dsp/engine/engine.h"
 
 namespace plaits {
+
+const size_t kFMLockstepVoices = 4;
   
 class FMEngine : public Engine {
  public:
@@ -46,8 +48,24 @@ class FMEngine : public Engine {
       size_t size,
       bool* already_enveloped);
   
+  // Renders kFMLockstepVoices engines side by side, with the oscillator
+  // state of all of them held in one set of registers. Same output as
+  // calling Render() on each engine.
+  static void RenderLockstep(
+      FMEngine* const* engines,
+      const EngineParameters* parameters,
+      float* const* out,
+      float* const* aux,
+      size_t size);
+  
  private:
-  inline float SinePM(uint32_t phase, float fm) const;
+  // Per-block targets shared by Render() and RenderLockstep().
+  static void ComputeTargets(
+      const EngineParameters& parameters,
+      float* carrier_frequency,
+      float* modulator_frequency,
+      float* amount,
+      float* feedback);
   
   uint32_t carrier_phase_;
   uint32_t modulator_phase_;
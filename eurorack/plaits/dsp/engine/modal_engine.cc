@@ -64,6 +64,7 @@ void ModalEngine::Render(
       harmonics_lp_,
       parameters.timbre,
       parameters.morph,
+      &random_,
       temp_buffer_,
       out,
       aux,
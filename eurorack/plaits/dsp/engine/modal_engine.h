@@ -46,9 +46,11 @@ class ModalEngine : public Engine {
       float* aux,
       size_t size,
       bool* already_enveloped);
+  virtual void Seed(uint32_t seed) { random_.Init(seed); }
   
  private:
   ModalVoice voice_;
+  RandomStream random_;
   float* temp_buffer_;
   float harmonics_lp_;
   
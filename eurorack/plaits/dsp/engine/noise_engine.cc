@@ -70,8 +70,9 @@ void NoiseEngine::Render(
       parameters.timbre * (128.0f - clock_lowest_note) + clock_lowest_note);
   const float q = 0.5f * SemitonesToRatio(parameters.morph * 120.0f);
   const bool sync = parameters.trigger & TRIGGER_RISING_EDGE;
-  clocked_noise_[0].Render(sync, clock_f, aux, size);
-  clocked_noise_[1].Render(sync, clock_f * f1 / f0, temp_buffer_, size);
+  clocked_noise_[0].Render(sync, clock_f, &random_, aux, size);
+  clocked_noise_[1].Render(
+      sync, clock_f * f1 / f0, &random_, temp_buffer_, size);
   
   ParameterInterpolator f0_modulation(&previous_f0_, f0, size);
   ParameterInterpolator f1_modulation(&previous_f1_, f1, size);
@@ -48,9 +48,11 @@ class NoiseEngine : public Engine {
       float* aux,
       size_t size,
       bool* already_enveloped);
+  virtual void Seed(uint32_t seed) { random_.Init(seed); }
   
  private:
   ClockedNoise clocked_noise_[2];
+  RandomStream random_;
   stmlib::Svf lp_hp_filter_;
   stmlib::Svf bp_filter_[2];
   
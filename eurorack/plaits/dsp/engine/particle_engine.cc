@@ -81,6 +81,7 @@ void ParticleEngine::Render(
         f0,
         spread,
         q,
+        &random_,
         out,
         aux,
         size);
@@ -49,9 +49,11 @@ class ParticleEngine : public Engine {
       float* aux,
       size_t size,
       bool* already_enveloped);
+  virtual void Seed(uint32_t seed) { random_.Init(seed); }
 
  private:
   Particle particle_[kNumParticles];
+  RandomStream random_;
   Diffuser diffuser_;
   stmlib::Svf post_filter_;
   
@@ -81,6 +81,7 @@ void StringEngine::Render(
         parameters.harmonics,
         parameters.timbre * parameters.timbre,
         parameters.morph,
+        &random_,
         temp_buffer_,
         out,
         aux,
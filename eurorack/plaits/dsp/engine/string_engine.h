@@ -48,9 +48,11 @@ class StringEngine : public Engine {
       float* aux,
       size_t size,
       bool* already_enveloped);
+  virtual void Seed(uint32_t seed) { random_.Init(seed); }
 
  private:
   StringVoice voice_[kNumStrings];
+  RandomStream random_;
 
   float f0_[kNumStrings];
   DelayLine<float, 16> f0_delay_;
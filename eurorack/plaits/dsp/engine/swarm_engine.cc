@@ -74,6 +74,7 @@ void SwarmEngine::Render(
         start_burst,
         spread,
         size_ratio,
+        &random_,
         out,
         aux,
         size);
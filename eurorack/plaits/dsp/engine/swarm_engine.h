@@ -31,13 +31,13 @@
 
 #include "stmlib/dsp/polyblep.h"
 #include "stmlib/dsp/units.h"
-#include "stmlib/utils/random.h"
 
 #include "plaits/dsp/engine/engine.h"
 #include "plaits/dsp/oscillator/oscillator.h"
 #include "plaits/dsp/oscillator/string_synth_oscillator.h"
 #include "plaits/dsp/oscillator/sine_oscillator.h"
 #include "plaits/resources.h"
+#include "RandomStream.h"
 
 namespace plaits {
 
@@ -57,7 +57,11 @@ class GrainEnvelope {
     previous_size_ratio_ = 0.0f;
   }
   
-  inline void Step(float rate, bool burst_mode, bool start_burst) {
+  inline void Step(
+      float rate,
+      bool burst_mode,
+      bool start_burst,
+      RandomStream* random) {
     bool randomize = false;
     if (start_burst) {
       phase_ = 0.5f;
@@ -73,12 +77,12 @@ class GrainEnvelope {
     
     if (randomize) {
       from_ += interval_;
-      interval_ = stmlib::Random::GetFloat() - from_;
+      interval_ = random->GetFloat() - from_;
       // Randomize the duration of the grain.
       if (burst_mode) {
-        fm_ *= 0.8f + 0.2f * stmlib::Random::GetFloat();
+        fm_ *= 0.8f + 0.2f * random->GetFloat();
       } else {
-        fm_ = 0.5f + 1.5f * stmlib::Random::GetFloat();
+        fm_ = 0.5f + 1.5f * random->GetFloat();
       }
     }
   }
@@ -205,10 +209,11 @@ class SwarmVoice {
       bool start_burst,
       float spread,
       float size_ratio,
+      RandomStream* random,
       float* saw,
       float* sine,
       size_t size) {
-    envelope_.Step(density, burst_mode, start_burst);
+    envelope_.Step(density, burst_mode, start_burst, random);
     
     const float scale = 1.0f / kNumSwarmVoices;
     const float amplitude = envelope_.amplitude(size_ratio) * scale;
@@ -243,9 +248,11 @@ class SwarmEngine : public Engine {
       float* aux,
       size_t size,
       bool* already_enveloped);
+  virtual void Seed(uint32_t seed) { random_.Init(seed); }
   
  private:
   SwarmVoice swarm_voice_[kNumSwarmVoices];
+  RandomStream random_;
   
   DISALLOW_COPY_AND_ASSIGN(SwarmEngine);
 };
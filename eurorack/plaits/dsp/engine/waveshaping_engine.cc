@@ -107,6 +107,8 @@ void WaveshapingEngine::Render(
     
     const int16_t* shape_1 = lookup_table_i16_table[shape_integral];
     const int16_t* shape_2 = lookup_table_i16_table[shape_integral + 1];
+    HOT_TABLE_COUNT(HotTableId(HOT_LUT_WS_INVERSE_TAN + shape_integral), 1);
+    HOT_TABLE_COUNT(HotTableId(HOT_LUT_WS_INVERSE_TAN + shape_integral + 1), 1);
     
     float ws_index = 127.0f * out[i] + 128.0f;
     MAKE_INTEGRAL_FRACTIONAL(ws_index)
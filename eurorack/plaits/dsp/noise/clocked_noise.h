@@ -32,7 +32,8 @@
 #include "stmlib/dsp/dsp.h"
 #include "stmlib/dsp/parameter_interpolator.h"
 #include "stmlib/dsp/polyblep.h"
-#include "stmlib/utils/random.h"
+
+#include "RandomStream.h"
 
 namespace plaits {
 
@@ -48,9 +49,17 @@ class ClockedNoise {
     frequency_ = 0.001f;
   }
 
-  void Render(bool sync, float frequency, float* out, size_t size) {
+  void Render(
+      bool sync,
+      float frequency,
+      RandomStream* random,
+      float* out,
+      size_t size) {
     CONSTRAIN(frequency, 0.0f, 1.0f);
     
+    // Each sample's draw is read from out before it is overwritten.
+    random->FillUniform(out, size);
+    
     stmlib::ParameterInterpolator fm(&frequency_, frequency, size);
 
     float next_sample = next_sample_;
@@ -60,12 +69,12 @@ class ClockedNoise {
       phase_ = 1.0f;
     }
 
-    while (size--) {
+    for (size_t i = 0; i < size; ++i) {
       float this_sample = next_sample;
       next_sample = 0.0f;
 
       const float frequency = fm.Next();
-      const float raw_sample = stmlib::Random::GetFloat() * 2.0f - 1.0f;
+      const float raw_sample = out[i] * 2.0f - 1.0f;
       float raw_amount = 4.0f * (frequency - 0.25f);
       CONSTRAIN(raw_amount, 0.0f, 1.0f);
       
@@ -81,7 +90,7 @@ class ClockedNoise {
         sample = new_sample;
       }
       next_sample += sample;
-      *out++ = this_sample + raw_amount * (raw_sample - this_sample);
+      out[i] = this_sample + raw_amount * (raw_sample - this_sample);
     }
     next_sample_ = next_sample;
     sample_ = sample;
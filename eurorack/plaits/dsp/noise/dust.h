@@ -29,13 +29,11 @@
 #ifndef PLAITS_DSP_NOISE_DUST_H_
 #define PLAITS_DSP_NOISE_DUST_H_
 
-#include "stmlib/utils/random.h"
-
 namespace plaits {
 
-inline float Dust(float frequency) {
+// u is a uniform draw in [0, 1); callers fill a block of them at once.
+inline float Dust(float u, float frequency) {
   float inv_frequency = 1.0f / frequency;
-  float u = stmlib::Random::GetFloat();
   if (u < frequency) {
     return u * inv_frequency;
   } else {
@@ -31,7 +31,9 @@
 
 #include "stmlib/dsp/dsp.h"
 #include "stmlib/dsp/filter.h"
-#include "stmlib/utils/random.h"
+
+#include "plaits/dsp/dsp.h"
+#include "RandomStream.h"
 
 namespace plaits {
 
@@ -52,20 +54,22 @@ class Particle {
       float frequency,
       float spread,
       float q,
+      RandomStream* random,
       float* out,
       float* aux,
       size_t size) {
-    float u = stmlib::Random::GetFloat();
+    float u[kMaxBlockSize];
+    random->FillUniform(u, size);
     if (sync) {
-      u = density;
+      u[0] = density;
     }
     bool can_radomize_frequency = true;
-    while (size--) {
+    for (size_t i = 0; i < size; ++i) {
       float s = 0.0f;
-      if (u <= density) {
-        s = u * gain;
+      if (u[i] <= density) {
+        s = u[i] * gain;
         if (can_radomize_frequency) {
-          const float u = 2.0f * stmlib::Random::GetFloat() - 1.0f;
+          const float u = 2.0f * random->GetFloat() - 1.0f;
           const float f = std::min(
               stmlib::SemitonesToRatio(spread * u) * frequency,
               0.25f);
@@ -77,7 +81,6 @@ class Particle {
       }
       *aux++ += s;
       *out++ += filter_.Process<stmlib::FILTER_MODE_BAND_PASS>(pre_gain_ * s);
-      u = stmlib::Random::GetFloat();
     }
   }
  
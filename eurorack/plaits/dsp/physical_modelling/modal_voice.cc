@@ -57,6 +57,7 @@ void ModalVoice::Render(
     float structure,
     float brightness,
     float damping,
+    RandomStream* random,
     float* temp,
     float* out,
     float* aux,
@@ -76,8 +77,9 @@ void ModalVoice::Render(
   // Synthesize excitation signal.
   if (sustain) {
     const float dust_f = 0.00005f + 0.99995f * density * density;
+    random->FillUniform(temp, size);
     for (size_t i = 0; i < size; ++i) {
-      temp[i] = Dust(dust_f) * (4.0f - dust_f * 3.0f) * accent;
+      temp[i] = Dust(temp[i], dust_f) * (4.0f - dust_f * 3.0f) * accent;
     }
   } else {
     fill(&temp[0], &temp[size], 0.0f);
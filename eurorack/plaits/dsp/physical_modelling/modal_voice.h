@@ -34,6 +34,7 @@
 #define PLAITS_DSP_PHYSICAL_MODELLING_MODAL_VOICE_H_
 
 #include "plaits/dsp/physical_modelling/resonator.h"
+#include "RandomStream.h"
 
 namespace plaits {
 
@@ -51,6 +52,7 @@ class ModalVoice {
       float structure,
       float brightness,
       float damping,
+      RandomStream* random,
       float* temp,
       float* out,
       float* aux,
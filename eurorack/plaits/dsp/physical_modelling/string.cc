@@ -33,7 +33,6 @@
 #include "stmlib/dsp/dsp.h"
 #include "stmlib/dsp/parameter_interpolator.h"
 #include "stmlib/dsp/units.h"
-#include "stmlib/utils/random.h"
 
 #include "plaits/dsp/dsp.h"
 #include "plaits/resources.h"
@@ -66,15 +65,18 @@ void String::Process(
     float non_linearity_amount,
     float brightness,
     float damping,
+    RandomStream* random,
     const float* in,
     float* out,
     size_t size) {
   if (non_linearity_amount <= 0.0f) {
     ProcessInternal<STRING_NON_LINEARITY_CURVED_BRIDGE>(
-        f0, -non_linearity_amount, brightness, damping, in, out, size);
+        f0, -non_linearity_amount, brightness, damping, random, in, out,
+        size);
   } else {
     ProcessInternal<STRING_NON_LINEARITY_DISPERSION>(
-        f0, non_linearity_amount, brightness, damping, in, out, size);
+        f0, non_linearity_amount, brightness, damping, random, in, out,
+        size);
   }
 }
 
@@ -84,6 +86,7 @@ void String::ProcessInternal(
     float non_linearity_amount,
     float brightness,
     float damping,
+    RandomStream* random,
     const float* in,
     float* out,
     size_t size) {
@@ -146,7 +149,7 @@ void String::ProcessInternal(
       float s = 0.0f;
       
       if (non_linearity == STRING_NON_LINEARITY_DISPERSION) {
-        float noise = Random::GetFloat() - 0.5f;
+        float noise = random->GetFloat() - 0.5f;
         ONE_POLE(dispersion_noise_, noise, noise_filter)
         delay *= 1.0f + dispersion_noise_ * noise_amount;
       } else {
@@ -37,6 +37,7 @@
 #include "stmlib/utils/buffer_allocator.h"
 
 #include "plaits/dsp/physical_modelling/delay_line.h"
+#include "RandomStream.h"
 
 namespace plaits {
 
@@ -59,6 +60,7 @@ class String {
       float non_linearity_amount,
       float brightness,
       float damping,
+      RandomStream* random,
       const float* in,
       float* out,
       size_t size);
@@ -70,6 +72,7 @@ class String {
       float non_linearity_amount,
       float brightness,
       float damping,
+      RandomStream* random,
       const float* in,
       float* out,
       size_t size);
@@ -31,7 +31,6 @@
 #include <algorithm>
 
 #include "stmlib/dsp/units.h"
-#include "stmlib/utils/random.h"
 
 #include "plaits/dsp/noise/dust.h"
 
@@ -58,6 +57,7 @@ void StringVoice::Render(
     float structure,
     float brightness,
     float damping,
+    RandomStream* random,
     float* temp,
     float* out,
     float* aux,
@@ -81,20 +81,19 @@ void StringVoice::Render(
 
   if (sustain) {
     const float dust_f = 0.00005f + 0.99995f * density * density;
+    random->FillUniform(temp, size);
     for (size_t i = 0; i < size; ++i) {
-      temp[i] = Dust(dust_f) * (8.0f - dust_f * 6.0f) * accent;
+      temp[i] = Dust(temp[i], dust_f) * (8.0f - dust_f * 6.0f) * accent;
     }
   } else if (remaining_noise_samples_) {
     size_t noise_samples = min(remaining_noise_samples_, size);
     remaining_noise_samples_ -= noise_samples;
     size_t tail = size - noise_samples;
-    float* start = temp;
-    while (noise_samples--) {
-      *start++ = 2.0f * Random::GetFloat() - 1.0f;
-    }
-    while (tail--) {
-      *start++ = 0.0f;
+    random->FillUniform(temp, noise_samples);
+    for (size_t i = 0; i < noise_samples; ++i) {
+      temp[i] = 2.0f * temp[i] - 1.0f;
     }
+    fill(&temp[noise_samples], &temp[noise_samples + tail], 0.0f);
   } else {
     fill(&temp[0], &temp[size], 0.0f);
   }
@@ -107,7 +106,8 @@ void StringVoice::Render(
   float non_linearity = structure < 0.24f
       ? (structure - 0.24f) * 4.166f
       : (structure > 0.26f ? (structure - 0.26f) * 1.35135f : 0.0f);
-  string_.Process(f0, non_linearity, brightness, damping, temp, out, size);
+  string_.Process(
+      f0, non_linearity, brightness, damping, random, temp, out, size);
 }
 
 }  // namespace plaits
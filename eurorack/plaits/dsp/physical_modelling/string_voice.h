@@ -33,6 +33,7 @@
 #include "stmlib/utils/buffer_allocator.h"
 
 #include "plaits/dsp/physical_modelling/string.h"
+#include "RandomStream.h"
 
 namespace plaits {
 
@@ -51,6 +52,7 @@ class StringVoice {
       float structure,
       float brightness,
       float damping,
+      RandomStream* random,
       float* temp,
       float* out,
       float* aux,
@@ -52,6 +52,10 @@ void Voice::Init(BufferAllocator* allocator) {
   engines_.RegisterInstance(&bass_drum_engine_, true, 0.8f, 0.8f);
   engines_.RegisterInstance(&snare_drum_engine_, true, 0.8f, 0.8f);
   engines_.RegisterInstance(&hi_hat_engine_, true, 0.8f, 0.8f);
+  
+  // Pad engines, cheap enough to run twice the voices; the lower gain keeps
+  // the mix of eight voices level with four Plaits voices.
+  engines_.RegisterInstance(&braids_engine_, false, 0.4f, 0.4f, 0.5f);
   for (int i = 0; i < engines_.size(); ++i) {
     // All engines will share the same RAM space.
     allocator->Free();
@@ -74,11 +78,59 @@ void Voice::Init(BufferAllocator* allocator) {
   trigger_delay_.Init(trigger_delay_line_);
 }
 
+void Voice::Seed(uint32_t seed) {
+  for (int i = 0; i < engines_.size(); ++i) {
+    engines_.get(i)->Seed(seed);
+  }
+}
+
 void Voice::Render(
     const Patch& patch,
     const Modulations& modulations,
     Frame* frames,
     size_t size) {
+  EngineParameters p;
+  BeginRender(patch, modulations, &p, size);
+  RenderEngine(p, size);
+  EndRender(patch, modulations, p, frames, size);
+}
+
+void Voice::RenderEngine(const EngineParameters& parameters, size_t size) {
+  engines_.get(previous_engine_index_)->Render(
+      parameters, out_buffer_, aux_buffer_, size, &already_enveloped_);
+}
+
+bool Voice::RenderLockstep(
+    Voice* const* voices,
+    const EngineParameters* parameters,
+    size_t size) {
+  int engine_index = voices[0]->previous_engine_index_;
+  for (size_t i = 1; i < kLockstepVoices; ++i) {
+    if (voices[i]->previous_engine_index_ != engine_index) {
+      return false;
+    }
+  }
+  if (engine_index != kFMEngineIndex) {
+    return false;
+  }
+  
+  FMEngine* engines[kLockstepVoices];
+  float* out[kLockstepVoices];
+  float* aux[kLockstepVoices];
+  for (size_t i = 0; i < kLockstepVoices; ++i) {
+    engines[i] = &voices[i]->fm_engine_;
+    out[i] = voices[i]->out_buffer_;
+    aux[i] = voices[i]->aux_buffer_;
+  }
+  FMEngine::RenderLockstep(engines, parameters, out, aux, size);
+  return true;
+}
+
+int Voice::BeginRender(
+    const Patch& patch,
+    const Modulations& modulations,
+    EngineParameters* parameters,
+    size_t size) {
   // Trigger, LPG, internal envelope.
       
   // Delay trigger by 1ms to deal with sequencers or MIDI interfaces whose
@@ -119,7 +171,7 @@ void Voice::Render(
     out_post_processor_.Reset();
     previous_engine_index_ = engine_index;
   }
-  EngineParameters p;
+  EngineParameters& p = *parameters;
 
   bool rising_edge = trigger_state_ && !previous_trigger_state;
   float note = (modulations.note + previous_note_) * 0.5f;
@@ -132,15 +184,12 @@ void Voice::Render(
     p.trigger = TRIGGER_UNPATCHED;
   }
   
-  const float short_decay = (200.0f * kBlockSize) / kSampleRate *
+  short_decay_ = (200.0f * kBlockSize) / kSampleRate *
       SemitonesToRatio(-96.0f * patch.decay);
 
-  decay_envelope_.Process(short_decay * 2.0f);
+  decay_envelope_.Process(short_decay_ * 2.0f);
 
-  const float compressed_level = max(
-      1.3f * modulations.level / (0.3f + fabsf(modulations.level)),
-      0.0f);
-  p.accent = modulations.level_patched ? compressed_level : 0.8f;
+  p.accent = modulations.level_patched ? CompressedLevel(modulations) : 0.8f;
 
   bool use_internal_envelope = modulations.trigger_patched;
 
@@ -195,23 +244,34 @@ void Voice::Render(
       0.0f,
       1.0f);
 
-  bool already_enveloped = pp_s.already_enveloped;
-  e->Render(p, out_buffer_, aux_buffer_, size, &already_enveloped);
+  already_enveloped_ = pp_s.already_enveloped;
+  return engine_index;
+}
+
+void Voice::EndRender(
+    const Patch& patch,
+    const Modulations& modulations,
+    const EngineParameters& p,
+    Frame* frames,
+    size_t size) {
+  const PostProcessingSettings& pp_s = \
+      engines_.get(previous_engine_index_)->post_processing_settings;
   
-  bool lpg_bypass = already_enveloped || \
+  bool lpg_bypass = already_enveloped_ || \
       (!modulations.level_patched && !modulations.trigger_patched);
   
   // Compute LPG parameters.
   if (!lpg_bypass) {
     const float hf = patch.lpg_colour;
     const float decay_tail = (20.0f * kBlockSize) / kSampleRate *
-        SemitonesToRatio(-72.0f * patch.decay + 12.0f * hf) - short_decay;
+        SemitonesToRatio(-72.0f * patch.decay + 12.0f * hf) - short_decay_;
     
     if (modulations.level_patched) {
-      lpg_envelope_.ProcessLP(compressed_level, short_decay, decay_tail, hf);
+      lpg_envelope_.ProcessLP(
+          CompressedLevel(modulations), short_decay_, decay_tail, hf);
     } else {
       const float attack = NoteToFrequency(p.note) * float(size) * 2.0f;
-      lpg_envelope_.ProcessPing(attack, short_decay, decay_tail, hf);
+      lpg_envelope_.ProcessPing(attack, short_decay_, decay_tail, hf);
     }
   }
   
@@ -37,6 +37,7 @@
 
 #include "plaits/dsp/engine/additive_engine.h"
 #include "plaits/dsp/engine/bass_drum_engine.h"
+#include "plaits/dsp/engine/braids_engine.h"
 #include "plaits/dsp/engine/chord_engine.h"
 #include "plaits/dsp/engine/engine.h"
 #include "plaits/dsp/engine/fm_engine.h"
@@ -59,9 +60,12 @@
 
 namespace plaits {
 
-const int kMaxEngines = 16;
+const int kMaxEngines = 24;
 const int kMaxTriggerDelay = 8;
 const int kTriggerDelay = 5;
+const int kFMEngineIndex = 2;
+const int kBraidsEngineIndex = 16;
+const size_t kLockstepVoices = kFMLockstepVoices;
 
 class ChannelPostProcessor {
  public:
@@ -162,13 +166,47 @@ class Voice {
       const Modulations& modulations,
       Frame* frames,
       size_t size);
+  
+  // Render() split into its three stages, so that a caller holding
+  // kLockstepVoices voices can run the engine stage of all of them at once
+  // with RenderLockstep(). BeginRender() returns the engine index.
+  int BeginRender(
+      const Patch& patch,
+      const Modulations& modulations,
+      EngineParameters* parameters,
+      size_t size);
+  void RenderEngine(const EngineParameters& parameters, size_t size);
+  void EndRender(
+      const Patch& patch,
+      const Modulations& modulations,
+      const EngineParameters& parameters,
+      Frame* frames,
+      size_t size);
+  
+  // Returns false, without rendering anything, when the voices are not all
+  // on the same engine or when that engine has no lock-step implementation.
+  static bool RenderLockstep(
+      Voice* const* voices,
+      const EngineParameters* parameters,
+      size_t size);
+  
+  // Gives every engine of this voice its own deterministic random stream.
+  void Seed(uint32_t seed);
+  
   inline int active_engine() const { return previous_engine_index_; }
   
   inline int GetNumEngines() const{ return engines_.size(); }
+  inline float GetEngineCost(int index) const { return engines_.cost(index); }
 
  private:
   void ComputeDecayParameters(const Patch& settings);
   
+  static inline float CompressedLevel(const Modulations& modulations) {
+    return std::max(
+        1.3f * modulations.level / (0.3f + fabsf(modulations.level)),
+        0.0f);
+  }
+  
   inline float ApplyModulations(
       float base_value,
       float modulation_amount,
@@ -195,6 +233,7 @@ class Voice {
   
   AdditiveEngine additive_engine_;
   BassDrumEngine bass_drum_engine_;
+  BraidsEngine braids_engine_;
   ChordEngine chord_engine_;
   FMEngine fm_engine_;
   GrainEngine grain_engine_;
@@ -218,6 +257,10 @@ class Voice {
   float previous_note_;
   bool trigger_state_;
   
+  // Carried from BeginRender() to EndRender().
+  float short_decay_;
+  bool already_enveloped_;
+  
   DecayEnvelope decay_envelope_;
   LPGEnvelope lpg_envelope_;
   
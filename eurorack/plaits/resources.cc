@@ -34,7 +34,7 @@
 
 namespace plaits {
 
-const float lut_sine[] = {
+const float lut_sine_flash[] = {
    0.000000000e+00,  6.135884649e-03,  1.227153829e-02,  1.840672991e-02,
    2.454122852e-02,  3.067480318e-02,  3.680722294e-02,  4.293825693e-02,
    4.906767433e-02,  5.519524435e-02,  6.132073630e-02,  6.744391956e-02,
@@ -392,7 +392,7 @@ const float lut_fm_frequency_quantizer[] = {
    3.525000000e+01,  3.600000000e+01,  3.600000000e+01,  3.600000000e+01,
    3.600000000e+01,
 };
-const float lut_fold[] = {
+const float lut_fold_flash[] = {
   -9.980545825e-01, -9.970653772e-01, -9.960649692e-01, -9.950532582e-01,
   -9.940301939e-01, -9.929957802e-01, -9.919500809e-01, -9.908932239e-01,
   -9.898254054e-01, -9.887468930e-01, -9.876580288e-01, -9.865592310e-01,
@@ -523,7 +523,7 @@ const float lut_fold[] = {
    9.940301939e-01,  9.950532582e-01,  9.960649692e-01,  9.970653772e-01,
    9.980545825e-01,  9.990327291e-01,  1.000000000e+00,  1.000000000e+00,
 };
-const float lut_fold_2[] = {
+const float lut_fold_2_flash[] = {
    1.000000000e+00,  9.992967758e-01,  9.985815484e-01,  9.978540078e-01,
    9.971138332e-01,  9.963606927e-01,  9.955942426e-01,  9.948141269e-01,
    9.940199768e-01,  9.932114103e-01,  9.923880310e-01,  9.915494283e-01,
@@ -673,7 +673,7 @@ const float lut_stiffness[] = {
    1.048005353e+00,  1.183990632e+00,  1.457101344e+00,  2.000000000e+00,
    2.000000000e+00,
 };
-const float lut_svf_shift[] = {
+const float lut_svf_shift_flash[] = {
    7.500000000e-01,  7.591880421e-01,  7.683455389e-01,  7.774424499e-01,
    7.864497239e-01,  7.953397451e-01,  8.040867240e-01,  8.126670211e-01,
    8.210593968e-01,  8.292451828e-01,  8.372083767e-01,  8.449356653e-01,
@@ -743,12 +743,12 @@ const float lut_svf_shift[] = {
 
 
 const float* lookup_table_table[] = {
-  lut_sine,
+  lut_sine_flash,
   lut_fm_frequency_quantizer,
-  lut_fold,
-  lut_fold_2,
+  lut_fold_flash,
+  lut_fold_2_flash,
   lut_stiffness,
-  lut_svf_shift,
+  lut_svf_shift_flash,
 };
 
 const int16_t lut_ws_inverse_tan[] = {
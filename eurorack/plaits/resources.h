@@ -36,6 +36,7 @@
 
 #include "stmlib/stmlib.h"
 #include "dev/sdram.h" // Changed from daisy_core.h to ensure DSY_SDRAM_BSS is defined
+#include "HotTable.h"
 
 
 
@@ -53,12 +54,18 @@ extern const int16_t* wavetables_table[];
 
 extern DSY_SDRAM_BSS int16_t wav_integrated_waves[49920]; // Moved to SDRAM
 
-extern const float lut_sine[];
+// Hot tables: the names point at RAM copies once LutResidency has run
+extern HOT_TABLE(float, HOT_LUT_SINE) lut_sine;
+extern HOT_TABLE(float, HOT_LUT_FOLD) lut_fold;
+extern HOT_TABLE(float, HOT_LUT_FOLD_2) lut_fold_2;
+extern HOT_TABLE(float, HOT_LUT_SVF_SHIFT) lut_svf_shift;
+
+extern const float lut_sine_flash[];
 extern const float lut_fm_frequency_quantizer[];
-extern const float lut_fold[];
-extern const float lut_fold_2[];
+extern const float lut_fold_flash[];
+extern const float lut_fold_2_flash[];
 extern const float lut_stiffness[];
-extern const float lut_svf_shift[];
+extern const float lut_svf_shift_flash[];
 extern const int16_t lut_ws_inverse_tan[];
 extern const int16_t lut_ws_inverse_sin[];
 extern const int16_t lut_ws_linear[];
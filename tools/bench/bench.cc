@@ -0,0 +1,741 @@
+// Host microbenchmarks: every Plaits engine at a few HARMONICS/TIMBRE/MORPH
+// points, every Clouds playback mode and quality, VoiceEnvelope, the
+// arpeggiator and the effects (vocoder insert included), each at block sizes 8, 16, 32 and 64.
+//
+// Inputs are generated from fixed seeds, so runs are comparable over time.
+// Each measurement is the best of kRepeats timed passes over --samples
+// samples, after a warm-up pass. Modules whose maximum block is 32 render a
+// 64-sample block as two calls, as the firmware would have to.
+//
+// Output is one JSON document on stdout:
+//   ns_per_sample      wall time per output sample
+//   cycles_per_sample  TSC cycles per sample (x86 only, else null)
+//   core_load          share of one host core at 32 kHz
+// The host is much faster than the Daisy; compare core_load between entries
+// (an engine at twice the load of another fits half as many voices) rather
+// than against 1.0.
+//
+//   make -C tools/bench && tools/bench/bench > bench.json
+//   tools/bench/bench --filter plaits/swarm --samples 4000
+//
+// --journal FILE replays a control journal dumped by the firmware
+// (ControlJournal.h, tools/telemetry_decode.py --journal) instead: the same
+// touch, knob, engine, layout, arp and freeze inputs, block for block, go
+// through the firmware's control path (ControlPath.cpp, PolyphonyEngine) and
+// Clouds, and the result lists the slowest blocks by journal block number.
+// What the journal does not hold is the device's state at its first keyframe
+// (voices still ringing, the Clouds buffer, noise generators), so a replay
+// from the middle of a session starts from a clean synth.
+//
+// The replay covers the block only up to and including Clouds. The idle
+// detector, vocoder insert, echo and post reverb are wired up in
+// AudioProcessor.cpp and DelayEffect.cpp, which include Thaumazein.h and so
+// need libDaisy; they are not run, and their cost is not in the timings. The
+// vocoder source is journaled all the same.
+//
+// --record-journal FILE plays a scripted session through the same path and
+// writes its journal; --render FILE saves the voice mix and the Clouds output
+// of either mode. make test records a session and checks that replaying its
+// journal in a new process renders the same bytes.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_CYCLE_COUNTER
+#endif
+
+#include "Arpeggiator.h"
+#include "BiquadFilters.h"
+#include "ControlJournal.h"
+#include "ControlPath.h"
+#include "EchoDelay.h"
+#include "LutResidency.h"
+#include "VocoderInsert.h"
+#include "Polyphony.h"
+#include "VoiceEnvelope.h"
+#include "reverbsc.h"
+#include "reverbsc16.h"
+#include "clouds/dsp/granular_processor.h"
+#include "plaits/dsp/voice.h"
+
+static const float kSampleRate = 32000.0f;
+static const size_t kBlockSizes[] = { 8, 16, 32, 64 };
+static const size_t kMaxBlock = 64;
+static const int kRepeats = 3;
+// Percussive engines and envelopes are retriggered this often; a multiple of
+// every block size.
+static const size_t kTriggerInterval = 8000;
+// As in Thaumazein.h
+static const size_t kCloudsGrainStagingSize = 4096;
+static const size_t kMaxDelaySamples = 48000;
+
+struct Point {
+  float harmonics;
+  float timbre;
+  float morph;
+};
+
+static const Point kPoints[] = {
+  { 0.1f, 0.1f, 0.1f },
+  { 0.5f, 0.5f, 0.5f },
+  { 0.9f, 0.9f, 0.9f },
+  { 0.9f, 0.1f, 0.5f },
+  { 0.1f, 0.9f, 0.5f },
+};
+
+static size_t num_samples = 16000;
+static const char* filter = NULL;
+static bool first_result = true;
+
+// Fixed-seed test signal: noise plus a slow sine, looped.
+static const size_t kSignalSize = 4096;
+static float test_signal[kSignalSize];
+
+static void InitSignal() {
+  uint32_t rng = 1;
+  for (size_t i = 0; i < kSignalSize; ++i) {
+    rng = rng * 1664525u + 1013904223u;
+    float noise = static_cast<float>(rng >> 8) / 16777216.0f - 0.5f;
+    test_signal[i] = 0.25f * noise + 0.4f * sinf(i * 2.0f * 3.14159265f / 256.0f);
+  }
+}
+
+static inline const float* Signal(size_t* position, size_t size) {
+  if (*position + size > kSignalSize) {
+    *position = 0;
+  }
+  const float* s = &test_signal[*position];
+  *position += size;
+  return s;
+}
+
+static inline uint64_t Cycles() {
+#ifdef HAVE_CYCLE_COUNTER
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+// Times render(block_size) and prints one result object. params is a JSON
+// object, or NULL.
+template<typename Render>
+static void Measure(
+    const char* group,
+    const char* name,
+    const char* params,
+    size_t block_size,
+    Render render) {
+  char full_name[128];
+  snprintf(full_name, sizeof(full_name), "%s/%s", group, name);
+  if (filter && !strstr(full_name, filter)) {
+    return;
+  }
+
+  const size_t blocks = std::max(num_samples / block_size, size_t(1));
+  for (size_t b = 0; b < blocks; ++b) {
+    render(block_size);
+  }
+
+  double best_ns = 1e30;
+  double best_cycles = 0.0;
+  for (int r = 0; r < kRepeats; ++r) {
+    auto start = std::chrono::steady_clock::now();
+    uint64_t start_cycles = Cycles();
+    for (size_t b = 0; b < blocks; ++b) {
+      render(block_size);
+    }
+    uint64_t cycles = Cycles() - start_cycles;
+    auto end = std::chrono::steady_clock::now();
+    double samples = static_cast<double>(blocks * block_size);
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    if (ns / samples < best_ns) {
+      best_ns = ns / samples;
+      best_cycles = cycles / samples;
+    }
+  }
+
+  printf("%s\n    {\"group\": \"%s\", \"name\": \"%s\", \"params\": %s, "
+         "\"block_size\": %zu, \"ns_per_sample\": %.2f, ",
+         first_result ? "" : ",", group, name, params ? params : "null",
+         block_size, best_ns);
+#ifdef HAVE_CYCLE_COUNTER
+  printf("\"cycles_per_sample\": %.2f, ", best_cycles);
+#else
+  printf("\"cycles_per_sample\": null, ");
+#endif
+  printf("\"core_load\": %.6f}", best_ns * kSampleRate * 1e-9);
+  first_result = false;
+  fflush(stdout);
+}
+
+static char plaits_buffer[262144];  // As Polyphony's shared_buffer
+
+static void BenchPlaits() {
+  static plaits::VirtualAnalogEngine virtual_analog;
+  static plaits::WaveshapingEngine waveshaping;
+  static plaits::FMEngine fm;
+  static plaits::GrainEngine grain;
+  static plaits::AdditiveEngine additive;
+  static plaits::WavetableEngine wavetable;
+  static plaits::ChordEngine chord;
+  static plaits::SpeechEngine speech;
+  static plaits::SwarmEngine swarm;
+  static plaits::NoiseEngine noise;
+  static plaits::ParticleEngine particle;
+  static plaits::StringEngine string_engine;
+  static plaits::ModalEngine modal;
+  static plaits::BassDrumEngine bass_drum;
+  static plaits::SnareDrumEngine snare_drum;
+  static plaits::HiHatEngine hi_hat;
+  static plaits::BraidsEngine braids;
+
+  // Same order as Voice::Init registers them
+  const struct {
+    const char* name;
+    plaits::Engine* engine;
+  } engines[] = {
+    { "virtual_analog", &virtual_analog },
+    { "waveshaping", &waveshaping },
+    { "fm", &fm },
+    { "grain", &grain },
+    { "additive", &additive },
+    { "wavetable", &wavetable },
+    { "chord", &chord },
+    { "speech", &speech },
+    { "swarm", &swarm },
+    { "noise", &noise },
+    { "particle", &particle },
+    { "string", &string_engine },
+    { "modal", &modal },
+    { "bass_drum", &bass_drum },
+    { "snare_drum", &snare_drum },
+    { "hi_hat", &hi_hat },
+    { "braids", &braids },
+  };
+
+  stmlib::BufferAllocator allocator(plaits_buffer, sizeof(plaits_buffer));
+  float out[kMaxBlock];
+  float aux[kMaxBlock];
+
+  for (const auto& e : engines) {
+    for (const Point& point : kPoints) {
+      char params[128];
+      snprintf(params, sizeof(params),
+               "{\"harmonics\": %.2f, \"timbre\": %.2f, \"morph\": %.2f}",
+               point.harmonics, point.timbre, point.morph);
+      for (size_t block_size : kBlockSizes) {
+        allocator.Free();
+        e.engine->Init(&allocator);
+        e.engine->Reset();
+        e.engine->Seed(1);
+
+        plaits::EngineParameters p;
+        p.note = 48.0f;
+        p.harmonics = point.harmonics;
+        p.timbre = point.timbre;
+        p.morph = point.morph;
+        p.accent = 0.8f;
+        size_t clock = 0;
+
+        Measure("plaits", e.name, params, block_size, [&](size_t size) {
+          for (size_t offset = 0; offset < size;
+               offset += plaits::kMaxBlockSize) {
+            size_t n = std::min(size - offset, plaits::kMaxBlockSize);
+            p.trigger = clock == 0
+                ? plaits::TRIGGER_RISING_EDGE
+                : plaits::TRIGGER_LOW;
+            clock = (clock + n) % kTriggerInterval;
+            bool already_enveloped;
+            e.engine->Render(p, out + offset, aux + offset, n,
+                             &already_enveloped);
+          }
+        });
+      }
+    }
+  }
+}
+
+static uint8_t clouds_buffer[118784];
+static uint8_t clouds_buffer_ccm[65408];
+static float clouds_grain_staging[kCloudsGrainStagingSize];
+
+static void BenchClouds() {
+  static clouds::GranularProcessor processor;
+  const char* modes[] = { "granular", "stretch", "looping_delay", "spectral" };
+  // set_quality(): bit 0 mono, bit 1 low fidelity
+  const char* qualities[] = {
+    "stereo_16bit", "mono_16bit", "stereo_8bit", "mono_8bit"
+  };
+
+  clouds::ShortFrame input[kMaxBlock];
+  clouds::ShortFrame output[kMaxBlock];
+
+  for (int mode = 0; mode < clouds::PLAYBACK_MODE_LAST; ++mode) {
+    for (int quality = 0; quality < 4; ++quality) {
+      char params[128];
+      snprintf(params, sizeof(params), "{\"quality\": \"%s\"}",
+               qualities[quality]);
+      for (size_t block_size : kBlockSizes) {
+        processor.Init(
+            clouds_buffer, sizeof(clouds_buffer),
+            clouds_buffer_ccm, sizeof(clouds_buffer_ccm));
+        processor.set_grain_staging_buffer(
+            clouds_grain_staging, kCloudsGrainStagingSize);
+        processor.set_playback_mode(
+            static_cast<clouds::PlaybackMode>(mode));
+        processor.set_quality(quality);
+        clouds::Parameters* p = processor.mutable_parameters();
+        p->position = 0.5f;
+        p->size = 0.5f;
+        p->pitch = 0.0f;
+        p->density = 0.7f;
+        p->texture = 0.5f;
+        p->dry_wet = 1.0f;
+        p->stereo_spread = 0.5f;
+        p->feedback = 0.2f;
+        p->reverb = 0.3f;
+        p->freeze = false;
+        p->trigger = false;
+        p->gate = false;
+        size_t position = 0;
+
+        char name[64];
+        snprintf(name, sizeof(name), "%s", modes[mode]);
+        Measure("clouds", name, params, block_size, [&](size_t size) {
+          for (size_t offset = 0; offset < size;
+               offset += clouds::kMaxBlockSize) {
+            size_t n = std::min(size - offset, clouds::kMaxBlockSize);
+            const float* s = Signal(&position, n);
+            for (size_t i = 0; i < n; ++i) {
+              input[i].l = input[i].r = static_cast<int16_t>(s[i] * 16384.0f);
+            }
+            processor.Prepare();
+            processor.Process(input, output, n);
+          }
+        });
+      }
+    }
+  }
+}
+
+static void BenchEnvelope() {
+  for (size_t block_size : kBlockSizes) {
+    VoiceEnvelope envelope;
+    envelope.Init(kSampleRate);
+    envelope.SetAttackTime(0.2f);
+    envelope.SetReleaseTime(0.3f);
+    float out[kMaxBlock];
+    size_t clock = 0;
+    Measure("voice", "envelope", NULL, block_size, [&](size_t size) {
+      const size_t release = kTriggerInterval / 2;
+      if (clock == 0) {
+        envelope.Trigger();
+      } else if (clock <= release && clock + size > release) {
+        envelope.Release();
+      }
+      clock = (clock + size) % kTriggerInterval;
+      for (size_t i = 0; i < size; ++i) {
+        out[i] = envelope.Process();
+      }
+    });
+  }
+}
+
+static void BenchArpeggiator() {
+  static float scale[12];
+  for (int i = 0; i < 12; ++i) {
+    scale[i] = 48.0f + i;
+  }
+  for (size_t block_size : kBlockSizes) {
+    Arpeggiator arp;
+    arp.Init(kSampleRate);
+    arp.SetScale(scale, 12);
+    arp.SetMainTempo(8.0f);
+    arp.SetPolyrhythmRatio(1.5f);
+    arp.SetOctaveJumpProbability(0.2f);
+    arp.SetDirection(Arpeggiator::Random);
+    int triggered = 0;
+    arp.SetNoteTriggerCallback([&](int pad) { triggered += pad; });
+    arp.UpdateHeldNotes(0x0a5b, 0);
+    Measure("voice", "arpeggiator", NULL, block_size, [&](size_t size) {
+      arp.Process(size);
+    });
+  }
+}
+
+static int16_t delay_buffer[kMaxDelaySamples];
+static char reverb16_buffer[65536];  // As AudioProcessor's post_reverb_buffer
+
+static void BenchEffects() {
+  float out_l[kMaxBlock];
+  float out_r[kMaxBlock];
+  float stereo[kMaxBlock * 2];
+
+  for (size_t block_size : kBlockSizes) {
+    infrasonic::EchoDelay delay;
+    delay.Init(kSampleRate, delay_buffer, kMaxDelaySamples);
+    delay.SetDelayTime(0.3f, true);
+    delay.SetFeedback(0.6f);
+    size_t position = 0;
+    Measure("effects", "echo_delay", NULL, block_size, [&](size_t size) {
+      delay.Process(Signal(&position, size), out_l, size);
+    });
+  }
+
+  for (size_t block_size : kBlockSizes) {
+    // Audio input source: the test signal against a 110 Hz saw
+    static VocoderInsert vocoder;
+    vocoder.Init(kSampleRate);
+    vocoder.SetSource(VocoderInsert::SOURCE_AUDIO_IN);
+    size_t position = 0;
+    float phase = 0.0f;
+    Measure("effects", "vocoder_insert", NULL, block_size, [&](size_t size) {
+      for (size_t i = 0; i < size; ++i) {
+        out_r[i] = 2.0f * phase - 1.0f;
+        phase += 110.0f / kSampleRate;
+        if (phase >= 1.0f) phase -= 1.0f;
+      }
+      vocoder.Process(Signal(&position, size), out_r, out_l, size);
+    });
+  }
+
+  for (size_t block_size : kBlockSizes) {
+    static daisysp::ReverbSc16 reverb;
+    stmlib::BufferAllocator allocator(reverb16_buffer, sizeof(reverb16_buffer));
+    reverb.Init(kSampleRate, &allocator);
+    reverb.SetFeedback(0.85f);
+    reverb.SetLpFreq(8000.0f);
+    size_t position = 0;
+    Measure("effects", "reverb_sc16", NULL, block_size, [&](size_t size) {
+      const float* s = Signal(&position, size);
+      reverb.Process(s, s, out_l, out_r, size);
+    });
+  }
+
+  for (size_t block_size : kBlockSizes) {
+    static daisysp::ReverbSc reverb;
+    reverb.Init(kSampleRate);
+    reverb.SetFeedback(0.85f);
+    reverb.SetLpFreq(8000.0f);
+    size_t position = 0;
+    Measure("effects", "reverb_sc", NULL, block_size, [&](size_t size) {
+      const float* s = Signal(&position, size);
+      for (size_t i = 0; i < size; ++i) {
+        reverb.Process(s[i], s[i], &out_l[i], &out_r[i]);
+      }
+    });
+  }
+
+  for (size_t block_size : kBlockSizes) {
+    infrasonic::LPF24 filter;
+    filter.Init(kSampleRate);
+    filter.SetParams(2000.0f, 0.9f);
+    size_t position = 0;
+    Measure("effects", "lpf24_block", NULL, block_size, [&](size_t size) {
+      filter.ProcessBlock(Signal(&position, size), out_l, size);
+    });
+  }
+
+  for (size_t block_size : kBlockSizes) {
+    infrasonic::LPF24 filter;
+    filter.Init(kSampleRate);
+    filter.SetParams(2000.0f, 0.9f);
+    size_t position = 0;
+    Measure("effects", "lpf24_block_stereo", NULL, block_size,
+            [&](size_t size) {
+      const float* s = Signal(&position, size);
+      for (size_t i = 0; i < size; ++i) {
+        stereo[2 * i] = stereo[2 * i + 1] = s[i];
+      }
+      filter.ProcessBlockStereo(stereo, size);
+    });
+  }
+}
+
+// Control journals go through the firmware's own control path
+// (ControlPath.cpp): knob values, Clouds parameters, arp tempo, engine and
+// layout changes, note handling and PolyphonyEngine.
+clouds::GranularProcessor clouds_processor;
+
+// As InitializeSynth
+static void InitSession() {
+  sample_rate = kSampleRate;
+  ResetControlPath();
+  poly_engine.Init(NULL);
+  controls.Init(1.0f / 1024.0f);
+  InitArpeggiator(NULL);
+  clouds_processor.Init(
+      clouds_buffer, sizeof(clouds_buffer),
+      clouds_buffer_ccm, sizeof(clouds_buffer_ccm));
+  clouds_processor.set_grain_staging_buffer(
+      clouds_grain_staging, kCloudsGrainStagingSize);
+  clouds_processor.mutable_parameters()->dry_wet = 0.0f;
+  clouds_processor.mutable_parameters()->freeze = false;
+  clouds_processor.set_playback_mode(clouds::PLAYBACK_MODE_GRANULAR);
+}
+
+// The audio callback once the controls are read: voices, then Clouds as in
+// ApplyEffectsAndOutput, and nothing after Clouds (see the top of the file).
+// Appends the voice mix and the Clouds output to render.
+static void RenderSessionBlock(std::vector<char>* render) {
+  int engine_index;
+  bool poly_mode;
+  int num_voices;
+  bool arp_on;
+  HandleEngineAndLayoutChange();
+  UpdateArpState(engine_index, poly_mode, num_voices, arp_on);
+  RenderVoices(engine_index, poly_mode, num_voices, arp_on);
+
+  const float* mix = poly_engine.GetMainOutputBuffer();
+  clouds::ShortFrame input[BLOCK_SIZE];
+  clouds::ShortFrame output[BLOCK_SIZE];
+  for (size_t i = 0; i < BLOCK_SIZE; ++i) {
+    float scaled = std::min(std::max(mix[i] / NUM_VOICES, -32768.0f),
+                            32767.0f);
+    input[i].l = input[i].r = static_cast<int16_t>(scaled);
+  }
+  clouds_processor.Process(input, output, BLOCK_SIZE);
+  clouds_processor.Prepare();
+
+  if (render) {
+    const char* m = reinterpret_cast<const char*>(mix);
+    render->insert(render->end(), m, m + BLOCK_SIZE * sizeof(float));
+    const char* o = reinterpret_cast<const char*>(output);
+    render->insert(render->end(), o, o + sizeof(output));
+  }
+}
+
+static bool WriteFile(const char* path, const void* data, size_t size) {
+  FILE* f = fopen(path, "wb");
+  if (!f) {
+    fprintf(stderr, "cannot open %s\n", path);
+    return false;
+  }
+  bool ok = fwrite(data, 1, size, f) == size;
+  return fclose(f) == 0 && ok;
+}
+
+static bool ReplayJournal(const char* path, const char* render_path) {
+  FILE* f = fopen(path, "rb");
+  if (!f) {
+    fprintf(stderr, "cannot open %s\n", path);
+    return false;
+  }
+  std::vector<JournalEvent> events;
+  JournalEvent event;
+  while (fread(&event, sizeof(event), 1, f) == 1) {
+    events.push_back(event);
+  }
+  fclose(f);
+  const size_t start = FindJournalStart(events.data(), events.size());
+  if (start == events.size()) {
+    fprintf(stderr, "%s: no keyframe\n", path);
+    return false;
+  }
+  JournalPlayer player;
+  player.Init(&events[start], events.size() - start);
+  InitSession();
+
+  std::vector<char> render;
+  std::vector<double> block_ns;
+  std::vector<uint32_t> block_number;
+  while (!player.done()) {
+    const uint32_t number = player.block();
+    const JournalState& s = player.Next();
+    auto start_time = std::chrono::steady_clock::now();
+    ReplayControls(s);
+    RenderSessionBlock(render_path ? &render : NULL);
+    auto end_time = std::chrono::steady_clock::now();
+    block_ns.push_back(std::chrono::duration<double, std::nano>(
+        end_time - start_time).count());
+    block_number.push_back(number);
+  }
+  if (render_path && !WriteFile(render_path, render.data(), render.size())) {
+    return false;
+  }
+
+  std::vector<size_t> order(block_ns.size());
+  double total_ns = 0.0;
+  for (size_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+    total_ns += block_ns[i];
+  }
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return block_ns[a] > block_ns[b];
+  });
+
+  const double budget_ns = 1e9 * BLOCK_SIZE / kSampleRate;
+  printf("{\n  \"journal\": \"%s\",\n  \"blocks\": %zu,\n"
+         "  \"core_load\": %.6f,\n  \"slowest_blocks\": [",
+         path, block_ns.size(),
+         total_ns / (std::max(block_ns.size(), size_t(1)) * budget_ns));
+  for (size_t i = 0; i < std::min(order.size(), size_t(10)); ++i) {
+    printf("%s\n    {\"block\": %u, \"ns\": %.0f, \"core_load\": %.6f}",
+           i ? "," : "", block_number[order[i]], block_ns[order[i]],
+           block_ns[order[i]] / budget_ns);
+  }
+  printf("\n  ]\n}\n");
+  return true;
+}
+
+// Scripted session for --record-journal, one call per block in place of
+// ProcessUIAndControls and PollTouchSensor: slowly moving knobs read with
+// some noise, chords, an engine step every 400 blocks, split, layer and back
+// to single, then the arpeggiator on and off again.
+static const uint32_t kSessionBlocks = 3000;
+
+static uint32_t session_rng = 1;
+
+static float SessionNoise() {
+  session_rng = session_rng * 1664525u + 1013904223u;
+  return (session_rng >> 8) * (1.0f / 16777216.0f) - 0.5f;
+}
+
+static void PlaySessionControls(uint32_t block) {
+  // As UpdateEngineSelection and UpdateArpeggiatorToggle
+  if (block % 400 == 200) {
+    current_engine_index = (current_engine_index + 3) % (MAX_ENGINE_INDEX + 1);
+    engine_changed_flag = true;
+  }
+  if (block == 1200 || block == 1600 || block == 2000) {
+    layout_change_flag = true;
+  }
+  if (block == 2200 || block == 2700) {
+    SetArpEnabled(!arp_enabled, NULL);
+  }
+
+  // As ReadKnobValues
+  static const struct {
+    ControlId id;
+    int adc;
+  } knobs[] = {
+    { CONTROL_DELAY_TIME, 0 }, { CONTROL_MIX, 1 }, { CONTROL_RELEASE, 2 },
+    { CONTROL_ATTACK, 3 }, { CONTROL_TIMBRE, 4 }, { CONTROL_HARMONICS, 5 },
+    { CONTROL_MORPH, 6 }, { CONTROL_PITCH, 7 }, { CONTROL_MOD_WHEEL, 11 },
+  };
+  const float t = block * (BLOCK_SIZE / kSampleRate);
+  for (size_t k = 0; k < sizeof(knobs) / sizeof(knobs[0]); ++k) {
+    float value = 0.5f + 0.45f * sinf(t * (0.4f + 0.13f * k) + k) +
+        0.002f * SessionNoise();
+    value = std::min(std::max(value, 0.0f), 1.0f);
+    adc_raw_values[knobs[k].adc] = value;
+    controls.Set(knobs[k].id, value);
+  }
+  controls.Set(CONTROL_TOUCH, touch_cv_value);
+  ApplyKnobValues();
+  UpdateArpTempo();
+
+  // As PollTouchSensor. The six-pad chord takes twelve voices in layer,
+  // more than there are slots, so layouts steal (and fade out) voices.
+  static const uint16_t kChords[] = {
+    0x001, 0x011, 0x091, 0x000, 0x124, 0x924, 0x000, 0x002, 0x00a, 0x000,
+    0x0fc, 0x000,
+  };
+  current_touch_state = kChords[(block / 150) % (sizeof(kChords) / sizeof(kChords[0]))];
+  float pressure = current_touch_state
+      ? 0.5f + 0.4f * sinf(t * 5.0f) + 0.01f * SessionNoise()
+      : 0.0f;
+  touch_cv_value = touch_cv_value * 0.9f + pressure * 0.1f;
+}
+
+static bool RecordJournal(const char* path, const char* render_path) {
+  static JournalEvent ring[1 << 18];
+  control_journal.Init(ring, sizeof(ring) / sizeof(ring[0]));
+  InitSession();
+
+  // Freezes like after a deadline miss, kPostRollBlocks blocks later
+  std::vector<char> render;
+  for (uint32_t block = 0; !control_journal.frozen(); ++block) {
+    PlaySessionControls(block);
+    JournalControls();
+    RenderSessionBlock(&render);
+    if (block + 1 == kSessionBlocks) {
+      control_journal.Freeze();
+    }
+  }
+
+  std::vector<JournalEvent> events(sizeof(ring) / sizeof(ring[0]));
+  uint32_t index;
+  size_t size = 0;
+  for (size_t n; (n = control_journal.ReadDump(
+           &events[size], events.size() - size, &index)) > 0; ) {
+    size += n;
+  }
+  events.resize(size);
+
+  // A replay ends with the last event; blocks after it are not in the
+  // journal, so they are not in the render either.
+  JournalPlayer player;
+  player.Init(events.data(), events.size());
+  const size_t block_bytes =
+      BLOCK_SIZE * (sizeof(float) + sizeof(clouds::ShortFrame));
+  render.resize(player.num_blocks() * block_bytes);
+
+  if (!WriteFile(path, events.data(), events.size() * sizeof(JournalEvent)) ||
+      (render_path && !WriteFile(render_path, render.data(), render.size()))) {
+    return false;
+  }
+  printf("{\n  \"journal\": \"%s\",\n  \"blocks\": %zu,\n"
+         "  \"events\": %zu\n}\n", path, player.num_blocks(), events.size());
+  return true;
+}
+
+int main(int argc, char** argv) {
+  const char* journal = NULL;
+  const char* record_journal = NULL;
+  const char* render = NULL;
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--samples") && i + 1 < argc) {
+      num_samples = strtoul(argv[++i], NULL, 10);
+    } else if (!strcmp(argv[i], "--filter") && i + 1 < argc) {
+      filter = argv[++i];
+    } else if (!strcmp(argv[i], "--journal") && i + 1 < argc) {
+      journal = argv[++i];
+    } else if (!strcmp(argv[i], "--record-journal") && i + 1 < argc) {
+      record_journal = argv[++i];
+    } else if (!strcmp(argv[i], "--render") && i + 1 < argc) {
+      render = argv[++i];
+    } else {
+      fprintf(stderr, "usage: %s [--samples N] [--filter group/name] "
+              "[--journal FILE | --record-journal FILE] [--render FILE]\n",
+              argv[0]);
+      return 1;
+    }
+  }
+
+  plaits::PlaitsResourcesInit();
+  LutResidency::Init();
+  InitSignal();
+
+  if (record_journal) {
+    return RecordJournal(record_journal, render) ? 0 : 1;
+  }
+  if (journal) {
+    return ReplayJournal(journal, render) ? 0 : 1;
+  }
+
+  printf("{\n  \"sample_rate\": %.0f,\n  \"samples_per_measurement\": %zu,\n"
+         "  \"repeats\": %d,\n  \"cycle_counter\": %s,\n  \"results\": [",
+         kSampleRate, num_samples, kRepeats,
+#ifdef HAVE_CYCLE_COUNTER
+         "\"tsc\""
+#else
+         "null"
+#endif
+         );
+  BenchPlaits();
+  BenchClouds();
+  BenchEnvelope();
+  BenchArpeggiator();
+  BenchEffects();
+  printf("\n  ]\n}\n");
+  return 0;
+}
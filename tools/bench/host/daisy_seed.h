@@ -0,0 +1,8 @@
+// Host stand-in for libDaisy's daisy_seed.h, which pulls in the STM32 HAL.
+// Arpeggiator.h only needs the namespace; Polyphony.h a DaisySeed pointer it
+// never uses on the host.
+#pragma once
+
+namespace daisy {
+class DaisySeed;
+}
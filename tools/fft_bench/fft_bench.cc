@@ -0,0 +1,75 @@
+// Host benchmark for the Clouds STFT FFT backends (clouds/dsp/pvoc/fft_backend.h).
+//
+// Times a Direct() + Inverse() pair - what the STFT does per hop - at 1024,
+// 2048 and 4096 points, and checks each backend's round-trip error. The
+// "budget" column is the share of one core the backend would need at 32 kHz
+// with the phase vocoder's 4x overlap, assuming the host is as fast as the
+// target; run the same sizes on the Daisy (make FFT_BENCHMARK=1) for the real
+// numbers.
+//
+//   make -C tools/fft_bench && tools/fft_bench/fft_bench
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "clouds/dsp/pvoc/fft_backend.h"
+
+using namespace clouds;
+
+static const float kSampleRate = 32000.0f;
+static const size_t kHopRatio = 4;
+
+static float input[kMaxFftSize];
+static float work_in[kMaxFftSize];
+static float work_out[kMaxFftSize];
+
+static void Benchmark(FftBackend* fft, size_t size) {
+  fft->Init(size);
+  for (size_t i = 0; i < size; ++i) {
+    input[i] = static_cast<float>(rand()) / RAND_MAX - 0.5f;
+  }
+
+  // Round trip accuracy
+  std::copy(&input[0], &input[size], &work_in[0]);
+  fft->Direct(work_in, work_out);
+  fft->Inverse(work_out, work_in);
+  float error = 0.0f;
+  const float gain = 1.0f / fft->inverse_gain();
+  for (size_t i = 0; i < size; ++i) {
+    error = std::max(error, fabsf(work_in[i] * gain - input[i]));
+  }
+
+  // Enough iterations for ~50 ms per measurement at these sizes
+  const size_t iterations = 200000 / (size / 64);
+  auto start = std::chrono::steady_clock::now();
+  for (size_t n = 0; n < iterations; ++n) {
+    std::copy(&input[0], &input[size], &work_in[0]);
+    fft->Direct(work_in, work_out);
+    fft->Inverse(work_out, work_in);
+  }
+  auto end = std::chrono::steady_clock::now();
+  double us = std::chrono::duration<double, std::micro>(end - start).count() / iterations;
+
+  const double frames_per_second = kSampleRate / (size / kHopRatio);
+  printf("%-8s %5zu  %9.2f us  %6.2f %%  %.2e\n",
+         fft->name(), size, us, us * frames_per_second * 1e-4, error);
+}
+
+static ShyFftBackend shy;
+static RealFft radix4;
+
+int main() {
+  FftBackend* backends[] = { &shy, &radix4 };
+  const size_t sizes[] = { 1024, 2048, 4096 };
+
+  printf("backend   size   fwd+inv     budget  round-trip error\n");
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+    for (size_t b = 0; b < sizeof(backends) / sizeof(backends[0]); ++b) {
+      Benchmark(backends[b], sizes[s]);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,911 @@
+// Golden-output equivalence harness for the DSP kernels.
+//
+// Every kernel (each Plaits engine on its own and through plaits::Voice,
+// each Clouds mode and quality, Clouds' sample rate converters and spectral
+// kernels, the effects and the vocoder insert) renders a fixed script of
+// parameter sweeps, notes and triggers from fixed seeds. "record" writes the
+// outputs of the current build as references; "compare" renders again and
+// checks each kernel against its reference under the tolerance given in the
+// tolerance file. Record from the commit before an optimisation, compare
+// after it:
+//
+//   make -B -C tools/golden && tools/golden/golden record /tmp/ref
+//   (apply the optimisation)
+//   make -B -C tools/golden && tools/golden/golden compare /tmp/ref
+//
+// Run it from the repository root, where the default tolerance file is.
+// References only hold for the compiler and flags they were recorded with:
+// a different -march or -ffp-contract moves most kernels by far more than
+// rounding (chord, noise and spectral Clouds are chaotic enough to drift
+// outright), so record and compare with the same toolchain.
+//
+// "pairs" compares the kernels that have an in-tree reference path without
+// any recording: block biquads against per-sample biquads, four FM voices
+// through Voice::RenderLockstep against four Voice::Render calls, granular
+// Clouds with staged grain reads against direct reads, the polyphase sample
+// rate converters against a direct-form FIR, and the batch cartesian/polar
+// kernels against libm.
+//
+// Tolerance file lines are "<pattern> <mode> [value]", first match wins;
+// a pattern ending in '*' matches by prefix. Modes:
+//   exact              bit-identical output
+//   max_abs <v>        largest sample difference at most v
+//   spectral <dB>      spectral error (below) at most <dB>, e.g. -60
+// The spectral error is the energy of the difference of the magnitude
+// spectra (1024-point Hann frames, hop 512) relative to the reference's, in
+// dB: it ignores phase, so it accepts a kernel that is equal to the ear but
+// not sample for sample. Kernels with no matching line must be exact.
+//
+// The report has one line per kernel with all three measures, and the exit
+// status is non-zero if any kernel fails.
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "BiquadFilters.h"
+#include "EchoDelay.h"
+#include "LutResidency.h"
+#include "VocoderInsert.h"
+#include "reverbsc16.h"
+#include "clouds/dsp/granular_processor.h"
+#include "clouds/dsp/pvoc/spectral_kernels.h"
+#include "clouds/dsp/sample_rate_converter.h"
+#include "clouds/resources.h"
+#include "plaits/dsp/voice.h"
+#include "stmlib/utils/random.h"
+
+static const double kPi = 3.14159265358979323846;
+static const float kSampleRate = 32000.0f;
+static const size_t kRenderFrames = 64000;  // 2 s per kernel
+static const size_t kMaxBlock = 64;
+static const int kMaxChannels = 2 * plaits::kLockstepVoices;
+static const size_t kNoteInterval = 8000;
+static const float kNotes[] = { 36.0f, 43.0f, 48.0f, 55.0f, 60.0f, 67.0f };
+
+static size_t block_size = 32;
+
+struct Kernel {
+  std::string name;
+  int channels;
+  // Renders kRenderFrames interleaved frames (at most kMaxChannels) into out
+  std::function<void(float* out)> render;
+  // In-tree reference path, for "pairs"; may be empty
+  std::function<void(float* out)> reference;
+};
+
+// Scripted controls, evaluated at the start of each block.
+struct Controls {
+  float harmonics;
+  float timbre;
+  float morph;
+  float note;
+  bool trigger;
+};
+
+static Controls Script(size_t frame) {
+  const float t = static_cast<float>(frame) / kRenderFrames;
+  Controls c;
+  c.harmonics = 0.5f + 0.45f * sinf(4.0f * static_cast<float>(kPi) * t);
+  c.timbre = t;
+  c.morph = t < 0.5f ? 2.0f * t : 2.0f - 2.0f * t;
+  c.note = kNotes[(frame / kNoteInterval) % (sizeof(kNotes) / sizeof(float))];
+  c.trigger = frame % kNoteInterval < block_size;
+  return c;
+}
+
+// Fixed-seed input for the effects and Clouds: noise bursts plus a sine
+static float test_signal[kRenderFrames];
+
+static void InitSignal() {
+  uint32_t rng = 1;
+  for (size_t i = 0; i < kRenderFrames; ++i) {
+    rng = rng * 1664525u + 1013904223u;
+    float noise = static_cast<float>(rng >> 8) / 16777216.0f - 0.5f;
+    float burst = (i % kNoteInterval) < 2000 ? 0.5f : 0.05f;
+    float sine = sinf(i * 2.0f * static_cast<float>(kPi) / 91.0f);
+    test_signal[i] = burst * noise + 0.3f * sine;
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Kernels
+
+static char plaits_buffer[262144];  // As Polyphony's shared_buffer
+
+static void RenderEngine(plaits::Engine* engine, float* out) {
+  stmlib::BufferAllocator allocator(plaits_buffer, sizeof(plaits_buffer));
+  engine->Init(&allocator);
+  engine->Reset();
+  engine->Seed(1);
+  stmlib::Random::Seed(1);
+
+  float o[plaits::kMaxBlockSize];
+  float a[plaits::kMaxBlockSize];
+  for (size_t frame = 0; frame < kRenderFrames; frame += block_size) {
+    const Controls c = Script(frame);
+    plaits::EngineParameters p;
+    p.trigger = c.trigger ? plaits::TRIGGER_RISING_EDGE : plaits::TRIGGER_LOW;
+    p.note = c.note;
+    p.harmonics = c.harmonics;
+    p.timbre = c.timbre;
+    p.morph = c.morph;
+    p.accent = 0.8f;
+    for (size_t offset = 0; offset < block_size;
+         offset += plaits::kMaxBlockSize) {
+      size_t n = std::min(block_size - offset, plaits::kMaxBlockSize);
+      bool already_enveloped;
+      engine->Render(p, o, a, n, &already_enveloped);
+      p.trigger = plaits::TRIGGER_LOW;
+      for (size_t i = 0; i < n; ++i) {
+        out[2 * (frame + offset + i)] = o[i];
+        out[2 * (frame + offset + i) + 1] = a[i];
+      }
+    }
+  }
+}
+
+static void RenderVoice(int engine, float* out) {
+  static plaits::Voice voice;
+  stmlib::BufferAllocator allocator(plaits_buffer, sizeof(plaits_buffer));
+  voice.Init(&allocator);
+  voice.Seed(1);
+  stmlib::Random::Seed(1);
+
+  plaits::Patch patch = { };
+  patch.engine = engine;
+  patch.decay = 0.5f;
+  patch.lpg_colour = 0.5f;
+  plaits::Modulations modulations = { };
+  modulations.trigger_patched = true;
+
+  plaits::Voice::Frame frames[plaits::kMaxBlockSize];
+  for (size_t frame = 0; frame < kRenderFrames; frame += block_size) {
+    const Controls c = Script(frame);
+    patch.note = c.note;
+    patch.harmonics = c.harmonics;
+    patch.timbre = c.timbre;
+    patch.morph = c.morph;
+    modulations.trigger = c.trigger ? 1.0f : 0.0f;
+    for (size_t offset = 0; offset < block_size;
+         offset += plaits::kMaxBlockSize) {
+      size_t n = std::min(block_size - offset, plaits::kMaxBlockSize);
+      voice.Render(patch, modulations, frames, n);
+      for (size_t i = 0; i < n; ++i) {
+        out[2 * (frame + offset + i)] = frames[i].out / 32768.0f;
+        out[2 * (frame + offset + i) + 1] = frames[i].aux / 32768.0f;
+      }
+    }
+  }
+}
+
+// kLockstepVoices voices on one engine, a chord apart, each with its own
+// seed, triggered one block after another; out and aux of voice v go to
+// channels 2v and 2v + 1. With lockstep set the engine stage runs through
+// Voice::RenderLockstep, otherwise each voice renders on its own.
+static void RenderVoices(int engine, bool lockstep, float* out) {
+  static plaits::Voice voices[plaits::kLockstepVoices];
+  static const float kChord[] = { 0.0f, 4.0f, 7.0f, 12.0f };
+  static_assert(sizeof(kChord) / sizeof(float) == plaits::kLockstepVoices,
+                "One chord note per voice");
+  const size_t slice = sizeof(plaits_buffer) / plaits::kLockstepVoices;
+  plaits::Voice* pointers[plaits::kLockstepVoices];
+  for (size_t v = 0; v < plaits::kLockstepVoices; ++v) {
+    stmlib::BufferAllocator allocator(&plaits_buffer[v * slice], slice);
+    voices[v].Init(&allocator);
+    voices[v].Seed(v + 1);
+    pointers[v] = &voices[v];
+  }
+  stmlib::Random::Seed(1);
+
+  plaits::Patch patches[plaits::kLockstepVoices] = { };
+  plaits::Modulations modulations[plaits::kLockstepVoices] = { };
+  for (size_t v = 0; v < plaits::kLockstepVoices; ++v) {
+    patches[v].engine = engine;
+    patches[v].decay = 0.5f;
+    patches[v].lpg_colour = 0.5f;
+    modulations[v].trigger_patched = true;
+  }
+
+  plaits::EngineParameters parameters[plaits::kLockstepVoices];
+  plaits::Voice::Frame frames[plaits::kMaxBlockSize];
+  for (size_t frame = 0; frame < kRenderFrames; frame += block_size) {
+    const Controls c = Script(frame);
+    for (size_t v = 0; v < plaits::kLockstepVoices; ++v) {
+      patches[v].note = c.note + kChord[v];
+      patches[v].harmonics = c.harmonics;
+      patches[v].timbre = c.timbre;
+      patches[v].morph = c.morph;
+      modulations[v].trigger =
+          (frame % kNoteInterval) / block_size == v ? 1.0f : 0.0f;
+    }
+    for (size_t offset = 0; offset < block_size;
+         offset += plaits::kMaxBlockSize) {
+      size_t n = std::min(block_size - offset, plaits::kMaxBlockSize);
+      if (lockstep) {
+        for (size_t v = 0; v < plaits::kLockstepVoices; ++v) {
+          voices[v].BeginRender(patches[v], modulations[v], &parameters[v], n);
+        }
+        if (!plaits::Voice::RenderLockstep(pointers, parameters, n)) {
+          fprintf(stderr, "engine %d has no lock-step path\n", engine);
+          exit(1);
+        }
+      }
+      for (size_t v = 0; v < plaits::kLockstepVoices; ++v) {
+        if (lockstep) {
+          voices[v].EndRender(
+              patches[v], modulations[v], parameters[v], frames, n);
+        } else {
+          voices[v].Render(patches[v], modulations[v], frames, n);
+        }
+        for (size_t i = 0; i < n; ++i) {
+          float* o = &out[kMaxChannels * (frame + offset + i) + 2 * v];
+          o[0] = frames[i].out / 32768.0f;
+          o[1] = frames[i].aux / 32768.0f;
+        }
+      }
+    }
+  }
+}
+
+static uint8_t clouds_buffer[118784];
+static uint8_t clouds_buffer_ccm[65408];
+static float clouds_grain_staging[4096];  // As Thaumazein.h
+
+// Without staging the grains read the recording directly, as they do when
+// their spans do not fit; that is the reference path of the staged reads.
+static void RenderClouds(int mode, int quality, bool staging, float* out) {
+  static clouds::GranularProcessor processor;
+  processor.Init(
+      clouds_buffer, sizeof(clouds_buffer),
+      clouds_buffer_ccm, sizeof(clouds_buffer_ccm));
+  if (staging) {
+    processor.set_grain_staging_buffer(clouds_grain_staging, 4096);
+  }
+  processor.set_playback_mode(static_cast<clouds::PlaybackMode>(mode));
+  processor.set_quality(quality);
+  stmlib::Random::Seed(1);
+
+  clouds::ShortFrame input[clouds::kMaxBlockSize];
+  clouds::ShortFrame output[clouds::kMaxBlockSize];
+  for (size_t frame = 0; frame < kRenderFrames; frame += block_size) {
+    const Controls c = Script(frame);
+    clouds::Parameters* p = processor.mutable_parameters();
+    p->position = c.harmonics;
+    p->size = c.timbre;
+    p->pitch = (c.note - 48.0f) * 0.5f;
+    p->density = c.morph;
+    p->texture = 0.5f;
+    p->dry_wet = 1.0f;
+    p->stereo_spread = 0.5f;
+    p->feedback = 0.2f;
+    p->reverb = 0.3f;
+    p->freeze = frame >= kRenderFrames / 2 && frame < 3 * kRenderFrames / 4;
+    p->trigger = c.trigger;
+    p->gate = c.trigger;
+    for (size_t offset = 0; offset < block_size;
+         offset += clouds::kMaxBlockSize) {
+      size_t n = std::min(block_size - offset, clouds::kMaxBlockSize);
+      for (size_t i = 0; i < n; ++i) {
+        int16_t s = static_cast<int16_t>(
+            test_signal[frame + offset + i] * 16384.0f);
+        input[i].l = input[i].r = s;
+      }
+      processor.Prepare();
+      processor.Process(input, output, n);
+      for (size_t i = 0; i < n; ++i) {
+        out[2 * (frame + offset + i)] = output[i].l / 32768.0f;
+        out[2 * (frame + offset + i) + 1] = output[i].r / 32768.0f;
+      }
+    }
+  }
+}
+
+// Clouds' low-fidelity path: the test signal (and its negation on the right)
+// down by two and back up, through the polyphase converters. Always in
+// Clouds' own blocks, since decimation needs an even block.
+typedef clouds::SampleRateConverter<
+    -clouds::kDownsamplingFactor, 45, clouds::src_filter_1x_2_45> SrcDown;
+typedef clouds::SampleRateConverter<
+    +clouds::kDownsamplingFactor, 45, clouds::src_filter_1x_2_45> SrcUp;
+
+static void RenderSrc(float* out) {
+  static SrcDown down;
+  static SrcUp up;
+  down.Init();
+  up.Init();
+  const size_t kBlock = clouds::kMaxBlockSize;
+  clouds::FloatFrame in[kBlock];
+  clouds::FloatFrame low[kBlock / clouds::kDownsamplingFactor];
+  for (size_t frame = 0; frame < kRenderFrames; frame += kBlock) {
+    for (size_t i = 0; i < kBlock; ++i) {
+      in[i].l = test_signal[frame + i];
+      in[i].r = -test_signal[frame + i];
+    }
+    down.Process(in, low, kBlock);
+    up.Process(low, reinterpret_cast<clouds::FloatFrame*>(&out[2 * frame]),
+               kBlock / clouds::kDownsamplingFactor);
+  }
+}
+
+// The same conversion as a direct-form FIR over the whole signal: keep every
+// second output of the filtered input, then filter the zero-stuffed result
+// with twice the gain.
+static void RenderSrcDirect(float* out) {
+  const int kFactor = clouds::kDownsamplingFactor;
+  const float* h = clouds::src_filter_1x_2_45;
+  const size_t low_frames = kRenderFrames / kFactor;
+  static float low[kRenderFrames / clouds::kDownsamplingFactor];
+  for (size_t n = 0; n < low_frames; ++n) {
+    const int32_t input = static_cast<int32_t>(n * kFactor + kFactor - 1);
+    float y = 0.0f;
+    for (int32_t k = 0; k < 45 && k <= input; ++k) {
+      y += h[k] * test_signal[input - k];
+    }
+    low[n] = y;
+  }
+  for (size_t n = 0; n < kRenderFrames; ++n) {
+    float y = 0.0f;
+    for (int32_t k = n % kFactor; k < 45 && k <= static_cast<int32_t>(n);
+         k += kFactor) {
+      y += h[k] * low[(n - k) / kFactor];
+    }
+    out[2 * n] = y * kFactor;
+    out[2 * n + 1] = -y * kFactor;
+  }
+}
+
+// Cartesian to polar on (test signal, reversed test signal) pairs, and polar
+// to cartesian on the test signal's magnitude with scripted phases. Channels:
+// magnitude, phase in turns, real, imaginary. The batch kernels run a block
+// at a time (with SSE on the host); the reference is libm in double.
+static uint32_t ScriptedPhase(size_t i) {
+  return static_cast<uint32_t>(i * 2654435761u) >> 16;
+}
+
+static void RenderSpectralKernels(float* out) {
+  float real[kMaxBlock];
+  float imag[kMaxBlock];
+  float magnitude[kMaxBlock];
+  uint16_t phase[kMaxBlock];
+  uint32_t polar_phase[kMaxBlock];
+  for (size_t frame = 0; frame < kRenderFrames; frame += block_size) {
+    for (size_t i = 0; i < block_size; ++i) {
+      real[i] = test_signal[frame + i];
+      imag[i] = test_signal[kRenderFrames - 1 - frame - i];
+    }
+    clouds::CartesianToPolar(real, imag, magnitude, phase, block_size);
+    for (size_t i = 0; i < block_size; ++i) {
+      out[4 * (frame + i)] = magnitude[i];
+      out[4 * (frame + i) + 1] = phase[i] / 65536.0f;
+      magnitude[i] = fabsf(test_signal[frame + i]);
+      polar_phase[i] = ScriptedPhase(frame + i);
+    }
+    clouds::PolarToCartesian(magnitude, polar_phase, real, imag, block_size);
+    for (size_t i = 0; i < block_size; ++i) {
+      out[4 * (frame + i) + 2] = real[i];
+      out[4 * (frame + i) + 3] = imag[i];
+    }
+  }
+}
+
+static void RenderSpectralKernelsLibm(float* out) {
+  for (size_t i = 0; i < kRenderFrames; ++i) {
+    const double x = test_signal[i];
+    const double y = test_signal[kRenderFrames - 1 - i];
+    const double turns = atan2(y, x) / (2.0 * kPi);
+    out[4 * i] = static_cast<float>(sqrt(x * x + y * y));
+    out[4 * i + 1] = static_cast<uint16_t>(
+        static_cast<int32_t>(floor(turns * 65536.0 + 65536.5))) / 65536.0f;
+    const double m = fabsf(test_signal[i]);
+    const double angle = ScriptedPhase(i) * (2.0 * kPi / 65536.0);
+    out[4 * i + 2] = static_cast<float>(m * cos(angle));
+    out[4 * i + 3] = static_cast<float>(m * sin(angle));
+  }
+}
+
+static int16_t delay_buffer[48000];
+
+static void RenderEchoDelay(float* out) {
+  infrasonic::EchoDelay delay;
+  delay.Init(kSampleRate, delay_buffer, 48000);
+  delay.SetFeedback(0.7f);
+  for (size_t frame = 0; frame < kRenderFrames; frame += block_size) {
+    const Controls c = Script(frame);
+    delay.SetDelayTime(0.05f + 0.4f * c.timbre);
+    delay.Process(&test_signal[frame], &out[frame], block_size);
+  }
+}
+
+static char reverb16_buffer[65536];
+
+static void RenderReverbSc16(float* out) {
+  static daisysp::ReverbSc16 reverb;
+  stmlib::BufferAllocator allocator(reverb16_buffer, sizeof(reverb16_buffer));
+  reverb.Init(kSampleRate, &allocator);
+  reverb.SetLpFreq(8000.0f);
+  float l[kMaxBlock];
+  float r[kMaxBlock];
+  for (size_t frame = 0; frame < kRenderFrames; frame += block_size) {
+    const Controls c = Script(frame);
+    reverb.SetFeedback(0.6f + 0.35f * c.morph);
+    const float* in = &test_signal[frame];
+    reverb.Process(in, in, l, r, block_size);
+    for (size_t i = 0; i < block_size; ++i) {
+      out[2 * (frame + i)] = l[i];
+      out[2 * (frame + i) + 1] = r[i];
+    }
+  }
+}
+
+// The test signal vocoding a saw at the scripted notes, as the insert runs
+// with the audio input as its source.
+static void RenderVocoderInsert(float* out) {
+  static VocoderInsert vocoder;
+  vocoder.Init(kSampleRate);
+  vocoder.SetSource(VocoderInsert::SOURCE_AUDIO_IN);
+  float carrier[kMaxBlock];
+  float phase = 0.0f;
+  for (size_t frame = 0; frame < kRenderFrames; frame += block_size) {
+    const Controls c = Script(frame);
+    vocoder.SetFormantShift(c.timbre);
+    vocoder.SetReleaseTime(c.morph);
+    const float increment =
+        440.0f * powf(2.0f, (c.note - 69.0f) / 12.0f) / kSampleRate;
+    for (size_t i = 0; i < block_size; ++i) {
+      carrier[i] = 2.0f * phase - 1.0f;
+      phase += increment;
+      if (phase >= 1.0f) phase -= 1.0f;
+    }
+    vocoder.Process(&test_signal[frame], carrier, &out[frame], block_size);
+  }
+}
+
+// Block biquads against the per-sample path, at a fixed cutoff: the block
+// path glides to new coefficients over kCoefRampBlocks blocks where the
+// per-sample path jumps, so the glide is run out on silence first.
+static const float kBiquadCutoff = 1500.0f;
+
+static void RenderBiquadBlock(bool stereo, float* out) {
+  infrasonic::LPF24 filter;
+  filter.Init(kSampleRate);
+  filter.SetParams(kBiquadCutoff, 0.9f);
+  float silence[kMaxBlock * 2] = { };
+  for (size_t i = 0; i < infrasonic::LPF24::kCoefRampBlocks; ++i) {
+    if (stereo) {
+      filter.ProcessBlockStereo(silence, block_size);
+    } else {
+      filter.ProcessBlock(silence, silence, block_size);
+    }
+  }
+  float interleaved[kMaxBlock * 2];
+  for (size_t frame = 0; frame < kRenderFrames; frame += block_size) {
+    const float* in = &test_signal[frame];
+    if (stereo) {
+      for (size_t i = 0; i < block_size; ++i) {
+        interleaved[2 * i] = in[i];
+        interleaved[2 * i + 1] = -in[i];
+      }
+      filter.ProcessBlockStereo(interleaved, block_size);
+      std::copy(&interleaved[0], &interleaved[2 * block_size],
+                &out[2 * frame]);
+    } else {
+      filter.ProcessBlock(in, &out[frame], block_size);
+    }
+  }
+}
+
+static void RenderBiquadSample(bool stereo, float* out) {
+  infrasonic::LPF24 filter;
+  filter.Init(kSampleRate);
+  filter.SetParams(kBiquadCutoff, 0.9f);
+  for (size_t frame = 0; frame < kRenderFrames; ++frame) {
+    const float in = test_signal[frame];
+    if (stereo) {
+      float l = in;
+      float r = -in;
+      filter.ProcessStereo(l, r);
+      out[2 * frame] = l;
+      out[2 * frame + 1] = r;
+    } else {
+      out[frame] = filter.Process(in);
+    }
+  }
+}
+
+static std::vector<Kernel> MakeKernels() {
+  static plaits::VirtualAnalogEngine virtual_analog;
+  static plaits::WaveshapingEngine waveshaping;
+  static plaits::FMEngine fm;
+  static plaits::GrainEngine grain;
+  static plaits::AdditiveEngine additive;
+  static plaits::WavetableEngine wavetable;
+  static plaits::ChordEngine chord;
+  static plaits::SpeechEngine speech;
+  static plaits::SwarmEngine swarm;
+  static plaits::NoiseEngine noise;
+  static plaits::ParticleEngine particle;
+  static plaits::StringEngine string_engine;
+  static plaits::ModalEngine modal;
+  static plaits::BassDrumEngine bass_drum;
+  static plaits::SnareDrumEngine snare_drum;
+  static plaits::HiHatEngine hi_hat;
+  static plaits::BraidsEngine braids;
+
+  // Same order as Voice::Init registers them, so the index is patch.engine
+  const struct {
+    const char* name;
+    plaits::Engine* engine;
+  } engines[] = {
+    { "virtual_analog", &virtual_analog },
+    { "waveshaping", &waveshaping },
+    { "fm", &fm },
+    { "grain", &grain },
+    { "additive", &additive },
+    { "wavetable", &wavetable },
+    { "chord", &chord },
+    { "speech", &speech },
+    { "swarm", &swarm },
+    { "noise", &noise },
+    { "particle", &particle },
+    { "string", &string_engine },
+    { "modal", &modal },
+    { "bass_drum", &bass_drum },
+    { "snare_drum", &snare_drum },
+    { "hi_hat", &hi_hat },
+    { "braids", &braids },
+  };
+  const char* modes[] = { "granular", "stretch", "looping_delay", "spectral" };
+  const char* qualities[] = {
+    "stereo_16bit", "mono_16bit", "stereo_8bit", "mono_8bit"
+  };
+
+  std::vector<Kernel> kernels;
+  int index = 0;
+  for (const auto& e : engines) {
+    plaits::Engine* engine = e.engine;
+    kernels.push_back({ std::string("plaits/") + e.name, 2,
+        [engine](float* out) { RenderEngine(engine, out); }, nullptr });
+    kernels.push_back({ std::string("plaits_voice/") + e.name, 2,
+        [index](float* out) { RenderVoice(index, out); }, nullptr });
+    ++index;
+  }
+  kernels.push_back({ "plaits_lockstep/fm", kMaxChannels,
+      [](float* out) { RenderVoices(plaits::kFMEngineIndex, true, out); },
+      [](float* out) { RenderVoices(plaits::kFMEngineIndex, false, out); } });
+  for (int mode = 0; mode < clouds::PLAYBACK_MODE_LAST; ++mode) {
+    for (int quality = 0; quality < 4; ++quality) {
+      // Only the granular player stages grains
+      std::function<void(float* out)> reference;
+      if (mode == clouds::PLAYBACK_MODE_GRANULAR) {
+        reference = [mode, quality](float* out) {
+          RenderClouds(mode, quality, false, out);
+        };
+      }
+      kernels.push_back({
+          std::string("clouds/") + modes[mode] + "/" + qualities[quality], 2,
+          [mode, quality](float* out) {
+            RenderClouds(mode, quality, true, out);
+          },
+          reference });
+    }
+  }
+  kernels.push_back({ "clouds/src_round_trip", 2, RenderSrc,
+                      RenderSrcDirect });
+  kernels.push_back({ "clouds/spectral_kernels", 4, RenderSpectralKernels,
+                      RenderSpectralKernelsLibm });
+  kernels.push_back({ "effects/echo_delay", 1, RenderEchoDelay, nullptr });
+  kernels.push_back({ "effects/reverb_sc16", 2, RenderReverbSc16, nullptr });
+  kernels.push_back({ "effects/vocoder_insert", 1, RenderVocoderInsert,
+                      nullptr });
+  kernels.push_back({ "effects/lpf24_block", 1,
+      [](float* out) { RenderBiquadBlock(false, out); },
+      [](float* out) { RenderBiquadSample(false, out); } });
+  kernels.push_back({ "effects/lpf24_block_stereo", 2,
+      [](float* out) { RenderBiquadBlock(true, out); },
+      [](float* out) { RenderBiquadSample(true, out); } });
+  return kernels;
+}
+
+// ---------------------------------------------------------------------------
+// Measures
+
+struct Tolerance {
+  enum Mode { EXACT, MAX_ABS, SPECTRAL } mode;
+  double value;
+};
+
+struct Rule {
+  std::string pattern;
+  Tolerance tolerance;
+};
+
+static bool Matches(const std::string& pattern, const std::string& name) {
+  if (!pattern.empty() && pattern.back() == '*') {
+    return name.compare(0, pattern.size() - 1, pattern, 0,
+                        pattern.size() - 1) == 0;
+  }
+  return pattern == name;
+}
+
+static std::vector<Rule> LoadRules(const char* path) {
+  std::vector<Rule> rules;
+  FILE* f = fopen(path, "r");
+  if (!f) {
+    return rules;
+  }
+  char line[256];
+  while (fgets(line, sizeof(line), f)) {
+    char pattern[128];
+    char mode[32];
+    double value = 0.0;
+    if (line[0] == '#' ||
+        sscanf(line, "%127s %31s %lf", pattern, mode, &value) < 2) {
+      continue;
+    }
+    Rule rule;
+    rule.pattern = pattern;
+    rule.tolerance.value = value;
+    if (!strcmp(mode, "max_abs")) {
+      rule.tolerance.mode = Tolerance::MAX_ABS;
+    } else if (!strcmp(mode, "spectral")) {
+      rule.tolerance.mode = Tolerance::SPECTRAL;
+    } else if (!strcmp(mode, "exact")) {
+      rule.tolerance.mode = Tolerance::EXACT;
+    } else {
+      fprintf(stderr, "%s: unknown mode '%s'\n", path, mode);
+      continue;
+    }
+    rules.push_back(rule);
+  }
+  fclose(f);
+  return rules;
+}
+
+static Tolerance FindTolerance(
+    const std::vector<Rule>& rules,
+    const std::string& name) {
+  for (const Rule& rule : rules) {
+    if (Matches(rule.pattern, name)) {
+      return rule.tolerance;
+    }
+  }
+  return Tolerance { Tolerance::EXACT, 0.0 };
+}
+
+static const size_t kFftSize = 1024;
+
+static void Fft(std::complex<double>* x, size_t n) {
+  for (size_t i = 1, j = 0; i < n; ++i) {
+    size_t bit = n >> 1;
+    for (; j & bit; bit >>= 1) {
+      j ^= bit;
+    }
+    j ^= bit;
+    if (i < j) {
+      std::swap(x[i], x[j]);
+    }
+  }
+  for (size_t length = 2; length <= n; length <<= 1) {
+    const double angle = -2.0 * kPi / length;
+    const std::complex<double> w_length(cos(angle), sin(angle));
+    for (size_t i = 0; i < n; i += length) {
+      std::complex<double> w(1.0, 0.0);
+      for (size_t k = 0; k < length / 2; ++k) {
+        std::complex<double> u = x[i + k];
+        std::complex<double> v = x[i + k + length / 2] * w;
+        x[i + k] = u + v;
+        x[i + k + length / 2] = u - v;
+        w *= w_length;
+      }
+    }
+  }
+}
+
+// Energy of |X_ref| - |X_test| over all frames and channels, relative to
+// the energy of |X_ref|, in dB. -inf for identical spectra.
+static double SpectralError(
+    const float* reference,
+    const float* test,
+    size_t frames,
+    int channels) {
+  std::vector<std::complex<double> > a(kFftSize);
+  std::vector<std::complex<double> > b(kFftSize);
+  double error = 0.0;
+  double energy = 0.0;
+  for (int ch = 0; ch < channels; ++ch) {
+    for (size_t start = 0; start + kFftSize <= frames; start += kFftSize / 2) {
+      for (size_t i = 0; i < kFftSize; ++i) {
+        double window = 0.5 - 0.5 * cos(2.0 * kPi * i / kFftSize);
+        a[i] = reference[(start + i) * channels + ch] * window;
+        b[i] = test[(start + i) * channels + ch] * window;
+      }
+      Fft(a.data(), kFftSize);
+      Fft(b.data(), kFftSize);
+      for (size_t i = 0; i <= kFftSize / 2; ++i) {
+        double d = std::abs(a[i]) - std::abs(b[i]);
+        error += d * d;
+        energy += std::norm(a[i]);
+      }
+    }
+  }
+  if (error == 0.0) {
+    return -INFINITY;
+  }
+  return 10.0 * log10(error / std::max(energy, 1e-30));
+}
+
+struct Report {
+  bool bit_exact;
+  double max_abs;
+  double snr_db;
+  double spectral_db;
+};
+
+static Report Compare(
+    const float* reference,
+    const float* test,
+    size_t frames,
+    int channels) {
+  Report r;
+  const size_t n = frames * channels;
+  r.bit_exact = memcmp(reference, test, n * sizeof(float)) == 0;
+  r.max_abs = 0.0;
+  double signal = 0.0;
+  double noise = 0.0;
+  for (size_t i = 0; i < n; ++i) {
+    double d = static_cast<double>(reference[i]) - test[i];
+    r.max_abs = std::max(r.max_abs, fabs(d));
+    signal += static_cast<double>(reference[i]) * reference[i];
+    noise += d * d;
+  }
+  r.snr_db = noise == 0.0
+      ? INFINITY
+      : 10.0 * log10(std::max(signal, 1e-30) / noise);
+  r.spectral_db = r.bit_exact
+      ? -INFINITY
+      : SpectralError(reference, test, frames, channels);
+  return r;
+}
+
+static bool Passes(const Report& r, const Tolerance& t) {
+  switch (t.mode) {
+    case Tolerance::EXACT: return r.bit_exact;
+    case Tolerance::MAX_ABS: return r.max_abs <= t.value;
+    case Tolerance::SPECTRAL: return r.spectral_db <= t.value;
+  }
+  return false;
+}
+
+static void PrintReport(
+    const Kernel& k,
+    const Report& r,
+    const Tolerance& t,
+    bool pass) {
+  const char* modes[] = { "exact", "max_abs", "spectral" };
+  printf("%-4s %-40s %-5s max_abs %.3e  snr %7.1f dB  spectral %7.1f dB  "
+         "[%s",
+         pass ? "ok" : "FAIL", k.name.c_str(), r.bit_exact ? "exact" : "",
+         r.max_abs, r.snr_db, r.spectral_db, modes[t.mode]);
+  if (t.mode != Tolerance::EXACT) {
+    printf(" %g", t.value);
+  }
+  printf("]\n");
+}
+
+// ---------------------------------------------------------------------------
+
+static std::string ReferencePath(const char* dir, const std::string& name) {
+  std::string file = name;
+  std::replace(file.begin(), file.end(), '/', '_');
+  return std::string(dir) + "/" + file + ".f32";
+}
+
+static int Usage(const char* argv0) {
+  fprintf(stderr,
+          "usage: %s record DIR | compare DIR | pairs\n"
+          "          [--tolerances FILE] [--filter PREFIX] [--block N]\n",
+          argv0);
+  return 2;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    return Usage(argv[0]);
+  }
+  const std::string command = argv[1];
+  const char* dir = NULL;
+  int arg = 2;
+  if (command == "record" || command == "compare") {
+    if (argc < 3) {
+      return Usage(argv[0]);
+    }
+    dir = argv[2];
+    arg = 3;
+  } else if (command != "pairs") {
+    return Usage(argv[0]);
+  }
+
+  const char* tolerances = "tools/golden/tolerances.txt";
+  const char* filter = "";
+  for (; arg < argc; ++arg) {
+    if (!strcmp(argv[arg], "--tolerances") && arg + 1 < argc) {
+      tolerances = argv[++arg];
+    } else if (!strcmp(argv[arg], "--filter") && arg + 1 < argc) {
+      filter = argv[++arg];
+    } else if (!strcmp(argv[arg], "--block") && arg + 1 < argc) {
+      block_size = strtoul(argv[++arg], NULL, 10);
+    } else {
+      return Usage(argv[0]);
+    }
+  }
+  if (block_size == 0 || block_size > kMaxBlock ||
+      kRenderFrames % block_size) {
+    fprintf(stderr, "block size must divide %zu and be at most %zu\n",
+            kRenderFrames, kMaxBlock);
+    return 2;
+  }
+
+  plaits::PlaitsResourcesInit();
+  LutResidency::Init();
+  InitSignal();
+  const std::vector<Rule> rules = LoadRules(tolerances);
+
+  static float output[kRenderFrames * kMaxChannels];
+  static float reference[kRenderFrames * kMaxChannels];
+  int failures = 0;
+  for (const Kernel& k : MakeKernels()) {
+    if (k.name.compare(0, strlen(filter), filter) != 0) {
+      continue;
+    }
+    const size_t n = kRenderFrames * k.channels;
+    if (command == "pairs" && !k.reference) {
+      continue;
+    }
+    k.render(output);
+
+    if (command == "record") {
+      const std::string path = ReferencePath(dir, k.name);
+      FILE* f = fopen(path.c_str(), "wb");
+      if (!f || fwrite(output, sizeof(float), n, f) != n) {
+        fprintf(stderr, "cannot write %s\n", path.c_str());
+        return 1;
+      }
+      fclose(f);
+      printf("recorded %s\n", k.name.c_str());
+      continue;
+    }
+
+    if (command == "pairs") {
+      k.reference(reference);
+    } else {
+      const std::string path = ReferencePath(dir, k.name);
+      FILE* f = fopen(path.c_str(), "rb");
+      size_t read = f ? fread(reference, sizeof(float), n, f) : 0;
+      if (f) {
+        fclose(f);
+      }
+      if (read != n) {
+        printf("FAIL %-40s no reference at %s\n", k.name.c_str(),
+               path.c_str());
+        ++failures;
+        continue;
+      }
+    }
+    const Tolerance t = FindTolerance(rules, k.name);
+    const Report r = Compare(reference, output, kRenderFrames, k.channels);
+    const bool pass = Passes(r, t);
+    PrintReport(k, r, t, pass);
+    failures += pass ? 0 : 1;
+  }
+  if (command != "record") {
+    printf("%d failure%s\n", failures, failures == 1 ? "" : "s");
+  }
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,188 @@
+// Host profile of hot lookup-table usage (LutResidency.h).
+//
+// Runs the tools/bench scenarios with the LUT_PROFILE lookup counters on:
+// every Plaits engine (through plaits::Voice, as Polyphony renders them) at
+// the bench's HARMONICS/TIMBRE/MORPH points, and Clouds in every quality on
+// the bench's test signal, kSamples samples each. Clouds only runs the
+// playback modes the firmware selects (granular, see Interface.cpp) unless
+// --all-modes is given, as the bench does. Prints
+// lookups per table, lookups per byte of table (what a cache line in RAM
+// buys) and the masks a greedy fill of the default arenas picks; the
+// defaults in LutResidency.h are this output, so paste the new masks there
+// if they differ.
+//
+//   make -C tools/lut_profile && tools/lut_profile/lut_profile [--all-modes]
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "LutResidency.h"
+#include "clouds/dsp/granular_processor.h"
+#include "plaits/dsp/voice.h"
+
+static const size_t kBlockSize = 32;
+static const size_t kSamples = 16000;
+static const size_t kTriggerInterval = 8000;
+static const size_t kDtcmBytes = 9216;
+static const size_t kSramBytes = 24576;
+static const size_t kCloudsGrainStagingSize = 4096;
+
+// As in tools/bench
+struct Point {
+  float harmonics;
+  float timbre;
+  float morph;
+};
+
+static const Point kPoints[] = {
+  { 0.1f, 0.1f, 0.1f },
+  { 0.5f, 0.5f, 0.5f },
+  { 0.9f, 0.9f, 0.9f },
+  { 0.9f, 0.1f, 0.5f },
+  { 0.1f, 0.9f, 0.5f },
+};
+
+static const size_t kSignalSize = 4096;
+static float test_signal[kSignalSize];
+
+static void InitSignal() {
+  uint32_t rng = 1;
+  for (size_t i = 0; i < kSignalSize; ++i) {
+    rng = rng * 1664525u + 1013904223u;
+    float noise = static_cast<float>(rng >> 8) / 16777216.0f - 0.5f;
+    test_signal[i] = 0.25f * noise + 0.4f * sinf(i * 2.0f * 3.14159265f / 256.0f);
+  }
+}
+
+static char plaits_buffer[262144];
+static uint8_t clouds_buffer[118784];
+static uint8_t clouds_buffer_ccm[65408];
+static float clouds_grain_staging[kCloudsGrainStagingSize];
+
+static void ProfilePlaits() {
+  static plaits::Voice voice;
+  stmlib::BufferAllocator allocator(plaits_buffer, sizeof(plaits_buffer));
+  voice.Init(&allocator);
+
+  plaits::Patch patch = { };
+  patch.note = 48.0f;
+  patch.decay = 0.5f;
+  patch.lpg_colour = 0.5f;
+  plaits::Modulations modulations = { };
+  modulations.trigger_patched = true;
+  plaits::Voice::Frame frames[kBlockSize];
+
+  for (int engine = 0; engine < voice.GetNumEngines(); ++engine) {
+    patch.engine = engine;
+    for (const Point& point : kPoints) {
+      patch.harmonics = point.harmonics;
+      patch.timbre = point.timbre;
+      patch.morph = point.morph;
+      for (size_t clock = 0; clock < kSamples; clock += kBlockSize) {
+        modulations.trigger = clock % kTriggerInterval == 0 ? 1.0f : 0.0f;
+        voice.Render(patch, modulations, frames, kBlockSize);
+      }
+    }
+  }
+}
+
+static void ProfileClouds(bool all_modes) {
+  static clouds::GranularProcessor processor;
+  clouds::ShortFrame input[kBlockSize];
+  clouds::ShortFrame output[kBlockSize];
+
+  for (int mode = 0; mode < clouds::PLAYBACK_MODE_LAST; ++mode) {
+    if (!all_modes && mode != clouds::PLAYBACK_MODE_GRANULAR) {
+      continue;
+    }
+    // set_quality(): bit 0 mono, bit 1 low fidelity
+    for (int quality = 0; quality < 4; ++quality) {
+      processor.Init(
+          clouds_buffer, sizeof(clouds_buffer),
+          clouds_buffer_ccm, sizeof(clouds_buffer_ccm));
+      processor.set_grain_staging_buffer(
+          clouds_grain_staging, kCloudsGrainStagingSize);
+      processor.set_playback_mode(static_cast<clouds::PlaybackMode>(mode));
+      processor.set_quality(quality);
+      clouds::Parameters* p = processor.mutable_parameters();
+      p->position = 0.5f;
+      p->size = 0.5f;
+      p->pitch = 0.0f;
+      p->density = 0.7f;
+      p->texture = 0.5f;
+      p->dry_wet = 1.0f;
+      p->stereo_spread = 0.5f;
+      p->feedback = 0.2f;
+      p->reverb = 0.3f;
+      p->freeze = false;
+      p->trigger = false;
+      p->gate = false;
+
+      size_t position = 0;
+      for (size_t n = 0; n < kSamples; n += kBlockSize) {
+        for (size_t i = 0; i < kBlockSize; ++i) {
+          int16_t s = static_cast<int16_t>(
+              test_signal[(position + i) % kSignalSize] * 16384.0f);
+          input[i].l = input[i].r = s;
+        }
+        position += kBlockSize;
+        processor.Prepare();
+        processor.Process(input, output, kBlockSize);
+      }
+    }
+  }
+}
+
+static uint32_t GreedyFill(const int* order, size_t budget, uint32_t taken) {
+  uint32_t mask = 0;
+  size_t used = 0;
+  for (int i = 0; i < HOT_TABLE_LAST; ++i) {
+    HotTableId id = static_cast<HotTableId>(order[i]);
+    size_t bytes = (LutResidency::bytes(id) + 3) & ~3;
+    if ((taken & HotTableMask(id)) || !hot_table_access_count[id] ||
+        used + bytes > budget) {
+      continue;
+    }
+    mask |= HotTableMask(id);
+    used += bytes;
+  }
+  return mask;
+}
+
+int main(int argc, char** argv) {
+  const bool all_modes = argc > 1 && !strcmp(argv[1], "--all-modes");
+  plaits::PlaitsResourcesInit();
+  InitSignal();
+  ProfilePlaits();
+  ProfileClouds(all_modes);
+
+  int order[HOT_TABLE_LAST];
+  for (int i = 0; i < HOT_TABLE_LAST; ++i) {
+    order[i] = i;
+  }
+  auto per_byte = [](int id) {
+    return static_cast<double>(hot_table_access_count[id]) /
+        LutResidency::bytes(static_cast<HotTableId>(id));
+  };
+  std::sort(&order[0], &order[HOT_TABLE_LAST], [&](int a, int b) {
+    return per_byte(a) > per_byte(b);
+  });
+
+  printf("%-30s %8s %12s %10s\n", "table", "bytes", "lookups", "per byte");
+  for (int i = 0; i < HOT_TABLE_LAST; ++i) {
+    HotTableId id = static_cast<HotTableId>(order[i]);
+    printf("%-30s %8zu %12u %10.1f\n",
+           LutResidency::name(id), LutResidency::bytes(id),
+           hot_table_access_count[id], per_byte(id));
+  }
+
+  uint32_t dtcm = GreedyFill(order, kDtcmBytes, 0);
+  uint32_t sram = GreedyFill(order, kSramBytes, dtcm);
+  printf("\nHOT_LUT_DTCM_MASK=0x%03x HOT_LUT_SRAM_MASK=0x%03x\n", dtcm, sram);
+  printf("defaults:         0x%03x                   0x%03x\n",
+         HOT_LUT_DTCM_MASK, HOT_LUT_SRAM_MASK);
+  return 0;
+}
@@ -0,0 +1,694 @@
+// Host tests for the SD storage code: WAV files written to a temporary
+// directory are streamed back through FileStreamSource, the stand-in for the
+// card, and the output is checked sample for sample, across the ring's halves,
+// the end of the file, loops and underruns. AudioRecorder takes are written
+// through FileStreamSink and read back: header, dropped-block silence and the
+// alignment of every write.
+//
+//   make -C tools/storage_test test
+//
+// Prints one line per failed check and exits non-zero if there was any.
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "AudioRecorder.h"
+#include "SampleStreaming.h"
+
+static const float kSampleRate = 32000.0f;
+static const size_t kBlockSize = 32;
+
+static int failures = 0;
+static int checks = 0;
+
+#define CHECK(condition, ...)                       \
+  do {                                              \
+    ++checks;                                       \
+    if (!(condition)) {                             \
+      ++failures;                                   \
+      printf("FAIL %s:%d: ", __FILE__, __LINE__);   \
+      printf(__VA_ARGS__);                          \
+      printf("\n");                                 \
+    }                                               \
+  } while (0)
+
+static std::string directory;
+
+static std::string TempPath(const char* name) {
+  return directory + "/" + name;
+}
+
+static void PutLe16(std::vector<uint8_t>* out, uint32_t value) {
+  out->push_back(value & 0xff);
+  out->push_back((value >> 8) & 0xff);
+}
+
+static void PutLe32(std::vector<uint8_t>* out, uint32_t value) {
+  PutLe16(out, value & 0xffff);
+  PutLe16(out, value >> 16);
+}
+
+// 16-bit PCM, with an odd-sized LIST chunk before "data" so that the header
+// parser has to walk (and pad) the chunk list.
+static bool WriteWav(const std::string& path, int channels, uint32_t rate,
+                     const std::vector<int16_t>& samples) {
+  const uint32_t data_size = samples.size() * sizeof(int16_t);
+  std::vector<uint8_t> wav;
+  wav.insert(wav.end(), { 'R', 'I', 'F', 'F' });
+  PutLe32(&wav, 4 + 24 + 8 + 4 + 8 + data_size);
+  wav.insert(wav.end(), { 'W', 'A', 'V', 'E', 'f', 'm', 't', ' ' });
+  PutLe32(&wav, 16);
+  PutLe16(&wav, 1);
+  PutLe16(&wav, channels);
+  PutLe32(&wav, rate);
+  PutLe32(&wav, rate * channels * 2);
+  PutLe16(&wav, channels * 2);
+  PutLe16(&wav, 16);
+  wav.insert(wav.end(), { 'L', 'I', 'S', 'T' });
+  PutLe32(&wav, 3);
+  wav.insert(wav.end(), { 'a', 'b', 'c', 0 });
+  wav.insert(wav.end(), { 'd', 'a', 't', 'a' });
+  PutLe32(&wav, data_size);
+  for (int16_t sample : samples) {
+    PutLe16(&wav, static_cast<uint16_t>(sample));
+  }
+
+  FileStreamSink sink;
+  return sink.Open(path.c_str()) &&
+         sink.Write(wav.data(), wav.size()) == wav.size() && sink.Sync();
+}
+
+// Never zero, so that a gap of silence cannot pass for samples.
+static std::vector<int16_t> Pattern(size_t size) {
+  std::vector<int16_t> samples(size);
+  for (size_t i = 0; i < size; ++i) {
+    samples[i] = static_cast<int16_t>(1 + (i * 37) % 30000) *
+                 ((i / 7) % 2 ? 1 : -1);
+  }
+  return samples;
+}
+
+// ---------------------------------------------------------------------------
+// SampleStreamer
+
+static int16_t ring[SampleStreamer::kRingSize];
+
+// Renders blocks until the streamer stops or max_samples have been rendered;
+// the main loop services the ring after every block.
+static std::vector<float> Stream(SampleStreamer* streamer, size_t max_samples) {
+  std::vector<float> out;
+  while (streamer->IsPlaying() && out.size() < max_samples) {
+    float block[kBlockSize] = { };
+    streamer->Render(block, kBlockSize);
+    out.insert(out.end(), block, block + kBlockSize);
+    streamer->Service();
+  }
+  return out;
+}
+
+// At the output rate the file comes out unchanged, across both halves of the
+// ring several times over, and playback stops at the end of the file.
+static void TestStreamMono() {
+  const size_t size = 3 * SampleStreamer::kRingSize + 123;
+  const std::vector<int16_t> samples = Pattern(size);
+  const std::string path = TempPath("mono.wav");
+  CHECK(WriteWav(path, 1, 32000, samples), "cannot write %s", path.c_str());
+
+  FileStreamSource source;
+  SampleStreamer streamer;
+  streamer.Init(ring, kSampleRate);
+  CHECK(source.Open(path.c_str()), "cannot open %s", path.c_str());
+  CHECK(streamer.Open(&source), "Open failed");
+  CHECK(streamer.info().data_offset == 56, "data at %u",
+        static_cast<unsigned>(streamer.info().data_offset));
+  streamer.SetLooping(false);
+  streamer.Start();
+
+  std::vector<float> out = Stream(&streamer, 2 * size);
+  // The last sample would need the one after it to interpolate against
+  CHECK(out.size() >= size - 1, "stopped after %zu samples", out.size());
+  size_t mismatches = 0;
+  for (size_t i = 0; i < size - 1 && i < out.size(); ++i) {
+    if (out[i] * 32768.0f != samples[i]) {
+      if (!mismatches++) {
+        printf("  first mismatch at %zu: %f vs %d\n", i, out[i] * 32768.0f,
+               samples[i]);
+      }
+    }
+  }
+  CHECK(mismatches == 0, "%zu samples differ", mismatches);
+  for (size_t i = size - 1; i < out.size(); ++i) {
+    CHECK(out[i] == 0.0f, "sample %zu after the end is %f", i, out[i]);
+  }
+  CHECK(!streamer.IsPlaying(), "still playing at the end of the file");
+  CHECK(streamer.underruns() == 0, "%u underruns",
+        static_cast<unsigned>(streamer.underruns()));
+}
+
+// A looped file shorter than a half wraps inside the half.
+static void TestStreamLoop() {
+  const size_t size = 1000;
+  const std::vector<int16_t> samples = Pattern(size);
+  const std::string path = TempPath("loop.wav");
+  CHECK(WriteWav(path, 1, 32000, samples), "cannot write %s", path.c_str());
+
+  FileStreamSource source;
+  SampleStreamer streamer;
+  streamer.Init(ring, kSampleRate);
+  source.Open(path.c_str());
+  CHECK(streamer.Open(&source), "Open failed");
+  streamer.SetLooping(true);
+  streamer.Start();
+
+  const size_t length = 5 * SampleStreamer::kRingSize;
+  std::vector<float> out = Stream(&streamer, length);
+  CHECK(out.size() >= length, "stopped after %zu samples", out.size());
+  size_t mismatches = 0;
+  for (size_t i = 0; i < out.size(); ++i) {
+    mismatches += out[i] * 32768.0f != samples[i % size];
+  }
+  CHECK(mismatches == 0, "%zu looped samples differ", mismatches);
+}
+
+// Stereo frames are summed, and a frame never straddles the two halves.
+static void TestStreamStereo() {
+  const size_t frames = SampleStreamer::kRingSize + 301;
+  const std::vector<int16_t> samples = Pattern(2 * frames);
+  const std::string path = TempPath("stereo.wav");
+  CHECK(WriteWav(path, 2, 32000, samples), "cannot write %s", path.c_str());
+
+  FileStreamSource source;
+  SampleStreamer streamer;
+  streamer.Init(ring, kSampleRate);
+  source.Open(path.c_str());
+  CHECK(streamer.Open(&source), "Open failed");
+  streamer.SetLooping(false);
+  streamer.Start();
+
+  std::vector<float> out = Stream(&streamer, 4 * frames);
+  CHECK(out.size() >= frames - 1, "stopped after %zu frames", out.size());
+  size_t mismatches = 0;
+  for (size_t i = 0; i < frames - 1 && i < out.size(); ++i) {
+    const int32_t sum = samples[2 * i] + samples[2 * i + 1];
+    mismatches += out[i] * 65536.0f != sum;
+  }
+  CHECK(mismatches == 0, "%zu stereo frames differ", mismatches);
+}
+
+// With the main loop stalled the callback plays out the ring, then silence,
+// counting underruns; once serviced it picks up at the next frame.
+static void TestStreamUnderrun() {
+  const size_t size = 4 * SampleStreamer::kRingSize;
+  const std::vector<int16_t> samples = Pattern(size);
+  const std::string path = TempPath("underrun.wav");
+  CHECK(WriteWav(path, 1, 32000, samples), "cannot write %s", path.c_str());
+
+  FileStreamSource source;
+  SampleStreamer streamer;
+  streamer.Init(ring, kSampleRate);
+  source.Open(path.c_str());
+  CHECK(streamer.Open(&source), "Open failed");
+  streamer.SetLooping(false);
+  streamer.Start();
+
+  std::vector<float> out;
+  for (size_t block = 0; block < 2 * SampleStreamer::kRingSize / kBlockSize;
+       ++block) {
+    float buffer[kBlockSize] = { };
+    streamer.Render(buffer, kBlockSize);
+    out.insert(out.end(), buffer, buffer + kBlockSize);
+  }
+  CHECK(streamer.underruns() > 0, "no underrun counted");
+  size_t played = 0;
+  while (played < out.size() && out[played] != 0.0f) {
+    ++played;
+  }
+  CHECK(played == SampleStreamer::kRingSize - 1,
+        "played %zu samples from a full ring", played);
+  for (size_t i = played; i < out.size(); ++i) {
+    CHECK(out[i] == 0.0f, "sample %zu of the underrun is %f", i, out[i]);
+  }
+
+  streamer.Service();
+  std::vector<float> rest = Stream(&streamer, size);
+  size_t mismatches = 0;
+  for (size_t i = 0; i + played < size - 1 && i < rest.size(); ++i) {
+    mismatches += rest[i] * 32768.0f != samples[played + i];
+  }
+  CHECK(rest.size() + played >= size - 1, "stopped early");
+  CHECK(mismatches == 0, "%zu samples differ after the underrun", mismatches);
+}
+
+// A 16 kHz file at 32 kHz: every other output sample interpolates halfway.
+static void TestStreamResample() {
+  const size_t size = SampleStreamer::kRingSize + 77;
+  const std::vector<int16_t> samples = Pattern(size);
+  const std::string path = TempPath("16k.wav");
+  CHECK(WriteWav(path, 1, 16000, samples), "cannot write %s", path.c_str());
+
+  FileStreamSource source;
+  SampleStreamer streamer;
+  streamer.Init(ring, kSampleRate);
+  source.Open(path.c_str());
+  CHECK(streamer.Open(&source), "Open failed");
+  CHECK(streamer.file_rate() == 16000, "rate %u",
+        static_cast<unsigned>(streamer.file_rate()));
+  streamer.SetLooping(false);
+  streamer.Start();
+
+  std::vector<float> out = Stream(&streamer, 4 * size);
+  CHECK(out.size() >= 2 * (size - 1), "stopped after %zu samples", out.size());
+  size_t mismatches = 0;
+  for (size_t i = 0; i + 1 < size && 2 * i + 1 < out.size(); ++i) {
+    const float half = 0.5f * (samples[i] + samples[i + 1]);
+    mismatches += out[2 * i] * 32768.0f != samples[i];
+    mismatches += fabsf(out[2 * i + 1] * 32768.0f - half) > 1e-2f;
+  }
+  CHECK(mismatches == 0, "%zu resampled samples differ", mismatches);
+}
+
+static void TestRejectsFloatWav() {
+  const std::string path = TempPath("float.wav");
+  CHECK(WriteWav(path, 1, 32000, Pattern(100)), "cannot write %s",
+        path.c_str());
+  // Patch the format tag to 3 (IEEE float)
+  FILE* file = fopen(path.c_str(), "r+b");
+  fseek(file, 20, SEEK_SET);
+  fputc(3, file);
+  fclose(file);
+
+  FileStreamSource source;
+  SampleStreamer streamer;
+  streamer.Init(ring, kSampleRate);
+  source.Open(path.c_str());
+  CHECK(!streamer.Open(&source), "a float WAV was accepted");
+}
+
+// ---------------------------------------------------------------------------
+// SampleVoice
+
+static int16_t head[SampleVoice::kHeadSize];
+
+// Note-on gain ramp at output sample i
+static float Ramp(size_t i) {
+  return std::min(static_cast<float>(i + 1) / SampleVoice::kRampSamples, 1.0f);
+}
+
+// Renders blocks of the voice, servicing it after every block unless the
+// main loop is held off for the first stall_blocks blocks.
+static std::vector<float> Play(SampleVoice* voice, size_t max_samples,
+                               size_t stall_blocks = 0) {
+  std::vector<float> out;
+  for (size_t block = 0; voice->IsPlaying() && out.size() < max_samples;
+       ++block) {
+    float buffer[kBlockSize] = { };
+    voice->Render(buffer, kBlockSize);
+    out.insert(out.end(), buffer, buffer + kBlockSize);
+    if (block >= stall_blocks) {
+      voice->Service();
+    }
+  }
+  return out;
+}
+
+// Counts output samples that differ from the file from sample first on,
+// after the note-on ramp.
+static size_t Mismatches(const std::vector<float>& out,
+                         const std::vector<int16_t>& samples, size_t first,
+                         size_t count) {
+  size_t mismatches = 0;
+  for (size_t i = 0; i < count && i < out.size(); ++i) {
+    const float expected = samples[first + i] * Ramp(i);
+    const float tolerance = i < SampleVoice::kRampSamples ? 1e-2f : 0.0f;
+    if (fabsf(out[i] * 32768.0f - expected) > tolerance) {
+      if (!mismatches++) {
+        printf("  first mismatch at %zu: %f vs %f\n", i, out[i] * 32768.0f,
+               expected);
+      }
+    }
+  }
+  return mismatches;
+}
+
+static const size_t kVoiceFileSize =
+    SampleVoice::kHeadSize + 3 * SampleStreamer::kRingSize + 500;
+
+static bool OpenVoice(SampleVoice* voice, FileStreamSource* source,
+                      const std::vector<int16_t>& samples, const char* name) {
+  const std::string path = TempPath(name);
+  if (!WriteWav(path, 1, 32000, samples) || !source->Open(path.c_str())) {
+    return false;
+  }
+  voice->Init(head, ring, kSampleRate);
+  return voice->Open(source);
+}
+
+// A note plays the head from memory and carries on from the ring without a
+// seam, through to the end of the file.
+static void TestVoicePlaysThrough() {
+  const std::vector<int16_t> samples = Pattern(kVoiceFileSize);
+  FileStreamSource source;
+  SampleVoice voice;
+  CHECK(OpenVoice(&voice, &source, samples, "voice.wav"), "Open failed");
+
+  voice.NoteOn(SampleVoice::kRootNote);
+  std::vector<float> out = Play(&voice, 2 * kVoiceFileSize);
+  CHECK(out.size() >= kVoiceFileSize - 1, "stopped after %zu samples",
+        out.size());
+  CHECK(Mismatches(out, samples, 0, kVoiceFileSize - 1) == 0,
+        "played samples differ from the file");
+  CHECK(!voice.IsPlaying(), "still playing at the end of the file");
+  CHECK(voice.underruns() == 0, "%u underruns",
+        static_cast<unsigned>(voice.underruns()));
+}
+
+// A second note fades the first out over kRampSamples, then restarts the
+// file: the stream is rewound to the end of the head for it.
+static void TestVoiceRetrigger() {
+  const std::vector<int16_t> samples = Pattern(kVoiceFileSize);
+  FileStreamSource source;
+  SampleVoice voice;
+  CHECK(OpenVoice(&voice, &source, samples, "retrigger.wav"), "Open failed");
+
+  voice.NoteOn(SampleVoice::kRootNote);
+  // Well into the ring
+  std::vector<float> first = Play(&voice, SampleVoice::kHeadSize + 5000);
+  CHECK(first.size() == SampleVoice::kHeadSize + 5024, "first note %zu",
+        first.size());
+
+  voice.NoteOn(SampleVoice::kRootNote);
+  std::vector<float> out = Play(&voice, 2 * kVoiceFileSize);
+  // The fade-out reaches zero on its last sample, where the note restarts
+  const size_t restart = SampleVoice::kRampSamples;
+  CHECK(out.size() > restart, "nothing after the retrigger");
+  for (size_t i = 0; i + 1 < restart; ++i) {
+    const float gain = 1.0f - static_cast<float>(i + 1) / SampleVoice::kRampSamples;
+    const float expected = samples[first.size() + i] * gain;
+    CHECK(fabsf(out[i] * 32768.0f - expected) < 1e-2f,
+          "fade-out sample %zu: %f vs %f", i, out[i] * 32768.0f, expected);
+  }
+  out.erase(out.begin(), out.begin() + restart);
+  CHECK(Mismatches(out, samples, 0, kVoiceFileSize - 1) == 0,
+        "retriggered note differs from the file");
+}
+
+// With the main loop stalled through the head the note goes silent, counting
+// underruns, and carries on where it stopped once the stream is rewound.
+static void TestVoiceLateService() {
+  const std::vector<int16_t> samples = Pattern(kVoiceFileSize);
+  FileStreamSource source;
+  SampleVoice voice;
+  CHECK(OpenVoice(&voice, &source, samples, "late.wav"), "Open failed");
+
+  voice.NoteOn(SampleVoice::kRootNote);
+  const size_t stall_blocks = SampleVoice::kHeadSize / kBlockSize + 10;
+  std::vector<float> out = Play(&voice, 2 * kVoiceFileSize, stall_blocks);
+  CHECK(voice.underruns() > 0, "no underrun counted");
+  size_t gap = 0;
+  std::vector<float> played;
+  for (float sample : out) {
+    if (sample == 0.0f) {
+      ++gap;
+    } else {
+      played.push_back(sample);
+    }
+  }
+  CHECK(gap >= 10 * kBlockSize, "%zu samples of silence", gap);
+  CHECK(Mismatches(played, samples, 0, kVoiceFileSize - 1) == 0,
+        "samples after the stall differ from the file");
+}
+
+// An octave up reads every other frame.
+static void TestVoicePitch() {
+  const std::vector<int16_t> samples = Pattern(kVoiceFileSize);
+  FileStreamSource source;
+  SampleVoice voice;
+  CHECK(OpenVoice(&voice, &source, samples, "pitch.wav"), "Open failed");
+
+  voice.NoteOn(SampleVoice::kRootNote + 12.0f);
+  std::vector<float> out = Play(&voice, kVoiceFileSize);
+  const size_t length = (kVoiceFileSize - 2) / 2;
+  CHECK(out.size() >= length, "stopped after %zu samples", out.size());
+  std::vector<int16_t> octave;
+  for (size_t i = 0; i < kVoiceFileSize; i += 2) {
+    octave.push_back(samples[i]);
+  }
+  CHECK(Mismatches(out, octave, 0, length) == 0,
+        "octave-up note differs from every other sample");
+}
+
+// A file shorter than the head plays from memory alone; note-off fades out.
+static void TestVoiceShortFileAndNoteOff() {
+  const size_t size = 3000;
+  const std::vector<int16_t> samples = Pattern(size);
+  FileStreamSource source;
+  SampleVoice voice;
+  CHECK(OpenVoice(&voice, &source, samples, "short.wav"), "Open failed");
+
+  voice.NoteOn(SampleVoice::kRootNote);
+  std::vector<float> out = Play(&voice, 2 * size);
+  CHECK(out.size() >= size - 1 && out.size() < size + kBlockSize,
+        "short file played %zu samples", out.size());
+  CHECK(Mismatches(out, samples, 0, size - 1) == 0,
+        "short file differs");
+  CHECK(!voice.IsPlaying(), "still playing at the end of the file");
+
+  voice.NoteOn(SampleVoice::kRootNote);
+  Play(&voice, 1000);
+  voice.NoteOff();
+  std::vector<float> tail = Play(&voice, 1000);
+  CHECK(!voice.IsPlaying(), "still playing after note-off");
+  CHECK(tail.size() <= SampleVoice::kRampSamples + kBlockSize,
+        "note-off took %zu samples", tail.size());
+}
+
+// FileStreamSink that logs where each write of sample data lands.
+class LoggingSink : public StreamSink {
+public:
+  struct Entry {
+    uint32_t offset;
+    size_t bytes;
+  };
+
+  bool Open(const char* path) override {
+    position_ = 0;
+    writes.clear();
+    return file_.Open(path);
+  }
+  void Close() override { file_.Close(); }
+  bool Seek(uint32_t offset) override {
+    position_ = offset;
+    return file_.Seek(offset);
+  }
+  size_t Write(const void* src, size_t bytes) override {
+    if (position_ >= AudioRecorder::kDataOffset) {
+      writes.push_back({ position_, bytes });
+    }
+    size_t written = file_.Write(src, bytes);
+    position_ += written;
+    return written;
+  }
+  bool Sync() override { return file_.Sync(); }
+
+  std::vector<Entry> writes;
+
+private:
+  FileStreamSink file_;
+  uint32_t position_;
+};
+
+// 16-bit stereo, as the dry take
+static const size_t kRecorderBlockBytes = kBlockSize * 2 * sizeof(int16_t);
+static const size_t kChunkBytes =
+    AudioRecorder::kFlushBlocks * kRecorderBlockBytes;
+static uint8_t recorder_ring[AudioRecorder::kRingBlocks * kRecorderBlockBytes];
+static AudioRecorder recorder;
+
+// Never 0, so that silence stands out.
+static int16_t RecordedSample(uint32_t block, size_t i) {
+  return static_cast<int16_t>(1 + (block * 2 * kBlockSize + i) % 30000);
+}
+
+static void CaptureBlock(uint32_t block) {
+  int16_t samples[kBlockSize * 2];
+  for (size_t i = 0; i < kBlockSize * 2; ++i) {
+    samples[i] = RecordedSample(block, i);
+  }
+  recorder.Capture(samples);
+}
+
+static std::vector<int16_t> ReadTake(const std::string& path, WavInfo* info) {
+  FileStreamSource source;
+  std::vector<int16_t> samples;
+  if (!source.Open(path.c_str()) || !ParseWavHeader(source, *info)) {
+    return samples;
+  }
+  samples.resize(info->data_size / sizeof(int16_t));
+  source.Seek(info->data_offset);
+  samples.resize(source.Read(samples.data(), info->data_size) /
+                 sizeof(int16_t));
+  return samples;
+}
+
+static size_t FileSize(const std::string& path) {
+  FILE* f = fopen(path.c_str(), "rb");
+  if (!f) {
+    return 0;
+  }
+  fseek(f, 0, SEEK_END);
+  size_t size = ftell(f);
+  fclose(f);
+  return size;
+}
+
+// Header fields, the data read back, and the header rewritten mid-take.
+static void TestRecorderHeader() {
+  const std::string path = TempPath("take.wav");
+  const uint32_t blocks = AudioRecorder::kHeaderIntervalBlocks + 100;
+  LoggingSink sink;
+  recorder.Init(recorder_ring, kRecorderBlockBytes, 2,
+                AudioRecorder::FORMAT_PCM16, 32000);
+  CHECK(recorder.Start(&sink, path.c_str()), "Start failed");
+  for (uint32_t block = 0; block < blocks; ++block) {
+    CaptureBlock(block);
+    recorder.Service();
+  }
+
+  // Before Stop: the last periodic header is on the card
+  WavInfo info;
+  ReadTake(path, &info);
+  CHECK(info.data_size >= AudioRecorder::kHeaderIntervalBlocks *
+        kRecorderBlockBytes, "mid-take header holds %u bytes", info.data_size);
+
+  recorder.Stop();
+  CHECK(!recorder.recording() && !recorder.failed(), "Stop failed");
+  std::vector<int16_t> samples = ReadTake(path, &info);
+  CHECK(info.format == 1 && info.channels == 2 && info.sample_rate == 32000 &&
+        info.bits_per_sample == 16, "format %u, %u channels, %u Hz, %u bits",
+        info.format, info.channels, info.sample_rate, info.bits_per_sample);
+  CHECK(info.data_offset == AudioRecorder::kDataOffset,
+        "data at %u", info.data_offset);
+  CHECK(info.data_size == blocks * kRecorderBlockBytes,
+        "data size %u", info.data_size);
+  CHECK(FileSize(path) == AudioRecorder::kDataOffset + info.data_size,
+        "file size %zu", FileSize(path));
+  CHECK(recorder.recorded_blocks() == blocks && recorder.dropped_blocks() == 0,
+        "%u blocks recorded, %u dropped", recorder.recorded_blocks(),
+        recorder.dropped_blocks());
+
+  FileStreamSource source;
+  uint8_t riff[8];
+  CHECK(source.Open(path.c_str()) && source.Read(riff, 8) == 8, "no header");
+  const uint32_t riff_size = riff[4] | (riff[5] << 8) | (riff[6] << 16) |
+      (static_cast<uint32_t>(riff[7]) << 24);
+  CHECK(riff_size == FileSize(path) - 8, "RIFF size %u", riff_size);
+
+  size_t mismatches = samples.size() == blocks * kBlockSize * 2 ? 0 : 1;
+  for (size_t i = 0; i < samples.size() && !mismatches; ++i) {
+    mismatches += samples[i] != RecordedSample(i / (kBlockSize * 2),
+                                               i % (kBlockSize * 2));
+  }
+  CHECK(mismatches == 0, "take differs from the captured blocks");
+}
+
+// The ring fills up and three blocks are dropped in the middle of a chunk.
+// They come back as silence in their place, and writes after the gap are
+// cut at the file's chunk boundaries again: every write starts or ends on
+// one, and full chunks start on one.
+static void TestRecorderDroppedBlocks() {
+  const std::string path = TempPath("dropped.wav");
+  const uint32_t kDropped = 3;
+  const uint32_t after = 2 * AudioRecorder::kRingBlocks + 10;
+  LoggingSink sink;
+  recorder.Init(recorder_ring, kRecorderBlockBytes, 2,
+                AudioRecorder::FORMAT_PCM16, 32000);
+  CHECK(recorder.Start(&sink, path.c_str()), "Start failed");
+
+  uint32_t block = 0;
+  for (; block < AudioRecorder::kRingBlocks; ++block) {
+    CaptureBlock(block);
+  }
+  for (uint32_t i = 0; i < kDropped; ++i) {
+    CaptureBlock(block++);   // Ring full: dropped
+  }
+  recorder.Service();         // Frees one chunk
+  for (uint32_t i = 0; i < after; ++i) {
+    CaptureBlock(block++);
+    recorder.Service();
+  }
+  recorder.Stop();
+  CHECK(recorder.dropped_blocks() == kDropped, "%u blocks dropped",
+        recorder.dropped_blocks());
+
+  WavInfo info;
+  std::vector<int16_t> samples = ReadTake(path, &info);
+  const size_t frame_words = kBlockSize * 2;
+  CHECK(samples.size() == static_cast<size_t>(block) * frame_words,
+        "take holds %zu blocks, expected %u", samples.size() / frame_words,
+        block);
+  size_t mismatches = 0;
+  for (size_t i = 0; i < samples.size(); ++i) {
+    const uint32_t b = i / frame_words;
+    const bool dropped = b >= AudioRecorder::kRingBlocks &&
+        b < AudioRecorder::kRingBlocks + kDropped;
+    const int16_t expected = dropped ? 0 : RecordedSample(b, i % frame_words);
+    mismatches += samples[i] != expected;
+  }
+  CHECK(mismatches == 0, "%zu samples differ", mismatches);
+
+  // The last write ends the take wherever it ends
+  size_t full_chunks = 0;
+  size_t unaligned = 0;
+  for (size_t i = 0; i + 1 < sink.writes.size(); ++i) {
+    const uint32_t begin =
+        sink.writes[i].offset - AudioRecorder::kDataOffset;
+    const size_t bytes = sink.writes[i].bytes;
+    if (bytes == kChunkBytes) {
+      ++full_chunks;
+      unaligned += begin % kChunkBytes != 0;
+    } else {
+      unaligned += begin % kChunkBytes != 0 &&
+          (begin + bytes) % kChunkBytes != 0;
+    }
+  }
+  CHECK(unaligned == 0, "%zu writes off the chunk grid", unaligned);
+  CHECK(full_chunks >= block / AudioRecorder::kFlushBlocks - 4,
+        "only %zu full chunks", full_chunks);
+}
+
+int main() {
+  char pattern[] = "/tmp/storage_test.XXXXXX";
+  if (!mkdtemp(pattern)) {
+    perror("mkdtemp");
+    return 1;
+  }
+  directory = pattern;
+
+  TestStreamMono();
+  TestStreamLoop();
+  TestStreamStereo();
+  TestStreamUnderrun();
+  TestStreamResample();
+  TestRejectsFloatWav();
+  TestVoicePlaysThrough();
+  TestVoiceRetrigger();
+  TestVoiceLateService();
+  TestVoicePitch();
+  TestVoiceShortFileAndNoteOff();
+  TestRecorderHeader();
+  TestRecorderDroppedBlocks();
+
+  const std::string remove = "rm -rf " + directory;
+  if (system(remove.c_str()) != 0) {
+    printf("could not remove %s\n", directory.c_str());
+  }
+  printf("%d checks, %d failures\n", checks, failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,220 @@
+#!/usr/bin/env python3
+"""Decodes the Thaumazein binary telemetry stream (see Telemetry.h).
+
+Usage:
+  telemetry_decode.py /dev/ttyACM0            # live, needs pyserial
+  telemetry_decode.py capture.bin             # recorded stream
+  telemetry_decode.py /dev/ttyACM0 --csv      # one CSV row per frame
+  telemetry_decode.py /dev/ttyACM0 --journal glitch
+                                              # control journals to glitch-N.bin
+
+Text printed by hw.PrintLine shares the port; it is passed through to stderr.
+"""
+
+import argparse
+import struct
+import sys
+
+SYNC = b'\xa5\x5a'
+PACKET_STATUS = 0x01
+PACKET_DEADLINE = 0x02
+PACKET_JOURNAL = 0x03
+
+# Must match TelemetryFrame
+STATUS_FORMAT = '<IIHH3IHBB12HIIII'
+STATUS_FIELDS = (
+    ['sequence', 'timestamp_ms', 'cpu_avg', 'cpu_max',
+     'cycles_controls', 'cycles_voices', 'cycles_effects',
+     'touch_state', 'engine', 'voice_active'] +
+    ['adc%d' % i for i in range(12)] +
+    ['stream_underruns', 'dropped', 'deadline_misses', 'deadline_near_misses'])
+STATUS_SIZE = struct.calcsize(STATUS_FORMAT)
+assert STATUS_SIZE == 68
+
+# Must match DeadlineMonitor::Record
+DEADLINE_FORMAT = '<III3I8B'
+DEADLINE_FIELDS = (
+    'timestamp_ms', 'block_cycles', 'interval_cycles',
+    'cycles_controls', 'cycles_voices', 'cycles_effects',
+    'kind', 'worst_stage', 'engine', 'active_voices', 'arp_on',
+    'clouds_mode', 'clouds_grains', 'clouds_quality')
+DEADLINE_SIZE = struct.calcsize(DEADLINE_FORMAT)
+assert DEADLINE_SIZE == 32
+
+# Must match JournalEvent; a journal file is these back to back, for
+# tools/bench --journal
+JOURNAL_EVENT_SIZE = 12
+
+STAGES = ('controls', 'voices', 'effects')
+EVENT_KINDS = {1: 'near-miss', 2: 'MISS', 3: 'late-start'}
+CLOUDS_MODES = ('granular', 'stretch', 'looping-delay', 'spectral')
+
+CPU_HZ = 480e6
+BLOCK_US = 1e6 * 32 / 32000
+
+
+def fletcher16(data):
+  sum1 = sum2 = 0
+  for byte in data:
+    sum1 = (sum1 + byte) % 255
+    sum2 = (sum2 + sum1) % 255
+  return sum1 | (sum2 << 8)
+
+
+def packets(stream, text_out):
+  """Yields (type, payload) tuples, resyncing on the 0xA5 0x5A marker."""
+  buffer = bytearray()
+  while True:
+    chunk = stream.read(256)
+    if not chunk:
+      return
+    buffer.extend(chunk)
+    while True:
+      start = buffer.find(SYNC)
+      if start < 0:
+        keep = 1 if buffer.endswith(SYNC[:1]) else 0
+        text_out.write(buffer[:len(buffer) - keep].decode('ascii', 'replace'))
+        del buffer[:len(buffer) - keep]
+        break
+      if start:
+        text_out.write(buffer[:start].decode('ascii', 'replace'))
+        del buffer[:start]
+      if len(buffer) < 4:
+        break
+      length = buffer[3]
+      total = 4 + length + 2
+      if len(buffer) < total:
+        break
+      checksum = buffer[4 + length] | (buffer[5 + length] << 8)
+      if fletcher16(buffer[2:4 + length]) != checksum:
+        del buffer[:1]  # False sync, keep looking
+        continue
+      yield buffer[2], bytes(buffer[4:4 + length])
+      del buffer[:total]
+
+
+def decode_status(payload):
+  return dict(zip(STATUS_FIELDS, struct.unpack(STATUS_FORMAT, payload)))
+
+
+def decode_deadline(payload):
+  return dict(zip(DEADLINE_FIELDS, struct.unpack(DEADLINE_FORMAT, payload)))
+
+
+def us(cycles):
+  return cycles / CPU_HZ * 1e6
+
+
+def format_status(frame):
+  stages = ' '.join(
+      '%s=%.0fus' % (name, us(frame['cycles_' + name])) for name in STAGES)
+  voices = ''.join('x' if frame['voice_active'] & (1 << v) else '.'
+                   for v in range(4))
+  return ('#%-6d %8.3fs cpu %4.1f/%4.1f%% | %s (block %.0fus) | '
+          'engine %2d voices %s touch %03x | adc8-11 %s | '
+          'underruns %d dropped %d deadline %d/%d' % (
+              frame['sequence'], frame['timestamp_ms'] / 1000.0,
+              frame['cpu_avg'] / 10.0, frame['cpu_max'] / 10.0,
+              stages, BLOCK_US, frame['engine'], voices,
+              frame['touch_state'],
+              ' '.join('%5d' % frame['adc%d' % i] for i in range(8, 12)),
+              frame['stream_underruns'], frame['dropped'],
+              frame['deadline_misses'], frame['deadline_near_misses']))
+
+
+def format_deadline(record):
+  mode = record['clouds_mode']
+  return ('!! %8.3fs %-10s block %.0fus (interval %.0fus) worst=%s [%s] | '
+          'engine %2d voices %d arp %s | clouds %s grains %d quality %d' % (
+              record['timestamp_ms'] / 1000.0,
+              EVENT_KINDS.get(record['kind'], '?'),
+              us(record['block_cycles']), us(record['interval_cycles']),
+              STAGES[record['worst_stage']] if record['worst_stage'] < 3 else '?',
+              ' '.join('%.0f' % us(record['cycles_' + s]) for s in STAGES),
+              record['engine'], record['active_voices'],
+              'on' if record['arp_on'] else 'off',
+              CLOUDS_MODES[mode] if mode < len(CLOUDS_MODES) else mode,
+              record['clouds_grains'], record['clouds_quality']))
+
+
+class JournalWriter(object):
+  """Writes each control journal dump to its own file."""
+
+  def __init__(self, prefix):
+    self.prefix = prefix
+    self.count = 0
+    self.file = None
+    self.expected = 0
+
+  def add(self, payload):
+    index, = struct.unpack('<I', payload[:4])
+    events = payload[4:]
+    if index == 0 or self.file is None:
+      self.close()
+      self.count += 1
+      path = '%s-%d.bin' % (self.prefix, self.count)
+      self.file = open(path, 'wb')
+      self.expected = 0
+      sys.stderr.write('-- control journal dump -> %s\n' % path)
+    if index != self.expected:
+      sys.stderr.write('-- journal: lost events %d-%d\n' % (
+          self.expected, index - 1))
+    self.file.seek(index * JOURNAL_EVENT_SIZE)
+    self.file.write(events)
+    self.expected = index + len(events) // JOURNAL_EVENT_SIZE
+
+  def close(self):
+    if self.file:
+      self.file.close()
+      self.file = None
+
+
+def open_source(path, baud):
+  if path.startswith('/dev/') or path.upper().startswith('COM'):
+    import serial
+    return serial.Serial(path, baud, timeout=0.5)
+  return open(path, 'rb')
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+  parser.add_argument('source', help='serial port or capture file')
+  parser.add_argument('--baud', type=int, default=115200)
+  parser.add_argument('--csv', action='store_true', help='CSV instead of text')
+  parser.add_argument('--journal', metavar='PREFIX',
+                      help='save control journal dumps as PREFIX-N.bin')
+  args = parser.parse_args()
+  journal = JournalWriter(args.journal) if args.journal else None
+
+  source = open_source(args.source, args.baud)
+  if args.csv:
+    print(','.join(STATUS_FIELDS))
+
+  last_sequence = None
+  for packet_type, payload in packets(source, sys.stderr):
+    if packet_type == PACKET_DEADLINE and len(payload) == DEADLINE_SIZE:
+      # Deadline events go to stderr so --csv output stays clean.
+      sys.stderr.write(format_deadline(decode_deadline(payload)) + '\n')
+      continue
+    if packet_type == PACKET_JOURNAL:
+      if journal:
+        journal.add(payload)
+      continue
+    if packet_type != PACKET_STATUS or len(payload) != STATUS_SIZE:
+      continue
+    frame = decode_status(payload)
+    if last_sequence is not None and frame['sequence'] != last_sequence + 1:
+      sys.stderr.write('-- lost %d frame(s)\n' % (
+          frame['sequence'] - last_sequence - 1))
+    last_sequence = frame['sequence']
+    if args.csv:
+      print(','.join(str(frame[f]) for f in STATUS_FIELDS))
+    else:
+      print(format_status(frame))
+    sys.stdout.flush()
+  if journal:
+    journal.close()
+
+
+if __name__ == '__main__':
+  main()